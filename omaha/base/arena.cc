@@ -0,0 +1,129 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/arena.h"
+#include <limits.h>
+#include <string.h>
+#include "omaha/base/debug.h"
+
+namespace omaha {
+
+Arena::Arena()
+    : next_(NULL),
+      remaining_(0),
+      num_allocations_(0),
+      bytes_allocated_(0) {
+}
+
+Arena::~Arena() {
+  for (size_t i = 0; i != blocks_.size(); ++i) {
+    delete[] blocks_[i];
+  }
+}
+
+void* Arena::Allocate(size_t size) {
+  if (!size || size + kAlignment < size) {
+    return NULL;
+  }
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+
+  uint8* memory = NULL;
+  if (size > kBlockSize / 4) {
+    memory = new uint8[size];
+    blocks_.push_back(memory);
+  } else {
+    if (size > remaining_) {
+      next_ = new uint8[kBlockSize];
+      remaining_ = kBlockSize;
+      blocks_.push_back(next_);
+    }
+    memory = next_;
+    next_ += size;
+    remaining_ -= size;
+  }
+
+  ++num_allocations_;
+  bytes_allocated_ += size;
+  return memory;
+}
+
+ArenaStringMgr::ArenaStringMgr() : default_mgr_(CString().GetManager()) {
+  ASSERT1(default_mgr_);
+  nil_string_.SetManager(this);
+}
+
+ArenaStringMgr::~ArenaStringMgr() {
+}
+
+CStringData* ArenaStringMgr::Allocate(int nAllocLength,
+                                      int nCharSize) throw() {
+  ASSERT1(nCharSize > 0);
+  if (nAllocLength < 0 || nAllocLength > (INT_MAX / nCharSize) - 8) {
+    return NULL;
+  }
+
+  // Rounds up the buffer as the default manager does, which lets most short
+  // appends happen in place.
+  const int num_chars = (nAllocLength + 1 + 7) & ~7;
+  CStringData* data = static_cast<CStringData*>(
+      arena_.Allocate(sizeof(CStringData) + num_chars * nCharSize));
+  if (!data) {
+    return NULL;
+  }
+
+  data->pStringMgr = this;
+  data->nRefs = 1;
+  data->nAllocLength = num_chars - 1;
+  data->nDataLength = 0;
+  return data;
+}
+
+// The buffers are freed with the arena.
+void ArenaStringMgr::Free(CStringData* pData) throw() {
+  ASSERT1(pData);
+  ASSERT1(pData->pStringMgr == this);
+  UNREFERENCED_PARAMETER(pData);
+}
+
+CStringData* ArenaStringMgr::Reallocate(CStringData* pData,
+                                        int nAllocLength,
+                                        int nCharSize) throw() {
+  ASSERT1(pData);
+  ASSERT1(pData->pStringMgr == this);
+
+  CStringData* new_data = Allocate(nAllocLength, nCharSize);
+  if (!new_data) {
+    return NULL;
+  }
+
+  ASSERT1(pData->nDataLength <= nAllocLength);
+  memcpy(new_data->data(),
+         pData->data(),
+         (pData->nDataLength + 1) * nCharSize);
+  new_data->nRefs = pData->nRefs;
+  new_data->nDataLength = pData->nDataLength;
+  return new_data;
+}
+
+CStringData* ArenaStringMgr::GetNilString() throw() {
+  nil_string_.AddRef();
+  return &nil_string_;
+}
+
+IAtlStringMgr* ArenaStringMgr::Clone() throw() {
+  return default_mgr_;
+}
+
+}  // namespace omaha
@@ -0,0 +1,106 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Arena allocates memory in large blocks, which are all freed at once when the
+// arena is destroyed. It is meant for many small objects which are built
+// together and die together, such as the strings of a parsed update response,
+// so that they do not cost a heap allocation and a heap free each.
+//
+// ArenaStringMgr is an ATL string manager which allocates the buffers of the
+// CStrings in an arena. A CString uses the manager once it is set with
+// CString::SetManager. Copies of such a string are allocated by the default
+// string manager, so a copy can safely outlive the arena.
+
+#ifndef OMAHA_BASE_ARENA_H_
+#define OMAHA_BASE_ARENA_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class Arena {
+ public:
+  // The size of the blocks. Allocations larger than a quarter of a block get
+  // a block of their own, so they do not waste the rest of the current block.
+  static const size_t kBlockSize = 16 * 1024;
+
+  // The memory is aligned for any of the types the arena is used for.
+  static const size_t kAlignment = 8;
+
+  Arena();
+  ~Arena();
+
+  // Returns 'size' bytes of memory, which are valid until the arena is
+  // destroyed. Returns NULL if 'size' is zero or too large.
+  void* Allocate(size_t size);
+
+  // The number of calls to Allocate which succeeded.
+  size_t num_allocations() const { return num_allocations_; }
+
+  // The number of blocks, which is the number of heap allocations the arena
+  // made.
+  size_t num_blocks() const { return blocks_.size(); }
+
+  // The number of bytes returned by Allocate, including the alignment.
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+ private:
+  std::vector<uint8*> blocks_;
+
+  // The free part of the current block.
+  uint8* next_;
+  size_t remaining_;
+
+  size_t num_allocations_;
+  size_t bytes_allocated_;
+
+  DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+// The manager must outlive all the strings which use it. The strings can be
+// read from any thread, but must be modified on one thread at a time, since
+// the arena is not thread-safe.
+class ArenaStringMgr : public IAtlStringMgr {
+ public:
+  ArenaStringMgr();
+  virtual ~ArenaStringMgr();
+
+  const Arena& arena() const { return arena_; }
+
+  // IAtlStringMgr implementation.
+  virtual CStringData* Allocate(int nAllocLength, int nCharSize) throw();
+  virtual void Free(CStringData* pData) throw();
+  virtual CStringData* Reallocate(CStringData* pData,
+                                  int nAllocLength,
+                                  int nCharSize) throw();
+  virtual CStringData* GetNilString() throw();
+  virtual IAtlStringMgr* Clone() throw();
+
+ private:
+  Arena arena_;
+  CNilStringData nil_string_;
+
+  // The manager of the copies of the strings.
+  IAtlStringMgr* const default_mgr_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArenaStringMgr);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_ARENA_H_
@@ -0,0 +1,139 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <string.h>
+#include "omaha/base/arena.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+TEST(ArenaTest, Allocate) {
+  Arena arena;
+  EXPECT_EQ(0, arena.num_blocks());
+  EXPECT_TRUE(arena.Allocate(0) == NULL);
+
+  uint8* first = static_cast<uint8*>(arena.Allocate(1));
+  uint8* second = static_cast<uint8*>(arena.Allocate(10));
+  uint8* third = static_cast<uint8*>(arena.Allocate(Arena::kAlignment));
+  ASSERT_TRUE(first && second && third);
+
+  // The allocations are aligned and follow each other in the same block.
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(first) % Arena::kAlignment);
+  EXPECT_EQ(first + Arena::kAlignment, second);
+  EXPECT_EQ(second + 2 * Arena::kAlignment, third);
+  memset(first, 0xab, 1);
+  memset(second, 0xcd, 10);
+  memset(third, 0xef, Arena::kAlignment);
+
+  EXPECT_EQ(3, arena.num_allocations());
+  EXPECT_EQ(1, arena.num_blocks());
+  EXPECT_EQ(4 * Arena::kAlignment, arena.bytes_allocated());
+}
+
+TEST(ArenaTest, Allocate_NewBlocks) {
+  Arena arena;
+  const size_t kSize = Arena::kBlockSize / 4;
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(arena.Allocate(kSize) != NULL);
+  }
+  EXPECT_EQ(1, arena.num_blocks());
+
+  EXPECT_TRUE(arena.Allocate(1) != NULL);
+  EXPECT_EQ(2, arena.num_blocks());
+
+  // A large allocation gets a block of its own, and the next allocations
+  // continue in the current block.
+  uint8* small = static_cast<uint8*>(arena.Allocate(1));
+  uint8* large = static_cast<uint8*>(arena.Allocate(Arena::kBlockSize * 2));
+  ASSERT_TRUE(large != NULL);
+  memset(large, 0, Arena::kBlockSize * 2);
+  EXPECT_EQ(3, arena.num_blocks());
+  EXPECT_EQ(small + Arena::kAlignment,
+            static_cast<uint8*>(arena.Allocate(1)));
+  EXPECT_EQ(3, arena.num_blocks());
+}
+
+TEST(ArenaStringMgrTest, SetManager) {
+  ArenaStringMgr string_mgr;
+  CString s;
+  s.SetManager(&string_mgr);
+  EXPECT_TRUE(s.IsEmpty());
+  EXPECT_EQ(0, string_mgr.arena().num_allocations());
+
+  s = _T("{8A69D345-D564-463C-AFF1-A69D9E530F96}");
+  EXPECT_STREQ(_T("{8A69D345-D564-463C-AFF1-A69D9E530F96}"), s);
+  EXPECT_EQ(1, string_mgr.arena().num_allocations());
+
+  // Strings from the default manager are copied into the arena.
+  const CString status(_T("noupdate"));
+  CString t;
+  t.SetManager(&string_mgr);
+  t = status;
+  EXPECT_STREQ(_T("noupdate"), t);
+  EXPECT_NE(status.GetString(), t.GetString());
+  EXPECT_EQ(2, string_mgr.arena().num_allocations());
+}
+
+TEST(ArenaStringMgrTest, Append) {
+  ArenaStringMgr string_mgr;
+  CString s;
+  s.SetManager(&string_mgr);
+  s = _T("a");
+
+  // The buffer is rounded up, so short appends happen in place.
+  s += _T("bc");
+  EXPECT_EQ(1, string_mgr.arena().num_allocations());
+
+  CString expected(_T("abc"));
+  for (int i = 0; i < 100; ++i) {
+    s += _T("0123456789");
+    expected += _T("0123456789");
+  }
+  EXPECT_STREQ(expected, s);
+  EXPECT_LT(1, string_mgr.arena().num_allocations());
+}
+
+TEST(ArenaStringMgrTest, CopiesOutliveTheArena) {
+  CString copy;
+  CString constructed_copy;
+  CString left;
+  {
+    ArenaStringMgr string_mgr;
+    CString s;
+    s.SetManager(&string_mgr);
+    s = _T("http://dl.google.com/update2/");
+    EXPECT_EQ(1, string_mgr.arena().num_allocations());
+
+    copy = s;
+    CString other_copy(s);
+    constructed_copy = other_copy;
+    left = s.Left(4);
+
+    // The copies do not share the buffer of the string and are not allocated
+    // in the arena.
+    EXPECT_NE(s.GetString(), copy.GetString());
+    EXPECT_NE(s.GetString(), other_copy.GetString());
+    EXPECT_EQ(1, string_mgr.arena().num_allocations());
+  }
+
+  EXPECT_STREQ(_T("http://dl.google.com/update2/"), copy);
+  EXPECT_STREQ(_T("http://dl.google.com/update2/"), constructed_copy);
+  EXPECT_STREQ(_T("http"), left);
+
+  copy += _T("installers/");
+  EXPECT_STREQ(_T("http://dl.google.com/update2/installers/"), copy);
+}
+
+}  // namespace omaha
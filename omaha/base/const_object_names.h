@@ -66,11 +66,22 @@ const TCHAR* const kCrashHandlerSingleInstance =
 const TCHAR* const kUpdateAppsSingleInstance =
     _T("{0EADE80E-E9B8-4A5D-AF64-6D2A918F597C}");
 
+// Signaled by the core to request an update cycle from the persistent /ua
+// process, which creates the event and waits on it between cycles.
+const TCHAR* const kUpdateAppsCycleEvent =
+    _T("{E36C8037-456C-458B-80A5-ED3410EF6FBA}");
+
 // Ensures only one installer for an app is running in a session.
 // The %s is replaced with the application ID.
 const TCHAR* const kInstallAppSingleInstance =
     _T("%s-{0684C3E2-4EFA-4D1C-AE8D-A61945B94687}");
 
+// Signaled by the COM server when the state or the progress of a bundle
+// changes, so that the client does not have to poll the server for it.
+// The %s is replaced with the session ID of the bundle.
+const TCHAR* const kBundleProgressEvent =
+    _T("%s-{986143E5-BB8A-4CE9-A587-F1D959F7AE05}");
+
 // Ensures the BraveUpdate3 server only runs one instance per machine and one
 // instance per each user session.
 const TCHAR* const kBraveUpdate3SingleInstance =
@@ -339,6 +339,20 @@ const TCHAR* const kRegValueDisableUpdateAppsHourlyJitter =
 // update check. This value must be set before the core process starts.
 const TCHAR* const kRegValueMonitorLastChecked = _T("MonitorLastChecked");
 
+// Enables the persistent update worker if the value is 1. The core starts one
+// /ua process which stays alive and runs the update cycles the core requests,
+// instead of starting a new /ua process for every cycle.
+const TCHAR* const kRegValuePersistentUpdateWorker =
+    _T("PersistentUpdateWorker");
+
+// Specifies a directory where each process writes a trace of its startup
+// phases when it exits. See StartupTrace.
+const TCHAR* const kRegValueStartupTraceDir = _T("StartupTraceDir");
+
+// Enables SpanTrace and specifies a directory where each process writes the
+// spans it recorded when it exits.
+const TCHAR* const kRegValueSpanTraceDir = _T("SpanTraceDir");
+
 // The test_source value to use for Omaha instances that have
 // customizations, and hence should be discarded from metrics.
 const TCHAR* const kRegValueTestSourceAuto     = _T("auto");
@@ -428,6 +442,13 @@ const int kMinLastCheckPeriodSec = 60;  // 60 seconds minimum.
 const int kAUCheckPeriodMs             = 60 * 60 * 1000;  // Hourly.
 const int kAUCheckPeriodInternalUserMs = 30 * 60 * 1000;  // 30 minutes.
 
+// A persistent update worker exits after it has run this many update cycles,
+// after it has been alive for this long, or when its working set grows beyond
+// this size. The core starts a new worker for the next cycle.
+const int kPersistentUpdateWorkerMaxCycles = 24;
+const int kPersistentUpdateWorkerMaxAgeMs = 24 * 60 * 60 * 1000;  // 1 day.
+const int kPersistentUpdateWorkerMaxWorkingSetBytes = 32 * 1024 * 1024;
+
 // Avoids starting workers too soon. This helps reduce disk thrashing at
 // boot or logon, as well as needlessly starting a worker after setting up.
 const int kUpdateTimerStartupDelayMinMs = 5 * 60 * 1000;   // 5 minutes.
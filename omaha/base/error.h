@@ -402,6 +402,17 @@ const ULONG kFacilityOmaha = 67;
 #define OMAHA_NET_E_EXCEEDED_MAX_RETRY_DELAY        \
     MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x892)
 
+// A download was abandoned because its throughput stayed below the minimum
+// throughput set for the request, so that the file can be downloaded from
+// another url instead.
+#define OMAHA_NET_E_DOWNLOAD_TOO_SLOW               \
+    MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x893)
+
+// A request was not sent because the host failed repeatedly and the circuit
+// breaker for the host is open until its cooldown is over.
+#define OMAHA_NET_E_HOST_UNAVAILABLE                \
+    MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x894)
+
 // Install Manager custom error codes.
 #define GOOPDATEINSTALL_E_FILENAME_INVALID         \
     MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x900)
@@ -0,0 +1,300 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/registry_snapshot.h"
+#include <algorithm>
+#include <iterator>
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/scoped_any.h"
+
+namespace omaha {
+
+RegistrySnapshot::RegistrySnapshot() {
+}
+
+RegistrySnapshot::~RegistrySnapshot() {
+  Clear();
+}
+
+void RegistrySnapshot::Clear() {
+  for (Subkeys::iterator it = subkeys_.begin(); it != subkeys_.end(); ++it) {
+    delete it->second;
+  }
+  subkeys_.clear();
+  values_.clear();
+}
+
+HRESULT RegistrySnapshot::Read(const CString& full_key_name, int max_depth) {
+  ASSERT1(max_depth >= 0);
+
+  Clear();
+
+  CString key_name(full_key_name);
+  HKEY root_key = RegKey::GetRootKeyInfo(&key_name);
+  if (!root_key) {
+    return E_INVALIDARG;
+  }
+
+  HKEY key = NULL;
+  LONG result = ::RegOpenKeyEx(root_key, key_name, 0, KEY_READ, &key);
+  if (result != ERROR_SUCCESS) {
+    return HRESULT_FROM_WIN32(result);
+  }
+
+  HRESULT hr = ReadKey(key, max_depth);
+  ::RegCloseKey(key);
+  return hr;
+}
+
+// Sizes the buffers once for the longest name and the largest value data,
+// then reads each value with a single call.
+HRESULT RegistrySnapshot::ReadKey(HKEY key, int max_depth) {
+  ASSERT1(key);
+
+  DWORD num_subkeys = 0;
+  DWORD max_subkey_name_length = 0;
+  DWORD num_values = 0;
+  DWORD max_value_name_length = 0;
+  DWORD max_value_data_size = 0;
+  LONG result = ::RegQueryInfoKey(key,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  &num_subkeys,
+                                  &max_subkey_name_length,
+                                  NULL,
+                                  &num_values,
+                                  &max_value_name_length,
+                                  &max_value_data_size,
+                                  NULL,
+                                  NULL);
+  if (result != ERROR_SUCCESS) {
+    return HRESULT_FROM_WIN32(result);
+  }
+
+  std::vector<TCHAR> name(std::max(max_subkey_name_length,
+                                   max_value_name_length) + 1);
+  std::vector<uint8> data(max_value_data_size + 1);
+
+  for (DWORD i = 0; i < num_values; ++i) {
+    DWORD name_length = static_cast<DWORD>(name.size());
+    DWORD type = REG_NONE;
+    DWORD data_size = static_cast<DWORD>(data.size());
+    result = ::RegEnumValue(key,
+                            i,
+                            &name.front(),
+                            &name_length,
+                            NULL,
+                            &type,
+                            &data.front(),
+                            &data_size);
+    if (result == ERROR_NO_MORE_ITEMS) {
+      break;
+    }
+    if (result != ERROR_SUCCESS) {
+      // The value may have changed after the key was queried.
+      UTIL_LOG(LW, (_T("[RegEnumValue failed][%d]"), result));
+      continue;
+    }
+    SetValueData(&name.front(), type, &data.front(), data_size);
+  }
+
+  if (max_depth == 0) {
+    return S_OK;
+  }
+
+  for (DWORD i = 0; i < num_subkeys; ++i) {
+    DWORD name_length = static_cast<DWORD>(name.size());
+    result = ::RegEnumKeyEx(key, i, &name.front(), &name_length,
+                            NULL, NULL, NULL, NULL);
+    if (result == ERROR_NO_MORE_ITEMS) {
+      break;
+    }
+    if (result != ERROR_SUCCESS) {
+      UTIL_LOG(LW, (_T("[RegEnumKeyEx failed][%d]"), result));
+      continue;
+    }
+
+    HKEY subkey = NULL;
+    result = ::RegOpenKeyEx(key, &name.front(), 0, KEY_READ, &subkey);
+    if (result != ERROR_SUCCESS) {
+      UTIL_LOG(LW, (_T("[RegOpenKeyEx failed][%s][%d]"), &name.front(),
+                    result));
+      continue;
+    }
+
+    HRESULT hr = AddSubkey(&name.front())->ReadKey(subkey, max_depth - 1);
+    ::RegCloseKey(subkey);
+    if (FAILED(hr)) {
+      UTIL_LOG(LW, (_T("[ReadKey failed][%s][0x%08x]"), &name.front(), hr));
+    }
+  }
+
+  return S_OK;
+}
+
+const RegistrySnapshot::Value* RegistrySnapshot::FindValue(
+    const TCHAR* value_name) const {
+  Values::const_iterator it = values_.find(value_name ? value_name : _T(""));
+  return it != values_.end() ? &it->second : NULL;
+}
+
+bool RegistrySnapshot::HasValue(const TCHAR* value_name) const {
+  return FindValue(value_name) != NULL;
+}
+
+HRESULT RegistrySnapshot::GetValue(const TCHAR* value_name,
+                                   CString* value) const {
+  ASSERT1(value);
+
+  const Value* data = FindValue(value_name);
+  if (!data) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+  if (data->type != REG_SZ && data->type != REG_EXPAND_SZ) {
+    return HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+  }
+
+  // The data is not necessarily terminated. Trailing terminators are dropped.
+  const TCHAR* chars = data->data.empty() ?
+      _T("") : reinterpret_cast<const TCHAR*>(&data->data.front());
+  int num_chars = static_cast<int>(data->data.size() / sizeof(TCHAR));
+  while (num_chars > 0 && chars[num_chars - 1] == _T('\0')) {
+    --num_chars;
+  }
+  CString string_value(chars, num_chars);
+
+  if (data->type == REG_EXPAND_SZ) {
+    DWORD size = ::ExpandEnvironmentStrings(string_value, NULL, 0);
+    if (!size) {
+      return HRESULTFromLastError();
+    }
+    CString expanded_value;
+    size = ::ExpandEnvironmentStrings(string_value,
+                                      CStrBuf(expanded_value, size),
+                                      size);
+    if (!size) {
+      return HRESULTFromLastError();
+    }
+    string_value = expanded_value;
+  }
+
+  *value = string_value;
+  return S_OK;
+}
+
+HRESULT RegistrySnapshot::GetValue(const TCHAR* value_name,
+                                   DWORD* value) const {
+  ASSERT1(value);
+
+  const Value* data = FindValue(value_name);
+  if (!data) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+  if (data->type != REG_DWORD || data->data.size() != sizeof(*value)) {
+    return HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+  }
+
+  memcpy(value, &data->data.front(), sizeof(*value));
+  return S_OK;
+}
+
+HRESULT RegistrySnapshot::GetValue(const TCHAR* value_name,
+                                   DWORD64* value) const {
+  ASSERT1(value);
+
+  const Value* data = FindValue(value_name);
+  if (!data) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+  if (data->type != REG_QWORD || data->data.size() != sizeof(*value)) {
+    return HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+  }
+
+  memcpy(value, &data->data.front(), sizeof(*value));
+  return S_OK;
+}
+
+HRESULT RegistrySnapshot::GetValueNameAt(size_t index,
+                                         CString* value_name,
+                                         DWORD* type) const {
+  ASSERT1(value_name);
+
+  if (index >= values_.size()) {
+    return HRESULT_FROM_WIN32(ERROR_NO_MORE_ITEMS);
+  }
+
+  Values::const_iterator it = values_.begin();
+  std::advance(it, index);
+  *value_name = it->first;
+  if (type) {
+    *type = it->second.type;
+  }
+  return S_OK;
+}
+
+const RegistrySnapshot* RegistrySnapshot::GetSubkey(
+    const TCHAR* subkey_name) const {
+  ASSERT1(subkey_name);
+  Subkeys::const_iterator it = subkeys_.find(subkey_name);
+  return it != subkeys_.end() ? it->second : NULL;
+}
+
+CString RegistrySnapshot::GetSubkeyNameAt(size_t index) const {
+  ASSERT1(index < subkeys_.size());
+  Subkeys::const_iterator it = subkeys_.begin();
+  std::advance(it, index);
+  return it->first;
+}
+
+void RegistrySnapshot::SetValue(const TCHAR* value_name,
+                                const CString& value) {
+  SetValueData(value_name,
+               REG_SZ,
+               value.GetString(),
+               (value.GetLength() + 1) * sizeof(TCHAR));
+}
+
+void RegistrySnapshot::SetValue(const TCHAR* value_name, DWORD value) {
+  SetValueData(value_name, REG_DWORD, &value, sizeof(value));
+}
+
+void RegistrySnapshot::SetValue(const TCHAR* value_name, DWORD64 value) {
+  SetValueData(value_name, REG_QWORD, &value, sizeof(value));
+}
+
+RegistrySnapshot* RegistrySnapshot::AddSubkey(const TCHAR* subkey_name) {
+  ASSERT1(subkey_name);
+  RegistrySnapshot*& subkey = subkeys_[subkey_name];
+  if (!subkey) {
+    subkey = new RegistrySnapshot;
+  }
+  return subkey;
+}
+
+void RegistrySnapshot::SetValueData(const TCHAR* value_name,
+                                    DWORD type,
+                                    const void* data,
+                                    size_t size) {
+  Value& value = values_[value_name ? value_name : _T("")];
+  value.type = type;
+  const uint8* bytes = static_cast<const uint8*>(data);
+  value.data.assign(bytes, bytes + size);
+}
+
+}  // namespace omaha
@@ -0,0 +1,107 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#ifndef OMAHA_BASE_REGISTRY_SNAPSHOT_H_
+#define OMAHA_BASE_REGISTRY_SNAPSHOT_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <map>
+#include <vector>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+// An in-memory copy of a registry key, its values, and its subkeys. The
+// snapshot is read with one enumeration of the key instead of one query per
+// value, and the reads it serves do not touch the registry. Snapshots can
+// also be built in memory, for instance, to unit test code which reads from
+// the registry.
+//
+// Value and subkey names are case-insensitive, like they are in the registry.
+class RegistrySnapshot {
+ public:
+  RegistrySnapshot();
+  ~RegistrySnapshot();
+
+  // Reads the values of the key and the subkeys of the key, down to
+  // 'max_depth' levels of subkeys. A 'max_depth' of 0 reads only the values
+  // of the key. Returns HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if the key
+  // does not exist.
+  HRESULT Read(const CString& full_key_name, int max_depth);
+
+  bool HasValue(const TCHAR* value_name) const;
+
+  // Reads the value of type REG_SZ or REG_EXPAND_SZ. REG_EXPAND_SZ values are
+  // expanded. 'value_name' may be NULL for the default value.
+  HRESULT GetValue(const TCHAR* value_name, CString* value) const;
+
+  // Reads the value of type REG_DWORD.
+  HRESULT GetValue(const TCHAR* value_name, DWORD* value) const;
+
+  // Reads the value of type REG_QWORD.
+  HRESULT GetValue(const TCHAR* value_name, DWORD64* value) const;
+
+  size_t GetValueCount() const { return values_.size(); }
+  HRESULT GetValueNameAt(size_t index, CString* value_name, DWORD* type) const;
+
+  // Returns the subkey or NULL if the subkey does not exist or if the subkey
+  // is deeper than the depth of the snapshot.
+  const RegistrySnapshot* GetSubkey(const TCHAR* subkey_name) const;
+
+  size_t GetSubkeyCount() const { return subkeys_.size(); }
+  CString GetSubkeyNameAt(size_t index) const;
+
+  // Builds snapshots in memory. The subkey is owned by this object.
+  void SetValue(const TCHAR* value_name, const CString& value);
+  void SetValue(const TCHAR* value_name, DWORD value);
+  void SetValue(const TCHAR* value_name, DWORD64 value);
+  RegistrySnapshot* AddSubkey(const TCHAR* subkey_name);
+
+ private:
+  struct Value {
+    Value() : type(REG_NONE) {}
+
+    DWORD type;
+    std::vector<uint8> data;
+  };
+
+  struct NameLess {
+    bool operator()(const CString& name1, const CString& name2) const {
+      return name1.CompareNoCase(name2) < 0;
+    }
+  };
+
+  typedef std::map<CString, Value, NameLess> Values;
+  typedef std::map<CString, RegistrySnapshot*, NameLess> Subkeys;
+
+  HRESULT ReadKey(HKEY key, int max_depth);
+  void Clear();
+
+  const Value* FindValue(const TCHAR* value_name) const;
+  void SetValueData(const TCHAR* value_name,
+                    DWORD type,
+                    const void* data,
+                    size_t size);
+
+  Values values_;
+  Subkeys subkeys_;
+
+  DISALLOW_COPY_AND_ASSIGN(RegistrySnapshot);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_REGISTRY_SNAPSHOT_H_
@@ -0,0 +1,172 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/registry_snapshot.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kTestKey = _T("HKCU\\Software\\Test");
+const TCHAR* const kTestSubkey = _T("HKCU\\Software\\Test\\Sub1");
+const TCHAR* const kTestSubSubkey = _T("HKCU\\Software\\Test\\Sub1\\Sub2");
+
+}  // namespace
+
+class RegistrySnapshotRegistryTest : public RegistryProtectedTest {
+};
+
+TEST(RegistrySnapshotTest, InMemoryValues) {
+  RegistrySnapshot snapshot;
+  EXPECT_EQ(0, snapshot.GetValueCount());
+  EXPECT_FALSE(snapshot.HasValue(_T("str")));
+
+  snapshot.SetValue(_T("str"), CString(_T("value")));
+  snapshot.SetValue(_T("dword"), static_cast<DWORD>(17));
+  snapshot.SetValue(_T("qword"), static_cast<DWORD64>(0x100000000));
+  snapshot.SetValue(NULL, CString(_T("default")));
+  EXPECT_EQ(4, snapshot.GetValueCount());
+
+  CString str_value;
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("str"), &str_value));
+  EXPECT_STREQ(_T("value"), str_value);
+  EXPECT_SUCCEEDED(snapshot.GetValue(NULL, &str_value));
+  EXPECT_STREQ(_T("default"), str_value);
+
+  DWORD dword_value = 0;
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("dword"), &dword_value));
+  EXPECT_EQ(17, dword_value);
+
+  DWORD64 qword_value = 0;
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("qword"), &qword_value));
+  EXPECT_EQ(0x100000000, qword_value);
+
+  // Value names are case-insensitive.
+  EXPECT_TRUE(snapshot.HasValue(_T("STR")));
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("DWord"), &dword_value));
+
+  // Overwriting a value replaces its data and its type.
+  snapshot.SetValue(_T("str"), static_cast<DWORD>(3));
+  EXPECT_EQ(4, snapshot.GetValueCount());
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("str"), &dword_value));
+  EXPECT_EQ(3, dword_value);
+}
+
+TEST(RegistrySnapshotTest, InMemoryValues_Errors) {
+  RegistrySnapshot snapshot;
+  snapshot.SetValue(_T("str"), CString(_T("value")));
+  snapshot.SetValue(_T("dword"), static_cast<DWORD>(17));
+
+  CString str_value(_T("unchanged"));
+  DWORD dword_value = 5;
+  DWORD64 qword_value = 6;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            snapshot.GetValue(_T("missing"), &str_value));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            snapshot.GetValue(_T("dword"), &str_value));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            snapshot.GetValue(_T("str"), &dword_value));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            snapshot.GetValue(_T("dword"), &qword_value));
+
+  EXPECT_STREQ(_T("unchanged"), str_value);
+  EXPECT_EQ(5, dword_value);
+  EXPECT_EQ(6, qword_value);
+}
+
+TEST(RegistrySnapshotTest, InMemorySubkeys) {
+  RegistrySnapshot snapshot;
+  EXPECT_EQ(0, snapshot.GetSubkeyCount());
+  EXPECT_TRUE(NULL == snapshot.GetSubkey(_T("sub")));
+
+  RegistrySnapshot* subkey = snapshot.AddSubkey(_T("Sub"));
+  ASSERT_TRUE(subkey);
+  subkey->SetValue(_T("name"), CString(_T("stable")));
+
+  // Adding an existing subkey returns the existing subkey.
+  EXPECT_EQ(subkey, snapshot.AddSubkey(_T("SUB")));
+  EXPECT_EQ(1, snapshot.GetSubkeyCount());
+  EXPECT_STREQ(_T("Sub"), snapshot.GetSubkeyNameAt(0));
+
+  const RegistrySnapshot* found = snapshot.GetSubkey(_T("sub"));
+  ASSERT_TRUE(found);
+  CString value;
+  EXPECT_SUCCEEDED(found->GetValue(_T("name"), &value));
+  EXPECT_STREQ(_T("stable"), value);
+}
+
+TEST_F(RegistrySnapshotRegistryTest, Read_KeyDoesNotExist) {
+  RegistrySnapshot snapshot;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            snapshot.Read(kTestKey, 0));
+  EXPECT_EQ(0, snapshot.GetValueCount());
+}
+
+TEST_F(RegistrySnapshotRegistryTest, Read) {
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestKey, _T("str"), _T("value")));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestKey,
+                                    _T("dword"),
+                                    static_cast<DWORD>(17)));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestKey,
+                                    _T("qword"),
+                                    static_cast<DWORD64>(0x100000000)));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestSubkey, _T("sub1"), _T("one")));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestSubSubkey, _T("sub2"), _T("two")));
+
+  RegistrySnapshot snapshot;
+  EXPECT_SUCCEEDED(snapshot.Read(kTestKey, 1));
+  EXPECT_EQ(3, snapshot.GetValueCount());
+
+  CString str_value;
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("str"), &str_value));
+  EXPECT_STREQ(_T("value"), str_value);
+  DWORD dword_value = 0;
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("dword"), &dword_value));
+  EXPECT_EQ(17, dword_value);
+  DWORD64 qword_value = 0;
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("qword"), &qword_value));
+  EXPECT_EQ(0x100000000, qword_value);
+
+  const RegistrySnapshot* subkey = snapshot.GetSubkey(_T("Sub1"));
+  ASSERT_TRUE(subkey);
+  EXPECT_SUCCEEDED(subkey->GetValue(_T("sub1"), &str_value));
+  EXPECT_STREQ(_T("one"), str_value);
+
+  // Subkeys deeper than the depth of the snapshot are not read.
+  EXPECT_TRUE(NULL == subkey->GetSubkey(_T("Sub2")));
+
+  // Reading again replaces the previous contents.
+  EXPECT_SUCCEEDED(snapshot.Read(kTestSubkey, 0));
+  EXPECT_EQ(1, snapshot.GetValueCount());
+  EXPECT_EQ(0, snapshot.GetSubkeyCount());
+}
+
+TEST_F(RegistrySnapshotRegistryTest, Read_ExpandsStrings) {
+  ASSERT_SUCCEEDED(RegKey::SetValueExpandSZ(kTestKey,
+                                            _T("expand"),
+                                            _T("%WINDIR%")));
+
+  RegistrySnapshot snapshot;
+  EXPECT_SUCCEEDED(snapshot.Read(kTestKey, 0));
+
+  CString value;
+  EXPECT_SUCCEEDED(snapshot.GetValue(_T("expand"), &value));
+  EXPECT_FALSE(value.IsEmpty());
+  EXPECT_EQ(-1, value.Find(_T('%')));
+}
+
+}  // namespace omaha
@@ -0,0 +1,268 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/span_trace.h"
+#include <algorithm>
+#include <vector>
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/path.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/string.h"
+#include "omaha/base/time.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+namespace {
+
+// Returns 'id' as a JSON string literal.
+CStringA ToJsonString(const TCHAR* id) {
+  const CStringA utf8_id(WideToUtf8(id));
+  CStringA json("\"");
+  for (int i = 0; i < utf8_id.GetLength(); ++i) {
+    const char c = utf8_id[i];
+    if (c == '"' || c == '\\') {
+      json.AppendChar('\\');
+      json.AppendChar(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      json.AppendFormat("\\u%04x", c);
+    } else {
+      json.AppendChar(c);
+    }
+  }
+  json.AppendChar('"');
+  return json;
+}
+
+}  // namespace
+
+volatile LONG SpanTrace::is_enabled_ = 0;
+DWORD SpanTrace::tls_index_ = TLS_OUT_OF_INDEXES;
+SpanTrace::ThreadBuffer* volatile SpanTrace::thread_buffers_ = NULL;
+
+void SpanTrace::EnableIfConfigured() {
+  if (RegKey::HasValue(MACHINE_REG_UPDATE_DEV, kRegValueSpanTraceDir)) {
+    VERIFY1(SUCCEEDED(Enable()));
+  }
+}
+
+HRESULT SpanTrace::Enable() {
+  if (tls_index_ == TLS_OUT_OF_INDEXES) {
+    tls_index_ = ::TlsAlloc();
+    if (tls_index_ == TLS_OUT_OF_INDEXES) {
+      return HRESULTFromLastError();
+    }
+  }
+
+  ::InterlockedExchange(&is_enabled_, 1);
+  return S_OK;
+}
+
+void SpanTrace::Disable() {
+  ::InterlockedExchange(&is_enabled_, 0);
+}
+
+void SpanTrace::Begin(const char* name, const TCHAR* id) {
+  ASSERT1(id);
+  AddEvent(name, 'B', id);
+
+  // The open spans are tracked even if the event is dropped, so that the
+  // nested spans get the right id.
+  if (!IsEnabled()) {
+    return;
+  }
+  ThreadBuffer* buffer = GetThreadBuffer();
+  if (buffer->depth < kMaxDepth) {
+    _tcsncpy_s(buffer->open_ids[buffer->depth],
+               arraysize(buffer->open_ids[buffer->depth]),
+               id,
+               _TRUNCATE);
+  }
+  ++buffer->depth;
+}
+
+void SpanTrace::End(const char* name) {
+  AddEvent(name, 'E', NULL);
+
+  // The span is closed even if the tracing was disabled while it was open.
+  if (tls_index_ == TLS_OUT_OF_INDEXES) {
+    return;
+  }
+  ThreadBuffer* buffer = static_cast<ThreadBuffer*>(::TlsGetValue(tls_index_));
+  if (buffer && buffer->depth > 0) {
+    --buffer->depth;
+  }
+}
+
+CString SpanTrace::GetCurrentId() {
+  if (tls_index_ == TLS_OUT_OF_INDEXES) {
+    return CString();
+  }
+  const ThreadBuffer* buffer =
+      static_cast<ThreadBuffer*>(::TlsGetValue(tls_index_));
+  if (!buffer || !buffer->depth) {
+    return CString();
+  }
+  return CString(buffer->open_ids[std::min(buffer->depth, kMaxDepth) - 1]);
+}
+
+SpanTrace::ThreadBuffer* SpanTrace::GetThreadBuffer() {
+  ThreadBuffer* buffer = static_cast<ThreadBuffer*>(::TlsGetValue(tls_index_));
+  if (buffer) {
+    return buffer;
+  }
+
+  buffer = new ThreadBuffer;
+  buffer->thread_id = ::GetCurrentThreadId();
+  buffer->num_events = 0;
+  buffer->depth = 0;
+  VERIFY1(::TlsSetValue(tls_index_, buffer));
+
+  // Buffers are only added to the list, therefore pushing them at the head
+  // is safe without a lock.
+  ThreadBuffer* head = NULL;
+  do {
+    head = thread_buffers_;
+    buffer->next = head;
+  } while (::InterlockedCompareExchangePointer(
+               reinterpret_cast<PVOID volatile*>(&thread_buffers_),
+               buffer,
+               head) != head);
+  return buffer;
+}
+
+void SpanTrace::AddEvent(const char* name, char phase, const TCHAR* id) {
+  ASSERT1(name);
+  if (!IsEnabled()) {
+    return;
+  }
+
+  ThreadBuffer* buffer = GetThreadBuffer();
+  const LONG index = buffer->num_events;
+  if (index >= kMaxEventsPerThread) {
+    return;
+  }
+
+  Event& event = buffer->events[index];
+  event.name = name;
+  event.phase = phase;
+  event.ticks = HighresTimer::GetCurrentTicks();
+  if (id) {
+    _tcsncpy_s(event.id, arraysize(event.id), id, _TRUNCATE);
+  } else {
+    event.id[0] = _T('\0');
+  }
+
+  // Publishes the event to threads which write the trace.
+  ::InterlockedExchange(&buffer->num_events, index + 1);
+}
+
+CStringA SpanTrace::ToChromeTraceJson() {
+  const double ticks_per_us = HighresTimer::GetTimerFrequency() / 1000000.0;
+  const DWORD process_id = ::GetCurrentProcessId();
+
+  uint64 origin_ticks = HighresTimer::GetCurrentTicks();
+  for (const ThreadBuffer* buffer = thread_buffers_;
+       buffer;
+       buffer = buffer->next) {
+    if (buffer->num_events > 0) {
+      origin_ticks = std::min(origin_ticks, buffer->events[0].ticks);
+    }
+  }
+
+  CStringA json("{\"traceEvents\":[\n");
+  bool is_first_event = true;
+  for (const ThreadBuffer* buffer = thread_buffers_;
+       buffer;
+       buffer = buffer->next) {
+    const LONG num_events = buffer->num_events;
+    for (LONG i = 0; i < num_events; ++i) {
+      const Event& event = buffer->events[i];
+      const int64 timestamp_us =
+          static_cast<int64>((event.ticks - origin_ticks) / ticks_per_us);
+      json.AppendFormat("%s{\"name\":\"%s\",\"cat\":\"update\",\"ph\":\"%c\","
+                        "\"ts\":%I64d,\"pid\":%u,\"tid\":%u",
+                        is_first_event ? "" : ",\n",
+                        event.name,
+                        event.phase,
+                        timestamp_us,
+                        process_id,
+                        buffer->thread_id);
+      if (event.phase == 'B') {
+        json.Append(",\"args\":{\"id\":");
+        json.Append(ToJsonString(event.id));
+        json.AppendChar('}');
+      }
+      json.AppendChar('}');
+      is_first_event = false;
+    }
+  }
+  json.Append("\n],\"displayTimeUnit\":\"ms\"}\n");
+  return json;
+}
+
+HRESULT SpanTrace::WriteChromeTraceIfEnabled(const TCHAR* process_name) {
+  ASSERT1(process_name);
+
+  CString trace_dir;
+  if (!IsEnabled() ||
+      FAILED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                              kRegValueSpanTraceDir,
+                              &trace_dir)) ||
+      trace_dir.IsEmpty()) {
+    return S_FALSE;
+  }
+
+  CString file_name;
+  SafeCStringFormat(&file_name, _T("%s_spans_%u_%I64u.json"),
+                    process_name,
+                    ::GetCurrentProcessId(),
+                    GetCurrentMsTime());
+
+  const CStringA json(ToChromeTraceJson());
+  std::vector<byte> buffer(json.GetString(),
+                           json.GetString() + json.GetLength());
+  HRESULT hr = WriteEntireFile(ConcatenatePath(trace_dir, file_name), buffer);
+  if (FAILED(hr)) {
+    UTIL_LOG(LE, (_T("[SpanTrace][WriteEntireFile failed][0x%x]"), hr));
+  }
+  return hr;
+}
+
+void SpanTrace::Reset() {
+  Disable();
+
+  ThreadBuffer* buffer = thread_buffers_;
+  thread_buffers_ = NULL;
+  while (buffer) {
+    ThreadBuffer* next = buffer->next;
+    delete buffer;
+    buffer = next;
+  }
+
+  // Freeing the index discards the buffer pointers of all threads. A new index
+  // starts with no buffers.
+  if (tls_index_ != TLS_OUT_OF_INDEXES) {
+    VERIFY1(::TlsFree(tls_index_));
+    tls_index_ = TLS_OUT_OF_INDEXES;
+  }
+}
+
+}  // namespace omaha
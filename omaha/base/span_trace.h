@@ -0,0 +1,165 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+// Records spans of work along the update pipeline, such as update checks,
+// downloads and installs, tagged with the id of the bundle or app they work
+// on. The spans of the lower layers, such as network requests or package
+// verifications, are tagged with the id of their enclosing span. Each thread
+// records into its own buffer, so recording a span takes no locks. When the
+// tracing is disabled, a span costs one test of a flag and the id is not
+// computed.
+//
+// The recorded spans can be written in the Chrome trace event format, for
+// viewing in chrome://tracing or for offline analysis.
+//
+// Usage:
+//   HRESULT DownloadManager::DoDownloadPackage(Package* package) {
+//     TRACE_SPAN("DownloadManager::DoDownloadPackage", app->span_id());
+//     ...
+//   }
+//
+//   HRESULT PackageCache::VerifyHash(...) {
+//     TRACE_NESTED_SPAN("PackageCache::VerifyHash");
+//     ...
+//   }
+
+#ifndef OMAHA_BASE_SPAN_TRACE_H_
+#define OMAHA_BASE_SPAN_TRACE_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class SpanTrace {
+ public:
+  // Each thread records at most this many events. Later events are dropped.
+  static const int kMaxEventsPerThread = 1024;
+
+  // Longer ids are truncated.
+  static const int kMaxIdLength = 63;
+
+  // The ids of the spans nested deeper than this are not tracked, and the
+  // spans nested in them take the id of their closest tracked enclosing span.
+  static const int kMaxDepth = 16;
+
+  static bool IsEnabled() { return is_enabled_ != 0; }
+
+  // Enables the tracing if the UpdateDev value SpanTraceDir is present. Must
+  // be called before the process starts other threads.
+  static void EnableIfConfigured();
+
+  // Enables or disables the tracing. The spans recorded so far are kept.
+  static HRESULT Enable();
+  static void Disable();
+
+  // Records the beginning of the span 'name', which must be a string literal,
+  // for 'id'. Does nothing if the tracing is disabled.
+  static void Begin(const char* name, const TCHAR* id);
+
+  // Records the end of the innermost span 'name' of the calling thread.
+  static void End(const char* name);
+
+  // Returns the id of the innermost open span of the calling thread, or an
+  // empty string if there is none.
+  static CString GetCurrentId();
+
+  // Returns the recorded events of all threads in the Chrome trace event
+  // format.
+  static CStringA ToChromeTraceJson();
+
+  // Writes the events to the directory in the UpdateDev value SpanTraceDir,
+  // if the value is present. The name of the file contains 'process_name' and
+  // the id of the process.
+  static HRESULT WriteChromeTraceIfEnabled(const TCHAR* process_name);
+
+  // Disables the tracing and discards the recorded events. Must not be called
+  // while other threads record spans. For unit tests only.
+  static void Reset();
+
+ private:
+  struct Event {
+    const char* name;
+    uint64 ticks;
+    char phase;
+    TCHAR id[kMaxIdLength + 1];
+  };
+
+  struct ThreadBuffer {
+    ThreadBuffer* next;
+    DWORD thread_id;
+    volatile LONG num_events;
+    Event events[kMaxEventsPerThread];
+
+    // The ids of the open spans of the thread, innermost last.
+    int depth;
+    TCHAR open_ids[kMaxDepth][kMaxIdLength + 1];
+  };
+
+  // Returns the buffer of the calling thread, which is created the first time
+  // the thread records an event.
+  static ThreadBuffer* GetThreadBuffer();
+
+  static void AddEvent(const char* name, char phase, const TCHAR* id);
+
+  static volatile LONG is_enabled_;
+  static DWORD tls_index_;
+  static ThreadBuffer* volatile thread_buffers_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SpanTrace);
+};
+
+// Records the end of a span when it goes out of scope. Use TRACE_SPAN.
+class ScopedSpan {
+ public:
+  explicit ScopedSpan(const char* name) : name_(name), is_recording_(false) {}
+
+  ~ScopedSpan() {
+    if (is_recording_) {
+      SpanTrace::End(name_);
+    }
+  }
+
+  void Begin(const CString& id) {
+    is_recording_ = true;
+    SpanTrace::Begin(name_, id);
+  }
+
+ private:
+  const char* const name_;
+  bool is_recording_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedSpan);
+};
+
+#define SPAN_TRACE_CONCAT_INTERNAL(a, b) a##b
+#define SPAN_TRACE_CONCAT(a, b) SPAN_TRACE_CONCAT_INTERNAL(a, b)
+
+// Records the span 'name' for 'id' until the end of the enclosing scope. The
+// 'id' expression is only evaluated if the tracing is enabled. Expands to more
+// than one statement, therefore it cannot be the body of an if or a loop.
+#define TRACE_SPAN(name, id)                                            \
+    omaha::ScopedSpan SPAN_TRACE_CONCAT(span_, __LINE__)(name);         \
+    if (omaha::SpanTrace::IsEnabled())                                  \
+      SPAN_TRACE_CONCAT(span_, __LINE__).Begin(id)
+
+// Records the span 'name' with the id of the enclosing span of the thread.
+#define TRACE_NESTED_SPAN(name) \
+    TRACE_SPAN(name, omaha::SpanTrace::GetCurrentId())
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_SPAN_TRACE_H_
@@ -0,0 +1,181 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/scoped_any.h"
+#include "omaha/base/span_trace.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+int num_id_evaluations = 0;
+
+CString GetId() {
+  ++num_id_evaluations;
+  return _T("{7F0B2D9E-9A52-4B0C-8E0A-0B4B9C6E1D2A}");
+}
+
+DWORD WINAPI RecordSpanOnThread(void*) {
+  TRACE_SPAN("OtherThread", _T("other"));
+  return 0;
+}
+
+}  // namespace
+
+class SpanTraceTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    SpanTrace::Reset();
+    num_id_evaluations = 0;
+  }
+
+  virtual void TearDown() {
+    SpanTrace::Reset();
+  }
+};
+
+TEST_F(SpanTraceTest, Disabled) {
+  EXPECT_FALSE(SpanTrace::IsEnabled());
+  {
+    TRACE_SPAN("Disabled", GetId());
+  }
+  EXPECT_EQ(0, num_id_evaluations);
+  EXPECT_EQ(-1, SpanTrace::ToChromeTraceJson().Find("Disabled"));
+}
+
+TEST_F(SpanTraceTest, Enabled) {
+  EXPECT_SUCCEEDED(SpanTrace::Enable());
+  EXPECT_TRUE(SpanTrace::IsEnabled());
+  {
+    TRACE_SPAN("Outer", GetId());
+    TRACE_SPAN("Inner", _T("a \"quoted\" \\ id"));
+  }
+  EXPECT_EQ(1, num_id_evaluations);
+
+  const CStringA json(SpanTrace::ToChromeTraceJson());
+  const int outer_begin = json.Find(
+      "{\"name\":\"Outer\",\"cat\":\"update\",\"ph\":\"B\"");
+  const int inner_begin = json.Find(
+      "{\"name\":\"Inner\",\"cat\":\"update\",\"ph\":\"B\"");
+  const int inner_end = json.Find(
+      "{\"name\":\"Inner\",\"cat\":\"update\",\"ph\":\"E\"");
+  const int outer_end = json.Find(
+      "{\"name\":\"Outer\",\"cat\":\"update\",\"ph\":\"E\"");
+  EXPECT_LT(0, outer_begin);
+  EXPECT_LT(outer_begin, inner_begin);
+  EXPECT_LT(inner_begin, inner_end);
+  EXPECT_LT(inner_end, outer_end);
+
+  EXPECT_NE(-1, json.Find(
+      "\"args\":{\"id\":\"{7F0B2D9E-9A52-4B0C-8E0A-0B4B9C6E1D2A}\"}"));
+  EXPECT_NE(-1, json.Find("\"args\":{\"id\":\"a \\\"quoted\\\" \\\\ id\"}"));
+}
+
+TEST_F(SpanTraceTest, DisabledWhileSpanIsOpen) {
+  EXPECT_SUCCEEDED(SpanTrace::Enable());
+  {
+    TRACE_SPAN("Open", _T("id"));
+    SpanTrace::Disable();
+  }
+
+  const CStringA json(SpanTrace::ToChromeTraceJson());
+  EXPECT_NE(-1, json.Find("{\"name\":\"Open\",\"cat\":\"update\",\"ph\":\"B\""));
+  EXPECT_EQ(-1, json.Find("{\"name\":\"Open\",\"cat\":\"update\",\"ph\":\"E\""));
+}
+
+TEST_F(SpanTraceTest, LongIdsAreTruncated) {
+  EXPECT_SUCCEEDED(SpanTrace::Enable());
+  CString long_id(_T('x'), SpanTrace::kMaxIdLength + 10);
+  SpanTrace::Begin("Long", long_id);
+
+  const CStringA json(SpanTrace::ToChromeTraceJson());
+  const CStringA truncated_id('x', SpanTrace::kMaxIdLength);
+  EXPECT_NE(-1, json.Find("\"id\":\"" + truncated_id + "\""));
+  EXPECT_EQ(-1, json.Find(truncated_id + "x"));
+}
+
+TEST_F(SpanTraceTest, NestedSpanTakesTheIdOfTheEnclosingSpan) {
+  EXPECT_SUCCEEDED(SpanTrace::Enable());
+  EXPECT_STREQ(_T(""), SpanTrace::GetCurrentId());
+  {
+    TRACE_SPAN("App", _T("session/app"));
+    {
+      TRACE_NESTED_SPAN("Nested");
+      EXPECT_STREQ(_T("session/app"), SpanTrace::GetCurrentId());
+    }
+    EXPECT_STREQ(_T("session/app"), SpanTrace::GetCurrentId());
+  }
+  EXPECT_STREQ(_T(""), SpanTrace::GetCurrentId());
+
+  const CStringA json(SpanTrace::ToChromeTraceJson());
+  const int nested_begin = json.Find(
+      "{\"name\":\"Nested\",\"cat\":\"update\",\"ph\":\"B\"");
+  EXPECT_LT(0, nested_begin);
+  const CStringA nested_event(
+      json.Mid(nested_begin, json.Find('\n', nested_begin) - nested_begin));
+  EXPECT_NE(-1, nested_event.Find("\"args\":{\"id\":\"session/app\"}"));
+}
+
+TEST_F(SpanTraceTest, EventsAfterBufferIsFullAreDropped) {
+  EXPECT_SUCCEEDED(SpanTrace::Enable());
+  for (int i = 0; i < SpanTrace::kMaxEventsPerThread; ++i) {
+    SpanTrace::Begin("Span", _T("id"));
+  }
+  SpanTrace::End("Dropped");
+  EXPECT_EQ(-1, SpanTrace::ToChromeTraceJson().Find("Dropped"));
+}
+
+TEST_F(SpanTraceTest, MultipleThreads) {
+  EXPECT_SUCCEEDED(SpanTrace::Enable());
+  {
+    TRACE_SPAN("MainThread", _T("main"));
+  }
+
+  scoped_handle thread(::CreateThread(NULL, 0, &RecordSpanOnThread,
+                                      NULL, 0, NULL));
+  ASSERT_TRUE(thread);
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(thread), INFINITE));
+
+  const CStringA json(SpanTrace::ToChromeTraceJson());
+  EXPECT_NE(-1, json.Find("\"name\":\"MainThread\""));
+  EXPECT_NE(-1, json.Find("\"name\":\"OtherThread\""));
+
+  CStringA main_thread_id;
+  main_thread_id.Format("\"tid\":%u", ::GetCurrentThreadId());
+  EXPECT_NE(-1, json.Find(main_thread_id));
+}
+
+// The spans recorded after the tracing is disabled are dropped, and the spans
+// recorded before are kept.
+TEST_F(SpanTraceTest, SpansAfterDisableAreDropped) {
+  EXPECT_SUCCEEDED(SpanTrace::Enable());
+  {
+    TRACE_SPAN("Kept", _T("id"));
+  }
+  SpanTrace::Disable();
+  {
+    TRACE_SPAN("Dropped", GetId());
+    TRACE_NESTED_SPAN("NestedDropped");
+  }
+  EXPECT_EQ(0, num_id_evaluations);
+
+  const CStringA json(SpanTrace::ToChromeTraceJson());
+  EXPECT_NE(-1, json.Find(
+      "{\"name\":\"Kept\",\"cat\":\"update\",\"ph\":\"E\""));
+  EXPECT_EQ(-1, json.Find("Dropped"));
+}
+
+}  // namespace omaha
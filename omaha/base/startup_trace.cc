@@ -0,0 +1,183 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/startup_trace.h"
+#include <algorithm>
+#include <vector>
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/path.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/time.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+namespace {
+
+// Returns the value of the performance counter at the time the process was
+// created, or 'default_ticks' if it cannot be determined.
+uint64 GetProcessCreationTicks(uint64 default_ticks) {
+  FILETIME creation_time = {0};
+  FILETIME exit_time = {0};
+  FILETIME kernel_time = {0};
+  FILETIME user_time = {0};
+  if (!::GetProcessTimes(::GetCurrentProcess(),
+                         &creation_time,
+                         &exit_time,
+                         &kernel_time,
+                         &user_time)) {
+    return default_ticks;
+  }
+
+  const uint64 now_ticks = HighresTimer::GetCurrentTicks();
+  const uint64 now_100ns = GetCurrent100NSTime();
+  const uint64 creation_100ns = FileTimeToTime64(creation_time);
+  if (creation_100ns > now_100ns) {
+    return default_ticks;
+  }
+
+  const double elapsed_ticks =
+      static_cast<double>(now_100ns - creation_100ns) *
+      HighresTimer::GetTimerFrequency() / kSecsTo100ns;
+  if (elapsed_ticks >= now_ticks) {
+    return default_ticks;
+  }
+
+  // The clocks are read at slightly different times, therefore the creation
+  // of the process is not allowed to appear after the first event.
+  return std::min(now_ticks - static_cast<uint64>(elapsed_ticks),
+                  default_ticks);
+}
+
+}  // namespace
+
+StartupTrace::Event StartupTrace::events_[StartupTrace::kMaxEvents];
+volatile LONG StartupTrace::num_events_ = 0;
+
+void StartupTrace::BeginPhase(const char* name) {
+  AddEvent(name, 'B');
+}
+
+void StartupTrace::EndPhase(const char* name) {
+  AddEvent(name, 'E');
+}
+
+void StartupTrace::AddEvent(const char* name, char phase) {
+  ASSERT1(name);
+
+  const LONG index = ::InterlockedIncrement(&num_events_) - 1;
+  if (index >= kMaxEvents) {
+    if (index == kMaxEvents) {
+      UTIL_LOG(LW, (_T("[StartupTrace][buffer full]['%S' and later events ")
+                    _T("are dropped]"), name));
+    }
+    return;
+  }
+
+  Event& event = events_[index];
+  event.phase = phase;
+  event.thread_id = ::GetCurrentThreadId();
+  event.ticks = HighresTimer::GetCurrentTicks();
+
+  // The name is published last. Events which are still being recorded while
+  // the trace is written have no name and are skipped.
+  ::InterlockedExchangePointer(
+      reinterpret_cast<PVOID volatile*>(&event.name),
+      const_cast<char*>(name));
+}
+
+int StartupTrace::GetEventCount() {
+  return std::min(static_cast<int>(num_events_), static_cast<int>(kMaxEvents));
+}
+
+CStringA StartupTrace::ToChromeTraceJson() {
+  const int num_events = GetEventCount();
+  const double ticks_per_us = HighresTimer::GetTimerFrequency() / 1000000.0;
+  const DWORD process_id = ::GetCurrentProcessId();
+
+  uint64 first_ticks = HighresTimer::GetCurrentTicks();
+  for (int i = 0; i < num_events; ++i) {
+    if (events_[i].name) {
+      first_ticks = std::min(first_ticks, events_[i].ticks);
+    }
+  }
+  const uint64 origin_ticks = GetProcessCreationTicks(first_ticks);
+
+  CStringA json("{\"traceEvents\":[\n");
+  bool is_first_event = true;
+  for (int i = 0; i < num_events; ++i) {
+    const Event& event = events_[i];
+    if (!event.name) {
+      continue;
+    }
+
+    const int64 timestamp_us =
+        static_cast<int64>((event.ticks - origin_ticks) / ticks_per_us);
+    json.AppendFormat("%s{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"%c\","
+                      "\"ts\":%I64d,\"pid\":%u,\"tid\":%u}",
+                      is_first_event ? "" : ",\n",
+                      event.name,
+                      event.phase,
+                      timestamp_us,
+                      process_id,
+                      event.thread_id);
+    is_first_event = false;
+  }
+  json.Append("\n],\"displayTimeUnit\":\"ms\"}\n");
+  return json;
+}
+
+HRESULT StartupTrace::WriteChromeTrace(const CString& file_path) {
+  const CStringA json(ToChromeTraceJson());
+  std::vector<byte> buffer(json.GetString(),
+                           json.GetString() + json.GetLength());
+  HRESULT hr = WriteEntireFile(file_path, buffer);
+  if (FAILED(hr)) {
+    UTIL_LOG(LE, (_T("[StartupTrace][WriteEntireFile failed][%s][0x%x]"),
+                  file_path, hr));
+  }
+  return hr;
+}
+
+HRESULT StartupTrace::WriteChromeTraceIfEnabled(const TCHAR* process_name) {
+  ASSERT1(process_name);
+
+  CString trace_dir;
+  if (FAILED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                              kRegValueStartupTraceDir,
+                              &trace_dir)) ||
+      trace_dir.IsEmpty()) {
+    return S_FALSE;
+  }
+
+  CString file_name;
+  SafeCStringFormat(&file_name, _T("%s_%u_%I64u.json"),
+                    process_name,
+                    ::GetCurrentProcessId(),
+                    GetCurrentMsTime());
+  return WriteChromeTrace(ConcatenatePath(trace_dir, file_name));
+}
+
+void StartupTrace::Reset() {
+  ::ZeroMemory(events_, sizeof(events_));
+  ::InterlockedExchange(&num_events_, 0);
+}
+
+}  // namespace omaha
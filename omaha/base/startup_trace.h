@@ -0,0 +1,110 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+// Records where the time goes while a process starts up. The phases are
+// recorded with high resolution timestamps in a fixed buffer, which costs
+// little enough that the tracing is always compiled in. The trace can be
+// written in the Chrome trace event format, which chrome://tracing displays,
+// and tools/startup_trace_report.py aggregates over many traces.
+//
+// Usage:
+//   HRESULT LoadResources() {
+//     STARTUP_TRACE_PHASE("LoadResources");
+//     ...
+//   }
+
+#ifndef OMAHA_BASE_STARTUP_TRACE_H_
+#define OMAHA_BASE_STARTUP_TRACE_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class StartupTrace {
+ public:
+  // The events after the first kMaxEvents events of the process are dropped,
+  // and the first dropped event is logged as a warning.
+  static const int kMaxEvents = 256;
+
+  // Records the beginning or the end of the phase 'name', which must be a
+  // string literal.
+  static void BeginPhase(const char* name);
+  static void EndPhase(const char* name);
+
+  // Returns the number of events recorded so far.
+  static int GetEventCount();
+
+  // Returns the recorded events in the Chrome trace event format. The
+  // timestamps are relative to the creation of the process.
+  static CStringA ToChromeTraceJson();
+
+  // Writes the events recorded so far to 'file_path'.
+  static HRESULT WriteChromeTrace(const CString& file_path);
+
+  // Writes the events to the directory in the UpdateDev value StartupTraceDir,
+  // if the value is present. The name of the file contains 'process_name' and
+  // the id of the process.
+  static HRESULT WriteChromeTraceIfEnabled(const TCHAR* process_name);
+
+  // Discards the recorded events. For unit tests only.
+  static void Reset();
+
+ private:
+  struct Event {
+    const char* name;
+    char phase;
+    DWORD thread_id;
+    uint64 ticks;
+  };
+
+  static void AddEvent(const char* name, char phase);
+
+  static Event events_[kMaxEvents];
+  static volatile LONG num_events_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(StartupTrace);
+};
+
+// Records the phase 'name' from the construction of the object to its
+// destruction.
+class ScopedStartupPhase {
+ public:
+  explicit ScopedStartupPhase(const char* name) : name_(name) {
+    StartupTrace::BeginPhase(name_);
+  }
+
+  ~ScopedStartupPhase() {
+    StartupTrace::EndPhase(name_);
+  }
+
+ private:
+  const char* const name_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedStartupPhase);
+};
+
+#define STARTUP_TRACE_CONCAT_INTERNAL(a, b) a##b
+#define STARTUP_TRACE_CONCAT(a, b) STARTUP_TRACE_CONCAT_INTERNAL(a, b)
+
+// Records the phase 'name' until the end of the enclosing scope.
+#define STARTUP_TRACE_PHASE(name) \
+    omaha::ScopedStartupPhase STARTUP_TRACE_CONCAT(startup_phase_, __LINE__)( \
+        name)
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_STARTUP_TRACE_H_
@@ -0,0 +1,104 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <vector>
+#include "omaha/base/file.h"
+#include "omaha/base/startup_trace.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+class StartupTraceTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    StartupTrace::Reset();
+  }
+
+  virtual void TearDown() {
+    StartupTrace::Reset();
+  }
+};
+
+TEST_F(StartupTraceTest, ScopedPhases) {
+  EXPECT_EQ(0, StartupTrace::GetEventCount());
+
+  {
+    STARTUP_TRACE_PHASE("Outer");
+    EXPECT_EQ(1, StartupTrace::GetEventCount());
+    {
+      STARTUP_TRACE_PHASE("Inner");
+      EXPECT_EQ(2, StartupTrace::GetEventCount());
+    }
+    EXPECT_EQ(3, StartupTrace::GetEventCount());
+  }
+  EXPECT_EQ(4, StartupTrace::GetEventCount());
+
+  const CStringA json(StartupTrace::ToChromeTraceJson());
+  const int outer_begin = json.Find("{\"name\":\"Outer\",\"cat\":\"startup\","
+                                    "\"ph\":\"B\"");
+  const int inner_begin = json.Find("{\"name\":\"Inner\",\"cat\":\"startup\","
+                                    "\"ph\":\"B\"");
+  const int inner_end = json.Find("{\"name\":\"Inner\",\"cat\":\"startup\","
+                                  "\"ph\":\"E\"");
+  const int outer_end = json.Find("{\"name\":\"Outer\",\"cat\":\"startup\","
+                                  "\"ph\":\"E\"");
+  EXPECT_EQ(0, json.Find("{\"traceEvents\":["));
+  EXPECT_LT(0, outer_begin);
+  EXPECT_LT(outer_begin, inner_begin);
+  EXPECT_LT(inner_begin, inner_end);
+  EXPECT_LT(inner_end, outer_end);
+}
+
+TEST_F(StartupTraceTest, NoEvents) {
+  EXPECT_STREQ("{\"traceEvents\":[\n\n],\"displayTimeUnit\":\"ms\"}\n",
+               StartupTrace::ToChromeTraceJson());
+}
+
+TEST_F(StartupTraceTest, EventsAfterBufferIsFullAreDropped) {
+  for (int i = 0; i < StartupTrace::kMaxEvents; ++i) {
+    StartupTrace::BeginPhase("Phase");
+  }
+  EXPECT_EQ(StartupTrace::kMaxEvents, StartupTrace::GetEventCount());
+
+  StartupTrace::EndPhase("Dropped");
+  EXPECT_EQ(StartupTrace::kMaxEvents, StartupTrace::GetEventCount());
+  EXPECT_EQ(-1, StartupTrace::ToChromeTraceJson().Find("Dropped"));
+}
+
+TEST_F(StartupTraceTest, WriteChromeTrace) {
+  {
+    STARTUP_TRACE_PHASE("Written");
+  }
+
+  const CString file_path(GetTempFilename(_T("trc")));
+  ASSERT_FALSE(file_path.IsEmpty());
+
+  EXPECT_SUCCEEDED(StartupTrace::WriteChromeTrace(file_path));
+
+  std::vector<byte> contents;
+  EXPECT_SUCCEEDED(ReadEntireFile(file_path, 0, &contents));
+  const CStringA json(reinterpret_cast<const char*>(&contents.front()),
+                      static_cast<int>(contents.size()));
+  EXPECT_EQ(0, json.Find("{\"traceEvents\":["));
+  EXPECT_NE(-1, json.Find("{\"name\":\"Written\",\"cat\":\"startup\","
+                          "\"ph\":\"B\""));
+  EXPECT_NE(-1, json.Find("{\"name\":\"Written\",\"cat\":\"startup\","
+                          "\"ph\":\"E\""));
+
+  EXPECT_SUCCEEDED(File::Remove(file_path));
+}
+
+}  // namespace omaha
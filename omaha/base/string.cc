@@ -386,32 +386,59 @@ CString AnsiToWideString(const char *from, int length) {
 }
 
 
+namespace {
+
+const char kUtf8Bom[] = {'\xEF', '\xBB', '\xBF'};
+
+// Returns the number of bytes of the UTF-8 encoding of the UTF-16 string.
+// Unpaired surrogates count as three bytes, which is the size of the U+FFFD
+// replacement character WideCharToMultiByte converts them to.
+int Utf8LengthOfWide(const wchar_t* input, int input_len) {
+  int utf8_len = 0;
+  for (int i = 0; i < input_len; ++i) {
+    const wchar_t c = input[i];
+    if (c < 0x80) {
+      utf8_len += 1;
+    } else if (c < 0x800) {
+      utf8_len += 2;
+    } else if (c >= 0xD800 && c <= 0xDBFF &&
+               i + 1 < input_len &&
+               input[i + 1] >= 0xDC00 && input[i + 1] <= 0xDFFF) {
+      utf8_len += 4;
+      ++i;
+    } else {
+      utf8_len += 3;
+    }
+  }
+  return utf8_len;
+}
+
+}  // namespace
+
 // Transform a unicode string into UTF8, as represented in an ASCII string
 CStringA WideToUtf8(const CString& w) {
-  // Add a cutoff. If it's all ascii, convert it directly
   const TCHAR* input = static_cast<const TCHAR*>(w.GetString());
-  int input_len = w.GetLength(), i;
-  for (i = 0; i < input_len; ++i) {
-    if (input[i] > 127) {
-      break;
-    }
-  }
+  const int input_len = w.GetLength();
 
-  // If we made it to the end without breaking, then it's all ANSI, so do a quick convert
-  if (i == input_len) {
+  // The length is computed in one pass, which also finds out whether the
+  // string is all ascii. Each non-ascii character encodes to more than one
+  // byte, so the lengths are only equal for ascii strings.
+  const int utf8_len = Utf8LengthOfWide(input, input_len);
+  if (utf8_len == input_len) {
     return WideToAnsiDirect(w);
   }
 
-  // Figure out how long the string is
-  int req_bytes = ::WideCharToMultiByte(CP_UTF8, 0, w, -1, NULL, 0, NULL, NULL);
-
-  scoped_array<char> utf8_buffer(new char[req_bytes]);
-
-  int conv_bytes = ::WideCharToMultiByte(CP_UTF8, 0, w, -1, utf8_buffer.get(), req_bytes, NULL, NULL);
-  ASSERT1(req_bytes == conv_bytes);
-
-  // conv_bytes includes the null terminator, when we read this in, don't read the terminator
-  CStringA out(utf8_buffer.get(), conv_bytes - 1);
+  CStringA out;
+  const int conv_bytes = ::WideCharToMultiByte(CP_UTF8,
+                                               0,
+                                               input,
+                                               input_len,
+                                               out.GetBuffer(utf8_len),
+                                               utf8_len,
+                                               NULL,
+                                               NULL);
+  ASSERT1(conv_bytes == utf8_len);
+  out.ReleaseBuffer(conv_bytes);
 
   return out;
 }
@@ -434,31 +461,31 @@ void WideToUtf8Vector(const CString& wstr, std::vector<uint8>* vec_out) {
 
 CString Utf8ToWideChar(const char* utf8, uint32 num_bytes) {
   ASSERT1(utf8);
+
+  // Skip the byte order marker if there is one in the document.
+  if (num_bytes >= arraysize(kUtf8Bom) &&
+      memcmp(utf8, kUtf8Bom, arraysize(kUtf8Bom)) == 0) {
+    utf8 += arraysize(kUtf8Bom);
+    num_bytes -= arraysize(kUtf8Bom);
+  }
+
   if (num_bytes == 0) {
     return CString();
   }
 
-  uint32 number_of_wide_chars = ::MultiByteToWideChar(CP_UTF8, 0, utf8, num_bytes, NULL, 0);
-  number_of_wide_chars += 1;  // make room for NULL terminator
-
+  // Each UTF-8 byte converts to at most one UTF-16 code unit, so the buffer
+  // is large enough for one conversion call.
   CString ret_string;
-  TCHAR* buffer = ret_string.GetBuffer(number_of_wide_chars);
-  DWORD number_of_characters_copied = ::MultiByteToWideChar(CP_UTF8, 0, utf8, num_bytes, buffer, number_of_wide_chars);
-  ASSERT1(number_of_characters_copied == number_of_wide_chars - 1);
-  buffer[number_of_wide_chars - 1] = _T('\0');  // ensure there is a NULL terminator
-  ret_string.ReleaseBuffer();
+  const int number_of_characters_copied = ::MultiByteToWideChar(
+      CP_UTF8,
+      0,
+      utf8,
+      num_bytes,
+      ret_string.GetBuffer(num_bytes),
+      num_bytes);
+  ret_string.ReleaseBuffer(number_of_characters_copied);
 
-  // Strip the byte order marker if there is one in the document.
-  if (ret_string[0] == kUnicodeBom) {
-    ret_string = ret_string.Right(ret_string.GetLength() - 1);
-  }
-
-  if (number_of_characters_copied > 0) {
-    return ret_string;
-  }
-
-  // Failure case
-  return CString();
+  return ret_string;
 }
 
 CString Utf8BufferToWideChar(const std::vector<uint8>& buffer) {
@@ -1449,6 +1476,42 @@ int Base64UnescapeInternal(const char *src, int len_src,
   int decode;
   int destidx = 0;
   int state = 0;
+
+  // Decode groups of four characters at once while the input contains no
+  // whitespace, padding, or terminator and the destination has room for the
+  // three decoded bytes. The values of base64 characters fit in six bits,
+  // while 99, the value of the other characters, does not. The loop below
+  // handles the rest of the input.
+  while (len_src >= 4 && (!dest || destidx + 3 <= len_dest)) {
+    // The characters are checked one at a time so that nothing past a
+    // terminator is read.
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+    const int a = unbase64[in[0]];
+    if (a & ~0x3f) {
+      break;
+    }
+    const int b = unbase64[in[1]];
+    if (b & ~0x3f) {
+      break;
+    }
+    const int c = unbase64[in[2]];
+    if (c & ~0x3f) {
+      break;
+    }
+    const int d = unbase64[in[3]];
+    if (d & ~0x3f) {
+      break;
+    }
+    if (dest) {
+      dest[destidx]     = static_cast<char>((a << 2) | (b >> 4));
+      dest[destidx + 1] = static_cast<char>((b << 4) | (c >> 2));
+      dest[destidx + 2] = static_cast<char>((c << 6) | d);
+    }
+    destidx += 3;
+    src += 4;
+    len_src -= 4;
+  }
+
   // Used an unsigned char, since ch is used as an array index (into unbase64).
   unsigned char ch = 0;
   while (len_src-- && (ch = *src++) != '\0')  {
@@ -1672,5 +1672,85 @@ TEST(StringTest, WideToUtf8Vector) {
   EXPECT_EQ(8, out.size());
 }
 
+TEST(StringTest, WideToUtf8) {
+  EXPECT_STREQ("", WideToUtf8(_T("")));
+  EXPECT_STREQ("abc", WideToUtf8(_T("abc")));
+
+  // U+0416 encodes to 2 bytes, U+266B to 3 bytes, and the surrogate pair for
+  // U+1D11E to 4 bytes.
+  const wchar_t kMultibytes[] = {L'a', 0x0416, 0x266B, 0xD834, 0xDD1E, L'z', 0};
+  EXPECT_STREQ("a\xD0\x96\xE2\x99\xAB\xF0\x9D\x84\x9Ez",
+               WideToUtf8(kMultibytes));
+
+  // An unpaired surrogate is replaced by U+FFFD.
+  const wchar_t kUnpaired[] = {L'a', 0xD834, L'z', 0};
+  EXPECT_EQ(5, WideToUtf8(kUnpaired).GetLength());
+}
+
+TEST(StringTest, Utf8ToWideChar) {
+  EXPECT_STREQ(_T(""), Utf8ToWideChar("", 0));
+  EXPECT_STREQ(_T("abc"), Utf8ToWideChar("abc", 3));
+
+  const char kMultibytes[] = "a\xD0\x96\xE2\x99\xAB\xF0\x9D\x84\x9Ez";
+  const wchar_t kExpected[] = {L'a', 0x0416, 0x266B, 0xD834, 0xDD1E, L'z', 0};
+  EXPECT_STREQ(kExpected,
+               Utf8ToWideChar(kMultibytes, arraysize(kMultibytes) - 1));
+  EXPECT_STREQ(kExpected, Utf8ToWideChar(WideToUtf8(kExpected),
+                                         WideToUtf8(kExpected).GetLength()));
+
+  // The byte order marker is removed.
+  EXPECT_STREQ(_T("abc"), Utf8ToWideChar("\xEF\xBB\xBF" "abc", 6));
+  EXPECT_STREQ(_T(""), Utf8ToWideChar("\xEF\xBB\xBF", 3));
+
+  // Only the given number of bytes is converted.
+  EXPECT_STREQ(_T("ab"), Utf8ToWideChar("abc", 2));
+}
+
+TEST(StringTest, Base64EscapeUnescape) {
+  const char kData[] = "Omaha base64 test data.";
+  for (int len = 0; len < static_cast<int>(arraysize(kData)); ++len) {
+    CStringA escaped;
+    Base64Escape(kData, len, &escaped, true);
+    EXPECT_EQ(CalculateBase64EscapedLen(len), escaped.GetLength());
+
+    char unescaped[arraysize(kData)] = {0};
+    EXPECT_EQ(len, Base64Unescape(escaped,
+                                  escaped.GetLength(),
+                                  unescaped,
+                                  static_cast<int>(arraysize(unescaped))));
+    EXPECT_EQ(0, memcmp(kData, unescaped, len));
+  }
+}
+
+TEST(StringTest, Base64Unescape) {
+  const int kOutSize = 16;
+  char out[kOutSize] = {0};
+
+  EXPECT_EQ(6, Base64Unescape("T21h aGEh", 9, out, kOutSize));
+  EXPECT_EQ(0, memcmp("Omaha!", out, 6));
+
+  EXPECT_EQ(4, Base64Unescape("T21haA==", 8, out, kOutSize));
+  EXPECT_EQ(0, memcmp("Omah", out, 4));
+
+  // Decoding stops at a terminator.
+  EXPECT_EQ(3, Base64Unescape("T21h\0aGEh", 9, out, kOutSize));
+
+  // The destination is too small.
+  EXPECT_EQ(-1, Base64Unescape("T21haGEh", 8, out, 5));
+
+  // Invalid characters and padding.
+  EXPECT_EQ(-1, Base64Unescape("T21!aGEh", 8, out, kOutSize));
+  EXPECT_EQ(-1, Base64Unescape("T=21", 4, out, kOutSize));
+  EXPECT_EQ(-1, Base64Unescape("T", 1, out, kOutSize));
+}
+
+TEST(StringTest, WebSafeBase64Unescape) {
+  const int kOutSize = 16;
+  char out[kOutSize] = {0};
+  EXPECT_EQ(3, WebSafeBase64Unescape("-_-_", 4, out, kOutSize));
+  EXPECT_EQ(0, memcmp("\xFB\xFF\xBF", out, 3));
+  EXPECT_EQ(-1, WebSafeBase64Unescape("+/+/", 4, out, kOutSize));
+}
+
 }  // namespace omaha
 
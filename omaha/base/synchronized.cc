@@ -216,6 +216,155 @@ DWORD_PTR LLock::GetOwner() const {
          reinterpret_cast<DWORD_PTR>(critical_section_.OwningThread) : 0;
 }
 
+#pragma warning(push)
+// C4355: 'this' : used in base member initializer list
+#pragma warning(disable : 4355)
+ReaderWriterLock::ReaderWriterLock()
+    : no_writers_event_(::CreateEvent(NULL, true, true, NULL)),
+      lock_free_event_(::CreateEvent(NULL, false, false, NULL)),
+      owner_(0),
+      recursion_count_(0),
+      active_readers_(0),
+      waiting_writers_(0),
+      tls_index_(::TlsAlloc()),
+      shared_(this) {
+  ::InitializeCriticalSection(&critical_section_);
+  VERIFY1(no_writers_event_);
+  VERIFY1(lock_free_event_);
+  VERIFY1(tls_index_ != TLS_OUT_OF_INDEXES);
+}
+#pragma warning(pop)
+
+ReaderWriterLock::~ReaderWriterLock() {
+  ASSERT1(!owner_);
+  ASSERT1(!active_readers_);
+  ::TlsFree(tls_index_);
+  ::CloseHandle(lock_free_event_);
+  ::CloseHandle(no_writers_event_);
+  ::DeleteCriticalSection(&critical_section_);
+}
+
+uint32 ReaderWriterLock::GetSharedCount() const {
+  return static_cast<uint32>(
+      reinterpret_cast<UINT_PTR>(::TlsGetValue(tls_index_)));
+}
+
+void ReaderWriterLock::SetSharedCount(uint32 count) const {
+  VERIFY1(::TlsSetValue(tls_index_, reinterpret_cast<void*>(
+      static_cast<UINT_PTR>(count))));
+}
+
+bool ReaderWriterLock::Lock() const {
+  const DWORD_PTR thread_id = ::GetCurrentThreadId();
+  if (GetOwner() == thread_id) {
+    ++recursion_count_;
+    return true;
+  }
+
+  // Upgrading from shared to exclusive deadlocks when two readers try it.
+  ASSERT(!GetSharedCount(), (_T("[ReaderWriterLock upgrade not supported]")));
+
+  ::EnterCriticalSection(&critical_section_);
+  ++waiting_writers_;
+  VERIFY1(::ResetEvent(no_writers_event_));
+  ::LeaveCriticalSection(&critical_section_);
+
+  for (;;) {
+    ::EnterCriticalSection(&critical_section_);
+    if (!owner_ && !active_readers_) {
+      --waiting_writers_;
+      recursion_count_ = 1;
+      owner_ = thread_id;
+      ::LeaveCriticalSection(&critical_section_);
+      return true;
+    }
+    ::LeaveCriticalSection(&critical_section_);
+
+    VERIFY1(::WaitForSingleObject(lock_free_event_, INFINITE) ==
+            WAIT_OBJECT_0);
+  }
+}
+
+bool ReaderWriterLock::Unlock() const {
+  ASSERT1(GetOwner() == ::GetCurrentThreadId());
+  ASSERT1(recursion_count_);
+
+  if (--recursion_count_) {
+    return true;
+  }
+
+  ::EnterCriticalSection(&critical_section_);
+  owner_ = 0;
+  if (waiting_writers_) {
+    VERIFY1(::SetEvent(lock_free_event_));
+  } else {
+    VERIFY1(::SetEvent(no_writers_event_));
+  }
+  ::LeaveCriticalSection(&critical_section_);
+  return true;
+}
+
+bool ReaderWriterLock::LockShared() const {
+  // The exclusive owner can read. The shared access is folded into the
+  // exclusive recursion count.
+  if (GetOwner() == ::GetCurrentThreadId()) {
+    return Lock();
+  }
+
+  // A thread already reading does not wait for writers, otherwise a waiting
+  // writer would deadlock with a recursive reader.
+  const uint32 shared_count = GetSharedCount();
+  if (shared_count) {
+    SetSharedCount(shared_count + 1);
+    return true;
+  }
+
+  for (;;) {
+    ::EnterCriticalSection(&critical_section_);
+    if (!owner_ && !waiting_writers_) {
+      ++active_readers_;
+      ::LeaveCriticalSection(&critical_section_);
+      SetSharedCount(1);
+      return true;
+    }
+    ::LeaveCriticalSection(&critical_section_);
+
+    VERIFY1(::WaitForSingleObject(no_writers_event_, INFINITE) ==
+            WAIT_OBJECT_0);
+  }
+}
+
+bool ReaderWriterLock::UnlockShared() const {
+  const uint32 shared_count = GetSharedCount();
+  if (!shared_count) {
+    return Unlock();
+  }
+
+  SetSharedCount(shared_count - 1);
+  if (shared_count > 1) {
+    return true;
+  }
+
+  ::EnterCriticalSection(&critical_section_);
+  ASSERT1(active_readers_);
+  if (!--active_readers_ && waiting_writers_) {
+    VERIFY1(::SetEvent(lock_free_event_));
+  }
+  ::LeaveCriticalSection(&critical_section_);
+  return true;
+}
+
+DWORD_PTR ReaderWriterLock::GetOwner() const {
+  ::EnterCriticalSection(&critical_section_);
+  const DWORD_PTR owner = owner_;
+  ::LeaveCriticalSection(&critical_section_);
+  return owner;
+}
+
+bool ReaderWriterLock::IsHeldByCaller() const {
+  return GetOwner() == ::GetCurrentThreadId() || GetSharedCount() != 0;
+}
+
 // Use this c-tor for interprocess gates.
 Gate::Gate(const TCHAR * event_name) : gate_(NULL) {
   VERIFY(Initialize(event_name), (_T("")));
@@ -169,6 +169,75 @@ class LLock : public Lockable {
   DISALLOW_EVIL_CONSTRUCTORS(LLock);
 };
 
+// In-process single writer, multiple readers lock. The Lockable interface
+// acquires the lock exclusively, with the same recursive semantics as LLock,
+// so the lock can be used with __mutexScope wherever an LLock is used. Shared
+// access is acquired through the Lockable returned by shared():
+//
+//   __mutexScope(rw_lock.shared());
+//
+// Shared access is recursive and it is granted to the thread owning the
+// exclusive lock. Waiting writers have priority over new readers, so that
+// continuous polling does not starve the writers. Upgrading from shared to
+// exclusive access is not supported and it deadlocks.
+class ReaderWriterLock : public Lockable {
+ public:
+  ReaderWriterLock();
+  virtual ~ReaderWriterLock();
+
+  virtual bool Lock() const;
+  virtual bool Unlock() const;
+
+  bool LockShared() const;
+  bool UnlockShared() const;
+
+  // Returns the thread id of the exclusive owner or 0 if the lock is not
+  // exclusively owned.
+  DWORD_PTR GetOwner() const;
+
+  // Returns true if the calling thread holds the lock, either exclusively or
+  // shared.
+  bool IsHeldByCaller() const;
+
+  const Lockable& shared() const { return shared_; }
+
+ private:
+  class SharedLockable : public Lockable {
+   public:
+    explicit SharedLockable(const ReaderWriterLock* lock) : lock_(lock) {}
+    virtual bool Lock() const { return lock_->LockShared(); }
+    virtual bool Unlock() const { return lock_->UnlockShared(); }
+   private:
+    const ReaderWriterLock* lock_;
+    DISALLOW_EVIL_CONSTRUCTORS(SharedLockable);
+  };
+
+  // Returns the shared recursion count of the calling thread.
+  uint32 GetSharedCount() const;
+  void SetSharedCount(uint32 count) const;
+
+  // Protects the members below.
+  mutable CRITICAL_SECTION critical_section_;
+
+  // Signaled when there is no writer owning or waiting for the lock.
+  HANDLE no_writers_event_;
+
+  // Auto-reset event signaled when the lock may be available to a writer.
+  HANDLE lock_free_event_;
+
+  mutable DWORD_PTR owner_;
+  mutable uint32 recursion_count_;
+  mutable uint32 active_readers_;
+  mutable uint32 waiting_writers_;
+
+  // Thread local storage slot for the per-thread shared recursion count.
+  DWORD tls_index_;
+
+  SharedLockable shared_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(ReaderWriterLock);
+};
+
 // A gate is a synchronization object used to either stop all
 // threads from proceeding through a point or to allow them all to proceed.
 class Gate {
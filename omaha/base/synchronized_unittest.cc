@@ -14,10 +14,82 @@
 // ========================================================================
 
 #include "omaha/base/synchronized.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/scoped_any.h"
 #include "omaha/testing/unit_test.h"
 
 namespace omaha {
 
+namespace {
+
+// Simulates the model state polled by the clients. The worker moves the state
+// through the download and install states and keeps both fields in sync.
+struct PolledState {
+  PolledState()
+      : state(0),
+        progress(0),
+        stop(0),
+        num_polls(0),
+        max_poll_latency_ticks(0),
+        torn_reads(0) {}
+
+  ReaderWriterLock lock;
+  int state;
+  int progress;
+  volatile LONG stop;
+  volatile LONG num_polls;
+  volatile LONGLONG max_poll_latency_ticks;
+  volatile LONG torn_reads;
+};
+
+DWORD WINAPI PollThreadProc(void* param) {
+  PolledState* polled_state = static_cast<PolledState*>(param);
+  while (!polled_state->stop) {
+    HighresTimer timer;
+    __mutexBlock(polled_state->lock.shared()) {
+      const LONGLONG latency_ticks = timer.GetElapsedTicks();
+      for (;;) {
+        const LONGLONG max_latency_ticks =
+            polled_state->max_poll_latency_ticks;
+        if (latency_ticks <= max_latency_ticks ||
+            ::InterlockedCompareExchange64(
+                &polled_state->max_poll_latency_ticks,
+                latency_ticks,
+                max_latency_ticks) == max_latency_ticks) {
+          break;
+        }
+      }
+
+      if (polled_state->progress != polled_state->state * 10) {
+        ::InterlockedIncrement(&polled_state->torn_reads);
+      }
+
+      // Recursive shared access, as in App::get_currentState.
+      __mutexScope(polled_state->lock.shared());
+    }
+    ::InterlockedIncrement(&polled_state->num_polls);
+  }
+  return 0;
+}
+
+DWORD WINAPI SharedHolderThreadProc(void* param) {
+  ReaderWriterLock* lock = static_cast<ReaderWriterLock*>(param);
+  __mutexScope(lock->shared());
+  EXPECT_FALSE(lock->GetOwner());
+  EXPECT_TRUE(lock->IsHeldByCaller());
+  return 0;
+}
+
+DWORD WINAPI ExclusiveHolderThreadProc(void* param) {
+  ReaderWriterLock* lock = static_cast<ReaderWriterLock*>(param);
+  __mutexScope(lock);
+  EXPECT_EQ(::GetCurrentThreadId(), lock->GetOwner());
+  return 0;
+}
+
+}  // namespace
+
 TEST(LLockTest, GetOwner) {
   LLock lock;
 
@@ -30,6 +102,142 @@ TEST(LLockTest, GetOwner) {
   EXPECT_EQ(0, lock.GetOwner());
 }
 
+TEST(ReaderWriterLockTest, GetOwner) {
+  ReaderWriterLock lock;
+
+  EXPECT_EQ(0, lock.GetOwner());
+  EXPECT_FALSE(lock.IsHeldByCaller());
+
+  EXPECT_TRUE(lock.Lock());
+  EXPECT_EQ(::GetCurrentThreadId(), lock.GetOwner());
+  EXPECT_TRUE(lock.IsHeldByCaller());
+
+  // Recursive exclusive access.
+  EXPECT_TRUE(lock.Lock());
+  EXPECT_TRUE(lock.Unlock());
+  EXPECT_EQ(::GetCurrentThreadId(), lock.GetOwner());
+
+  // The owner is granted shared access.
+  EXPECT_TRUE(lock.shared().Lock());
+  EXPECT_EQ(::GetCurrentThreadId(), lock.GetOwner());
+  EXPECT_TRUE(lock.shared().Unlock());
+
+  EXPECT_TRUE(lock.Unlock());
+  EXPECT_EQ(0, lock.GetOwner());
+  EXPECT_FALSE(lock.IsHeldByCaller());
+}
+
+TEST(ReaderWriterLockTest, SharedAccessIsConcurrent) {
+  ReaderWriterLock lock;
+
+  __mutexScope(lock.shared());
+  EXPECT_EQ(0, lock.GetOwner());
+  EXPECT_TRUE(lock.IsHeldByCaller());
+
+  // Another reader gets in while this thread reads.
+  scoped_handle reader(::CreateThread(NULL,
+                                      0,
+                                      SharedHolderThreadProc,
+                                      &lock,
+                                      0,
+                                      NULL));
+  ASSERT_TRUE(get(reader));
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(reader), 10000));
+}
+
+TEST(ReaderWriterLockTest, ExclusiveAccessWaitsForReaders) {
+  ReaderWriterLock lock;
+
+  EXPECT_TRUE(lock.LockShared());
+
+  scoped_handle writer(::CreateThread(NULL,
+                                      0,
+                                      ExclusiveHolderThreadProc,
+                                      &lock,
+                                      0,
+                                      NULL));
+  ASSERT_TRUE(get(writer));
+  EXPECT_EQ(WAIT_TIMEOUT, ::WaitForSingleObject(get(writer), 100));
+
+  // A recursive reader does not wait for the pending writer.
+  EXPECT_TRUE(lock.LockShared());
+  EXPECT_TRUE(lock.UnlockShared());
+
+  EXPECT_TRUE(lock.UnlockShared());
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(writer), 10000));
+  EXPECT_EQ(0, lock.GetOwner());
+}
+
+TEST(ReaderWriterLockTest, SharedAccessWaitsForWriter) {
+  ReaderWriterLock lock;
+
+  EXPECT_TRUE(lock.Lock());
+
+  scoped_handle reader(::CreateThread(NULL,
+                                      0,
+                                      SharedHolderThreadProc,
+                                      &lock,
+                                      0,
+                                      NULL));
+  ASSERT_TRUE(get(reader));
+  EXPECT_EQ(WAIT_TIMEOUT, ::WaitForSingleObject(get(reader), 100));
+
+  EXPECT_TRUE(lock.Unlock());
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(reader), 10000));
+}
+
+// Polls the state from several threads while a writer runs through the state
+// transitions of a download and install, then reports the poll latency.
+TEST(ReaderWriterLockTest, PollLatencyUnderStateTransitions) {
+  const int kNumPollThreads = 8;
+  const int kNumTransitions = 20000;
+
+  PolledState polled_state;
+
+  HANDLE poll_threads[kNumPollThreads] = { NULL };
+  for (int i = 0; i < kNumPollThreads; ++i) {
+    poll_threads[i] = ::CreateThread(NULL,
+                                     0,
+                                     PollThreadProc,
+                                     &polled_state,
+                                     0,
+                                     NULL);
+    ASSERT_TRUE(poll_threads[i]);
+  }
+
+  HighresTimer transitions_timer;
+  for (int i = 0; i < kNumTransitions; ++i) {
+    __mutexScope(polled_state.lock);
+    polled_state.state = i % 16;
+    if (i % 4 == 0) {
+      ::SwitchToThread();
+    }
+    polled_state.progress = polled_state.state * 10;
+  }
+  const ULONGLONG transitions_ms = transitions_timer.GetElapsedMs();
+
+  ::InterlockedExchange(&polled_state.stop, 1);
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForMultipleObjects(kNumPollThreads,
+                                                    poll_threads,
+                                                    true,
+                                                    60000));
+  for (int i = 0; i < kNumPollThreads; ++i) {
+    ::CloseHandle(poll_threads[i]);
+  }
+
+  EXPECT_EQ(0, polled_state.torn_reads);
+  EXPECT_LT(0, polled_state.num_polls);
+
+  const ULONGLONG max_poll_latency_us =
+      polled_state.max_poll_latency_ticks * 1000000 /
+      HighresTimer::GetTimerFrequency();
+  UTIL_LOG(L1, (_T("[PollLatencyUnderStateTransitions][transitions %d ms]")
+                _T("[polls %d][max poll latency %I64u us]"),
+                static_cast<int>(transitions_ms),
+                polled_state.num_polls,
+                max_poll_latency_us));
+}
+
 TEST(GateTest, WaitAny) {
   const DWORD kTimeout = 100;
   const size_t kFewGates = 10;
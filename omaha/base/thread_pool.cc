@@ -15,7 +15,7 @@
 
 #include "omaha/base/thread_pool.h"
 
-#include "base/scoped_ptr.h"
+#include <algorithm>
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
@@ -23,51 +23,26 @@
 
 namespace omaha {
 
-namespace {
-
-// Context keeps track the information necessary to execute a work item
-// inside a thread pool thread.
-class Context {
- public:
-  Context(ThreadPool* pool, UserWorkItem* work_item, DWORD coinit_flags)
-      : pool_(pool),
-        work_item_(work_item),
-        coinit_flags_(coinit_flags) {
-    ASSERT1(pool);
-    ASSERT1(work_item);
-  }
-
-  ThreadPool*   pool() const { return pool_; }
-  UserWorkItem* work_item() const { return work_item_; }
-  DWORD coinit_flags() const { return coinit_flags_; }
-
- private:
-  ThreadPool*   pool_;
-  UserWorkItem* work_item_;
-  const DWORD   coinit_flags_;
-
-  DISALLOW_EVIL_CONSTRUCTORS(Context);
-};
-
-}   // namespace
-
-
 DWORD WINAPI ThreadPool::ThreadProc(void* param) {
   UTIL_LOG(L4, (_T("[ThreadPool::ThreadProc]")));
   ASSERT1(param);
 
-  Context* context = static_cast<Context*>(param);
+  ThreadPool* pool = static_cast<ThreadPool*>(param);
 
-  scoped_co_init init_com_apt(context->coinit_flags());
-  ASSERT1(SUCCEEDED(init_com_apt.hresult()));
+  QueuedWorkItem queued_work_item = {};
+  while (pool->DequeueWorkItem(&queued_work_item)) {
+    scoped_co_init init_com_apt(queued_work_item.coinit_flags);
+    ASSERT1(SUCCEEDED(init_com_apt.hresult()));
 
-  context->pool()->ProcessWorkItem(context->work_item());
-  delete context;
+    pool->ProcessWorkItem(queued_work_item.work_item);
+  }
   return 0;
 }
 
 ThreadPool::ThreadPool()
     : work_item_count_(0),
+      num_running_(0),
+      max_concurrent_work_items_(0),
       shutdown_delay_(0) {
   UTIL_LOG(L2, (_T("[ThreadPool::ThreadPool]")));
 }
@@ -99,7 +74,14 @@ ThreadPool::~ThreadPool() {
 }
 
 HRESULT ThreadPool::Initialize(int shutdown_delay) {
+  return Initialize(shutdown_delay, 0);
+}
+
+HRESULT ThreadPool::Initialize(int shutdown_delay,
+                               int max_concurrent_work_items) {
+  ASSERT1(max_concurrent_work_items >= 0);
   shutdown_delay_ = shutdown_delay;
+  max_concurrent_work_items_ = max_concurrent_work_items;
   reset(shutdown_event_, ::CreateEvent(NULL, true, false, NULL));
   return shutdown_event_ ? S_OK : HRESULTFromLastError();
 }
@@ -111,24 +93,132 @@ void ThreadPool::ProcessWorkItem(UserWorkItem* work_item) {
   ::InterlockedDecrement(&work_item_count_);
 }
 
+bool ThreadPool::DequeueWorkItem(QueuedWorkItem* queued_work_item) {
+  ASSERT1(queued_work_item);
+
+  __mutexScope(lock_);
+
+  PriorityQueues::iterator it = queues_.begin();
+  const bool is_over_limit = max_concurrent_work_items_ &&
+                             num_running_ > max_concurrent_work_items_;
+  if (it == queues_.end() ||
+      (is_over_limit && it->first < UserWorkItem::kPriorityUrgent)) {
+    ASSERT1(num_running_ > 0);
+    --num_running_;
+    return false;
+  }
+
+  ASSERT1(!it->second.empty());
+  *queued_work_item = it->second.front();
+  it->second.pop_front();
+  if (it->second.empty()) {
+    queues_.erase(it);
+  }
+
+  const DWORD queue_latency_ms =
+      ::GetTickCount() - queued_work_item->queued_time_ms;
+  --stats_.queue_depth;
+  stats_.total_queue_latency_ms += queue_latency_ms;
+  stats_.max_queue_latency_ms = std::max(stats_.max_queue_latency_ms,
+                                         queue_latency_ms);
+  if (queued_work_item->work_item->is_canceled()) {
+    ++stats_.num_canceled;
+  } else {
+    ++stats_.num_processed;
+  }
+
+  return true;
+}
+
+bool ThreadPool::RemoveWorkItem(const UserWorkItem* work_item) {
+  __mutexScope(lock_);
+
+  PriorityQueues::iterator it = queues_.find(work_item->priority());
+  if (it == queues_.end()) {
+    return false;
+  }
+
+  WorkItemQueue& queue = it->second;
+  for (WorkItemQueue::iterator item = queue.begin();
+       item != queue.end();
+       ++item) {
+    if (item->work_item == work_item) {
+      queue.erase(item);
+      if (queue.empty()) {
+        queues_.erase(it);
+      }
+      --stats_.queue_depth;
+      return true;
+    }
+  }
+
+  return false;
+}
+
 HRESULT ThreadPool::QueueUserWorkItem(UserWorkItem* work_item,
                                       DWORD coinit_flags,
                                       uint32 flags) {
-  UTIL_LOG(L4, (_T("[ThreadPool::QueueUserWorkItem]")));
+  UTIL_LOG(L4, (_T("[ThreadPool::QueueUserWorkItem][priority %d]"),
+                work_item ? work_item->priority() : 0));
   ASSERT1(work_item);
 
-  scoped_ptr<Context> context(new Context(this, work_item, coinit_flags));
   work_item->set_shutdown_event(get(shutdown_event_));
   ::InterlockedIncrement(&work_item_count_);
-  if (!::QueueUserWorkItem(&ThreadPool::ThreadProc, context.get(), flags)) {
+
+  bool needs_thread = false;
+  __mutexBlock(lock_) {
+    QueuedWorkItem queued_work_item = {};
+    queued_work_item.work_item = work_item;
+    queued_work_item.coinit_flags = coinit_flags;
+    queued_work_item.queued_time_ms = ::GetTickCount();
+    queues_[work_item->priority()].push_back(queued_work_item);
+
+    ++stats_.queue_depth;
+    stats_.max_queue_depth = std::max(stats_.max_queue_depth,
+                                      stats_.queue_depth);
+
+    if (!max_concurrent_work_items_ ||
+        num_running_ < max_concurrent_work_items_ ||
+        work_item->priority() >= UserWorkItem::kPriorityUrgent) {
+      ++num_running_;
+      needs_thread = true;
+    }
+  }
+
+  if (!needs_thread) {
+    // A running pool thread picks up the work item when it becomes the
+    // highest priority work item in the queue.
+    return S_OK;
+  }
+
+  if (!::QueueUserWorkItem(&ThreadPool::ThreadProc, this, flags)) {
+    const HRESULT hr = HRESULTFromLastError();
+    UTIL_LOG(LE, (_T("[::QueueUserWorkItem failed][0x%08x]"), hr));
+
+    __mutexBlock(lock_) {
+      --num_running_;
+    }
+
+    // A running pool thread may have already dequeued the work item, in which
+    // case the thread pool has the ownership of the work item.
+    if (!RemoveWorkItem(work_item)) {
+      return S_OK;
+    }
+
     ::InterlockedDecrement(&work_item_count_);
-    return HRESULTFromLastError();
+    return hr;
   }
 
   // The thread pool has the ownership of the work item thereon.
-  context.release();
   return S_OK;
 }
 
+void ThreadPool::GetStats(ThreadPoolStats* stats) const {
+  ASSERT1(stats);
+
+  __mutexScope(lock_);
+  *stats = stats_;
+}
+
 }   // namespace omaha
 
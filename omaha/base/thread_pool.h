@@ -17,35 +17,99 @@
 #define OMAHA_BASE_THREAD_POOL_H_
 
 #include <windows.h>
+#include <deque>
+#include <functional>
+#include <map>
 #include "base/basictypes.h"
 #include "omaha/base/scoped_any.h"
+#include "omaha/base/synchronized.h"
 
 namespace omaha {
 
 class UserWorkItem {
  public:
-  UserWorkItem() : shutdown_event_(NULL) {}
+  UserWorkItem()
+      : shutdown_event_(NULL),
+        priority_(kPriorityNormal),
+        is_canceled_(0) {}
   virtual ~UserWorkItem() {}
 
+  // Work items with higher priority values are dequeued first. The values
+  // match the INSTALL_PRIORITY values of the app bundle.
+  static const int kPriorityLow = 0;
+  static const int kPriorityNormal = 5;
+  static const int kPriorityHigh = 10;
+
+  // Urgent work items start right away regardless of the concurrency limit of
+  // the thread pool. Use this priority for work items whose callers block
+  // until the work item starts.
+  static const int kPriorityUrgent = 20;
+
   // Template method interface
-  void Process() { DoProcess(); }
+  void Process() {
+    if (is_canceled()) {
+      DoCancel();
+    } else {
+      DoProcess();
+    }
+  }
 
   HANDLE shutdown_event() const { return shutdown_event_; }
   void set_shutdown_event(HANDLE shutdown_event) {
     shutdown_event_ = shutdown_event;
   }
 
+  int priority() const { return priority_; }
+  void set_priority(int priority) { priority_ = priority; }
+
+  // Requests the cancellation of the work item. If the work item has not
+  // started yet, DoCancel is called instead of DoProcess. Otherwise, it is up
+  // to the implementers to check is_canceled() and to return early.
+  void Cancel() { ::InterlockedExchange(&is_canceled_, 1); }
+  bool is_canceled() const { return is_canceled_ != 0; }
+
  private:
   // Executes the work item.
   virtual void DoProcess() = 0;
 
+  // Called on the thread pool thread instead of DoProcess when the work item
+  // has been canceled before it started.
+  virtual void DoCancel() {}
+
   // It is the job of implementers to watch for the signaling of this event
   // and shutdown correctly. This event is set when the thread pool is closing.
   // Do not close this event as is owned by the thread pool.
   HANDLE shutdown_event_;
+  int priority_;
+  volatile LONG is_canceled_;
   DISALLOW_EVIL_CONSTRUCTORS(UserWorkItem);
 };
 
+// Queue depth and latency counters of the thread pool. The latency is the
+// time a work item waits in the queue before it starts.
+struct ThreadPoolStats {
+  ThreadPoolStats()
+      : queue_depth(0),
+        max_queue_depth(0),
+        num_processed(0),
+        num_canceled(0),
+        total_queue_latency_ms(0),
+        max_queue_latency_ms(0) {}
+
+  int queue_depth;
+  int max_queue_depth;
+  int num_processed;
+  int num_canceled;
+  uint64 total_queue_latency_ms;
+  DWORD max_queue_latency_ms;
+};
+
+// Runs work items on threads of the Windows thread pool. The work items are
+// queued by priority and at most 'max_concurrent_work_items' of them run at
+// the same time, not counting the urgent work items. Each pool thread keeps
+// dequeuing the highest priority work item until the queue is empty, therefore
+// a high priority work item queued behind lower priority ones starts as soon
+// as a slot is available.
 class ThreadPool {
  public:
   ThreadPool();
@@ -53,7 +117,9 @@ class ThreadPool {
   // The destructor might block for 'shutdown_delay'.
   ~ThreadPool();
 
+  // Zero 'max_concurrent_work_items' means there is no concurrency limit.
   HRESULT Initialize(int shutdown_delay);
+  HRESULT Initialize(int shutdown_delay, int max_concurrent_work_items);
 
   // Returns true if any work items are still in progress.
   bool HasWorkItems() const { return (0 != work_item_count_); }
@@ -64,7 +130,25 @@ class ThreadPool {
                             DWORD coinit_flags,
                             uint32 flags);
 
+  void GetStats(ThreadPoolStats* stats) const;
+
  private:
+  struct QueuedWorkItem {
+    UserWorkItem* work_item;
+    DWORD coinit_flags;
+    DWORD queued_time_ms;
+  };
+  typedef std::deque<QueuedWorkItem> WorkItemQueue;
+  typedef std::map<int, WorkItemQueue, std::greater<int> > PriorityQueues;
+
+  // Removes the highest priority work item from the queue. Returns false and
+  // releases the running slot of the caller if the queue is empty or if the
+  // pool runs over its concurrency limit because of urgent work items.
+  bool DequeueWorkItem(QueuedWorkItem* queued_work_item);
+
+  // Removes a work item which has not started yet from the queue.
+  bool RemoveWorkItem(const UserWorkItem* work_item);
+
   // Calls UserWorkItem::Process() in the context of the worker thread.
   void ProcessWorkItem(UserWorkItem* work_item);
 
@@ -74,6 +158,13 @@ class ThreadPool {
   // Approximate number of work items in the pool.
   volatile LONG work_item_count_;
 
+  // Protects the queues, the running count, and the stats.
+  LLock lock_;
+  PriorityQueues queues_;
+  int num_running_;
+  int max_concurrent_work_items_;
+  ThreadPoolStats stats_;
+
   // This event signals when the thread pool destructor is in progress.
   scoped_event shutdown_event_;
 
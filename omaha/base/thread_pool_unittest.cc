@@ -13,8 +13,12 @@
 // limitations under the License.
 // ========================================================================
 
+#include <vector>
 #include "base/basictypes.h"
 #include "base/scoped_ptr.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/synchronized.h"
 #include "omaha/base/thread_pool.h"
 #include "omaha/base/timer.h"
 #include "omaha/testing/unit_test.h"
@@ -84,6 +88,60 @@ class UserWorkItemCoInitTest : public UserWorkItem {
   DISALLOW_COPY_AND_ASSIGN(UserWorkItemCoInitTest);
 };
 
+// Blocks the pool thread until the gate is opened.
+class BlockingJob : public UserWorkItem {
+ public:
+  BlockingJob(Gate* started_gate, Gate* release_gate)
+      : started_gate_(started_gate), release_gate_(release_gate) {}
+
+ private:
+  virtual void DoProcess() {
+    started_gate_->Open();
+    EXPECT_TRUE(release_gate_->Wait(INFINITE));
+  }
+
+  Gate* started_gate_;
+  Gate* release_gate_;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockingJob);
+};
+
+// Records the order in which the jobs run or are canceled.
+class OrderedJob : public UserWorkItem {
+ public:
+  OrderedJob(int id, int priority, LLock* lock, std::vector<int>* order)
+      : id_(id), lock_(lock), order_(order) {
+    set_priority(priority);
+  }
+
+ private:
+  virtual void DoProcess() {
+    __mutexScope(lock_);
+    order_->push_back(id_);
+  }
+
+  virtual void DoCancel() {
+    __mutexScope(lock_);
+    order_->push_back(-id_);
+  }
+
+  const int id_;
+  LLock* lock_;
+  std::vector<int>* order_;
+
+  DISALLOW_COPY_AND_ASSIGN(OrderedJob);
+};
+
+void WaitForWorkItems(const ThreadPool& thread_pool) {
+  const int kMaxWaitForJobsMs = 10000;
+  LowResTimer t(true);
+  while (thread_pool.HasWorkItems() &&
+         t.GetMilliseconds() < kMaxWaitForJobsMs) {
+    ::Sleep(10);
+  }
+  EXPECT_FALSE(thread_pool.HasWorkItems());
+}
+
 HRESULT QueueMyJob1(ThreadPool* thread_pool) {
   scoped_ptr<MyJob1> job(new MyJob1);
   HRESULT hr = thread_pool->QueueUserWorkItem(job.get(),
@@ -199,5 +257,180 @@ TEST(ThreadPoolTest, UserWorkItemCoInitTest) {
   }
 }
 
+// Runs one work item at a time, therefore the queued work items run in the
+// order of their priority and in FIFO order within the same priority.
+TEST(ThreadPoolTest, Priority) {
+  const int kShutdownDelayMs = 0;
+  const int kMaxConcurrentWorkItems = 1;
+
+  ThreadPool thread_pool;
+  ASSERT_HRESULT_SUCCEEDED(thread_pool.Initialize(kShutdownDelayMs,
+                                                  kMaxConcurrentWorkItems));
+
+  Gate started_gate;
+  Gate release_gate;
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
+      new BlockingJob(&started_gate, &release_gate),
+      COINIT_MULTITHREADED,
+      WT_EXECUTEDEFAULT));
+  EXPECT_TRUE(started_gate.Wait(INFINITE));
+
+  LLock lock;
+  std::vector<int> order;
+  const int kPriorities[] = {
+    UserWorkItem::kPriorityLow,
+    UserWorkItem::kPriorityNormal,
+    UserWorkItem::kPriorityHigh,
+    UserWorkItem::kPriorityLow,
+    UserWorkItem::kPriorityHigh,
+  };
+  const int kNumJobs = arraysize(kPriorities);
+  for (int i = 0; i != kNumJobs; ++i) {
+    EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
+        new OrderedJob(i + 1, kPriorities[i], &lock, &order),
+        COINIT_MULTITHREADED,
+        WT_EXECUTEDEFAULT));
+  }
+
+  ThreadPoolStats stats;
+  thread_pool.GetStats(&stats);
+  EXPECT_EQ(kNumJobs, stats.queue_depth);
+
+  release_gate.Open();
+  WaitForWorkItems(thread_pool);
+
+  const int kExpectedOrder[] = {3, 5, 2, 1, 4};
+  ASSERT_EQ(arraysize(kExpectedOrder), order.size());
+  for (size_t i = 0; i != arraysize(kExpectedOrder); ++i) {
+    EXPECT_EQ(kExpectedOrder[i], order[i]);
+  }
+
+  thread_pool.GetStats(&stats);
+  EXPECT_EQ(0, stats.queue_depth);
+  EXPECT_EQ(kNumJobs, stats.max_queue_depth);
+  EXPECT_EQ(kNumJobs + 1, stats.num_processed);
+  EXPECT_EQ(0, stats.num_canceled);
+}
+
+TEST(ThreadPoolTest, Cancel) {
+  const int kShutdownDelayMs = 0;
+  const int kMaxConcurrentWorkItems = 1;
+
+  ThreadPool thread_pool;
+  ASSERT_HRESULT_SUCCEEDED(thread_pool.Initialize(kShutdownDelayMs,
+                                                  kMaxConcurrentWorkItems));
+
+  Gate started_gate;
+  Gate release_gate;
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
+      new BlockingJob(&started_gate, &release_gate),
+      COINIT_MULTITHREADED,
+      WT_EXECUTEDEFAULT));
+  EXPECT_TRUE(started_gate.Wait(INFINITE));
+
+  LLock lock;
+  std::vector<int> order;
+  OrderedJob* job1 = new OrderedJob(1, UserWorkItem::kPriorityNormal,
+                                    &lock, &order);
+  OrderedJob* job2 = new OrderedJob(2, UserWorkItem::kPriorityNormal,
+                                    &lock, &order);
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(job1,
+                                                         COINIT_MULTITHREADED,
+                                                         WT_EXECUTEDEFAULT));
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(job2,
+                                                         COINIT_MULTITHREADED,
+                                                         WT_EXECUTEDEFAULT));
+  job1->Cancel();
+
+  release_gate.Open();
+  WaitForWorkItems(thread_pool);
+
+  ASSERT_EQ(2U, order.size());
+  EXPECT_EQ(-1, order[0]);
+  EXPECT_EQ(2, order[1]);
+
+  ThreadPoolStats stats;
+  thread_pool.GetStats(&stats);
+  EXPECT_EQ(2, stats.num_processed);
+  EXPECT_EQ(1, stats.num_canceled);
+}
+
+// Urgent work items start even if the pool is at its concurrency limit, while
+// the other work items wait for a running work item to complete.
+TEST(ThreadPoolTest, UrgentWorkItemBypassesLimit) {
+  const int kShutdownDelayMs = 0;
+  const int kMaxConcurrentWorkItems = 1;
+
+  ThreadPool thread_pool;
+  ASSERT_HRESULT_SUCCEEDED(thread_pool.Initialize(kShutdownDelayMs,
+                                                  kMaxConcurrentWorkItems));
+
+  Gate started_gate;
+  Gate release_gate;
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
+      new BlockingJob(&started_gate, &release_gate),
+      COINIT_MULTITHREADED,
+      WT_EXECUTEDEFAULT));
+  EXPECT_TRUE(started_gate.Wait(INFINITE));
+
+  LLock lock;
+  std::vector<int> order;
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
+      new OrderedJob(1, UserWorkItem::kPriorityHigh, &lock, &order),
+      COINIT_MULTITHREADED,
+      WT_EXECUTEDEFAULT));
+
+  Gate urgent_started_gate;
+  BlockingJob* urgent_job = new BlockingJob(&urgent_started_gate,
+                                            &release_gate);
+  urgent_job->set_priority(UserWorkItem::kPriorityUrgent);
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(urgent_job,
+                                                         COINIT_MULTITHREADED,
+                                                         WT_EXECUTEDEFAULT));
+  EXPECT_TRUE(urgent_started_gate.Wait(10000));
+
+  __mutexBlock(lock) {
+    EXPECT_TRUE(order.empty());
+  }
+
+  release_gate.Open();
+  WaitForWorkItems(thread_pool);
+
+  ASSERT_EQ(1U, order.size());
+  EXPECT_EQ(1, order[0]);
+}
+
+// Measures the throughput of the thread pool for short work items, with and
+// without a concurrency limit.
+TEST(ThreadPoolTest, Throughput) {
+  const int kShutdownDelayMs = 0;
+  const int kNumJobs = 10000;
+  const int kMaxConcurrentWorkItems[] = {0, 1, 4};
+
+  for (size_t i = 0; i != arraysize(kMaxConcurrentWorkItems); ++i) {
+    ThreadPool thread_pool;
+    ASSERT_HRESULT_SUCCEEDED(thread_pool.Initialize(
+        kShutdownDelayMs, kMaxConcurrentWorkItems[i]));
+
+    g_completed_count = 0;
+    HighresTimer timer;
+    for (int j = 0; j != kNumJobs; ++j) {
+      EXPECT_HRESULT_SUCCEEDED(QueueMyJob1(&thread_pool));
+    }
+    WaitForWorkItems(thread_pool);
+    const ULONGLONG elapsed_ms = timer.GetElapsedMs();
+    EXPECT_EQ(kNumJobs, g_completed_count);
+
+    ThreadPoolStats stats;
+    thread_pool.GetStats(&stats);
+    UTIL_LOG(L1, (_T("[ThreadPoolTest::Throughput][max concurrency %d]")
+                  _T("[%d jobs in %I64u ms][max queue depth %d]")
+                  _T("[max queue latency %u ms]"),
+                  kMaxConcurrentWorkItems[i], kNumJobs, elapsed_ms,
+                  stats.max_queue_depth, stats.max_queue_latency_ms));
+  }
+  g_completed_count = 0;
+}
+
 }   // namespace omaha
 
@@ -47,6 +47,7 @@
 #include "omaha/base/time.h"
 #include "omaha/base/user_info.h"
 #include "omaha/base/user_rights.h"
+#include "omaha/base/version.h"
 #include "omaha/base/vistautil.h"
 
 namespace omaha {
@@ -120,47 +121,13 @@ bool EnsurePrivateNamespaceAvailable() {
 
 // Returns 0 if an error occurs.
 ULONGLONG VersionFromString(const CString& s) {
-  int pos(0);
-  unsigned int quad[4] = {0, 0, 0, 0};
-
-  for (int i = 0; i < 4; ++i) {
-    CString q = s.Tokenize(_T("."), pos);
-    if (pos == -1) {
-      return 0;
-    }
-
-    int quad_value(0);
-    if (!String_StringToDecimalIntChecked(q, &quad_value)) {
-      return 0;
-    }
-
-    quad[i] = static_cast<unsigned int>(quad_value);
-
-    if (kuint16max < quad[i]) {
-      return 0;
-    }
-  }
-
-  if (s.GetLength() + 1 != pos) {
-    return 0;
-  }
-
-  return MAKEDLLVERULL(quad[0], quad[1], quad[2], quad[3]);
+  Version version;
+  Version::Parse(s, &version);
+  return version.value();
 }
 
 CString StringFromVersion(ULONGLONG version) {
-  const WORD version_major = HIWORD(version >> 32);
-  const WORD version_minor = LOWORD(version >> 32);
-  const WORD version_build = HIWORD(version);
-  const WORD version_patch = LOWORD(version);
-
-  CString version_string;
-  SafeCStringFormat(&version_string, _T("%u.%u.%u.%u"),
-                    version_major,
-                    version_minor,
-                    version_build,
-                    version_patch);
-  return version_string;
+  return Version(version).ToString();
 }
 
 CString GetCurrentDir() {
@@ -70,6 +70,8 @@ enum __MIDL___MIDL_itf_objidl_0000_0047_0002 {
 #define URLACTION_MANAGED_UNSIGNED (0x00002004)
 #endif
 
+// Converts between dotted quad versions and their packed values. Invalid
+// versions are converted to 0. See the Version class for the details.
 ULONGLONG VersionFromString(const CString& s);
 
 CString StringFromVersion(ULONGLONG version);
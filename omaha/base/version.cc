@@ -0,0 +1,96 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/version.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/safe_format.h"
+
+namespace omaha {
+
+bool Version::Parse(const TCHAR* s, Version* version) {
+  return ParsePartial(s, kNumComponents, version);
+}
+
+bool Version::ParsePartial(const TCHAR* s,
+                           int min_components,
+                           Version* version) {
+  ASSERT1(min_components > 0 && min_components <= kNumComponents);
+  ASSERT1(version);
+
+  *version = Version();
+  if (!s) {
+    return false;
+  }
+
+  ULONGLONG value = 0;
+  int num_components = 0;
+  for (const TCHAR* p = s; ; ++p) {
+    if (*p < _T('0') || *p > _T('9')) {
+      return false;
+    }
+
+    // Stops as soon as the component is out of range, so that long strings
+    // of digits do not overflow.
+    unsigned int component = 0;
+    do {
+      component = component * 10 + (*p - _T('0'));
+      if (component > kuint16max) {
+        return false;
+      }
+      ++p;
+    } while (*p >= _T('0') && *p <= _T('9'));
+
+    value = value << 16 | component;
+    ++num_components;
+
+    if (!*p) {
+      break;
+    }
+    if (*p != _T('.') || num_components == kNumComponents) {
+      return false;
+    }
+  }
+
+  if (num_components < min_components) {
+    return false;
+  }
+
+  *version = Version(value << 16 * (kNumComponents - num_components));
+  return true;
+}
+
+CString Version::ToString() const {
+  CString version_string;
+  SafeCStringFormat(&version_string, _T("%u.%u.%u.%u"),
+                    major(),
+                    minor(),
+                    build(),
+                    patch());
+  return version_string;
+}
+
+size_t Version::Hash() const {
+  // The finalizer of MurmurHash3. Versions mostly differ in the low bits of
+  // their components, which the multiplications spread over the hash.
+  uint64 hash = value_;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return static_cast<size_t>(hash);
+}
+
+}  // namespace omaha
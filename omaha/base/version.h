@@ -0,0 +1,94 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Version is a four-part version, such as 1.3.26.0, packed in 64 bits the
+// same way as the versions of the version resources, so that versions compare
+// and hash as integers. Parsing a version does not allocate, since versions
+// are parsed in loops over all the apps of a response or all the directories
+// of the package cache.
+
+#ifndef OMAHA_BASE_VERSION_H_
+#define OMAHA_BASE_VERSION_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class Version {
+ public:
+  static const int kNumComponents = 4;
+
+  // The constructors are inline and do not call any function, so that the
+  // compiler folds the versions built from constants.
+  Version() : value_(0) {}
+
+  explicit Version(ULONGLONG value) : value_(value) {}
+
+  Version(WORD major, WORD minor, WORD build, WORD patch)
+      : value_(static_cast<ULONGLONG>(major) << 48 |
+               static_cast<ULONGLONG>(minor) << 32 |
+               static_cast<ULONGLONG>(build) << 16 |
+               patch) {}
+
+  // Parses a version of exactly four components. Each component is made of
+  // decimal digits and is at most 65535. Returns false and sets 'version' to
+  // zero if 's' is not a valid version.
+  static bool Parse(const TCHAR* s, Version* version);
+
+  // Parses a version of at least 'min_components' components, such as the
+  // "6.1" versions of the OS. The missing components are zero.
+  static bool ParsePartial(const TCHAR* s,
+                           int min_components,
+                           Version* version);
+
+  ULONGLONG value() const { return value_; }
+  bool IsZero() const { return !value_; }
+
+  WORD major() const { return static_cast<WORD>(value_ >> 48); }
+  WORD minor() const { return static_cast<WORD>(value_ >> 32); }
+  WORD build() const { return static_cast<WORD>(value_ >> 16); }
+  WORD patch() const { return static_cast<WORD>(value_); }
+
+  // Returns the version as a dotted quad.
+  CString ToString() const;
+
+  // Returns a hash which spreads the bits of all the components, for hash
+  // tables keyed by version.
+  size_t Hash() const;
+
+  bool operator==(const Version& other) const {
+    return value_ == other.value_;
+  }
+  bool operator!=(const Version& other) const {
+    return value_ != other.value_;
+  }
+  bool operator<(const Version& other) const { return value_ < other.value_; }
+  bool operator<=(const Version& other) const {
+    return value_ <= other.value_;
+  }
+  bool operator>(const Version& other) const { return value_ > other.value_; }
+  bool operator>=(const Version& other) const {
+    return value_ >= other.value_;
+  }
+
+ private:
+  ULONGLONG value_;
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_VERSION_H_
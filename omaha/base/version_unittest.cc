@@ -0,0 +1,288 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <stdlib.h>
+#include <set>
+#include <vector>
+#include "omaha/base/atl_regexp.h"
+#include "omaha/base/string.h"
+#include "omaha/base/version.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+// Parses a version the straightforward way, to check the parser against.
+bool ParseReference(const CString& s, int min_components, Version* version) {
+  *version = Version();
+
+  std::vector<CString> components;
+  int begin = 0;
+  for (;;) {
+    const int end = s.Find(_T('.'), begin);
+    components.push_back(s.Mid(begin, end == -1 ? s.GetLength() - begin :
+                                                  end - begin));
+    if (end == -1) {
+      break;
+    }
+    begin = end + 1;
+  }
+  if (static_cast<int>(components.size()) < min_components ||
+      static_cast<int>(components.size()) > Version::kNumComponents) {
+    return false;
+  }
+
+  WORD quad[Version::kNumComponents] = {0};
+  for (size_t i = 0; i != components.size(); ++i) {
+    const CString& component = components[i];
+    if (component.IsEmpty() ||
+        component.SpanIncluding(_T("0123456789")) != component) {
+      return false;
+    }
+    CString digits(component);
+    digits.TrimLeft(_T('0'));
+    if (digits.GetLength() > 5 || _ttoi(digits) > kuint16max) {
+      return false;
+    }
+    quad[i] = static_cast<WORD>(_ttoi(digits));
+  }
+
+  *version = Version(quad[0], quad[1], quad[2], quad[3]);
+  return true;
+}
+
+// Parses a version the way the OS versions were parsed before the Version
+// class: a regular expression picks the format, then the string is split in
+// tokens which are converted one at a time.
+ULONGLONG ParseWithRegex(const CString& s) {
+  CString quad(s);
+  if (AtlRE::PartialMatch(s, AtlRE(_T("^\\d+\\.\\d+$")))) {
+    quad += _T(".0.0");
+  } else if (!AtlRE::PartialMatch(
+                 s, AtlRE(_T("^\\d+\\.\\d+\\.\\d+\\.\\d+$")))) {
+    return 0;
+  }
+
+  int pos = 0;
+  ULONGLONG value = 0;
+  for (int i = 0; i < Version::kNumComponents; ++i) {
+    int component = 0;
+    if (!String_StringToDecimalIntChecked(quad.Tokenize(_T("."), pos),
+                                          &component) ||
+        component > kuint16max) {
+      return 0;
+    }
+    value = value << 16 | component;
+  }
+  return value;
+}
+
+// Returns a random string made mostly of digits and dots.
+CString MakeRandomString() {
+  const TCHAR kAlphabet[] = _T("0123456789....-+ aB\xe9");
+  CString s;
+  const int length = rand() % 24;
+  for (int i = 0; i < length; ++i) {
+    s.AppendChar(kAlphabet[rand() % (arraysize(kAlphabet) - 1)]);
+  }
+  return s;
+}
+
+}  // namespace
+
+TEST(VersionTest, Components) {
+  const Version version(1, 3, 26, 9);
+  EXPECT_EQ(MAKEDLLVERULL(1, 3, 26, 9), version.value());
+  EXPECT_EQ(1, version.major());
+  EXPECT_EQ(3, version.minor());
+  EXPECT_EQ(26, version.build());
+  EXPECT_EQ(9, version.patch());
+  EXPECT_FALSE(version.IsZero());
+
+  EXPECT_TRUE(Version().IsZero());
+  EXPECT_TRUE(Version(0xffff, 0xffff, 0xffff, 0xffff) ==
+              Version(_UI64_MAX));
+}
+
+TEST(VersionTest, Parse) {
+  Version version;
+  EXPECT_TRUE(Version::Parse(_T("42.1.21.12345"), &version));
+  EXPECT_TRUE(Version(42, 1, 21, 12345) == version);
+
+  EXPECT_TRUE(Version::Parse(_T("0.0.0.0"), &version));
+  EXPECT_TRUE(version.IsZero());
+
+  EXPECT_TRUE(Version::Parse(_T("65535.65535.65535.65535"), &version));
+  EXPECT_EQ(_UI64_MAX, version.value());
+
+  // Leading zeros do not change the value.
+  EXPECT_TRUE(Version::Parse(_T("01.0003.00000000026.0"), &version));
+  EXPECT_TRUE(Version(1, 3, 26, 0) == version);
+}
+
+TEST(VersionTest, Parse_Invalid) {
+  const TCHAR* const kInvalidVersions[] = {
+    _T(""),
+    _T("1"),
+    _T("1.1.1"),
+    _T("1.1.2.3."),
+    _T("1.1.2.3.4"),
+    _T(".1.2.3"),
+    _T("1..2.3"),
+    _T("1.2.3.-22"),
+    _T("1.2.3.+22"),
+    _T("1.2.3. 4"),
+    _T("1.2.3.4 "),
+    _T("1.B.3.4"),
+    _T("1.2.3.9B"),
+    _T("65536.65536.65536.65536"),
+    _T("1.2.65536.0"),
+    _T("1.2.3.4294967296"),
+    _T("1.2.3.99999999999999999999"),
+  };
+  for (int i = 0; i < arraysize(kInvalidVersions); ++i) {
+    Version version(1, 2, 3, 4);
+    EXPECT_FALSE(Version::Parse(kInvalidVersions[i], &version))
+        << kInvalidVersions[i];
+    EXPECT_TRUE(version.IsZero());
+  }
+
+  Version version(1, 2, 3, 4);
+  EXPECT_FALSE(Version::Parse(NULL, &version));
+  EXPECT_TRUE(version.IsZero());
+}
+
+TEST(VersionTest, ParsePartial) {
+  Version version;
+  EXPECT_TRUE(Version::ParsePartial(_T("6.1"), 2, &version));
+  EXPECT_TRUE(Version(6, 1, 0, 0) == version);
+
+  EXPECT_TRUE(Version::ParsePartial(_T("6.1.7601"), 2, &version));
+  EXPECT_TRUE(Version(6, 1, 7601, 0) == version);
+
+  EXPECT_TRUE(Version::ParsePartial(_T("6.1.7601.1"), 2, &version));
+  EXPECT_TRUE(Version(6, 1, 7601, 1) == version);
+
+  EXPECT_TRUE(Version::ParsePartial(_T("6"), 1, &version));
+  EXPECT_TRUE(Version(6, 0, 0, 0) == version);
+
+  EXPECT_FALSE(Version::ParsePartial(_T("6"), 2, &version));
+  EXPECT_FALSE(Version::ParsePartial(_T("6."), 1, &version));
+  EXPECT_FALSE(Version::ParsePartial(_T("6.1.7601.1.0"), 2, &version));
+}
+
+TEST(VersionTest, ToString) {
+  EXPECT_STREQ(_T("42.1.21.12345"), Version(42, 1, 21, 12345).ToString());
+  EXPECT_STREQ(_T("0.0.0.0"), Version().ToString());
+  EXPECT_STREQ(_T("65535.65535.65535.65535"), Version(_UI64_MAX).ToString());
+}
+
+TEST(VersionTest, Compare) {
+  const Version kVersions[] = {
+    Version(),
+    Version(0, 0, 0, 1),
+    Version(0, 0, 1, 0),
+    Version(0, 1, 0, 0),
+    Version(1, 0, 0, 0),
+    Version(1, 3, 9, 65535),
+    Version(1, 3, 10, 0),
+    Version(1, 3, 26, 1),
+    Version(65535, 0, 0, 0),
+  };
+  for (int i = 0; i < arraysize(kVersions); ++i) {
+    for (int j = 0; j < arraysize(kVersions); ++j) {
+      EXPECT_EQ(i == j, kVersions[i] == kVersions[j]);
+      EXPECT_EQ(i != j, kVersions[i] != kVersions[j]);
+      EXPECT_EQ(i < j, kVersions[i] < kVersions[j]);
+      EXPECT_EQ(i <= j, kVersions[i] <= kVersions[j]);
+      EXPECT_EQ(i > j, kVersions[i] > kVersions[j]);
+      EXPECT_EQ(i >= j, kVersions[i] >= kVersions[j]);
+    }
+  }
+}
+
+TEST(VersionTest, Hash) {
+  // Versions which differ in one low bit of one component land in different
+  // buckets of a small table.
+  const size_t kNumBuckets = 64;
+  std::set<size_t> buckets;
+  for (WORD i = 0; i < 16; ++i) {
+    buckets.insert(Version(1, 3, 26, i).Hash() % kNumBuckets);
+    buckets.insert(Version(1, 3, i, 0).Hash() % kNumBuckets);
+  }
+  EXPECT_LT(20U, buckets.size());
+
+  EXPECT_EQ(Version(1, 3, 26, 9).Hash(), Version(1, 3, 26, 9).Hash());
+}
+
+// Checks the parser against the reference parser for random strings, and for
+// valid versions with one character changed.
+TEST(VersionTest, Fuzz) {
+  srand(1);
+  for (int i = 0; i < 100000; ++i) {
+    const CString s = MakeRandomString();
+    for (int min_components = 1;
+         min_components <= Version::kNumComponents;
+         ++min_components) {
+      Version version;
+      Version expected_version;
+      EXPECT_EQ(ParseReference(s, min_components, &expected_version),
+                Version::ParsePartial(s, min_components, &version)) << s;
+      EXPECT_TRUE(expected_version == version) << s;
+    }
+  }
+
+  const TCHAR kMutations[] = _T("0123456789.a-");
+  for (int i = 0; i < 100000; ++i) {
+    const Version original(static_cast<ULONGLONG>(rand()) << 48 ^
+                           static_cast<ULONGLONG>(rand()) << 32 ^
+                           static_cast<ULONGLONG>(rand()) << 16 ^
+                           rand());
+    CString s = original.ToString();
+
+    // Valid versions survive the round trip.
+    Version version;
+    EXPECT_TRUE(Version::Parse(s, &version));
+    EXPECT_TRUE(original == version) << s;
+
+    s.SetAt(rand() % s.GetLength(),
+            kMutations[rand() % (arraysize(kMutations) - 1)]);
+    Version expected_version;
+    EXPECT_EQ(ParseReference(s, Version::kNumComponents, &expected_version),
+              Version::Parse(s, &version)) << s;
+    EXPECT_TRUE(expected_version == version) << s;
+  }
+}
+
+// Checks that the parser reads the OS versions as OSVersionFromString did
+// with a regular expression and tokens.
+TEST(VersionTest, ParsePartial_MatchesRegex) {
+  const TCHAR* const kVersions[] = {
+    _T("6.1"),
+    _T("10.0.14393.0"),
+    _T("1.3.26.9"),
+    _T("65535.65535.65535.65535"),
+    _T("1.3.x.9"),
+  };
+
+  for (int i = 0; i < arraysize(kVersions); ++i) {
+    Version version;
+    Version::ParsePartial(kVersions[i], 2, &version);
+    EXPECT_EQ(ParseWithRegex(kVersions[i]), version.value()) << kVersions[i];
+  }
+}
+
+}  // namespace omaha
@@ -23,6 +23,7 @@
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/startup_trace.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
 #include "omaha/base/vista_utils.h"
@@ -316,6 +317,7 @@ HRESULT Create(bool is_machine,
                bool is_interactive,
                bool send_pings,
                IAppBundle** app_bundle) {
+  STARTUP_TRACE_PHASE("bundle_creator::Create");
   CORE_LOG(L2, (_T("[bundle_creator::Create]")));
   ASSERT1(app_bundle);
 
@@ -374,6 +376,7 @@ HRESULT CreateFromCommandLine(bool is_machine,
                               bool is_interactive,
                               bool send_pings,
                               IAppBundle** app_bundle) {
+  STARTUP_TRACE_PHASE("bundle_creator::CreateFromCommandLine");
   CORE_LOG(L2, (_T("[bundle_creator::CreateFromCommandLine]")));
   ASSERT1(app_bundle);
   UNREFERENCED_PARAMETER(is_interactive);
@@ -23,6 +23,7 @@
 #include "omaha/base/scoped_ptr_address.h"
 #include "omaha/client/client_utils.h"
 #include "omaha/client/help_url_builder.h"
+#include "omaha/client/progress_events.h"
 #include "omaha/client/resource.h"
 #include "omaha/client/shutdown_events.h"
 #include "omaha/common/const_goopdate.h"
@@ -440,6 +441,8 @@ BundleInstaller::BundleInstaller(HelpUrlBuilder* help_url_builder,
       result_(E_UNEXPECTED),
       is_canceled_(false),
       is_handling_message_(false),
+      last_poll_ms_(0),
+      is_progress_poll_pending_(false),
       is_update_all_apps_(is_update_all_apps),
       is_update_check_only_(is_update_check_only),
       is_browser_type_supported_(is_browser_type_supported) {
@@ -460,14 +463,43 @@ LRESULT BundleInstaller::OnTimer(UINT msg,
   is_handling_message_ = true;
 
   VERIFY1(msg == WM_TIMER);
-  VERIFY1(wparam == kPollingTimerId);
+  VERIFY1(wparam == kPollingTimerId || wparam == kProgressTimerId);
 
-  if (!PollServer()) {
-    CORE_LOG(L6, (_T("[BundleInstaller::OnTimer][Stopping polling timer]")));
+  if (wparam == kProgressTimerId) {
+    KillTimer(kProgressTimerId);
+    is_progress_poll_pending_ = false;
+  }
 
-    // Ignore return value. KillTimer does not remove WM_TIMER messages already
-    // posted to the message queue.
-    KillTimer(kPollingTimerId);
+  PollServerAndRearm();
+
+  is_handling_message_ = false;
+  handled = true;
+  return 0;
+}
+
+// Polls the server right away unless the last poll is too recent, in which
+// case the poll is delayed. The server signals each change, so polls that
+// happen together are coalesced into one.
+LRESULT BundleInstaller::OnProgressEvent(UINT msg,
+                                         WPARAM,
+                                         LPARAM,
+                                         BOOL& handled) {  // NOLINT
+  if (is_handling_message_) {
+    ASSERT(false, (_T("[Reentrancy detected]")));
+    return 0;
+  }
+  is_handling_message_ = true;
+
+  VERIFY1(msg == kProgressEventMessage);
+
+  if (state_ != kComplete && !is_progress_poll_pending_) {
+    const DWORD min_interval_ms = kMinPollingIntervalMs;
+    const DWORD elapsed_ms = ::GetTickCount() - last_poll_ms_;
+    if (elapsed_ms >= min_interval_ms) {
+      PollServerAndRearm();
+    } else if (SetTimer(kProgressTimerId, min_interval_ms - elapsed_ms)) {
+      is_progress_poll_pending_ = true;
+    }
   }
 
   is_handling_message_ = false;
@@ -475,6 +507,32 @@ LRESULT BundleInstaller::OnTimer(UINT msg,
   return 0;
 }
 
+void BundleInstaller::PollServerAndRearm() {
+  // The event is reset before the state of the bundle is read, so that the
+  // changes made while the state is read trigger another poll.
+  if (progress_events_.get()) {
+    HRESULT hr = progress_events_->Rearm();
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[Rearm failed, polling the bundle][0x%08x]"), hr));
+      progress_events_.reset();
+      VERIFY1(SetTimer(kPollingTimerId, kPollingTimerPeriodMs));
+    }
+  }
+  last_poll_ms_ = ::GetTickCount();
+
+  if (!PollServer()) {
+    CORE_LOG(L6, (_T("[BundleInstaller::PollServerAndRearm]")
+                  _T("[Stopping polling timer]")));
+
+    // Ignore return value. KillTimer does not remove WM_TIMER messages already
+    // posted to the message queue.
+    KillTimer(kPollingTimerId);
+    KillTimer(kProgressTimerId);
+    is_progress_poll_pending_ = false;
+    progress_events_.reset();
+  }
+}
+
 HRESULT BundleInstaller::Initialize() {
   CORE_LOG(L3, (_T("[BundleInstaller::Initialize]")));
 
@@ -494,9 +552,14 @@ HRESULT BundleInstaller::Initialize() {
 }
 
 void BundleInstaller::Uninitialize() {
+  // Waits for the pending progress notifications, which post messages to the
+  // window.
+  progress_events_.reset();
+
   if (IsWindow()) {
     // This may fail if it was already killed when the bundle completed.
     KillTimer(kPollingTimerId);
+    KillTimer(kProgressTimerId);
 
     DestroyWindow();
   }
@@ -523,6 +586,37 @@ void BundleInstaller::StopListenToShutdownEvent(bool is_machine) {
   shutdown_callback_.reset();
 }
 
+// The installer keeps polling at short intervals if the server does not create
+// the progress event, for instance if the server is an older version.
+HRESULT BundleInstaller::ListenToProgressEvent(bool is_machine) {
+  ASSERT1(app_bundle_);
+  ASSERT1(!progress_events_.get());
+
+  CComBSTR session_id;
+  HRESULT hr = app_bundle_->get_sessionId(&session_id);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[get_sessionId failed][0x%08x]"), hr));
+    return hr;
+  }
+
+  scoped_ptr<ProgressEvents> progress_events(new ProgressEvents(this));
+  hr = progress_events->Initialize(is_machine, CString(session_id));
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[Progress event not available, polling the bundle]")
+                  _T("[0x%08x]"), hr));
+    return hr;
+  }
+
+  if (!SetTimer(kPollingTimerId, kFallbackPollingTimerPeriodMs)) {
+    return HRESULTFromLastError();
+  }
+  progress_events_.reset(progress_events.release());
+
+  // Starts processing the bundle without waiting for the first timer tick.
+  VERIFY1(PostMessage(kProgressEventMessage, 0, 0));
+  return S_OK;
+}
+
 HRESULT BundleInstaller::InstallBundle(bool is_machine,
                                        bool listen_to_shutdown_event,
                                        IAppBundle* app_bundle,
@@ -538,6 +632,8 @@ HRESULT BundleInstaller::InstallBundle(bool is_machine,
     ListenToShutdownEvent(is_machine);
   }
 
+  ListenToProgressEvent(is_machine);
+
   _pAtlModule->Lock();
 
   message_loop_.Run();
@@ -60,6 +60,7 @@ CString GetBundleCompletionMessage(
 }  // namespace internal
 
 class HelpUrlBuilder;
+class ProgressEvents;
 class ShutdownCallback;
 
 class BundleInstaller
@@ -67,6 +68,9 @@ class BundleInstaller
                          CWindow,
                          CWinTraits<WS_OVERLAPPED, WS_EX_TOOLWINDOW> > {
  public:
+  // Posted by ProgressEvents when the server signals a change in the bundle.
+  static const UINT kProgressEventMessage = WM_APP + 1;
+
   // Takes ownership of help_url_builder.
   BundleInstaller(HelpUrlBuilder* help_url_builder,
                   bool is_update_all_apps,
@@ -161,6 +165,13 @@ class BundleInstaller
   // listening. Otherwise no effect.
   void StopListenToShutdownEvent(bool is_machine);
 
+  // Makes the installer poll the server when the server signals a change in
+  // the bundle instead of polling it at short intervals.
+  HRESULT ListenToProgressEvent(bool is_machine);
+
+  // Polls the server and stops the timers when the bundle is complete.
+  void PollServerAndRearm();
+
   // These functions update the UI during HandleProcessingState().
   // TODO(omaha): Rename these to Notify*.
   HRESULT NotifyUpdateAvailable(IApp* app);
@@ -188,11 +199,22 @@ class BundleInstaller
   BEGIN_MSG_MAP(BundleInstaller)
     MESSAGE_HANDLER(WM_CLOSE, OnClose)
     MESSAGE_HANDLER(WM_TIMER, OnTimer)
+    MESSAGE_HANDLER(kProgressEventMessage, OnProgressEvent)
   END_MSG_MAP()
 
   static const int kPollingTimerId = 1;
   static const int kPollingTimerPeriodMs = 100;
 
+  // When the server signals the changes in the bundle, the polling timer only
+  // picks up the progress that the server does not signal, such as the
+  // estimated install progress.
+  static const int kFallbackPollingTimerPeriodMs = 1000;
+
+  // Delays the polls requested by the server so that the server is not polled
+  // and the UI is not updated more often than this.
+  static const int kProgressTimerId = 2;
+  static const int kMinPollingIntervalMs = 100;
+
   // The main use case for this OnClose() handler is the shutdown handler via a
   // PostMessage in the /UA scenario.
   LRESULT OnClose(UINT msg,
@@ -206,6 +228,12 @@ class BundleInstaller
                   LPARAM lparam,
                   BOOL& handled);  // NOLINT
 
+  // Calls BundleInstaller::PollServer() when the server signals a change.
+  LRESULT OnProgressEvent(UINT msg,
+                          WPARAM wparam,
+                          LPARAM lparam,
+                          BOOL& handled);  // NOLINT
+
   void ReleaseAppBundle();
 
   InstallProgressObserver* observer_;
@@ -223,6 +251,14 @@ class BundleInstaller
   // Shutdown event listener.
   scoped_ptr<ShutdownCallback> shutdown_callback_;
 
+  // Progress event listener. NULL if the installer polls at short intervals.
+  scoped_ptr<ProgressEvents> progress_events_;
+
+  // The time of the last poll and whether a poll requested by the server is
+  // delayed by kProgressTimerId.
+  DWORD last_poll_ms_;
+  bool is_progress_poll_pending_;
+
   // The apps in app_bundle_. Allows easier and quicker access to the apps than
   // going through app_bundle_.
   typedef CComPtr<IApp> ComPtrIApp;
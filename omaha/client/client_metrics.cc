@@ -20,4 +20,8 @@ namespace omaha {
 DEFINE_METRIC_count(client_another_install_in_progress);
 DEFINE_METRIC_count(client_another_update_in_progress);
 
+DEFINE_METRIC_integer(client_ua_cold_start_ms);
+DEFINE_METRIC_integer(client_ua_warm_start_ms);
+DEFINE_METRIC_count(client_ua_warm_cycles);
+
 }  // namespace omaha
@@ -32,6 +32,17 @@ DECLARE_METRIC_count(client_another_install_in_progress);
 // This metric was named worker_another_install_in_progress in Omaha 2.
 DECLARE_METRIC_count(client_another_update_in_progress);
 
+// Time from the start of a persistent /ua process to the start of its first
+// update cycle. This includes the startup costs of the process.
+DECLARE_METRIC_integer(client_ua_cold_start_ms);
+
+// Time from the core requesting an update cycle from a persistent /ua process
+// to the start of the cycle.
+DECLARE_METRIC_integer(client_ua_warm_start_ms);
+
+// How many update cycles a persistent /ua process ran after its first cycle.
+DECLARE_METRIC_count(client_ua_warm_cycles);
+
 }  // namespace omaha
 
 #endif  // OMAHA_CLIENT_CLIENT_METRICS_H_
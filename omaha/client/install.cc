@@ -361,6 +361,20 @@ HRESULT CopyOfflineManifest(const CString& offline_dir) {
     return hr;
   }
 
+  // Installers built with an offline index carry it next to the manifest.
+  const CString source_index_path = ConcatenatePath(setup_temp_dir,
+                                                    kOfflineIndexFileName);
+  if (File::Exists(source_index_path)) {
+    const CString dest_index_path = ConcatenatePath(offline_dir,
+                                                    kOfflineIndexFileName);
+    hr = File::Copy(source_index_path, dest_index_path, true);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[File copy failed][%s][%s][0x%08x]"),
+                     source_index_path, dest_index_path, hr));
+      return hr;
+    }
+  }
+
   return S_OK;
 }
 
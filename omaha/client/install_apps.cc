@@ -25,6 +25,7 @@
 #include "omaha/base/scoped_ptr_address.h"
 #include "omaha/base/shutdown_callback.h"
 #include "omaha/base/shutdown_handler.h"
+#include "omaha/base/startup_trace.h"
 #include "omaha/base/string.h"
 #include "omaha/base/time.h"
 #include "omaha/base/utils.h"
@@ -209,12 +210,47 @@ class BundleAtlModule : public CAtlExeModuleT<BundleAtlModule> {
     allow_post_quit_ = true;
   }
 
+  void disable_quit() {
+    allow_post_quit_ = false;
+  }
+
  private:
   bool allow_post_quit_;
 
   DISALLOW_COPY_AND_ASSIGN(BundleAtlModule);
 };
 
+// The module created by ScopedBundleAtlModule, if any.
+BundleAtlModule* shared_atl_module = NULL;
+
+// Uses the shared module if there is one, otherwise creates a module for the
+// lifetime of the object. The module does not post WM_QUIT until enable_quit()
+// is called, even if the shared module did so for a previous bundle.
+class BundleAtlModuleScope {
+ public:
+  BundleAtlModuleScope() : atl_module_(shared_atl_module) {
+    if (!atl_module_) {
+      own_atl_module_.reset(new BundleAtlModule);
+      atl_module_ = own_atl_module_.get();
+    }
+    atl_module_->disable_quit();
+  }
+
+  ~BundleAtlModuleScope() {
+    atl_module_->disable_quit();
+  }
+
+  void enable_quit() {
+    atl_module_->enable_quit();
+  }
+
+ private:
+  scoped_ptr<BundleAtlModule> own_atl_module_;
+  BundleAtlModule* atl_module_;
+
+  DISALLOW_COPY_AND_ASSIGN(BundleAtlModuleScope);
+};
+
 }  // namespace
 
 namespace internal {
@@ -384,6 +420,7 @@ HRESULT DoInstallApps(BundleInstaller* installer,
                       bool is_update_all_apps,
                       BrowserType browser_type,
                       bool* has_ui_been_displayed) {
+  STARTUP_TRACE_PHASE("DoInstallApps");
   CORE_LOG(L2, (_T("[DoInstallApps]")));
   ASSERT1(installer);
   ASSERT1(has_ui_been_displayed);
@@ -577,6 +614,7 @@ HRESULT InstallApps(bool is_machine,
                     const CString& install_source,
                     const CString& session_id,
                     bool* has_ui_been_displayed) {
+  STARTUP_TRACE_PHASE("InstallApps");
   CORE_LOG(L2, (_T("[InstallApps][is_machine: %u][is_interactive: %u]")
       _T("[is_eula_accepted: %u][is_oem_install: %u][is_offline: %u]")
       _T("[is_enterprise_install: %u][offline_directory: %s]"), is_machine,
@@ -584,7 +622,7 @@ HRESULT InstallApps(bool is_machine,
       is_enterprise_install, offline_directory));
   ASSERT1(has_ui_been_displayed);
 
-  BundleAtlModule atl_module;
+  BundleAtlModuleScope atl_module;
   const bool send_pings = !is_enterprise_install;
 
   CComPtr<IAppBundle> app_bundle;
@@ -643,10 +681,11 @@ HRESULT UpdateAllApps(bool is_machine,
                       const CString& display_language,
                       const CString& session_id,
                       bool* has_ui_been_displayed) {
+  STARTUP_TRACE_PHASE("UpdateAllApps");
   CORE_LOG(L2, (_T("[UpdateAllApps][%u][%u]"), is_machine, is_interactive));
   ASSERT1(has_ui_been_displayed);
 
-  BundleAtlModule atl_module;
+  BundleAtlModuleScope atl_module;
   const bool send_pings = true;
 
   CComPtr<IAppBundle> app_bundle;
@@ -685,4 +724,14 @@ HRESULT UpdateAllApps(bool is_machine,
                                  has_ui_been_displayed);
 }
 
+ScopedBundleAtlModule::ScopedBundleAtlModule() {
+  ASSERT1(!shared_atl_module);
+  shared_atl_module = new BundleAtlModule;
+}
+
+ScopedBundleAtlModule::~ScopedBundleAtlModule() {
+  delete shared_atl_module;
+  shared_atl_module = NULL;
+}
+
 }  // namespace omaha
@@ -20,6 +20,7 @@
 
 #include <windows.h>
 #include <atlstr.h>
+#include "base/basictypes.h"
 #include "omaha/client/install_progress_observer.h"
 
 namespace omaha {
@@ -69,6 +70,19 @@ HRESULT UpdateAllApps(bool is_machine,
                       const CString& session_id,
                       bool* has_ui_been_displayed);
 
+// Creates the ATL module which InstallApps and UpdateAllApps need and keeps it
+// for the lifetime of the object. ATL allows only one module per process, so
+// a process which runs several bundles one after the other must create the
+// module once. Otherwise, each call creates its own module.
+class ScopedBundleAtlModule {
+ public:
+  ScopedBundleAtlModule();
+  ~ScopedBundleAtlModule();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedBundleAtlModule);
+};
+
 }  // namespace omaha
 
 #endif  // OMAHA_CLIENT_INSTALL_APPS_H_
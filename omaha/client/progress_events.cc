@@ -0,0 +1,85 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/client/progress_events.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/reactor.h"
+#include "omaha/base/utils.h"
+#include "omaha/client/bundle_installer.h"
+#include "omaha/common/goopdate_utils.h"
+
+namespace omaha {
+
+ProgressEvents::ProgressEvents(BundleInstaller* installer)
+    : installer_(installer) {
+  ASSERT1(installer);
+}
+
+ProgressEvents::~ProgressEvents() {
+  CORE_LOG(L3, (_T("[ProgressEvents::~ProgressEvents]")));
+  if (progress_event_) {
+    VERIFY1(SUCCEEDED(reactor_->UnregisterHandle(get(progress_event_))));
+  }
+  reactor_.reset();
+}
+
+HRESULT ProgressEvents::Initialize(bool is_machine, const CString& session_id) {
+  CORE_LOG(L3, (_T("[ProgressEvents::Initialize][%s]"), session_id));
+  ASSERT1(!progress_event_);
+
+  NamedObjectAttributes event_attr;
+  goopdate_utils::GetBundleProgressEventAttributes(session_id,
+                                                   is_machine,
+                                                   &event_attr);
+  reset(progress_event_, ::OpenEvent(SYNCHRONIZE | EVENT_MODIFY_STATE,
+                                     false,
+                                     event_attr.name));
+  if (!progress_event_) {
+    return HRESULTFromLastError();
+  }
+
+  reactor_.reset(new Reactor);
+  HRESULT hr = reactor_->RegisterHandle(get(progress_event_), this, 0);
+  if (FAILED(hr)) {
+    reset(progress_event_);
+    return hr;
+  }
+
+  return S_OK;
+}
+
+HRESULT ProgressEvents::Rearm() {
+  ASSERT1(progress_event_);
+
+  if (!::ResetEvent(get(progress_event_))) {
+    return HRESULTFromLastError();
+  }
+  return reactor_->RegisterHandle(get(progress_event_));
+}
+
+// The event stays signaled until the installer rearms it, so this is called at
+// most once for each time the installer reads the state of the bundle.
+void ProgressEvents::HandleEvent(HANDLE handle) {
+  ASSERT1(handle == get(progress_event_));
+  UNREFERENCED_PARAMETER(handle);
+
+  if (installer_->IsWindow()) {
+    installer_->PostMessage(BundleInstaller::kProgressEventMessage, 0, 0);
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,64 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// ProgressEvents wakes up the BundleInstaller when the COM server signals that
+// the state or the progress of the bundle has changed, so that the installer
+// does not need to poll the server at short intervals while nothing changes.
+
+#ifndef OMAHA_CLIENT_PROGRESS_EVENTS_H_
+#define OMAHA_CLIENT_PROGRESS_EVENTS_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include "base/basictypes.h"
+#include "base/scoped_ptr.h"
+#include "omaha/base/event_handler.h"
+#include "omaha/base/scoped_any.h"
+
+namespace omaha {
+
+class BundleInstaller;
+class Reactor;
+
+class ProgressEvents : public EventHandler {
+ public:
+  explicit ProgressEvents(BundleInstaller* installer);
+  virtual ~ProgressEvents();
+
+  // Opens the progress event of the bundle with the given session ID. Fails
+  // if the COM server did not create the event.
+  HRESULT Initialize(bool is_machine, const CString& session_id);
+
+  // Resets the event and waits for it to be signaled again. The installer
+  // calls this before it reads the state of the bundle, so that the changes
+  // made while the state is being read are not missed.
+  HRESULT Rearm();
+
+  // Posts a message to the installer window. Called from a thread in the OS
+  // thread pool.
+  virtual void HandleEvent(HANDLE handle);
+
+ private:
+  BundleInstaller* installer_;
+
+  scoped_ptr<Reactor> reactor_;
+  scoped_event progress_event_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ProgressEvents);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_CLIENT_PROGRESS_EVENTS_H_
@@ -16,6 +16,7 @@
 #include "omaha/client/ua.h"
 
 #include <windows.h>
+#include <atlbase.h>
 #include <atlstr.h>
 #include <stdlib.h>
 
@@ -25,14 +26,21 @@
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
+#include "omaha/base/omaha_version.h"
 #include "omaha/base/program_instance.h"
+#include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/scoped_any.h"
 #include "omaha/base/scoped_ptr_address.h"
+#include "omaha/base/startup_trace.h"
+#include "omaha/base/system.h"
 #include "omaha/base/utils.h"
 #include "omaha/base/time.h"
+#include "omaha/base/version.h"
 #include "omaha/client/install_apps.h"
 #include "omaha/client/install_self.h"
 #include "omaha/client/client_metrics.h"
+#include "omaha/client/update_worker_budget.h"
 #include "omaha/common/app_registry_utils.h"
 #include "omaha/common/command_line_builder.h"
 #include "omaha/common/config_manager.h"
@@ -157,6 +165,41 @@ bool IsUpdateAppsHourlyJitterDisabled() {
   }
 }
 
+// Returns the time the current process started, in milliseconds.
+time64 GetProcessStartTimeMs() {
+  FILETIME creation_time = {0};
+  FILETIME exit_time = {0};
+  FILETIME kernel_time = {0};
+  FILETIME user_time = {0};
+  if (!::GetProcessTimes(::GetCurrentProcess(),
+                         &creation_time,
+                         &exit_time,
+                         &kernel_time,
+                         &user_time)) {
+    return GetCurrentMsTime();
+  }
+  return FileTimeToTime64(creation_time) / kMillisecsTo100ns;
+}
+
+// Returns true if the installed version of Omaha is not the version of this
+// process, which is the case after a self-update. A persistent worker must not
+// run the update cycles of the new version.
+bool IsInstalledVersionChanged(bool is_machine) {
+  CString installed_version;
+  if (FAILED(RegKey::GetValue(
+          ConfigManager::Instance()->registry_update(is_machine),
+          kRegValueInstalledVersion,
+          &installed_version))) {
+    return false;
+  }
+
+  Version this_version;
+  Version registered_version;
+  return Version::Parse(GetVersionString(), &this_version) &&
+         Version::Parse(installed_version, &registered_version) &&
+         this_version != registered_version;
+}
+
 }  // namespace
 
 // Returns false if "RetryAfter" in the registry is set to a time greater than
@@ -242,6 +285,7 @@ HRESULT UpdateApps(bool is_machine,
                    const CString& install_source,
                    const CString& display_language,
                    bool* has_ui_been_displayed) {
+  STARTUP_TRACE_PHASE("UpdateApps");
   CORE_LOG(L1, (_T("[UpdateApps]")));
   ASSERT1(has_ui_been_displayed);
 
@@ -308,4 +352,125 @@ HRESULT UpdateApps(bool is_machine,
   return hr;
 }
 
+// The cold start of the first cycle includes the creation and initialization
+// of the process. The warm start of the next cycles is measured from the time
+// the core requested the cycle. Comparing the two metrics gives the startup
+// cost which a persistent worker saves for each cycle.
+HRESULT UpdateAppsPersistent(bool is_machine,
+                             const CString& install_source,
+                             const CString& display_language) {
+  CORE_LOG(L1, (_T("[UpdateAppsPersistent]")));
+
+  NamedObjectAttributes cycle_event_attr;
+  GetNamedObjectAttributes(kUpdateAppsCycleEvent,
+                           is_machine,
+                           &cycle_event_attr);
+  scoped_event cycle_event(::CreateEvent(&cycle_event_attr.sa,
+                                         false,
+                                         false,
+                                         cycle_event_attr.name));
+  const bool is_already_running = ::GetLastError() == ERROR_ALREADY_EXISTS;
+  if (!cycle_event || is_already_running) {
+    // Run one cycle like a regular /ua process. If another persistent worker
+    // is running, UpdateApps detects it and exits.
+    OPT_LOG(LW, (_T("[Cannot run as a persistent worker][%d]"),
+                 is_already_running));
+    bool has_ui_been_displayed = false;
+    return UpdateApps(is_machine,
+                      false,  // Is not interactive.
+                      false,  // Is not on demand.
+                      install_source,
+                      display_language,
+                      &has_ui_been_displayed);
+  }
+
+  NamedObjectAttributes shutdown_event_attr;
+  GetNamedObjectAttributes(kShutdownEvent, is_machine, &shutdown_event_attr);
+  scoped_event shutdown_event(::OpenEvent(SYNCHRONIZE,
+                                          false,
+                                          shutdown_event_attr.name));
+
+  // If the core stops requesting cycles, for instance because it exited,
+  // the worker exits as well.
+  const int idle_timeout_ms =
+      2 * ConfigManager::Instance()->GetAutoUpdateTimerIntervalMs();
+
+  const time64 start_time_ms = GetProcessStartTimeMs();
+  UpdateWorkerBudget budget(kPersistentUpdateWorkerMaxCycles,
+                            kPersistentUpdateWorkerMaxAgeMs,
+                            kPersistentUpdateWorkerMaxWorkingSetBytes,
+                            start_time_ms);
+  time64 cycle_requested_ms = start_time_ms;
+  HRESULT hr = S_OK;
+
+  // All the cycles share one ATL module, which lives as long as the worker.
+  ScopedBundleAtlModule atl_module;
+
+  for (;;) {
+    const time64 cycle_start_ms = GetCurrentMsTime();
+    const int startup_ms = cycle_start_ms >= cycle_requested_ms ?
+        static_cast<int>(cycle_start_ms - cycle_requested_ms) : 0;
+    const bool is_cold_start = budget.cycles() == 0;
+    if (is_cold_start) {
+      metric_client_ua_cold_start_ms = startup_ms;
+    } else {
+      metric_client_ua_warm_start_ms = startup_ms;
+      ++metric_client_ua_warm_cycles;
+    }
+
+    bool has_ui_been_displayed = false;
+    hr = UpdateApps(is_machine,
+                    false,  // Is not interactive.
+                    false,  // Is not on demand.
+                    install_source,
+                    display_language,
+                    &has_ui_been_displayed);
+
+    budget.RecordCycle();
+    OPT_LOG(L1, (_T("[Update cycle finished][%s start %d ms][cycle %llu ms]")
+                 _T("[0x%x]"),
+                 is_cold_start ? _T("cold") : _T("warm"),
+                 startup_ms,
+                 GetCurrentMsTime() - cycle_start_ms,
+                 hr));
+
+    uint64 working_set_bytes = 0;
+    VERIFY1(SUCCEEDED(System::GetProcessMemoryStatistics(&working_set_bytes,
+                                                         NULL,
+                                                         NULL,
+                                                         NULL)));
+    if (budget.IsExhausted(GetCurrentMsTime(), working_set_bytes)) {
+      OPT_LOG(L1, (_T("[Persistent worker budget exhausted][%d cycles]"),
+                   budget.cycles()));
+      break;
+    }
+
+    if (IsInstalledVersionChanged(is_machine)) {
+      OPT_LOG(L1, (_T("[Persistent worker exiting][new version installed]")));
+      break;
+    }
+
+    // The core may have requested a cycle while this cycle was running. Such
+    // a request is served by the cycle which just finished.
+    VERIFY1(::ResetEvent(get(cycle_event)));
+
+    HANDLE handles[] = { get(cycle_event), get(shutdown_event) };
+    const DWORD num_handles = valid(shutdown_event) ? arraysize(handles) : 1;
+    const DWORD result = ::WaitForMultipleObjects(num_handles,
+                                                  handles,
+                                                  false,
+                                                  idle_timeout_ms);
+    if (result != WAIT_OBJECT_0) {
+      CORE_LOG(L1, (_T("[Persistent worker exiting][%u]"), result));
+      break;
+    }
+    cycle_requested_ms = GetCurrentMsTime();
+  }
+
+  // Closing the event as soon as possible makes the core start a new worker
+  // for its next request.
+  reset(cycle_event);
+  return hr;
+}
+
 }  // namespace omaha
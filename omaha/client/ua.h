@@ -34,6 +34,15 @@ HRESULT UpdateApps(bool is_machine,
                    const CString& display_language,
                    bool* has_ui_been_displayed);
 
+// Performs the duties of a persistent /ua process. Runs an update cycle right
+// away, then runs another cycle each time the core requests one, until the
+// process has used up its budget, the core stops requesting cycles, or the
+// shutdown event is signaled. The process initialization, the loaded resources
+// and the network configuration are reused by all the cycles.
+HRESULT UpdateAppsPersistent(bool is_machine,
+                             const CString& install_source,
+                             const CString& display_language);
+
 }  // namespace omaha
 
 #endif  // OMAHA_CLIENT_UA_H_
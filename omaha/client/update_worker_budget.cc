@@ -0,0 +1,58 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/client/update_worker_budget.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/logging.h"
+
+namespace omaha {
+
+UpdateWorkerBudget::UpdateWorkerBudget(int max_cycles,
+                                       int max_age_ms,
+                                       uint64 max_working_set_bytes,
+                                       time64 start_time_ms)
+    : max_cycles_(max_cycles),
+      max_age_ms_(max_age_ms),
+      max_working_set_bytes_(max_working_set_bytes),
+      start_time_ms_(start_time_ms),
+      cycles_(0) {
+  ASSERT1(max_cycles_ > 0);
+  ASSERT1(max_age_ms_ > 0);
+}
+
+bool UpdateWorkerBudget::IsExhausted(time64 now_ms,
+                                     uint64 working_set_bytes) const {
+  if (cycles_ >= max_cycles_) {
+    CORE_LOG(L2, (_T("[UpdateWorkerBudget][cycles exhausted][%d]"), cycles_));
+    return true;
+  }
+
+  // A clock which moved backwards does not extend the life of the worker.
+  if (now_ms < start_time_ms_ ||
+      now_ms - start_time_ms_ >= static_cast<time64>(max_age_ms_)) {
+    CORE_LOG(L2, (_T("[UpdateWorkerBudget][age exhausted]")));
+    return true;
+  }
+
+  if (working_set_bytes > max_working_set_bytes_) {
+    CORE_LOG(L2, (_T("[UpdateWorkerBudget][memory exhausted][%llu]"),
+                  working_set_bytes));
+    return true;
+  }
+
+  return false;
+}
+
+}  // namespace omaha
@@ -0,0 +1,54 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+// Tracks the resources used by a persistent /ua process, which exits once it
+// has used up its budget so that leaks and fragmentation do not accumulate.
+
+#ifndef OMAHA_CLIENT_UPDATE_WORKER_BUDGET_H_
+#define OMAHA_CLIENT_UPDATE_WORKER_BUDGET_H_
+
+#include "base/basictypes.h"
+#include "omaha/base/time.h"
+
+namespace omaha {
+
+class UpdateWorkerBudget {
+ public:
+  UpdateWorkerBudget(int max_cycles,
+                     int max_age_ms,
+                     uint64 max_working_set_bytes,
+                     time64 start_time_ms);
+
+  void RecordCycle() { ++cycles_; }
+
+  // Returns true if the worker has run its maximum number of cycles, is older
+  // than its maximum age at 'now_ms', or uses more memory than allowed.
+  bool IsExhausted(time64 now_ms, uint64 working_set_bytes) const;
+
+  int cycles() const { return cycles_; }
+
+ private:
+  const int max_cycles_;
+  const int max_age_ms_;
+  const uint64 max_working_set_bytes_;
+  const time64 start_time_ms_;
+  int cycles_;
+
+  DISALLOW_COPY_AND_ASSIGN(UpdateWorkerBudget);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_CLIENT_UPDATE_WORKER_BUDGET_H_
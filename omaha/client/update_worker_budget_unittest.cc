@@ -0,0 +1,65 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/client/update_worker_budget.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const int kMaxCycles = 3;
+const int kMaxAgeMs = 1000;
+const uint64 kMaxWorkingSetBytes = 1024;
+const time64 kStartTimeMs = 5000;
+
+}  // namespace
+
+TEST(UpdateWorkerBudgetTest, Cycles) {
+  UpdateWorkerBudget budget(kMaxCycles,
+                            kMaxAgeMs,
+                            kMaxWorkingSetBytes,
+                            kStartTimeMs);
+  for (int i = 0; i < kMaxCycles; ++i) {
+    EXPECT_EQ(i, budget.cycles());
+    EXPECT_FALSE(budget.IsExhausted(kStartTimeMs, 0));
+    budget.RecordCycle();
+  }
+  EXPECT_EQ(kMaxCycles, budget.cycles());
+  EXPECT_TRUE(budget.IsExhausted(kStartTimeMs, 0));
+}
+
+TEST(UpdateWorkerBudgetTest, Age) {
+  UpdateWorkerBudget budget(kMaxCycles,
+                            kMaxAgeMs,
+                            kMaxWorkingSetBytes,
+                            kStartTimeMs);
+  EXPECT_FALSE(budget.IsExhausted(kStartTimeMs + kMaxAgeMs - 1, 0));
+  EXPECT_TRUE(budget.IsExhausted(kStartTimeMs + kMaxAgeMs, 0));
+
+  // The clock moved backwards.
+  EXPECT_TRUE(budget.IsExhausted(kStartTimeMs - 1, 0));
+}
+
+TEST(UpdateWorkerBudgetTest, WorkingSet) {
+  UpdateWorkerBudget budget(kMaxCycles,
+                            kMaxAgeMs,
+                            kMaxWorkingSetBytes,
+                            kStartTimeMs);
+  EXPECT_FALSE(budget.IsExhausted(kStartTimeMs, kMaxWorkingSetBytes));
+  EXPECT_TRUE(budget.IsExhausted(kStartTimeMs, kMaxWorkingSetBytes + 1));
+}
+
+}  // namespace omaha
@@ -483,17 +483,31 @@ int GetInstallTimeDiffSec(bool is_machine, const CString& app_id) {
   }
 
   DWORD install_time(0);
-  int install_time_diff_sec(0);
-  if (SUCCEEDED(key.GetValue(kRegValueInstallTimeSec, &install_time))) {
-    const int now = Time64ToInt32(GetCurrent100NSTime());
-    if (0 != install_time &&
-        static_cast<DWORD>(now) >= install_time &&
-        INT_MAX >= static_cast<DWORD>(now) - install_time) {
-      install_time_diff_sec = now - install_time;
-    }
+  if (FAILED(key.GetValue(kRegValueInstallTimeSec, &install_time))) {
+    return 0;
+  }
+
+  return InstallTimeToInstallTimeDiffSec(install_time);
+}
+
+int InstallTimeToInstallTimeDiffSec(DWORD install_time) {
+  const int now = Time64ToInt32(GetCurrent100NSTime());
+  if (0 != install_time &&
+      static_cast<DWORD>(now) >= install_time &&
+      INT_MAX >= static_cast<DWORD>(now) - install_time) {
+    return now - install_time;
   }
 
-  return install_time_diff_sec;
+  return 0;
+}
+
+DWORD TruncateDayOfInstall(DWORD day_of_install) {
+  if (day_of_install == static_cast<DWORD>(-1)) {
+    return day_of_install;
+  }
+
+  const int kDaysInWeek = 7;
+  return day_of_install / kDaysInWeek * kDaysInWeek;
 }
 
 HRESULT GetDayOfInstall(
@@ -511,11 +525,7 @@ HRESULT GetDayOfInstall(
     return hr;
   }
 
-  if (*day_of_install != -1) {
-    // Truncate day of install to the first day of that week.
-    const int kDaysInWeek = 7;
-    *day_of_install = *day_of_install / kDaysInWeek * kDaysInWeek;
-  }
+  *day_of_install = TruncateDayOfInstall(*day_of_install);
   return S_OK;
 }
 
@@ -131,6 +131,14 @@ void GetClientStateData(bool is_machine,
 // Reads InstallTime and computes InstallTimeDiffSec.
 int GetInstallTimeDiffSec(bool is_machine, const CString& app_id);
 
+// Computes InstallTimeDiffSec from the value of InstallTime. Returns 0 if the
+// install time is not valid.
+int InstallTimeToInstallTimeDiffSec(DWORD install_time);
+
+// Truncates the value of DayOfInstall to the first day of that week. The
+// value -1, which is written for new installs, is not changed.
+DWORD TruncateDayOfInstall(DWORD day_of_install);
+
 // Reads day_of_install from registry.
 HRESULT GetDayOfInstall(bool is_machine,
                         const CString& app_id,
@@ -40,6 +40,7 @@
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/crash_utils.h"
 #include "omaha/common/oem_install_utils.h"
+#include "omaha/common/update_check_policy.h"
 #include "omaha/statsreport/metrics.h"
 
 namespace omaha {
@@ -595,6 +596,32 @@ HRESULT ConfigManager::SetRetryAfterTime(bool is_machine, DWORD time) const {
   return RegKey::SetValue(reg_update_key, kRegValueRetryAfter, time);
 }
 
+DWORD ConfigManager::GetUpdateCheckFailures(bool is_machine) const {
+  const TCHAR* reg_update_key = is_machine ? MACHINE_REG_UPDATE:
+                                             USER_REG_UPDATE;
+  DWORD failures = 0;
+  if (SUCCEEDED(RegKey::GetValue(reg_update_key,
+                                 kRegValueUpdateCheckFailures,
+                                 &failures))) {
+    return failures;
+  }
+  return 0;
+}
+
+HRESULT ConfigManager::SetUpdateCheckFailures(bool is_machine,
+                                              DWORD failures) const {
+  const TCHAR* reg_update_key = is_machine ? MACHINE_REG_UPDATE:
+                                             USER_REG_UPDATE;
+  if (!failures) {
+    if (!RegKey::HasValue(reg_update_key, kRegValueUpdateCheckFailures)) {
+      return S_OK;
+    }
+    return RegKey::DeleteValue(reg_update_key, kRegValueUpdateCheckFailures);
+  }
+  return RegKey::SetValue(reg_update_key, kRegValueUpdateCheckFailures,
+                          failures);
+}
+
 bool ConfigManager::CanRetryNow(bool is_machine) const {
   const uint32 now = Time64ToInt32(GetCurrent100NSTime());
   const uint32 retry_after = GetRetryAfterTime(is_machine);
@@ -742,6 +769,27 @@ int ConfigManager::GetUpdateWorkerStartUpDelayMs() const {
   return kUpdateTimerStartupDelayMinMs + random_value % kRangeMs;
 }
 
+int ConfigManager::GetNextUpdateWorkerDelayMs() const {
+  const int au_timer_interval_ms = GetAutoUpdateTimerIntervalMs();
+
+  // If the AuCheckPeriod is overriden then use it as is.
+  if (RegKey::HasValue(MACHINE_REG_UPDATE_DEV, kRegValueAuCheckPeriodMs)) {
+    return au_timer_interval_ms;
+  }
+
+  // Keeps the workers of clients which started at the same time, for
+  // instance after a reboot, from running at the same time every period.
+  return update_check_policy::AddTimerJitterMs(au_timer_interval_ms);
+}
+
+bool ConfigManager::IsPersistentUpdateWorkerEnabled() const {
+  DWORD persistent_update_worker = 0;
+  RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                   kRegValuePersistentUpdateWorker,
+                   &persistent_update_worker);
+  return persistent_update_worker != 0;
+}
+
 int ConfigManager::GetAutoUpdateJitterMs() const {
   const int kMaxJitterMs = 60000;
   DWORD auto_update_jitter_ms(0);
@@ -184,6 +184,10 @@ class ConfigManager {
   HRESULT SetRetryAfterTime(bool is_machine, DWORD time) const;
   bool CanRetryNow(bool is_machine) const;
 
+  // Gets and sets the number of consecutive update checks the server failed.
+  DWORD GetUpdateCheckFailures(bool is_machine) const;
+  HRESULT SetUpdateCheckFailures(bool is_machine, DWORD failures) const;
+
   // Gets and sets the last time a successful server update check was made.
   DWORD GetLastCheckedTime(bool is_machine) const;
   HRESULT SetLastCheckedTime(bool is_machine, DWORD time) const;
@@ -205,6 +209,15 @@ class ConfigManager {
   // Returns the wait time in ms to start the first worker.
   int GetUpdateWorkerStartUpDelayMs() const;
 
+  // Returns the wait time in ms to start the next worker. This is the auto
+  // update timer interval with a random jitter, unless the interval is
+  // overridden.
+  int GetNextUpdateWorkerDelayMs() const;
+
+  // Returns true if the core keeps one silent /ua process alive across update
+  // cycles instead of starting a new /ua process for every cycle.
+  bool IsPersistentUpdateWorkerEnabled() const;
+
   // Returns the wait time in ms before making an update check The range of
   // the returned value is [0, 60000) ms, even if the value is overriden
   // by UpdateDev settings.
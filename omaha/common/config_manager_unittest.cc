@@ -27,6 +27,7 @@
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/const_group_policy.h"
+#include "omaha/common/update_check_policy.h"
 #include "omaha/testing/unit_test.h"
 
 namespace omaha {
@@ -1743,6 +1744,22 @@ TEST_P(ConfigManagerTest, RetryAfterTime) {
   EXPECT_EQ(time, cm_->GetRetryAfterTime(false));
 }
 
+TEST_P(ConfigManagerTest, UpdateCheckFailures) {
+  EXPECT_EQ(0, cm_->GetUpdateCheckFailures(true));
+  EXPECT_EQ(0, cm_->GetUpdateCheckFailures(false));
+
+  EXPECT_SUCCEEDED(cm_->SetUpdateCheckFailures(true, 3));
+  EXPECT_EQ(3, cm_->GetUpdateCheckFailures(true));
+  EXPECT_EQ(0, cm_->GetUpdateCheckFailures(false));
+
+  // Resetting the failures deletes the value.
+  EXPECT_SUCCEEDED(cm_->SetUpdateCheckFailures(true, 0));
+  EXPECT_EQ(0, cm_->GetUpdateCheckFailures(true));
+  EXPECT_FALSE(RegKey::HasValue(MACHINE_REG_UPDATE,
+                                kRegValueUpdateCheckFailures));
+  EXPECT_SUCCEEDED(cm_->SetUpdateCheckFailures(false, 0));
+}
+
 TEST_P(ConfigManagerTest, CanRetryNow) {
   EXPECT_SUCCEEDED(cm_->SetRetryAfterTime(true, 0));
   EXPECT_TRUE(cm_->CanRetryNow(true));
@@ -1834,6 +1851,42 @@ TEST_P(ConfigManagerTest, GetUpdateWorkerStartUpDelayMs_Override) {
   EXPECT_EQ(val, random);
 }
 
+TEST_P(ConfigManagerTest, GetNextUpdateWorkerDelayMs) {
+  const int interval_ms = cm_->GetAutoUpdateTimerIntervalMs();
+  const int max_jitter_ms =
+      interval_ms / 100 * update_check_policy::kTimerJitterPercent;
+  for (int i = 0; i < 10; ++i) {
+    const int delay_ms = cm_->GetNextUpdateWorkerDelayMs();
+    EXPECT_GE(delay_ms, interval_ms - max_jitter_ms);
+    EXPECT_LE(delay_ms, interval_ms + max_jitter_ms);
+  }
+}
+
+TEST_P(ConfigManagerTest, GetNextUpdateWorkerDelayMs_Override) {
+  DWORD val = 3320;
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValueAuCheckPeriodMs,
+                                    val));
+
+  EXPECT_EQ(val, cm_->GetNextUpdateWorkerDelayMs());
+}
+
+TEST_P(ConfigManagerTest, IsPersistentUpdateWorkerEnabled) {
+  EXPECT_FALSE(cm_->IsPersistentUpdateWorkerEnabled());
+
+  DWORD value = 1;
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValuePersistentUpdateWorker,
+                                    value));
+  EXPECT_TRUE(cm_->IsPersistentUpdateWorkerEnabled());
+
+  value = 0;
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValuePersistentUpdateWorker,
+                                    value));
+  EXPECT_FALSE(cm_->IsPersistentUpdateWorkerEnabled());
+}
+
 TEST_P(ConfigManagerTest, GetTimeSinceLastCheckedSec_User) {
   // First, there is no value present in the registry.
   uint32 now_sec = Time64ToInt32(GetCurrent100NSTime());
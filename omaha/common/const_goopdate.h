@@ -210,6 +210,7 @@ const TCHAR* const kRegValueUsageStats       = _T("usagestats");
 
 // Registry values stored in the ClientState key for Omaha's internal use.
 const TCHAR* const kRegValueTTToken               = _T("tttoken");
+const TCHAR* const kRegValueStateToken            = _T("statetoken");
 const TCHAR* const kRegValueUpdateAvailableCount  = _T("UpdateAvailableCount");
 const TCHAR* const kRegValueUpdateAvailableSince  = _T("UpdateAvailableSince");
 
@@ -246,6 +247,10 @@ const TCHAR* const kRegValueLastOSVersion         = _T("LastOSVersion");
 // for update checks. See the explanation of kHeaderXRetryAfter in constants.h.
 const TCHAR* const kRegValueRetryAfter            = _T("RetryAfter");
 
+// The number of consecutive update checks the server failed. Automatic update
+// checks back off while the server is failing.
+const TCHAR* const kRegValueUpdateCheckFailures   = _T("UpdateCheckFailures");
+
 // UID registry entries.
 const TCHAR* const kRegValueUserId                = _T("uid");
 const TCHAR* const kRegValueOldUserId             = _T("old-uid");
@@ -369,6 +374,9 @@ const TCHAR* const kProgIDCredentialDialogMachine =
 // Offline v3 manifest name.
 const TCHAR* const kOfflineManifestFileName = _T("OfflineManifest.gup");
 
+// Index of the offline manifest, written by offline_index.py.
+const TCHAR* const kOfflineIndexFileName = _T("OfflineIndex.dat");
+
 }  // namespace omaha
 
 #endif  // OMAHA_COMMON_CONST_GOOPDATE_H_
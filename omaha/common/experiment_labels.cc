@@ -29,6 +29,8 @@
 
 #include "omaha/common/experiment_labels.h"
 
+#include <algorithm>
+
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/safe_format.h"
@@ -48,40 +50,39 @@ size_t ExperimentLabels::NumLabels() const {
 
 bool ExperimentLabels::ContainsKey(const CString& key) const {
   ASSERT1(!key.IsEmpty());
-  return labels_.find(key) != labels_.end();
+  return FindLabelByKey(key, NULL, NULL);
 }
 
 void ExperimentLabels::GetLabelByIndex(int index, CString* key, CString* value,
                                        time64* expiration) const {
   ASSERT1(index >= 0);
-  ASSERT1(static_cast<LabelMap::size_type>(index) < labels_.size());
+  ASSERT1(static_cast<LabelList::size_type>(index) < labels_.size());
 
-  LabelMap::const_iterator cit = labels_.begin();
-  std::advance(cit, static_cast<LabelMap::size_type>(index));
+  const Label& label = labels_[index];
   if (key) {
-    *key = cit->first;
+    *key = label.key;
   }
   if (value) {
-    *value = cit->second.first;
+    *value = label.value;
   }
   if (expiration) {
-    *expiration = cit->second.second;
+    *expiration = label.expiration;
   }
 }
 
 bool ExperimentLabels::FindLabelByKey(const CString& key, CString* value,
                                       time64* expiration) const {
   ASSERT1(!key.IsEmpty());
-  LabelMap::const_iterator cit = labels_.find(key);
-  if (labels_.end() == cit) {
+  LabelList::const_iterator cit = LowerBound(labels_, key);
+  if (labels_.end() == cit || cit->key != key) {
     return false;
   }
 
   if (value) {
-    *value = cit->second.first;
+    *value = cit->value;
   }
   if (expiration) {
-    *expiration = cit->second.second;
+    *expiration = cit->expiration;
   }
   return true;
 }
@@ -94,29 +95,39 @@ bool ExperimentLabels::SetLabel(const CString& key, const CString& value,
   if (expiration < GetCurrent100NSTime() && !preserve_expired_) {
     return false;
   }
-  labels_[key] = std::make_pair(value, expiration);
+
+  const LabelList::size_type index = LowerBound(labels_, key) - labels_.begin();
+  if (index < labels_.size() && labels_[index].key == key) {
+    labels_[index].value = value;
+    labels_[index].expiration = expiration;
+  } else {
+    labels_.insert(labels_.begin() + index, Label(key, value, expiration));
+  }
   return true;
 }
 
 bool ExperimentLabels::ClearLabel(const CString& key) {
-  LabelMap::iterator it = labels_.find(key);
-  if (labels_.end() == it) {
+  const LabelList::size_type index = LowerBound(labels_, key) - labels_.begin();
+  if (index == labels_.size() || labels_[index].key != key) {
     return false;
   }
-  labels_.erase(it);
+  labels_.erase(labels_.begin() + index);
   return true;
 }
 
 void ExperimentLabels::ExpireLabels() {
-  time64 current_time = GetCurrent100NSTime();
-  for (LabelMap::iterator it = labels_.begin(); it != labels_.end(); ++it) {
-    if (it->second.second < current_time) {
-      it = labels_.erase(it);
-      if (it == labels_.end()) {
-        break;
+  // Compacts the unexpired labels in place, which keeps them sorted.
+  const time64 current_time = GetCurrent100NSTime();
+  LabelList::iterator end = labels_.begin();
+  for (LabelList::iterator it = labels_.begin(); it != labels_.end(); ++it) {
+    if (it->expiration >= current_time) {
+      if (end != it) {
+        *end = *it;
       }
+      ++end;
     }
   }
+  labels_.erase(end, labels_.end());
 }
 
 void ExperimentLabels::ClearAllLabels() {
@@ -126,18 +137,17 @@ void ExperimentLabels::ClearAllLabels() {
 CString ExperimentLabels::Serialize(SerializeOptions options) const {
   CString serialized;
   const time64 current_time = GetCurrent100NSTime();
-  for (LabelMap::const_iterator cit = labels_.begin();
+  for (LabelList::const_iterator cit = labels_.begin();
        cit != labels_.end();
        ++cit) {
-    if (preserve_expired_ || cit->second.second >= current_time) {
+    if (preserve_expired_ || cit->expiration >= current_time) {
       if (!serialized.IsEmpty()) {
         serialized.Append(L";");
       }
-      SafeCStringAppendFormat(&serialized, L"%s=%s",
-                              cit->first, cit->second.first);
+      SafeCStringAppendFormat(&serialized, L"%s=%s", cit->key, cit->value);
       if (options & SerializeOptions::INCLUDE_TIMESTAMPS) {
         FILETIME ft = {};
-        Time64ToFileTime(cit->second.second, &ft);
+        Time64ToFileTime(cit->expiration, &ft);
         SafeCStringAppendFormat(&serialized, L"|%s",
                                 ConvertTimeToGMTString(&ft));
       }
@@ -147,18 +157,18 @@ CString ExperimentLabels::Serialize(SerializeOptions options) const {
 }
 
 bool ExperimentLabels::Deserialize(const CString& label_list) {
-  LabelMap new_labels;
-  if (DoDeserialize(&new_labels, label_list, preserve_expired_)) {
-    std::swap(labels_, new_labels);
+  LabelList new_labels;
+  if (DoDeserialize(LabelList(), label_list, preserve_expired_, &new_labels)) {
+    labels_.swap(new_labels);
     return true;
   }
   return false;
 }
 
 bool ExperimentLabels::DeserializeAndApplyDelta(const CString& label_list) {
-  LabelMap merged_labels = labels_;
-  if (DoDeserialize(&merged_labels, label_list, false)) {
-    std::swap(labels_, merged_labels);
+  LabelList merged_labels;
+  if (DoDeserialize(labels_, label_list, false, &merged_labels)) {
+    labels_.swap(merged_labels);
     return true;
   }
   return false;
@@ -277,16 +287,29 @@ bool ExperimentLabels::SplitCombinedLabel(const CString& combined, CString* key,
   return true;
 }
 
-bool ExperimentLabels::DoDeserialize(LabelMap* map, const CString& label_list,
-                                     bool accept_expired) {
-  ASSERT1(map);
+ExperimentLabels::LabelList::const_iterator ExperimentLabels::LowerBound(
+    const LabelList& labels,
+    const CString& key) {
+  const Label key_label(key, CString(), 0);
+  return std::lower_bound(labels.begin(), labels.end(), key_label, LessByKey);
+}
+
+bool ExperimentLabels::LessByKey(const Label& lhs, const Label& rhs) {
+  return lhs.key < rhs.key;
+}
+
+bool ExperimentLabels::DoDeserialize(const LabelList& labels,
+                                     const CString& label_list,
+                                     bool accept_expired,
+                                     LabelList* merged) {
+  ASSERT1(merged);
 
   if (label_list.IsEmpty()) {
+    *merged = labels;
     return true;
   }
 
-  time64 current_time = GetCurrent100NSTime();
-
+  LabelList delta;
   for (int offset = 0;;) {
     CString combined_label = label_list.Tokenize(L";", offset);
     if (combined_label.IsEmpty()) {
@@ -296,22 +319,47 @@ bool ExperimentLabels::DoDeserialize(LabelMap* map, const CString& label_list,
       return false;
     }
 
-    CString key;
-    CString value;
-    time64 expiration = 0;
-    if (!SplitCombinedLabel(combined_label, &key, &value, &expiration)) {
+    Label label;
+    if (!SplitCombinedLabel(combined_label,
+                            &label.key,
+                            &label.value,
+                            &label.expiration)) {
       return false;
     }
+    delta.push_back(label);
+  }
+
+  // Labels which appear more than once in the input are applied in order, so
+  // the last one wins. The stable sort keeps them in that order.
+  std::stable_sort(delta.begin(), delta.end(), LessByKey);
+
+  // Merges the two sorted lists in a single pass.
+  const time64 current_time = GetCurrent100NSTime();
+  merged->clear();
+  merged->reserve(labels.size() + delta.size());
+  LabelList::const_iterator it = labels.begin();
+  LabelList::const_iterator delta_it = delta.begin();
+  while (delta_it != delta.end()) {
+    LabelList::const_iterator last = delta_it;
+    while (++delta_it != delta.end() && delta_it->key == last->key) {
+      last = delta_it;
+    }
+
+    for (; it != labels.end() && it->key < last->key; ++it) {
+      merged->push_back(*it);
+    }
+    if (it != labels.end() && it->key == last->key) {
+      ++it;
+    }
 
     // If the label is well-formatted but expired, we accept the input, but
-    // do not add it to the map and do not emit an error.  If there is already
-    // a label in the map with that key, delete it.
-    if (accept_expired || expiration > current_time) {
-      (*map)[key] = std::make_pair(value, expiration);
-    } else {
-      map->erase(key);
+    // do not add it to the list and do not emit an error.  If there is
+    // already a label in the list with that key, it is deleted.
+    if (accept_expired || last->expiration > current_time) {
+      merged->push_back(*last);
     }
   }
+  merged->insert(merged->end(), it, labels.end());
 
   return true;
 }
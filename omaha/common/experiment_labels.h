@@ -32,8 +32,7 @@
 
 #include <atlstr.h>
 
-#include <map>
-#include <utility>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "gtest/gtest_prod.h"
@@ -86,7 +85,19 @@ class ExperimentLabels {
   ExperimentLabels();
   ~ExperimentLabels();
 
-  typedef std::map<CString, std::pair<CString, time64> > LabelMap;
+  // The labels are kept in a flat vector sorted by key, which is searched in
+  // O(log n). The keys and values are reference-counted CStrings, therefore
+  // moving labels around the vector does not copy their contents.
+  struct Label {
+    Label() : expiration(0) {}
+    Label(const CString& k, const CString& v, time64 e)
+        : key(k), value(v), expiration(e) {}
+
+    CString key;
+    CString value;
+    time64 expiration;
+  };
+  typedef std::vector<Label> LabelList;
 
   // Returns the number of labels in the store.
   size_t NumLabels() const;
@@ -98,9 +109,9 @@ class ExperimentLabels {
   // parameters are allowed to be NULL.  If index is out of range, asserts
   // on a debug build.
   //
-  // NOTE: This method is O(n), and indexes are not stable with respect to
-  // insertion order; it should not be called from any hot path.  Unit tests
-  // and diagnostic tools should use this to enumerate keys.
+  // NOTE: Indexes follow the order of the keys and are not stable with
+  // respect to insertion order.  Unit tests and diagnostic tools should use
+  // this to enumerate keys.
   void GetLabelByIndex(int index,
                        CString* key,
                        CString* value,
@@ -172,12 +183,22 @@ class ExperimentLabels {
                                  CString* value,
                                  time64* expiration);
 
-  // Splits an input string and applies it against an existing internal map.
-  static bool DoDeserialize(LabelMap* map,
+  // Returns the position of 'key' in 'labels', or the position where a label
+  // with this key would be inserted.
+  static LabelList::const_iterator LowerBound(const LabelList& labels,
+                                              const CString& key);
+
+  // Orders labels by key.
+  static bool LessByKey(const Label& lhs, const Label& rhs);
+
+  // Splits an input string and applies it against 'labels'.  On success,
+  // writes the merged labels to 'merged' and returns true.
+  static bool DoDeserialize(const LabelList& labels,
                             const CString& label_list,
-                            bool accept_expired);
+                            bool accept_expired,
+                            LabelList* merged);
 
-  LabelMap labels_;
+  LabelList labels_;
   bool preserve_expired_;
 
   FRIEND_TEST(ExperimentLabelsTest, Empty);
@@ -211,6 +232,9 @@ class ExperimentLabels {
   FRIEND_TEST(ExperimentLabelsTest,
               DeserializeAndApplyDelta_Overwrite_Multi_Expired);
   FRIEND_TEST(ExperimentLabelsTest, Expire);
+  FRIEND_TEST(ExperimentLabelsTest, Expire_Consecutive);
+  FRIEND_TEST(ExperimentLabelsTest, DeserializeAndApplyDelta_DuplicateKeys);
+  FRIEND_TEST(ExperimentLabelsTest, ManyLabelsManyApps);
   FRIEND_TEST(ExperimentLabelsRegistryProtectedTest, ClientStateOnly);
   FRIEND_TEST(ExperimentLabelsRegistryProtectedTest, ClientStateMediumOnly);
   FRIEND_TEST(ExperimentLabelsRegistryProtectedTest, Merge);
@@ -14,6 +14,7 @@
 // ========================================================================
 
 #include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
@@ -788,6 +789,105 @@ TEST_F(ExperimentLabelsTest, Expire) {
   EXPECT_FALSE(el.ContainsKey(kLabelOldKey));
 }
 
+// Consecutive expired labels are all removed.
+TEST_F(ExperimentLabelsTest, Expire_Consecutive) {
+  const time64 future = GetCurrent100NSTime() + 30 * kDaysTo100ns;
+  ExperimentLabels el;
+
+  el.SetPreserveExpiredLabels(true);
+  EXPECT_TRUE(el.SetLabel(_T("a"), kLabelOldValue, kLabelOldExpInt));
+  EXPECT_TRUE(el.SetLabel(_T("b"), kLabelOldValue, kLabelOldExpInt));
+  EXPECT_TRUE(el.SetLabel(_T("c"), kLabelOneValue, future));
+  EXPECT_TRUE(el.SetLabel(_T("d"), kLabelOldValue, kLabelOldExpInt));
+  EXPECT_TRUE(el.SetLabel(_T("e"), kLabelOldValue, kLabelOldExpInt));
+  EXPECT_EQ(5, el.NumLabels());
+
+  el.ExpireLabels();
+  EXPECT_EQ(1, el.NumLabels());
+  EXPECT_TRUE(el.ContainsKey(_T("c")));
+}
+
+// The last label of a key in the input wins, as if the labels were applied
+// one after another.
+TEST_F(ExperimentLabelsTest, DeserializeAndApplyDelta_DuplicateKeys) {
+  const time64 future = GetCurrent100NSTime() + 30 * kDaysTo100ns;
+
+  ExperimentLabels el;
+  EXPECT_TRUE(el.SetLabel(_T("a"), _T("old"), future));
+  EXPECT_TRUE(el.SetLabel(_T("c"), _T("old"), future));
+
+  CString delta;
+  SafeCStringFormat(&delta, _T("%s;%s;%s;%s;%s"),
+                    ExperimentLabels::CreateLabel(_T("a"), _T("first"), future),
+                    ExperimentLabels::CreateLabel(_T("b"), _T("new"), future),
+                    ExperimentLabels::CreateLabel(_T("a"), _T("second"),
+                                                  future),
+                    ExperimentLabels::CreateLabel(_T("c"), _T("new"), future),
+                    _T("c=new|") LABELOLD_EXP_STR);
+  EXPECT_TRUE(el.DeserializeAndApplyDelta(delta));
+  EXPECT_EQ(2, el.NumLabels());
+
+  CString value;
+  EXPECT_TRUE(el.FindLabelByKey(_T("a"), &value, NULL));
+  EXPECT_STREQ(_T("second"), value);
+  EXPECT_TRUE(el.ContainsKey(_T("b")));
+  EXPECT_FALSE(el.ContainsKey(_T("c")));
+
+  // The labels stay sorted by key.
+  CString key;
+  el.GetLabelByIndex(0, &key, NULL, NULL);
+  EXPECT_STREQ(_T("a"), key);
+  el.GetLabelByIndex(1, &key, NULL, NULL);
+  EXPECT_STREQ(_T("b"), key);
+}
+
+// Merges a delta into the labels of an app which has hundreds of labels.
+TEST_F(ExperimentLabelsTest, ManyLabels) {
+  const int kNumLabels = 300;
+  const time64 future = GetCurrent100NSTime() + 30 * kDaysTo100ns;
+
+  CString label_list;
+  CString delta;
+  for (int i = 0; i < kNumLabels; ++i) {
+    CString key;
+    SafeCStringFormat(&key, _T("key_%03d"), i);
+    if (!label_list.IsEmpty()) {
+      label_list.Append(LABEL_DELIMITER_LA);
+    }
+    label_list.Append(ExperimentLabels::CreateLabel(key, _T("value"), future));
+
+    if (i % 10 == 0) {
+      SafeCStringFormat(&key, _T("key_%03d"), kNumLabels - i);
+      if (!delta.IsEmpty()) {
+        delta.Append(LABEL_DELIMITER_LA);
+      }
+      delta.Append(ExperimentLabels::CreateLabel(key, _T("new"), future));
+    }
+  }
+
+  CString merged;
+  EXPECT_TRUE(ExperimentLabels::MergeLabelSets(label_list, delta, &merged));
+
+  ExperimentLabels el;
+  EXPECT_TRUE(el.Deserialize(merged));
+  EXPECT_EQ(kNumLabels + 1, el.NumLabels());
+  for (int i = 0; i < kNumLabels; i += 7) {
+    CString key;
+    SafeCStringFormat(&key, _T("key_%03d"), i);
+    EXPECT_TRUE(el.ContainsKey(key));
+  }
+
+  CString value;
+  EXPECT_TRUE(el.FindLabelByKey(_T("key_010"), &value, NULL));
+  EXPECT_STREQ(_T("new"), value);
+  EXPECT_TRUE(el.FindLabelByKey(_T("key_011"), &value, NULL));
+  EXPECT_STREQ(_T("value"), value);
+  EXPECT_TRUE(el.ContainsKey(_T("key_300")));
+
+  el.ExpireLabels();
+  EXPECT_EQ(kNumLabels + 1, el.NumLabels());
+}
+
 class ExperimentLabelsRegistryProtectedTest : public testing::Test {
  protected:
   ExperimentLabelsRegistryProtectedTest()
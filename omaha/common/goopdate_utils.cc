@@ -1288,6 +1288,17 @@ HRESULT CreateEvent(NamedObjectAttributes* event_attr, HANDLE* event_handle) {
   return S_OK;
 }
 
+void GetBundleProgressEventAttributes(const CString& session_id,
+                                      bool is_machine,
+                                      NamedObjectAttributes* event_attr) {
+  ASSERT1(!session_id.IsEmpty());
+  ASSERT1(event_attr);
+
+  CString event_name;
+  SafeCStringFormat(&event_name, kBundleProgressEvent, session_id);
+  GetNamedObjectAttributes(event_name, is_machine, event_attr);
+}
+
 bool IsTestSource() {
   return !ConfigManager::Instance()->GetTestSource().IsEmpty();
 }
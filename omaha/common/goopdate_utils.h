@@ -227,6 +227,12 @@ HRESULT OpenUniqueEventFromEnvironment(const CString& var_name,
 // Creates an event based on the provided attributes.
 HRESULT CreateEvent(NamedObjectAttributes* event_attr, HANDLE* event_handle);
 
+// Gets the attributes of the event the COM server signals when the state or
+// the progress of the bundle with the given session ID changes.
+void GetBundleProgressEventAttributes(const CString& session_id,
+                                      bool is_machine,
+                                      NamedObjectAttributes* event_attr);
+
 HRESULT ReadNameValuePairsFromFile(const CString& file_path,
                                    const CString& group_name,
                                    std::map<CString, CString>* pairs);
@@ -548,6 +548,9 @@ HRESULT Ping::SendString(bool is_machine,
     return hr;
   }
 
+  // Pings which fail are persisted and sent again later.
+  web_service_client.set_use_circuit_breaker(true);
+
   scoped_ptr<xml::UpdateResponse> response(xml::UpdateResponse::Create());
   hr = web_service_client.SendString(&request_string, response.get());
   if (FAILED(hr)) {
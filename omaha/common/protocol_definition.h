@@ -82,6 +82,10 @@ struct UpdateCheck {
 
   CString tt_token;
 
+  // Opaque token of the last update check which found no update for the app.
+  // The server answers "unchanged" if its answer would still be the same.
+  CString state_token;
+
   CString target_version_prefix;
 };
 
@@ -206,6 +210,7 @@ namespace response {
 // Status strings returned by the server.
 const TCHAR* const kStatusOkValue = _T("ok");
 const TCHAR* const kStatusNoUpdate = _T("noupdate");
+const TCHAR* const kStatusUnchanged = _T("unchanged");
 const TCHAR* const kStatusRestrictedExportCountry = _T("restricted");
 const TCHAR* const kStatusHwNotSupported = _T("error-hwnotsupported");
 const TCHAR* const kStatusOsNotSupported = _T("error-osnotsupported");
@@ -238,6 +243,9 @@ struct UpdateCheck {
 
   CString tt_token;
 
+  // Echoed by the client in the next update check. Only sent with "noupdate".
+  CString state_token;
+
   CString error_url;         // URL describing error. Ignored in Omaha 3.
 
   std::vector<CString> urls;
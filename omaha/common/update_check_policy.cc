@@ -0,0 +1,111 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/update_check_policy.h"
+#include <algorithm>
+#include "base/rand_util.h"
+#include "omaha/base/debug.h"
+
+namespace omaha {
+
+namespace update_check_policy {
+
+namespace {
+
+// Returns the 32-bit FNV-1a hash of the case-insensitive 'client_id'.
+uint32 HashClientId(const CString& client_id) {
+  const uint32 kFnvOffsetBasis = 2166136261U;
+  const uint32 kFnvPrime = 16777619U;
+
+  CString id(client_id);
+  id.MakeLower();
+
+  uint32 hash = kFnvOffsetBasis;
+  for (int i = 0; i < id.GetLength(); ++i) {
+    const uint16 c = static_cast<uint16>(id[i]);
+    hash = (hash ^ (c & 0xFF)) * kFnvPrime;
+    hash = (hash ^ (c >> 8)) * kFnvPrime;
+  }
+  return hash;
+}
+
+}  // namespace
+
+int GetClientSpread(const CString& client_id, int range) {
+  if (range <= 0) {
+    return 0;
+  }
+
+  uint32 value = 0;
+  if (!client_id.IsEmpty()) {
+    value = HashClientId(client_id);
+  } else if (!RandUint32(&value)) {
+    value = 0;
+  }
+  return static_cast<int>(value % range);
+}
+
+bool IsServerFailure(int http_status_code) {
+  const int kHttpTooManyRequests = 429;
+  const int kHttpServerErrorFirst = 500;
+  const int kHttpServerErrorLast = 599;
+  return (http_status_code >= kHttpServerErrorFirst &&
+          http_status_code <= kHttpServerErrorLast) ||
+         http_status_code == kHttpTooManyRequests;
+}
+
+int GetErrorBackoffSec(int consecutive_failures, const CString& client_id) {
+  if (consecutive_failures <= 0) {
+    return 0;
+  }
+
+  int backoff_sec = kMinErrorBackoffSec;
+  for (int i = 1;
+       i < consecutive_failures && backoff_sec < kMaxErrorBackoffSec;
+       ++i) {
+    backoff_sec *= 2;
+  }
+  backoff_sec = std::min(backoff_sec, kMaxErrorBackoffSec);
+
+  return backoff_sec - GetClientSpread(client_id, backoff_sec / 4);
+}
+
+int GetRetryAfterSec(int server_retry_after_sec,
+                     int consecutive_failures,
+                     const CString& client_id) {
+  return std::max(server_retry_after_sec,
+                  GetErrorBackoffSec(consecutive_failures, client_id));
+}
+
+int AddTimerJitterMs(int interval_ms) {
+  const int max_jitter_ms = interval_ms / 100 * kTimerJitterPercent;
+  if (max_jitter_ms <= 0) {
+    return interval_ms;
+  }
+
+  uint32 random_value = 0;
+  if (!RandUint32(&random_value)) {
+    return interval_ms;
+  }
+
+  const int64 jittered_interval_ms =
+      static_cast<int64>(interval_ms) - max_jitter_ms +
+      random_value % (2 * static_cast<uint32>(max_jitter_ms) + 1);
+  return static_cast<int>(std::min<int64>(jittered_interval_ms, INT_MAX));
+}
+
+}  // namespace update_check_policy
+
+}  // namespace omaha
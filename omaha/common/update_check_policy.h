@@ -0,0 +1,72 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+// Spreads the automatic update checks of the clients over time, so that
+// events which happen to many clients at once, such as reboots after patches,
+// clock synchronization, or server outages, do not turn into request peaks.
+
+#ifndef OMAHA_COMMON_UPDATE_CHECK_POLICY_H_
+#define OMAHA_COMMON_UPDATE_CHECK_POLICY_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include "base/basictypes.h"
+#include "omaha/base/constants.h"
+
+namespace omaha {
+
+namespace update_check_policy {
+
+// After the server fails an update check, automatic update checks back off
+// starting at one hour, doubling for each consecutive failure, up to one day.
+// One day is the longest "retry after" time the clients honor.
+const int kMinErrorBackoffSec = kSecondsPerHour;
+const int kMaxErrorBackoffSec = kSecondsPerDay;
+
+// The core timer fires at its interval plus or minus this percentage, so the
+// clients which started at the same time drift apart.
+const int kTimerJitterPercent = 10;
+
+// Returns a value in [0, range) which is derived from 'client_id', therefore
+// it is the same every time it is computed for that client. Returns a random
+// value if 'client_id' is empty.
+int GetClientSpread(const CString& client_id, int range);
+
+// Returns true if an update check which failed with 'http_status_code' should
+// make the client back off. Only the failures of a reachable server count, so
+// that clients which were offline do not delay their next update check.
+bool IsServerFailure(int http_status_code);
+
+// Returns the number of seconds to wait before the next automatic update
+// check after 'consecutive_failures' failures, or 0 if there are none. The
+// delay of each client is in the upper quarter of the backoff interval,
+// depending on 'client_id'.
+int GetErrorBackoffSec(int consecutive_failures, const CString& client_id);
+
+// Returns the later of the "retry after" time the server sent in the response
+// and the error backoff, in seconds.
+int GetRetryAfterSec(int server_retry_after_sec,
+                     int consecutive_failures,
+                     const CString& client_id);
+
+// Returns 'interval_ms' plus or minus a random jitter of at most
+// kTimerJitterPercent of the interval.
+int AddTimerJitterMs(int interval_ms);
+
+}  // namespace update_check_policy
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_UPDATE_CHECK_POLICY_H_
@@ -0,0 +1,143 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <algorithm>
+#include <vector>
+#include "omaha/base/safe_format.h"
+#include "omaha/common/update_check_policy.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace update_check_policy {
+
+namespace {
+
+const TCHAR* const kClientId = _T("{A2B4D5C1-8E3F-4A1B-9C2D-3E4F5A6B7C8D}");
+
+CString GetSimulatedClientId(int client) {
+  CString client_id;
+  SafeCStringFormat(&client_id,
+                    _T("{%08X-0000-0000-0000-000000000000}"),
+                    client);
+  return client_id;
+}
+
+// Simulates 'num_clients' clients whose update checks the server failed
+// 'failures' times in a row, all at the same time. Returns the largest number
+// of clients which check again within the same minute.
+int GetPeakChecksPerMinute(int num_clients, int failures) {
+  std::vector<int> checks_per_minute(kMaxErrorBackoffSec / 60 + 1, 0);
+  for (int i = 0; i < num_clients; ++i) {
+    const int backoff_sec = GetErrorBackoffSec(failures,
+                                               GetSimulatedClientId(i));
+    ++checks_per_minute[backoff_sec / 60];
+  }
+  return *std::max_element(checks_per_minute.begin(), checks_per_minute.end());
+}
+
+}  // namespace
+
+TEST(UpdateCheckPolicyTest, GetClientSpread) {
+  EXPECT_EQ(0, GetClientSpread(kClientId, 0));
+  EXPECT_EQ(0, GetClientSpread(kClientId, 1));
+
+  const int spread = GetClientSpread(kClientId, 1000);
+  EXPECT_LE(0, spread);
+  EXPECT_GT(1000, spread);
+
+  // The spread is stable and does not depend on the case of the id.
+  EXPECT_EQ(spread, GetClientSpread(kClientId, 1000));
+  CString lower_case_id(kClientId);
+  lower_case_id.MakeLower();
+  EXPECT_EQ(spread, GetClientSpread(lower_case_id, 1000));
+
+  for (int i = 0; i < 100; ++i) {
+    const int random_spread = GetClientSpread(CString(), 1000);
+    EXPECT_LE(0, random_spread);
+    EXPECT_GT(1000, random_spread);
+  }
+}
+
+TEST(UpdateCheckPolicyTest, IsServerFailure) {
+  EXPECT_FALSE(IsServerFailure(0));
+  EXPECT_FALSE(IsServerFailure(200));
+  EXPECT_FALSE(IsServerFailure(404));
+  EXPECT_TRUE(IsServerFailure(429));
+  EXPECT_TRUE(IsServerFailure(500));
+  EXPECT_TRUE(IsServerFailure(503));
+  EXPECT_FALSE(IsServerFailure(600));
+}
+
+TEST(UpdateCheckPolicyTest, GetErrorBackoffSec) {
+  EXPECT_EQ(0, GetErrorBackoffSec(0, kClientId));
+  EXPECT_EQ(0, GetErrorBackoffSec(-1, kClientId));
+
+  int expected_max_sec = kMinErrorBackoffSec;
+  for (int failures = 1; failures <= 10; ++failures) {
+    const int backoff_sec = GetErrorBackoffSec(failures, kClientId);
+    EXPECT_GT(backoff_sec, expected_max_sec - expected_max_sec / 4);
+    EXPECT_LE(backoff_sec, expected_max_sec);
+    EXPECT_EQ(backoff_sec, GetErrorBackoffSec(failures, kClientId));
+
+    expected_max_sec = std::min(2 * expected_max_sec, kMaxErrorBackoffSec);
+  }
+
+  EXPECT_LE(GetErrorBackoffSec(INT_MAX, kClientId), kMaxErrorBackoffSec);
+}
+
+TEST(UpdateCheckPolicyTest, GetRetryAfterSec) {
+  EXPECT_EQ(0, GetRetryAfterSec(0, 0, kClientId));
+  EXPECT_EQ(-1, GetRetryAfterSec(-1, 0, kClientId));
+  EXPECT_EQ(300, GetRetryAfterSec(300, 0, kClientId));
+  EXPECT_EQ(GetErrorBackoffSec(2, kClientId),
+            GetRetryAfterSec(300, 2, kClientId));
+  EXPECT_EQ(kSecondsPerDay, GetRetryAfterSec(kSecondsPerDay, 2, kClientId));
+}
+
+TEST(UpdateCheckPolicyTest, AddTimerJitterMs) {
+  EXPECT_EQ(0, AddTimerJitterMs(0));
+  EXPECT_EQ(5, AddTimerJitterMs(5));
+
+  const int kIntervalMs = kAUCheckPeriodMs;
+  const int kMaxJitterMs = kIntervalMs / 100 * kTimerJitterPercent;
+  for (int i = 0; i < 100; ++i) {
+    const int interval_ms = AddTimerJitterMs(kIntervalMs);
+    EXPECT_GE(interval_ms, kIntervalMs - kMaxJitterMs);
+    EXPECT_LE(interval_ms, kIntervalMs + kMaxJitterMs);
+  }
+
+  EXPECT_LE(INT_MAX - INT_MAX / 100 * kTimerJitterPercent,
+            AddTimerJitterMs(INT_MAX));
+}
+
+// Clients which fail at the same time retry spread out over the last quarter
+// of their backoff interval instead of all at once.
+TEST(UpdateCheckPolicyTest, SimulatedClientsSpreadOut) {
+  const int kNumClients = 10000;
+
+  // One failure spreads the clients over 15 minutes.
+  const int kAverageChecksPerMinute = kNumClients / 15;
+  EXPECT_GT(kAverageChecksPerMinute * 3 / 2,
+            GetPeakChecksPerMinute(kNumClients, 1));
+
+  // Five failures spread the clients over 4 hours.
+  EXPECT_GT(2 * kNumClients / (4 * 60),
+            GetPeakChecksPerMinute(kNumClients, 5));
+}
+
+}  // namespace update_check_policy
+
+}  // namespace omaha
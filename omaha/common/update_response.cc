@@ -14,6 +14,7 @@
 // ========================================================================
 
 #include "omaha/common/update_response.h"
+#include "omaha/base/arena.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/xml_parser.h"
 
@@ -21,7 +22,7 @@ namespace omaha {
 
 namespace xml {
 
-UpdateResponse::UpdateResponse() {
+UpdateResponse::UpdateResponse() : response_(new response::Response) {
 }
 
 UpdateResponse::~UpdateResponse() {
@@ -46,12 +47,60 @@ HRESULT UpdateResponse::DeserializeFromFile(const CString& filename) {
   return Deserialize(buffer);
 }
 
+const response::App* UpdateResponse::GetApp(const CString& appid) const {
+  GUID guid = GUID_NULL;
+  if (SUCCEEDED(StringToGuidSafe(appid, &guid))) {
+    AppIndex::const_iterator it = app_index_.find(guid);
+    return it != app_index_.end() ? &response_->apps[it->second] : NULL;
+  }
+
+  for (size_t i = 0; i < response_->apps.size(); ++i) {
+    if (!appid.CompareNoCase(response_->apps[i].appid)) {
+      return &response_->apps[i];
+    }
+  }
+  return NULL;
+}
+
+void UpdateResponse::CopyFrom(const UpdateResponse& other) {
+  SetResponse(*other.response_);
+}
+
+// The copy of the strings is allocated by the default string manager, so the
+// arena is not needed anymore. The copy is made before the arena is released,
+// in case 'response' is response_ itself.
+void UpdateResponse::SetResponse(const response::Response& response) {
+  AdoptResponse(new response::Response(response), NULL);
+}
+
+void UpdateResponse::AdoptResponse(response::Response* response,
+                                   ArenaStringMgr* string_mgr) {
+  ASSERT1(response);
+
+  // Destroys the old strings before the arena they are allocated in.
+  response_.reset(response);
+  string_mgr_.reset(string_mgr);
+
+  BuildAppIndex();
+}
+
+void UpdateResponse::BuildAppIndex() {
+  app_index_.clear();
+  for (size_t i = 0; i < response_->apps.size(); ++i) {
+    GUID guid = GUID_NULL;
+    if (SUCCEEDED(StringToGuidSafe(response_->apps[i].appid, &guid))) {
+      // The first app with an id wins, as it does for a linear search.
+      app_index_.insert(std::make_pair(guid, i));
+    }
+  }
+}
+
 int UpdateResponse::GetElapsedSecondsSinceDayStart() const {
-  return response_.day_start.elapsed_seconds;
+  return response_->day_start.elapsed_seconds;
 }
 
 int UpdateResponse::GetElapsedDaysSinceDatum() const {
-  return response_.day_start.elapsed_days;
+  return response_->day_start.elapsed_days;
 }
 
 // Sets update_response's response_ member to response. Used by unit tests to
@@ -60,7 +109,7 @@ int UpdateResponse::GetElapsedDaysSinceDatum() const {
 void SetResponseForUnitTest(UpdateResponse* update_response,
                             const response::Response& response) {
   ASSERT1(update_response);
-  update_response->response_ = response;
+  update_response->SetResponse(response);
 }
 
 }  // namespace xml
@@ -20,13 +20,17 @@
 #define OMAHA_COMMON_UPDATE_RESPONSE_H_
 
 #include <windows.h>
+#include <map>
 #include <utility>
 #include <vector>
 #include "base/basictypes.h"
+#include "base/scoped_ptr.h"
 #include "omaha/common/protocol_definition.h"
 
 namespace omaha {
 
+class ArenaStringMgr;
+
 namespace xml {
 
 class UpdateResponse {
@@ -46,9 +50,25 @@ class UpdateResponse {
 
   int GetElapsedDaysSinceDatum() const;
 
-  const response::Response& response() const { return response_; }
+  const response::Response& response() const { return *response_; }
+
+  // Replaces this response with a copy of 'other'.
+  void CopyFrom(const UpdateResponse& other);
+
+  // Returns the app in the response which has the given app id, or NULL if
+  // there is no such app. The app ids are compared case-insensitively. Apps
+  // with GUID ids are found through an index, which is built when the response
+  // is set, so looking up all the apps of a large bundle is not quadratic.
+  const response::App* GetApp(const CString& appid) const;
 
  private:
+  struct GuidLess {
+    bool operator()(const GUID& lhs, const GUID& rhs) const {
+      return memcmp(&lhs, &rhs, sizeof(GUID)) < 0;
+    }
+  };
+  typedef std::map<GUID, size_t, GuidLess> AppIndex;
+
   friend class XmlParser;
   friend class XmlParserTest;
 
@@ -58,7 +78,23 @@ class UpdateResponse {
 
   UpdateResponse();
 
-  response::Response response_;
+  // Sets response_ to a copy of 'response' and rebuilds the app index.
+  void SetResponse(const response::Response& response);
+
+  // Sets response_ and rebuilds the app index. Takes ownership of 'response'
+  // and of 'string_mgr', which allocated the strings of 'response'.
+  void AdoptResponse(response::Response* response, ArenaStringMgr* string_mgr);
+
+  void BuildAppIndex();
+
+  // Allocated the strings of response_ if response_ was deserialized. It is
+  // declared before response_, so that it outlives the strings.
+  scoped_ptr<ArenaStringMgr> string_mgr_;
+
+  scoped_ptr<response::Response> response_;
+
+  // Maps the app GUIDs to their positions in response_.apps.
+  AppIndex app_index_;
 
   DISALLOW_COPY_AND_ASSIGN(UpdateResponse);
 };
@@ -15,6 +15,7 @@
 
 #include "omaha/common/web_services_client.h"
 #include <atlstr.h>
+#include <algorithm>
 #include "omaha/base/const_addresses.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
@@ -24,7 +25,10 @@
 #include "omaha/common/config_manager.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
+#include "omaha/net/circuit_breaker.h"
+#include "omaha/net/content_encoding.h"
 #include "omaha/net/cup_ecdsa_request.h"
+#include "omaha/net/http_client.h"
 #include "omaha/net/net_utils.h"
 #include "omaha/net/network_config.h"
 #include "omaha/net/network_request.h"
@@ -32,12 +36,34 @@
 
 namespace omaha {
 
+WebServicesClientResult::WebServicesClientResult()
+    : http_status_code(0),
+      http_ssl_result(S_FALSE),
+      http_xdaystart_header_value(-1),
+      http_xdaynum_header_value(-1),
+      retry_after_sec(-1) {
+}
+
+WebServicesClientResult::WebServicesClientResult(
+    const WebServicesClientInterface& client)
+    : http_status_code(client.http_status_code()),
+      http_trace(client.http_trace()),
+      http_ssl_result(client.http_ssl_result()),
+      http_xdaystart_header_value(client.http_xdaystart_header_value()),
+      http_xdaynum_header_value(client.http_xdaynum_header_value()),
+      retry_after_sec(client.retry_after_sec()) {
+}
+
+LLock WebServicesClient::servers_lock_;
+std::vector<CString> WebServicesClient::servers_decoding_requests_;
+
 WebServicesClient::WebServicesClient(bool is_machine)
     : lock_(NULL),
       is_machine_(is_machine),
       used_ssl_(false),
       ssl_result_(S_FALSE),
       use_cup_(false),
+      use_circuit_breaker_(false),
       http_xdaystart_header_value_(-1),
       http_xdaynum_header_value_(-1),
       retry_after_sec_(-1) {
@@ -66,7 +92,7 @@ HRESULT WebServicesClient::Initialize(const CString& url,
   return S_OK;
 }
 
-HRESULT WebServicesClient::CreateRequest() {
+HRESULT WebServicesClient::CreateRequest(const CString& url) {
   __mutexScope(lock_);
 
   network_request_.reset();
@@ -96,7 +122,11 @@ HRESULT WebServicesClient::CreateRequest() {
   }
 
   network_request_->set_num_retries(1);
+  network_request_->set_compress_request(ServerDecodesRequests(url));
   network_request_->set_proxy_auth_config(proxy_auth_config_);
+  if (use_circuit_breaker_) {
+    network_request_->set_host_health_store(new RegistryHostHealthStore);
+  }
 
   return S_OK;
 }
@@ -210,7 +240,7 @@ HRESULT WebServicesClient::SendStringInternal(
   CORE_LOG(L3, (_T("[actual_url is %s]"), actual_url));
 
   // Each attempt to send a request is using its own network client.
-  HRESULT hr = CreateRequest();
+  HRESULT hr = CreateRequest(actual_url);
   if (FAILED(hr)) {
     return hr;
   }
@@ -226,6 +256,10 @@ HRESULT WebServicesClient::SendStringInternal(
   // Save the values of the custom headers if the values are found.
   CaptureCustomHeaderValues();
 
+  if (SUCCEEDED(hr) && IsEncodedResponse()) {
+    SetServerDecodesRequests(actual_url);
+  }
+
   // The value of the X-Retry-After header is only trusted when the response is
   // over https.
   if (IsHttpsUrl(actual_url)) {
@@ -289,6 +323,11 @@ void WebServicesClient::set_proxy_auth_config(const ProxyAuthConfig& config) {
   proxy_auth_config_ = config;
 }
 
+void WebServicesClient::set_use_circuit_breaker(bool use_circuit_breaker) {
+  __mutexScope(lock_);
+  use_circuit_breaker_ = use_circuit_breaker;
+}
+
 bool WebServicesClient::is_http_success() const {
   return network_request_.get() &&
          network_request_->http_status_code() == HTTP_STATUS_OK;
@@ -328,6 +367,35 @@ int WebServicesClient::FindHttpHeaderValueInt(const CString& header) const {
   return -1;
 }
 
+bool WebServicesClient::IsEncodedResponse() const {
+  if (!network_request_.get()) {
+    return false;
+  }
+
+  const CString content_encoding(FindHttpHeaderValue(
+      network_request_->response_headers(), kHttpContentEncodingHeader));
+  return !content_encoding.CompareNoCase(kLzmaContentEncoding);
+}
+
+// static
+bool WebServicesClient::ServerDecodesRequests(const CString& url) {
+  __mutexScope(servers_lock_);
+  return std::find(servers_decoding_requests_.begin(),
+                   servers_decoding_requests_.end(),
+                   url) != servers_decoding_requests_.end();
+}
+
+// static
+void WebServicesClient::SetServerDecodesRequests(const CString& url) {
+  __mutexScope(servers_lock_);
+  if (std::find(servers_decoding_requests_.begin(),
+                servers_decoding_requests_.end(),
+                url) == servers_decoding_requests_.end()) {
+    CORE_LOG(L3, (_T("[server decodes requests][%s]"), url));
+    servers_decoding_requests_.push_back(url);
+  }
+}
+
 int WebServicesClient::http_xdaystart_header_value() const {
   __mutexScope(lock_);
   return http_xdaystart_header_value_;
@@ -22,6 +22,7 @@
 #include <vector>
 #include "base/basictypes.h"
 #include "base/scoped_ptr.h"
+#include "omaha/base/synchronized.h"
 #include "omaha/net/proxy_auth.h"
 
 namespace omaha {
@@ -53,6 +54,12 @@ class WebServicesClientInterface {
 
   virtual void set_proxy_auth_config(const ProxyAuthConfig& config) = 0;
 
+  // Sets whether the requests stop going to a server which keeps answering
+  // with server errors, as the circuit breaker of the net module decides.
+  // Only background requests, which can wait for the server to recover,
+  // should use it. The default is false.
+  virtual void set_use_circuit_breaker(bool use_circuit_breaker) = 0;
+
   // Returns true if the http transaction completed with 200 OK.
   virtual bool is_http_success() const = 0;
 
@@ -91,6 +98,21 @@ class WebServicesClientInterface {
   virtual int retry_after_sec() const = 0;
 };
 
+// The outcome of the http transaction of a request sent by a web services
+// client. Unlike the client, it can be handed to the callers which share the
+// response of a request they did not send themselves.
+struct WebServicesClientResult {
+  WebServicesClientResult();
+  explicit WebServicesClientResult(const WebServicesClientInterface& client);
+
+  int http_status_code;
+  CString http_trace;
+  HRESULT http_ssl_result;
+  int http_xdaystart_header_value;
+  int http_xdaynum_header_value;
+  int retry_after_sec;
+};
+
 // Defines a class to send and receive protocol requests, with a fall back
 // from HTTPS to HTTP.
 class WebServicesClient : public WebServicesClientInterface {
@@ -112,6 +134,8 @@ class WebServicesClient : public WebServicesClientInterface {
 
   virtual void set_proxy_auth_config(const ProxyAuthConfig& proxy_auth_config);
 
+  virtual void set_use_circuit_breaker(bool use_circuit_breaker);
+
   virtual bool is_http_success() const;
 
   virtual int http_status_code() const;
@@ -129,7 +153,7 @@ class WebServicesClient : public WebServicesClientInterface {
   virtual int retry_after_sec() const;
 
  private:
-  HRESULT CreateRequest();
+  HRESULT CreateRequest(const CString& url);
 
   // Sends a string and possibly retries the request  by falling back on http
   // if the request has failed the first time. No fall backs happens if the
@@ -157,6 +181,16 @@ class WebServicesClient : public WebServicesClientInterface {
 
   int FindHttpHeaderValueInt(const CString& header_name) const;
 
+  // Returns true if the last response was LZMA-encoded.
+  bool IsEncodedResponse() const;
+
+  // The server at |url| is known to decode LZMA-encoded requests once it has
+  // sent an encoded response, since the server supports both encodings or
+  // none. Nothing is known about the servers when the process starts, so the
+  // first request to each server is sent as is.
+  static bool ServerDecodesRequests(const CString& url);
+  static void SetServerDecodesRequests(const CString& url);
+
   Lockable* volatile lock_;   // Owned by this instance.
 
   const bool is_machine_;
@@ -179,6 +213,8 @@ class WebServicesClient : public WebServicesClientInterface {
   // update checks. Pings don't use CUP.
   bool use_cup_;
 
+  bool use_circuit_breaker_;
+
   // Contains the request headers to send.
   HeadersVector headers_;
   HeadersVector update_request_headers_;
@@ -202,6 +238,10 @@ class WebServicesClient : public WebServicesClientInterface {
   // Each web services request must use its own network request instance.
   scoped_ptr<NetworkRequest> network_request_;
 
+  // The urls of the servers which are known to decode encoded requests.
+  static LLock servers_lock_;
+  static std::vector<CString> servers_decoding_requests_;
+
   friend class WebServicesClientTest;
   DISALLOW_COPY_AND_ASSIGN(WebServicesClient);
 };
@@ -66,6 +66,14 @@ class WebServicesClientTest : public testing::Test {
     return web_service_client_->CaptureCustomHeaderValues();
   }
 
+  static bool ServerDecodesRequests(const CString& url) {
+    return WebServicesClient::ServerDecodesRequests(url);
+  }
+
+  static void SetServerDecodesRequests(const CString& url) {
+    WebServicesClient::SetServerDecodesRequests(url);
+  }
+
   CString update_check_url_;
 
   scoped_ptr<WebServicesClient> web_service_client_;
@@ -322,5 +330,18 @@ TEST_F(WebServicesClientTest, FindHttpHeaderValue) {
   EXPECT_STREQ(_T("no-cache"), FindHttpHeaderValue(headers, _T("Pragma")));
 }
 
-}  // namespace omaha
+TEST_F(WebServicesClientTest, ServerDecodesRequests) {
+  const CString url(_T("https://decoding.example.com/service/update2"));
+  const CString other_url(_T("http://decoding.example.com/service/update2"));
+  EXPECT_FALSE(ServerDecodesRequests(url));
 
+  SetServerDecodesRequests(url);
+  EXPECT_TRUE(ServerDecodesRequests(url));
+  EXPECT_FALSE(ServerDecodesRequests(other_url));
+
+  // Setting a server again has no effect.
+  SetServerDecodesRequests(url);
+  EXPECT_TRUE(ServerDecodesRequests(url));
+}
+
+}  // namespace omaha
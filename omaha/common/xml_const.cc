@@ -127,6 +127,7 @@ const TCHAR* const kSsse3 = _T("ssse3");
 const TCHAR* const kSse41 = _T("sse41");
 const TCHAR* const kSse42 = _T("sse42");
 const TCHAR* const kStateCancelled = _T("state_cancelled");
+const TCHAR* const kStateToken = _T("statetoken");
 const TCHAR* const kStatus = _T("status");
 const TCHAR* const kSuccessAction = _T("onsuccess");
 const TCHAR* const kSuccessUrl = _T("successurl");
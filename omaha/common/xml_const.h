@@ -127,6 +127,7 @@ extern const TCHAR* const kSsse3;
 extern const TCHAR* const kSse41;
 extern const TCHAR* const kSse42;
 extern const TCHAR* const kStateCancelled;
+extern const TCHAR* const kStateToken;
 extern const TCHAR* const kStatus;
 extern const TCHAR* const kSuccessAction;
 extern const TCHAR* const kSuccessUrl;
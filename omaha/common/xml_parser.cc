@@ -17,6 +17,8 @@
 #include <stdlib.h>
 #include <vector>
 #include "base/basictypes.h"
+#include "base/scoped_ptr.h"
+#include "omaha/base/arena.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/error.h"
 #include "omaha/base/safe_format.h"
@@ -44,6 +46,19 @@ struct Tuple {
   Type2 second;
 };
 
+// Reserves room in 'list' for the children of 'node'. The lists of the response
+// are not grown while they are parsed, since growing a list copies its strings
+// out of the arena. The count includes the text nodes between the elements, if
+// any, so it is an upper bound.
+template <typename T>
+void ReserveChildren(IXMLDOMNode* node, std::vector<T>* list) {
+  ASSERT1(list);
+  int num_children = 0;
+  if (SUCCEEDED(GetNumChildren(node, &num_children))) {
+    list->reserve(list->size() + num_children);
+  }
+}
+
 // Converts a string to the SuccessfulInstallAction enum.
 HRESULT ConvertStringToSuccessfulInstallAction(
     const CString& str,
@@ -167,13 +182,17 @@ CString ConvertProcessorArchitectureToString(DWORD arch) {
 // the template method design pattern.
 class ElementHandler {
  public:
-  ElementHandler() {}
+  ElementHandler() : string_mgr_(NULL) {}
   virtual ~ElementHandler() {}
 
-  HRESULT Handle(IXMLDOMNode* node, response::Response* response) {
+  HRESULT Handle(IXMLDOMNode* node,
+                 IAtlStringMgr* string_mgr,
+                 response::Response* response) {
     ASSERT1(node);
     ASSERT1(response);
 
+    string_mgr_ = string_mgr;
+
     HRESULT hr = Validate(node);
     if (FAILED(hr)) {
       return hr;
@@ -187,7 +206,29 @@ class ElementHandler {
     return S_OK;
   }
 
+ protected:
+  // Read the strings into the arena of the response. These hide the functions
+  // in xml_utils, so that the handlers below use them without qualification.
+  HRESULT ReadStringAttribute(IXMLDOMNode* node,
+                              const TCHAR* attr_name,
+                              CString* value) {
+    UseStringMgr(value);
+    return omaha::ReadStringAttribute(node, attr_name, value);
+  }
+
+  HRESULT ReadStringValue(IXMLDOMNode* node, CString* value) {
+    UseStringMgr(value);
+    return omaha::ReadStringValue(node, value);
+  }
+
  private:
+  void UseStringMgr(CString* value) {
+    ASSERT1(value);
+    if (string_mgr_ && value->IsEmpty()) {
+      value->SetManager(string_mgr_);
+    }
+  }
+
   // Validates a node and returns S_OK in case of success.
   virtual HRESULT Validate(IXMLDOMNode* node) {
     UNREFERENCED_PARAMETER(node);
@@ -201,6 +242,8 @@ class ElementHandler {
     return S_OK;
   }
 
+  IAtlStringMgr* string_mgr_;
+
   DISALLOW_COPY_AND_ASSIGN(ElementHandler);
 };
 
@@ -223,6 +266,7 @@ class ResponseElementHandler : public ElementHandler {
       return hr;
     }
 
+    ReserveChildren(node, &response->apps);
     return S_OK;
   }
 };
@@ -234,7 +278,8 @@ class AppElementHandler : public ElementHandler {
 
  private:
   virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response::App app;
+    response->apps.push_back(response::App());
+    response::App& app = response->apps.back();
 
     HRESULT hr = ReadStringAttribute(node, xml::attribute::kAppId, &app.appid);
     if (FAILED(hr)) {
@@ -259,13 +304,7 @@ class AppElementHandler : public ElementHandler {
       }
     }
 
-    hr = ReadCohortAttributes(node, &app);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    response->apps.push_back(app);
-    return S_OK;
+    return ReadCohortAttributes(node, &app);
   }
 
   HRESULT ReadCohortAttributes(IXMLDOMNode* node, response::App* app) {
@@ -317,6 +356,10 @@ class UpdateCheckElementHandler : public ElementHandler {
                         xml::attribute::kTTToken,
                         &update_check.tt_token);
 
+    ReadStringAttribute(node,
+                        xml::attribute::kStateToken,
+                        &update_check.state_token);
+
     ReadStringAttribute(node,
                         xml::attribute::kErrorUrl,
                         &update_check.error_url);
@@ -332,6 +375,12 @@ class UpdateCheckElementHandler : public ElementHandler {
 class UrlsElementHandler : public ElementHandler {
  public:
   static ElementHandler* Create() { return new UrlsElementHandler; }
+
+ private:
+  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
+    ReserveChildren(node, &response->apps.back().update_check.urls);
+    return S_OK;
+  }
 };
 
 
@@ -342,16 +391,9 @@ class UrlElementHandler : public ElementHandler {
 
  private:
   virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    CString url;
-    HRESULT hr = ReadStringAttribute(node, xml::attribute::kCodebase, &url);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    response::UpdateCheck& update_check = response->apps.back().update_check;
-    update_check.urls.push_back(url);
-
-    return S_OK;
+    std::vector<CString>& urls = response->apps.back().update_check.urls;
+    urls.push_back(CString());
+    return ReadStringAttribute(node, xml::attribute::kCodebase, &urls.back());
   }
 };
 
@@ -377,6 +419,14 @@ class ManifestElementHandler : public ElementHandler {
 class PackagesElementHandler : public ElementHandler {
  public:
   static ElementHandler* Create() { return new PackagesElementHandler; }
+
+ private:
+  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
+    InstallManifest& install_manifest =
+        response->apps.back().update_check.install_manifest;
+    ReserveChildren(node, &install_manifest.packages);
+    return S_OK;
+  }
 };
 
 
@@ -388,7 +438,10 @@ class PackageElementHandler : public ElementHandler {
 
  private:
   virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    InstallPackage install_package;
+    InstallManifest& install_manifest =
+        response->apps.back().update_check.install_manifest;
+    install_manifest.packages.push_back(InstallPackage());
+    InstallPackage& install_package = install_manifest.packages.back();
 
     HRESULT hr = ReadStringAttribute(node,
                                      xml::attribute::kName,
@@ -420,10 +473,6 @@ class PackageElementHandler : public ElementHandler {
       return hr;
     }
 
-    InstallManifest& install_manifest =
-        response->apps.back().update_check.install_manifest;
-    install_manifest.packages.push_back(install_package);
-
     return S_OK;
   }
 };
@@ -432,6 +481,14 @@ class PackageElementHandler : public ElementHandler {
 class ActionsElementHandler : public ElementHandler {
  public:
   static ElementHandler* Create() { return new ActionsElementHandler; }
+
+ private:
+  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
+    InstallManifest& install_manifest =
+        response->apps.back().update_check.install_manifest;
+    ReserveChildren(node, &install_manifest.install_actions);
+    return S_OK;
+  }
 };
 
 
@@ -442,7 +499,10 @@ class ActionElementHandler : public ElementHandler {
 
  private:
   virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    InstallAction install_action;
+    InstallManifest& install_manifest =
+        response->apps.back().update_check.install_manifest;
+    install_manifest.install_actions.push_back(InstallAction());
+    InstallAction& install_action = install_manifest.install_actions.back();
 
     CString event;
     HRESULT hr = ReadStringAttribute(node, xml::attribute::kEvent, &event);
@@ -476,10 +536,6 @@ class ActionElementHandler : public ElementHandler {
     ConvertStringToSuccessfulInstallAction(success_action,
                                            &install_action.success_action);
 
-    InstallManifest& install_manifest =
-        response->apps.back().update_check.install_manifest;
-    install_manifest.install_actions.push_back(install_action);
-
     return S_OK;
   }
 };
@@ -549,11 +605,10 @@ class EventElementHandler : public ElementHandler {
 
  private:
   virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response::Event event;
-    ReadStringAttribute(node, xml::attribute::kStatus, &event.status);
-    ASSERT1(event.status == xml::response::kStatusOkValue);
-    response::App& app = response->apps.back();
-    app.events.push_back(event);
+    std::vector<response::Event>& events = response->apps.back().events;
+    events.push_back(response::Event());
+    ReadStringAttribute(node, xml::attribute::kStatus, &events.back().status);
+    ASSERT1(events.back().status == xml::response::kStatusOkValue);
     return S_OK;
   }
 };
@@ -648,8 +703,13 @@ class GUpdateElementHandler : public ElementHandler {
     if (FAILED(hr)) {
       return hr;
     }
-    return VerifyProtocolCompatibility(response->protocol,
-                                       value::kVersion2);
+    hr = VerifyProtocolCompatibility(response->protocol, value::kVersion2);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    ReserveChildren(node, &response->apps);
+    return S_OK;
   }
 };
 
@@ -766,7 +826,11 @@ class UpdateCheckElementHandler : public ElementHandler {
 
 }  // namespace v2
 
-XmlParser::XmlParser() {}
+XmlParser::XmlParser()
+    : request_(NULL),
+      response_(NULL),
+      string_mgr_(NULL) {
+}
 
 void XmlParser::InitializeElementHandlers() {
   const Tuple<const TCHAR*, ElementHandler* (*)()> tuples[] = {
@@ -1446,6 +1510,16 @@ HRESULT XmlParser::BuildUpdateCheckElement(const request::App& app,
     }
   }
 
+  if (!app.update_check.state_token.IsEmpty()) {
+    hr = AddXMLAttributeNode(element,
+                             kXmlNamespace,
+                             xml::attribute::kStateToken,
+                             app.update_check.state_token);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
   if (!app.update_check.target_version_prefix.IsEmpty()) {
     hr = AddXMLAttributeNode(element,
                              kXmlNamespace,
@@ -1692,15 +1766,19 @@ HRESULT XmlParser::DeserializeResponse(const std::vector<uint8>& buffer,
     return hr;
   }
 
-  response::Response response;
-  xml_parser.response_ = &response;
+  // The strings of the response are allocated in an arena, which is released
+  // with the response. The response is destroyed first if parsing fails.
+  scoped_ptr<ArenaStringMgr> string_mgr(new ArenaStringMgr);
+  scoped_ptr<response::Response> response(new response::Response);
+  xml_parser.string_mgr_ = string_mgr.get();
+  xml_parser.response_ = response.get();
 
   hr = xml_parser.Parse();
   if (FAILED(hr)) {
     return hr;
   }
 
-  update_response->response_ = response;
+  update_response->AdoptResponse(response.release(), string_mgr.release());
   return S_OK;
 }
 
@@ -1794,10 +1872,10 @@ HRESULT XmlParser::VisitElement(IXMLDOMNode* node) {
   CORE_LOG(L4, (_T("[element name][%s:%s]"), node_name.uri, node_name.base));
 
   // Ignore elements not understood.
-  ElementHandler* element_handler =
-      element_handler_factory_.CreateObject(node_name.base);
-  if (element_handler) {
-    return element_handler->Handle(node, response_);
+  scoped_ptr<ElementHandler> element_handler(
+      element_handler_factory_.CreateObject(node_name.base));
+  if (element_handler.get()) {
+    return element_handler->Handle(node, string_mgr_, response_);
   } else {
     CORE_LOG(LW, (_T("[VisitElement: don't know how to handle %s:%s]"),
                   node_name.uri, node_name.base));
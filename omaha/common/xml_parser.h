@@ -47,7 +47,9 @@ class XmlParser {
  public:
   // Parses the update response buffer and fills in the UpdateResponse.
   // The UpdateResponse object is not modified in case of errors and it can
-  // be safely reused for subsequent parsing attempts.
+  // be safely reused for subsequent parsing attempts. The strings of the
+  // response are allocated in an arena, which the UpdateResponse releases in
+  // one go along with the response.
   // TODO(omaha): since the xml docs are strings we could use a CString as
   // an input parameter, no reason why this should be a buffer.
   static HRESULT DeserializeResponse(const std::vector<uint8>& buffer,
@@ -130,6 +132,10 @@ class XmlParser {
   // The xml response being deserialized. Not owned by this class.
   response::Response* response_;
 
+  // Allocates the strings of the response being deserialized. Not owned by
+  // this class.
+  IAtlStringMgr* string_mgr_;
+
   ElementHandlerFactory element_handler_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(XmlParser);
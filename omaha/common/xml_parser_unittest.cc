@@ -16,8 +16,10 @@
 #include <windows.h>
 #include "base/utils.h"
 #include "base/scoped_ptr.h"
+#include "omaha/base/arena.h"
 #include "omaha/base/error.h"
 #include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
 #include "omaha/common/const_group_policy.h"
 #include "omaha/common/xml_parser.h"
 #include "omaha/goopdate/update_response_utils.h"
@@ -54,6 +56,46 @@ class XmlParserTest : public ::testing::TestWithParam<bool> {
   request::Request& get_xml_request(UpdateRequest* update_request) {
     return update_request->request_;
   }
+
+  // Returns the arena of the strings of the response, or NULL if the response
+  // was not deserialized.
+  const Arena* GetStringArena(const UpdateResponse& update_response) {
+    return update_response.string_mgr_.get() ?
+           &update_response.string_mgr_->arena() : NULL;
+  }
+
+  // Returns a response for 'num_apps' apps which have an update.
+  static std::vector<uint8> MakeUpdateResponse(int num_apps) {
+    CStringA response =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\">"
+        "<daystart elapsed_seconds=\"8400\" elapsed_days=\"3255\"/>";
+    for (int i = 0; i < num_apps; ++i) {
+      CStringA app;
+      SafeCStringAFormat(&app,
+          "<app appid=\"{%08X-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\" "
+          "cohort=\"1:1f:\" cohorthint=\"Stable\" cohortname=\"Stable\">"
+          "<updatecheck status=\"ok\"><urls>"
+          "<url codebase=\"http://dl.google.com/edgedl/%08x/\"/>"
+          "<url codebase=\"https://dl.google.com/edgedl/%08x/\"/></urls>"
+          "<manifest version=\"%d.0.%d.0\"><packages>"
+          "<package name=\"installer_%d.exe\" hash_sha256=\"5c9c54d8d3b5d"
+          "1f3a2e6b4e8a3f8c7d9e0b1a2c3d4e5f60718293a4b5c6d7e8\" "
+          "size=\"%d\" required=\"true\"/></packages><actions>"
+          "<action event=\"install\" run=\"installer_%d.exe\" "
+          "arguments=\"--do-not-launch-chrome\"/>"
+          "<action event=\"postinstall\" onsuccess=\"exitsilently\"/>"
+          "</actions></manifest></updatecheck>"
+          "<data index=\"verboselogging\" name=\"install\" status=\"ok\">"
+          "{\"distribution\": {\"verbose_logging\": true}}</data>"
+          "<ping status=\"ok\"/><event status=\"ok\"/></app>",
+          i, i, i, i % 7, i, i, 1000 + i, i);
+      response += app;
+    }
+    response += "</response>";
+
+    const uint8* begin = reinterpret_cast<const uint8*>(response.GetString());
+    return std::vector<uint8>(begin, begin + response.GetLength());
+  }
 };
 
 // Creates a machine update request and serializes it.
@@ -611,6 +653,191 @@ TEST_F(XmlParserTest, PingFreshness) {
   EXPECT_STREQ(expected_buffer, actual_buffer);
 }
 
+TEST_F(XmlParserTest, StateToken) {
+  scoped_ptr<UpdateRequest> update_request(
+         UpdateRequest::Create(false, _T(""), _T("is"), _T("")));
+  request::Request& xml_request = get_xml_request(update_request.get());
+
+  xml_request.omaha_version = _T("1.3.24.1");
+  xml_request.omaha_shell_version = _T("1.2.1.1");
+  xml_request.test_source = _T("dev");
+  xml_request.request_id = _T("{387E2718-B39C-4458-98CC-24B5293C8385}");
+  xml_request.hw.physmemory = 0;
+  xml_request.hw.has_sse = false;
+  xml_request.hw.has_sse2 = false;
+  xml_request.hw.has_sse3 = false;
+  xml_request.hw.has_ssse3 = false;
+  xml_request.hw.has_sse41 = false;
+  xml_request.hw.has_sse42 = false;
+  xml_request.hw.has_avx = false;
+  xml_request.os.platform = _T("win");
+  xml_request.os.version = _T("9.0");
+  xml_request.os.service_pack = _T("Service Pack 3");
+  xml_request.os.arch = _T("unknown");
+  xml_request.check_period_sec = 120000;
+  xml_request.uid.Empty();
+
+  request::App app;
+  app.app_id = _T("{8A69D345-D564-463C-AFF1-A69D9E530F96}");
+  app.update_check.is_valid = true;
+  app.update_check.state_token = _T("4:a0f2");
+  xml_request.apps.push_back(app);
+
+  const CString expected_buffer = _T("<?xml version=\"1.0\" encoding=\"UTF-8\"?><request protocol=\"3.0\" version=\"1.3.24.1\" shell_version=\"1.2.1.1\" ismachine=\"0\" sessionid=\"\" installsource=\"is\" testsource=\"dev\" requestid=\"{387E2718-B39C-4458-98CC-24B5293C8385}\" periodoverridesec=\"120000\" dedup=\"cr\"><hw physmemory=\"0\" sse=\"0\" sse2=\"0\" sse3=\"0\" ssse3=\"0\" sse41=\"0\" sse42=\"0\" avx=\"0\"/><os platform=\"win\" version=\"9.0\" sp=\"Service Pack 3\" arch=\"unknown\"/><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" version=\"\" nextversion=\"\" lang=\"\" brand=\"\" client=\"\"><updatecheck statetoken=\"4:a0f2\"/></app></request>");  // NOLINT
+  CString actual_buffer;
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::SerializeRequest(*update_request,
+                                                       &actual_buffer));
+  EXPECT_STREQ(expected_buffer, actual_buffer);
+
+  CStringA response_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><daystart elapsed_seconds=\"8400\" elapsed_days=\"3255\"/><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"noupdate\" statetoken=\"4:a0f3\"/></app><app appid=\"{AD3D0CC0-AD1E-4b1f-B98E-BAA41DCE396C}\" status=\"ok\"><updatecheck status=\"unchanged\"/></app></response>";  // NOLINT
+  std::vector<uint8> buffer(response_string.GetLength());
+  memcpy(&buffer.front(), response_string, buffer.size());
+
+  scoped_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      buffer,
+      update_response.get()));
+
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(2, xml_response.apps.size());
+  EXPECT_STREQ(_T("noupdate"), xml_response.apps[0].update_check.status);
+  EXPECT_STREQ(_T("4:a0f3"), xml_response.apps[0].update_check.state_token);
+  EXPECT_FALSE(update_response_utils::IsUnchangedResponse(
+      xml_response.apps[0]));
+  EXPECT_STREQ(_T("unchanged"), xml_response.apps[1].update_check.status);
+  EXPECT_TRUE(xml_response.apps[1].update_check.state_token.IsEmpty());
+  EXPECT_TRUE(update_response_utils::IsUnchangedResponse(
+      xml_response.apps[1]));
+}
+
+// An "unchanged" app has none of the fields of a full response, and the state
+// token of a full response is echoed by the next request.
+TEST_F(XmlParserTest, Parse_UnchangedResponses) {
+  CStringA response_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><daystart elapsed_seconds=\"8400\" elapsed_days=\"3255\"/><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\" cohort=\"1:1f:\" cohorthint=\"Stable\" cohortname=\"Stable\" experiments=\"url_exp_2=a\"><updatecheck status=\"noupdate\" statetoken=\"4:0000002a\"/><data index=\"verboselogging\" name=\"install\" status=\"ok\">{}</data><ping status=\"ok\"/></app><app appid=\"{AD3D0CC0-AD1E-4b1f-B98E-BAA41DCE396C}\" status=\"ok\"><updatecheck status=\"unchanged\"/></app></response>";  // NOLINT
+  std::vector<uint8> buffer(response_string.GetLength());
+  memcpy(&buffer.front(), response_string, buffer.size());
+
+  scoped_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      buffer,
+      update_response.get()));
+
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(2, xml_response.apps.size());
+
+  const response::App& unchanged_app = xml_response.apps[1];
+  EXPECT_STREQ(_T("ok"), unchanged_app.status);
+  EXPECT_STREQ(_T("unchanged"), unchanged_app.update_check.status);
+  EXPECT_TRUE(update_response_utils::IsUnchangedResponse(unchanged_app));
+  EXPECT_TRUE(unchanged_app.update_check.state_token.IsEmpty());
+  EXPECT_TRUE(unchanged_app.update_check.urls.empty());
+  EXPECT_TRUE(unchanged_app.update_check.install_manifest.version.IsEmpty());
+  EXPECT_TRUE(unchanged_app.cohort.IsEmpty());
+  EXPECT_TRUE(unchanged_app.cohort_hint.IsEmpty());
+  EXPECT_TRUE(unchanged_app.cohort_name.IsEmpty());
+  EXPECT_TRUE(unchanged_app.experiments.IsEmpty());
+  EXPECT_TRUE(unchanged_app.data.empty());
+  EXPECT_TRUE(unchanged_app.ping.status.IsEmpty());
+
+  const response::App& full_app = xml_response.apps[0];
+  EXPECT_STREQ(_T("noupdate"), full_app.update_check.status);
+  EXPECT_FALSE(update_response_utils::IsUnchangedResponse(full_app));
+  EXPECT_STREQ(_T("4:0000002a"), full_app.update_check.state_token);
+
+  scoped_ptr<UpdateRequest> update_request(
+         UpdateRequest::Create(false, _T(""), _T("is"), _T("")));
+  request::App app;
+  app.app_id = full_app.appid;
+  app.update_check.is_valid = true;
+  app.update_check.state_token = full_app.update_check.state_token;
+  get_xml_request(update_request.get()).apps.push_back(app);
+
+  CString request_string;
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::SerializeRequest(*update_request,
+                                                       &request_string));
+  EXPECT_NE(-1, request_string.Find(
+      _T("<updatecheck statetoken=\"4:0000002a\"/>")));
+}
+
+TEST_F(XmlParserTest, Parse_StringsInArena) {
+  scoped_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_TRUE(GetStringArena(*update_response) == NULL);
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      MakeUpdateResponse(2),
+      update_response.get()));
+
+  const Arena* arena = GetStringArena(*update_response);
+  ASSERT_TRUE(arena);
+  EXPECT_LT(0, arena->num_allocations());
+  EXPECT_EQ(1, arena->num_blocks());
+
+  const response::Response& xml_response = update_response->response();
+  ASSERT_EQ(2, xml_response.apps.size());
+  const response::App& app = xml_response.apps[1];
+  EXPECT_STREQ(_T("{00000001-D564-463C-AFF1-A69D9E530F96}"), app.appid);
+  EXPECT_STREQ(_T("Stable"), app.cohort_name);
+  ASSERT_EQ(2, app.update_check.urls.size());
+  EXPECT_STREQ(_T("https://dl.google.com/edgedl/00000001/"),
+               app.update_check.urls[1]);
+  const InstallManifest& install_manifest = app.update_check.install_manifest;
+  EXPECT_STREQ(_T("1.0.1.0"), install_manifest.version);
+  ASSERT_EQ(1, install_manifest.packages.size());
+  EXPECT_STREQ(_T("installer_1.exe"), install_manifest.packages[0].name);
+  EXPECT_EQ(1001, install_manifest.packages[0].size);
+  ASSERT_EQ(2, install_manifest.install_actions.size());
+  EXPECT_EQ(InstallAction::kPostInstall,
+            install_manifest.install_actions[1].install_event);
+  ASSERT_EQ(1, app.data.size());
+  EXPECT_STREQ(_T("{\"distribution\": {\"verbose_logging\": true}}"),
+               app.data[0].install_data);
+  ASSERT_EQ(1, app.events.size());
+  EXPECT_STREQ(_T("ok"), app.events[0].status);
+
+  // A copy of the response does not need the arena, and outlives it.
+  scoped_ptr<UpdateResponse> copy(UpdateResponse::Create());
+  copy->CopyFrom(*update_response);
+  EXPECT_TRUE(GetStringArena(*copy) == NULL);
+  update_response.reset();
+
+  const response::App* copied_app =
+      copy->GetApp(_T("{00000001-D564-463C-AFF1-A69D9E530F96}"));
+  ASSERT_TRUE(copied_app);
+  EXPECT_STREQ(_T("Stable"), copied_app->cohort_name);
+  EXPECT_STREQ(_T("installer_1.exe"),
+               copied_app->update_check.install_manifest.packages[0].name);
+}
+
+TEST_F(XmlParserTest, Parse_InvalidResponseKeepsPreviousResponse) {
+  scoped_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      MakeUpdateResponse(1),
+      update_response.get()));
+
+  CStringA response_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"ok\"><manifest version=\"1.0.0.0\"><actions><action event=\"unknown\"/></actions></manifest></updatecheck></app></response>";  // NOLINT
+  std::vector<uint8> buffer(response_string.GetLength());
+  memcpy(&buffer.front(), response_string, buffer.size());
+  EXPECT_FAILED(XmlParser::DeserializeResponse(buffer, update_response.get()));
+
+  ASSERT_EQ(1, update_response->response().apps.size());
+  EXPECT_STREQ(_T("{00000000-D564-463C-AFF1-A69D9E530F96}"),
+               update_response->response().apps[0].appid);
+  EXPECT_TRUE(GetStringArena(*update_response) != NULL);
+}
+
+// The strings of a response are allocated in a few blocks of the arena instead
+// of one heap allocation each.
+TEST_F(XmlParserTest, Parse_StringsShareArenaBlocks) {
+  scoped_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      MakeUpdateResponse(5),
+      update_response.get()));
+  ASSERT_EQ(5, update_response->response().apps.size());
+
+  const Arena* arena = GetStringArena(*update_response);
+  ASSERT_TRUE(arena);
+  EXPECT_LT(10 * arena->num_blocks(), arena->num_allocations());
+}
+
 }  // namespace xml
 
 }  // namespace omaha
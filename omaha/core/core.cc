@@ -360,6 +360,13 @@ HRESULT Core::StartUpdateWorker() const {
 HRESULT Core::StartUpdateWorkerInternal() const {
   CORE_LOG(L2, (_T("[Core::StartUpdateWorkerInternal]")));
 
+  if (ConfigManager::Instance()->IsPersistentUpdateWorkerEnabled() &&
+      SUCCEEDED(SignalPersistentUpdateWorker())) {
+    ++metric_core_worker_signaled;
+    ++metric_core_worker_total;
+    return S_OK;
+  }
+
   CString exe_path = goopdate_utils::BuildBraveUpdateExePath(is_system_);
   CommandLineBuilder builder(COMMANDLINE_MODE_UA);
   builder.set_install_source(kCmdLineInstallSource_Core);
@@ -374,6 +381,28 @@ HRESULT Core::StartUpdateWorkerInternal() const {
   return hr;
 }
 
+HRESULT Core::SignalPersistentUpdateWorker() const {
+  NamedObjectAttributes cycle_event_attr;
+  GetNamedObjectAttributes(kUpdateAppsCycleEvent,
+                           is_system_,
+                           &cycle_event_attr);
+  scoped_event cycle_event(::OpenEvent(EVENT_MODIFY_STATE,
+                                       false,
+                                       cycle_event_attr.name));
+  if (!cycle_event) {
+    return HRESULTFromLastError();
+  }
+
+  if (!::SetEvent(get(cycle_event))) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[can't signal update worker][0x%08x]"), hr));
+    return hr;
+  }
+
+  CORE_LOG(L2, (_T("[Core::SignalPersistentUpdateWorker][signaled]")));
+  return S_OK;
+}
+
 bool Core::ShouldRunCodeRed() const {
   if (RegKey::HasValue(MACHINE_REG_UPDATE_DEV, kRegValueNoCodeRedCheck)) {
     CORE_LOG(LW, (_T("[Code Red is disabled for this system]")));
@@ -84,6 +84,10 @@ class Core
   // Starts an update worker process.
   HRESULT StartUpdateWorkerInternal() const;
 
+  // Requests an update cycle from the persistent update worker. Fails if there
+  // is no persistent update worker waiting for requests.
+  HRESULT SignalPersistentUpdateWorker() const;
+
   bool AreScheduledTasksHealthy() const;
   bool IsServiceHealthy() const;
   bool IsCheckingForUpdates() const;
@@ -32,6 +32,7 @@ DEFINE_METRIC_count(core_worker_total);
 DEFINE_METRIC_count(core_worker_succeeded);
 DEFINE_METRIC_count(core_cr_total);
 DEFINE_METRIC_count(core_cr_succeeded);
+DEFINE_METRIC_count(core_worker_signaled);
 
 DEFINE_METRIC_integer(core_cr_expected_timer_interval_ms);
 DEFINE_METRIC_integer(core_cr_actual_timer_interval_ms);
@@ -44,6 +44,10 @@ DECLARE_METRIC_count(core_worker_succeeded);
 DECLARE_METRIC_count(core_cr_total);
 DECLARE_METRIC_count(core_cr_succeeded);
 
+// How many update cycles the core requested from a persistent worker instead
+// of starting a worker process.
+DECLARE_METRIC_count(core_worker_signaled);
+
 // The period of code red checks.
 DECLARE_METRIC_integer(core_cr_expected_timer_interval_ms);
 DECLARE_METRIC_integer(core_cr_actual_timer_interval_ms);
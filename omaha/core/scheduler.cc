@@ -90,7 +90,7 @@ void Scheduler::HandleCallback(QueueTimer* timer) {
   ConfigManager* config_manager = ConfigManager::Instance();
   if (update_timer_.get() == timer) {
     core_.StartUpdateWorker();
-    int au_timer_interval_ms = config_manager->GetAutoUpdateTimerIntervalMs();
+    int au_timer_interval_ms = config_manager->GetNextUpdateWorkerDelayMs();
     VERIFY1(SUCCEEDED(ScheduleUpdateTimer(au_timer_interval_ms)));
   } else if (code_red_timer_.get() == timer) {
     core_.StartCodeRed();
@@ -19,6 +19,7 @@
 #include <atlstr.h>
 #include <algorithm>
 
+#include "omaha/base/debug.h"
 #include "omaha/base/scoped_ptr_address.h"
 #include "omaha/base/utils.h"
 #include "omaha/crashhandler/crash_analyzer_checks.h"
@@ -26,6 +27,62 @@
 
 namespace omaha {
 
+namespace internal {
+
+BYTE* FindContainingRegion(const MemoryMap& regions, BYTE* ptr) {
+  MemoryMap::const_iterator it = regions.upper_bound(ptr);
+  if (it == regions.begin()) {
+    return NULL;
+  }
+  --it;
+  if (ptr < (*it).first + (*it).second.RegionSize) {
+    return (*it).first;
+  }
+
+  // The address is outside of the closest mapping and therefore bad.
+  return NULL;
+}
+
+size_t ScanBufferForPointers(const BYTE* buffer,
+                             size_t size,
+                             const std::vector<BYTE*>& patterns,
+                             std::vector<size_t>* matches) {
+  ASSERT1(buffer || !size);
+  ASSERT1(matches);
+
+  matches->assign(patterns.size(), 0);
+  if (patterns.empty() || size < sizeof(BYTE*)) {
+    return 0;
+  }
+
+  // The values are little-endian, so the byte at an offset is the lowest byte
+  // of the value read at that offset. Most offsets are rejected by looking up
+  // that byte before any of the patterns is compared.
+  bool is_low_byte[256] = {false};
+  for (size_t p = 0; p != patterns.size(); ++p) {
+    is_low_byte[reinterpret_cast<UINT_PTR>(patterns[p]) & 0xFF] = true;
+  }
+
+  size_t total_matches = 0;
+  const size_t last_offset = size - sizeof(BYTE*);
+  for (size_t i = 0; i <= last_offset; ++i) {
+    if (!is_low_byte[buffer[i]]) {
+      continue;
+    }
+    BYTE* value = NULL;
+    memcpy(&value, buffer + i, sizeof(value));
+    for (size_t p = 0; p != patterns.size(); ++p) {
+      if (value == patterns[p]) {
+        ++(*matches)[p];
+        ++total_matches;
+      }
+    }
+  }
+  return total_matches;
+}
+
+}  // namespace internal
+
 GPA_WRAP(psapi.dll,
          GetMappedFileNameA,
          (HANDLE process, LPVOID address, LPCSTR filename, DWORD size),
@@ -209,28 +266,7 @@ bool CrashAnalyzer::ReadMemorySegment(BYTE* ptr,
 }
 
 BYTE* CrashAnalyzer::FindContainingMemorySegment(BYTE* ptr) const {
-  SYSTEM_INFO system_info = {0};
-  ::GetSystemInfo(&system_info);
-  UINT_PTR page_size = system_info.dwPageSize;
-  for (UINT_PTR guess = reinterpret_cast<UINT_PTR>(ptr) &
-           ~(page_size - 1);
-       guess != 0;
-       guess -= system_info.dwPageSize) {
-    BYTE* guess_addr = reinterpret_cast<BYTE*>(guess);
-    MemoryMap::const_iterator mem_it = memory_regions_.find(guess_addr);
-    if (mem_it == memory_regions_.end()) {
-      continue;
-    }
-    const MEMORY_BASIC_INFORMATION mbi = (*mem_it).second;
-    if (guess_addr + mbi.RegionSize > ptr) {
-      return guess_addr;
-    }
-    // The address is outside of the closest mapping and therefore bad.
-    break;
-  }
-  // We either reached 0x0 without finding a mapped segment or the address
-  // is not mapped.
-  return 0;
+  return internal::FindContainingRegion(memory_regions_, ptr);
 }
 
 BYTE* CrashAnalyzer::GetThreadStack(BYTE* ptr) const {
@@ -238,7 +274,7 @@ BYTE* CrashAnalyzer::GetThreadStack(BYTE* ptr) const {
   if (thread_it == thread_contexts_.end()) {
     return 0;
   }
-  const ThreadInfo thread = (*thread_it).second;
+  const ThreadInfo& thread = (*thread_it).second;
 #ifdef _WIN64
   UINT_PTR stack_address = thread.context.Rsp;
 #else
@@ -248,19 +284,24 @@ BYTE* CrashAnalyzer::GetThreadStack(BYTE* ptr) const {
 }
 
 size_t CrashAnalyzer::ScanSegmentForPointer(BYTE* ptr, BYTE* pattern) {
+  std::vector<BYTE*> patterns(1, pattern);
+  std::vector<size_t> matches;
+  return ScanSegmentForPointers(ptr, patterns, &matches);
+}
+
+size_t CrashAnalyzer::ScanSegmentForPointers(
+    BYTE* ptr,
+    const std::vector<BYTE*>& patterns,
+    std::vector<size_t>* matches) {
+  ASSERT1(matches);
+  matches->assign(patterns.size(), 0);
+
   BYTE* buffer = 0;
   size_t size = 0;
   if (!ReadMemorySegment(ptr, &buffer, &size)) {
     return 0;
   }
-  size_t matches = 0;
-  for (size_t i = 0; i != size; ++i) {
-    BYTE** cmp = reinterpret_cast<BYTE**>(&buffer[i]);
-    if (*cmp == pattern) {
-      ++matches;
-    }
-  }
-  return matches;
+  return internal::ScanBufferForPointers(buffer, size, patterns, matches);
 }
 
 void CrashAnalyzer::AddCommentToUserStreams(const CStringA& text) {
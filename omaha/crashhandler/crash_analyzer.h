@@ -116,6 +116,24 @@ typedef std::map<BYTE*, ThreadInfo> ThreadMap;
 // Map for caching memory segments read from the debugee.
 typedef std::map<BYTE*, BYTE*> MemoryCache;
 
+namespace internal {
+
+// Returns the base address of the region in 'regions' which contains 'ptr' or
+// NULL if 'ptr' is not mapped. The regions do not overlap so the containing
+// region, if any, is the one with the highest base address not above 'ptr'.
+BYTE* FindContainingRegion(const MemoryMap& regions, BYTE* ptr);
+
+// Counts the pointer-sized values equal to each of 'patterns', at every byte
+// offset of the buffer, in a single pass over the buffer. 'matches' receives
+// the count for each pattern, in the order of the patterns. Returns the total
+// number of matches.
+size_t ScanBufferForPointers(const BYTE* buffer,
+                             size_t size,
+                             const std::vector<BYTE*>& patterns,
+                             std::vector<size_t>* matches);
+
+}  // namespace internal
+
 class CrashAnalyzer {
  public:
   explicit CrashAnalyzer(const google_breakpad::ClientInfo& client_info);
@@ -129,6 +147,9 @@ class CrashAnalyzer {
   BYTE* FindContainingMemorySegment(BYTE* ptr) const;
   BYTE* GetThreadStack(BYTE* ptr) const;
   size_t ScanSegmentForPointer(BYTE* ptr, BYTE* pattern);
+  size_t ScanSegmentForPointers(BYTE* ptr,
+                                const std::vector<BYTE*>& patterns,
+                                std::vector<size_t>* matches);
   bool ReadExceptionContext(CONTEXT* context) const;
   bool ReadExceptionRecord(EXCEPTION_RECORD* exception_record) const;
 
@@ -138,9 +159,9 @@ class CrashAnalyzer {
                            size_t user_stream_array_size);
 
   size_t exec_pages() const { return exec_pages_; }
-  MemoryMap memory_regions() const { return memory_regions_; }
-  ModuleMap modules() const { return modules_; }
-  ThreadMap thread_contexts() const { return thread_contexts_; }
+  const MemoryMap& memory_regions() const { return memory_regions_; }
+  const ModuleMap& modules() const { return modules_; }
+  const ThreadMap& thread_contexts() const { return thread_contexts_; }
   const google_breakpad::ClientInfo& client_info() const {
     return client_info_;
   }
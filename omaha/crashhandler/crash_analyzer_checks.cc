@@ -42,7 +42,7 @@ WildStackPointer::WildStackPointer(CrashAnalyzer* analyzer)
     : CrashAnalyzerCheck(analyzer) {}
 
 CrashAnalysisResult WildStackPointer::Run() {
-  const ThreadMap contexts = analyzer_.thread_contexts();
+  const ThreadMap& contexts = analyzer_.thread_contexts();
   for (ThreadMap::const_iterator thread_it = contexts.begin();
        thread_it != contexts.end();
        ++thread_it) {
@@ -114,7 +114,7 @@ CrashAnalysisResult NtFunctionsOnStack::Run() {
   functions.push_back(reinterpret_cast<BYTE*>(
       ::GetProcAddress(ntdll, "ZwWriteVirtualMemory")));
 
-  const ThreadMap contexts = analyzer_.thread_contexts();
+  const ThreadMap& contexts = analyzer_.thread_contexts();
   for (ThreadMap::const_iterator i = contexts.begin();
        i != contexts.end();
        ++i) {
@@ -123,8 +123,14 @@ CrashAnalysisResult NtFunctionsOnStack::Run() {
     if (!stack_segment) {
       continue;
     }
+    std::vector<size_t> matches;
+    if (!analyzer_.ScanSegmentForPointers(stack_segment,
+                                          functions,
+                                          &matches)) {
+      continue;
+    }
     for (size_t p = 0; p != functions.size(); ++p) {
-      if (analyzer_.ScanSegmentForPointer(stack_segment, functions[p])) {
+      if (matches[p]) {
         const BYTE* func_ptr = functions[p];
         CStringA context;
         SafeCStringAFormat(
@@ -149,8 +155,8 @@ CrashAnalysisResult PENotInModuleList::Run() {
   SYSTEM_INFO system_info = {0};
   ::GetSystemInfo(&system_info);
   const size_t page_size = system_info.dwPageSize;
-  const MemoryMap map = analyzer_.memory_regions();
-  const ModuleMap modules = analyzer_.modules();
+  const MemoryMap& map = analyzer_.memory_regions();
+  const ModuleMap& modules = analyzer_.modules();
   for (MemoryMap::const_iterator it = map.begin();
        it != map.end();
        ++it) {
@@ -249,8 +255,8 @@ CrashAnalysisResult ShellcodeSprayPattern::Run() {
   SYSTEM_INFO system_info = {0};
   ::GetSystemInfo(&system_info);
   const size_t page_size = system_info.dwPageSize;
-  const MemoryMap map = analyzer_.memory_regions();
-  const ModuleMap modules = analyzer_.modules();
+  const MemoryMap& map = analyzer_.memory_regions();
+  const ModuleMap& modules = analyzer_.modules();
   for (MemoryMap::const_iterator it = map.begin();
        it != map.end();
        ++it) {
@@ -299,7 +305,7 @@ CrashAnalysisResult ShellcodeSprayPattern::Run() {
 
 bool ShellcodeSprayPattern::SampleSegmentForRepeatedPatterns(
     BYTE* ptr,
-    const std::vector<BYTE> patterns) const {
+    const std::vector<BYTE>& patterns) const {
   BYTE* buffer;
   size_t size = 0;
   if (!analyzer_.ReadMemorySegment(ptr, &buffer, &size)) {
@@ -414,7 +420,7 @@ CrashAnalysisResult ShellcodeJmpCallPop::Run() {
   const size_t offset =
       reinterpret_cast<BYTE*>(record.ExceptionAddress) - segment_base;
 
-  const ModuleMap modules = analyzer_.modules();
+  const ModuleMap& modules = analyzer_.modules();
   if (modules.find(segment_base) != modules.end()) {
     return ANALYSIS_NORMAL;
   }
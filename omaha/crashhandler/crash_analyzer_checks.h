@@ -73,7 +73,7 @@ class ShellcodeSprayPattern : public CrashAnalyzerCheck {
  private:
   bool SampleSegmentForRepeatedPatterns(
       BYTE* ptr,
-      const std::vector<BYTE> patterns) const;
+      const std::vector<BYTE>& patterns) const;
 
   static const BYTE kOverlapingInstructions[];
   static const size_t kNumSamples;
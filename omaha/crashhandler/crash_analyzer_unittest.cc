@@ -59,6 +59,90 @@ void CleanupCrashAnalyzer(CrashAnalyzer* analyzer) {
   delete analyzer;
 }
 
+namespace {
+
+void AddRegion(UINT_PTR base, size_t size, MemoryMap* regions) {
+  MEMORY_BASIC_INFORMATION mbi = {0};
+  mbi.BaseAddress = reinterpret_cast<PVOID>(base);
+  mbi.RegionSize = size;
+  mbi.State = MEM_COMMIT;
+  (*regions)[reinterpret_cast<BYTE*>(base)] = mbi;
+}
+
+BYTE* ToPtr(UINT_PTR address) {
+  return reinterpret_cast<BYTE*>(address);
+}
+
+}  // namespace
+
+TEST(CrashAnalyzerTest, FindContainingRegion) {
+  MemoryMap regions;
+  EXPECT_TRUE(NULL == internal::FindContainingRegion(regions, ToPtr(0x1000)));
+
+  AddRegion(0x10000, 0x3000, &regions);
+  AddRegion(0x20000, 0x1000, &regions);
+  AddRegion(0x21000, 0x1000, &regions);
+
+  EXPECT_TRUE(NULL == internal::FindContainingRegion(regions, ToPtr(0x1000)));
+  EXPECT_EQ(ToPtr(0x10000),
+            internal::FindContainingRegion(regions, ToPtr(0x10000)));
+  EXPECT_EQ(ToPtr(0x10000),
+            internal::FindContainingRegion(regions, ToPtr(0x12fff)));
+  EXPECT_TRUE(NULL == internal::FindContainingRegion(regions, ToPtr(0x13000)));
+  EXPECT_TRUE(NULL == internal::FindContainingRegion(regions, ToPtr(0x1ffff)));
+  EXPECT_EQ(ToPtr(0x20000),
+            internal::FindContainingRegion(regions, ToPtr(0x20fff)));
+  EXPECT_EQ(ToPtr(0x21000),
+            internal::FindContainingRegion(regions, ToPtr(0x21000)));
+  EXPECT_TRUE(NULL == internal::FindContainingRegion(regions, ToPtr(0x22000)));
+}
+
+TEST(CrashAnalyzerTest, ScanBufferForPointers) {
+  std::vector<BYTE*> patterns;
+  patterns.push_back(ToPtr(0x77001234));
+  patterns.push_back(ToPtr(0x77005678));
+  patterns.push_back(ToPtr(0x12345678));
+
+  // The second pattern appears at an unaligned offset and at the very end of
+  // the buffer. The third pattern does not appear.
+  std::vector<BYTE> buffer(64, 0x34);
+  BYTE* pattern = patterns[0];
+  memcpy(&buffer[0], &pattern, sizeof(pattern));
+  memcpy(&buffer[24], &pattern, sizeof(pattern));
+  pattern = patterns[1];
+  memcpy(&buffer[9], &pattern, sizeof(pattern));
+  memcpy(&buffer[buffer.size() - sizeof(pattern)], &pattern, sizeof(pattern));
+
+  std::vector<size_t> matches;
+  EXPECT_EQ(4, internal::ScanBufferForPointers(&buffer.front(),
+                                               buffer.size(),
+                                               patterns,
+                                               &matches));
+  ASSERT_EQ(3, matches.size());
+  EXPECT_EQ(2, matches[0]);
+  EXPECT_EQ(2, matches[1]);
+  EXPECT_EQ(0, matches[2]);
+
+  // The scan does not read past the end of the buffer.
+  EXPECT_EQ(3, internal::ScanBufferForPointers(&buffer.front(),
+                                               buffer.size() - 1,
+                                               patterns,
+                                               &matches));
+  EXPECT_EQ(1, matches[1]);
+
+  EXPECT_EQ(0, internal::ScanBufferForPointers(&buffer.front(),
+                                               sizeof(BYTE*) - 1,
+                                               patterns,
+                                               &matches));
+  EXPECT_EQ(3, matches.size());
+
+  EXPECT_EQ(0, internal::ScanBufferForPointers(&buffer.front(),
+                                               buffer.size(),
+                                               std::vector<BYTE*>(),
+                                               &matches));
+  EXPECT_TRUE(matches.empty());
+}
+
 TEST(CrashAnalyzerTest, Normal) {
   CrashAnalyzer* analyzer = InitializeCrashAnalyzer(L"Normal");
   EXPECT_EQ(ANALYSIS_NORMAL, analyzer->Analyze());
@@ -93,14 +93,14 @@ App::~App() {
 }
 
 STDMETHODIMP App::get_appId(BSTR* app_id) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(app_id);
   *app_id = GuidToString(app_guid_).AllocSysString();
   return S_OK;
 }
 
 STDMETHODIMP App::get_language(BSTR* language) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(language);
   *language = language_.AllocSysString();
   return S_OK;
@@ -113,7 +113,7 @@ STDMETHODIMP App::put_language(BSTR language) {
 }
 
 STDMETHODIMP App::get_ap(BSTR* ap) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(ap);
   *ap = ap_.AllocSysString();
   return S_OK;
@@ -126,7 +126,7 @@ STDMETHODIMP App::put_ap(BSTR ap) {
 }
 
 STDMETHODIMP App::get_pv(BSTR* pv) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(pv);
   *pv = pv_.AllocSysString();
   return S_OK;
@@ -139,7 +139,7 @@ STDMETHODIMP App::put_pv(BSTR pv) {
 }
 
 STDMETHODIMP App::get_ttToken(BSTR* tt_token) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(tt_token);
   *tt_token = tt_token_.AllocSysString();
   return S_OK;
@@ -152,7 +152,7 @@ STDMETHODIMP App::put_ttToken(BSTR tt_token) {
 }
 
 STDMETHODIMP App::get_iid(BSTR* iid) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(iid);
   *iid = GuidToString(iid_).AllocSysString();
   return S_OK;
@@ -164,7 +164,7 @@ STDMETHODIMP App::put_iid(BSTR iid) {
 }
 
 STDMETHODIMP App::get_brandCode(BSTR* brand_code) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(brand_code);
   *brand_code = brand_code_.AllocSysString();
   return S_OK;
@@ -177,7 +177,7 @@ STDMETHODIMP App::put_brandCode(BSTR brand_code) {
 }
 
 STDMETHODIMP App::get_clientId(BSTR* client_id) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(client_id);
   *client_id = client_id_.AllocSysString();
   return S_OK;
@@ -190,7 +190,7 @@ STDMETHODIMP App::put_clientId(BSTR client_id) {
 }
 
 STDMETHODIMP App::get_labels(BSTR* labels) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(labels);
   *labels = GetExperimentLabels().AllocSysString();
   return S_OK;
@@ -204,7 +204,7 @@ STDMETHODIMP App::put_labels(BSTR labels) {
 }
 
 STDMETHODIMP App::get_referralId(BSTR* referral_id) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(referral_id);
   *referral_id = referral_id_.AllocSysString();
   return S_OK;
@@ -217,14 +217,14 @@ STDMETHODIMP App::put_referralId(BSTR referral_id) {
 }
 
 STDMETHODIMP App::get_installTimeDiffSec(UINT* install_time_diff_sec) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(install_time_diff_sec);
   *install_time_diff_sec = install_time_diff_sec_;
   return S_OK;
 }
 
 STDMETHODIMP App::get_isEulaAccepted(VARIANT_BOOL* is_eula_accepted) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(is_eula_accepted);
   *is_eula_accepted = App::is_eula_accepted() ? VARIANT_TRUE : VARIANT_FALSE;
   return S_OK;
@@ -237,7 +237,7 @@ STDMETHODIMP App::put_isEulaAccepted(VARIANT_BOOL is_eula_accepted) {
 }
 
 STDMETHODIMP App::get_displayName(BSTR* display_name) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(display_name);
   *display_name = display_name_.AllocSysString();
   return S_OK;
@@ -250,7 +250,7 @@ STDMETHODIMP App::put_displayName(BSTR display_name) {
 }
 
 STDMETHODIMP App::get_browserType(UINT* browser_type) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(browser_type);
   *browser_type = browser_type_;
   return S_OK;
@@ -266,7 +266,7 @@ STDMETHODIMP App::put_browserType(UINT browser_type) {
 }
 
 STDMETHODIMP App::get_clientInstallData(BSTR* data) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(data);
   *data = client_install_data_.AllocSysString();
   return S_OK;
@@ -279,7 +279,7 @@ STDMETHODIMP App::put_clientInstallData(BSTR data) {
 }
 
 STDMETHODIMP App::get_serverInstallDataIndex(BSTR* index) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(index);
   *index = server_install_data_index_.AllocSysString();
   return S_OK;
@@ -292,7 +292,7 @@ STDMETHODIMP App::put_serverInstallDataIndex(BSTR index) {
 }
 
 STDMETHODIMP App::get_usageStatsEnable(UINT* usage_stats_enable) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(usage_stats_enable);
   *usage_stats_enable = usage_stats_enable_;
   return S_OK;
@@ -310,7 +310,7 @@ STDMETHODIMP App::put_usageStatsEnable(UINT usage_stats_enable) {
 // TODO(omaha3): Replace decisions based on state() with calls to AppState.
 // In this case, there should be a GetCurrentState() method on AppState.
 STDMETHODIMP App::get_currentState(IDispatch** current_state) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
 
   CORE_LOG(L6, (_T("[App::get_currentState][0x%p]"), this));
   ASSERT1(current_state);
@@ -432,7 +432,7 @@ STDMETHODIMP App::get_currentState(IDispatch** current_state) {
 }
 
 STDMETHODIMP App::get_untrustedData(BSTR* data) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(data);
   *data = untrusted_data_.AllocSysString();
   return S_OK;
@@ -455,7 +455,7 @@ HRESULT App::GetDownloadProgress(uint64* bytes_downloaded,
                                  uint64* bytes_total,
                                  LONG* time_remaining_ms,
                                  uint64* next_retry_time) {
-  ASSERT1(model()->IsLockedByCaller());
+  ASSERT1(model()->IsLockedSharedByCaller());
 
   ASSERT1(bytes_downloaded);
   ASSERT1(bytes_total);
@@ -498,14 +498,19 @@ HRESULT App::GetDownloadProgress(uint64* bytes_downloaded,
 
   ASSERT1(previous_total_download_bytes_ == *bytes_total ||
           previous_total_download_bytes_ == 0);
-  previous_total_download_bytes_ = *bytes_total;
+
+  // Concurrent readers only check the previous total, since they are not
+  // allowed to modify the model.
+  if (model()->IsLockedByCaller()) {
+    previous_total_download_bytes_ = *bytes_total;
+  }
 
   return S_OK;
 }
 
 HRESULT App::GetInstallProgress(LONG* install_progress_percentage,
                                 LONG* install_time_remaining_ms) {
-  ASSERT1(model()->IsLockedByCaller());
+  ASSERT1(model()->IsLockedSharedByCaller());
 
   ASSERT1(install_progress_percentage);
   ASSERT1(install_time_remaining_ms);
@@ -539,32 +544,32 @@ HRESULT App::GetInstallProgress(LONG* install_progress_percentage,
 }
 
 AppBundle* App::app_bundle() {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return app_bundle_;
 }
 
 const AppBundle* App::app_bundle() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return app_bundle_;
 }
 
 AppVersion* App::current_version() {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return current_version_.get();
 }
 
 const AppVersion* App::current_version() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return current_version_.get();
 }
 
 AppVersion* App::next_version() {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return next_version_.get();
 }
 
 const AppVersion* App::next_version() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return next_version_.get();
 }
 
@@ -591,8 +596,13 @@ CString App::app_guid_string() const {
   return GuidToString(app_guid());
 }
 
+CString App::span_id() const {
+  __mutexScope(model()->shared_lock());
+  return app_bundle_->session_id() + _T("/") + app_guid_string();
+}
+
 GUID App::app_guid() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return app_guid_;
 }
 
@@ -602,22 +612,22 @@ void App::set_app_guid(const GUID& app_guid) {
 }
 
 CString App::language() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return language_;
 }
 
 bool App::is_eula_accepted() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return is_eula_accepted_ == TRISTATE_TRUE;
 }
 
 CString App::display_name() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return display_name_;
 }
 
 CurrentState App::state() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return app_state_->state();
 }
 
@@ -653,13 +663,13 @@ CString App::client_id() const {
 }
 
 CString App::GetExperimentLabels() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return ExperimentLabels::ReadRegistry(app_bundle_->is_machine(),
                                         app_guid_string());
 }
 
 CString App::GetExperimentLabelsNoTimestamps() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return ExperimentLabels::RemoveTimestamps(GetExperimentLabels());
 }
 
@@ -783,6 +793,16 @@ CString App::tt_token() const {
   return tt_token_;
 }
 
+CString App::state_token() const {
+  __mutexScope(model()->lock());
+  return state_token_;
+}
+
+void App::set_state_token(const CString& state_token) {
+  __mutexScope(model()->lock());
+  state_token_ = state_token;
+}
+
 Cohort App::cohort() const {
   __mutexScope(model()->lock());
   return cohort_;
@@ -804,7 +824,7 @@ CString App::untrusted_data() const {
 }
 
 HRESULT App::error_code() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return error_context_.error_code;
 }
 
@@ -829,12 +849,12 @@ const PingEventVector& App::ping_events() const {
 }
 
 AppVersion* App::working_version() {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return working_version_;
 }
 
 const AppVersion* App::working_version() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return working_version_;
 }
 
@@ -1131,6 +1151,8 @@ void App::ChangeState(fsm::AppState* app_state) {
   if (ping_event.get()) {
     AddPingEvent(ping_event);
   }
+
+  app_bundle_->NotifyProgress();
 }
 
 void App::SetError(const ErrorContext& error_context, const CString& message) {
@@ -1255,12 +1277,12 @@ STDMETHODIMP AppWrapper::get_command(BSTR command_id, IDispatch** command) {
 
 // IApp.
 STDMETHODIMP AppWrapper::get_appId(BSTR* app_id) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_appId(app_id);
 }
 
 STDMETHODIMP AppWrapper::get_pv(BSTR* pv) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_pv(pv);
 }
 
@@ -1270,7 +1292,7 @@ STDMETHODIMP AppWrapper::put_pv(BSTR pv) {
 }
 
 STDMETHODIMP AppWrapper::get_language(BSTR* language) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_language(language);
 }
 
@@ -1280,7 +1302,7 @@ STDMETHODIMP AppWrapper::put_language(BSTR language) {
 }
 
 STDMETHODIMP AppWrapper::get_ap(BSTR* ap) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_ap(ap);
 }
 
@@ -1290,7 +1312,7 @@ STDMETHODIMP AppWrapper::put_ap(BSTR ap) {
 }
 
 STDMETHODIMP AppWrapper::get_ttToken(BSTR* tt_token) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_ttToken(tt_token);
 }
 
@@ -1300,7 +1322,7 @@ STDMETHODIMP AppWrapper::put_ttToken(BSTR tt_token) {
 }
 
 STDMETHODIMP AppWrapper::get_iid(BSTR* iid) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_iid(iid);
 }
 
@@ -1310,7 +1332,7 @@ STDMETHODIMP AppWrapper::put_iid(BSTR iid) {
 }
 
 STDMETHODIMP AppWrapper::get_brandCode(BSTR* brand_code) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_brandCode(brand_code);
 }
 
@@ -1320,7 +1342,7 @@ STDMETHODIMP AppWrapper::put_brandCode(BSTR brand_code) {
 }
 
 STDMETHODIMP AppWrapper::get_clientId(BSTR* client_id) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_clientId(client_id);
 }
 
@@ -1330,7 +1352,7 @@ STDMETHODIMP AppWrapper::put_clientId(BSTR client_id) {
 }
 
 STDMETHODIMP AppWrapper::get_labels(BSTR* labels) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_labels(labels);
 }
 
@@ -1340,7 +1362,7 @@ STDMETHODIMP AppWrapper::put_labels(BSTR labels) {
 }
 
 STDMETHODIMP AppWrapper::get_referralId(BSTR* referral_id) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_referralId(referral_id);
 }
 
@@ -1350,12 +1372,12 @@ STDMETHODIMP AppWrapper::put_referralId(BSTR referral_id) {
 }
 
 STDMETHODIMP AppWrapper::get_installTimeDiffSec(UINT* install_time_diff_sec) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_installTimeDiffSec(install_time_diff_sec);
 }
 
 STDMETHODIMP AppWrapper::get_isEulaAccepted(VARIANT_BOOL* is_eula_accepted) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_isEulaAccepted(is_eula_accepted);
 }
 
@@ -1365,7 +1387,7 @@ STDMETHODIMP AppWrapper::put_isEulaAccepted(VARIANT_BOOL is_eula_accepted) {
 }
 
 STDMETHODIMP AppWrapper::get_displayName(BSTR* display_name) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_displayName(display_name);
 }
 
@@ -1375,7 +1397,7 @@ STDMETHODIMP AppWrapper::put_displayName(BSTR display_name) {
 }
 
 STDMETHODIMP AppWrapper::get_browserType(UINT* browser_type) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_browserType(browser_type);
 }
 
@@ -1385,7 +1407,7 @@ STDMETHODIMP AppWrapper::put_browserType(UINT browser_type) {
 }
 
 STDMETHODIMP AppWrapper::get_clientInstallData(BSTR* data) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_clientInstallData(data);
 }
 
@@ -1395,7 +1417,7 @@ STDMETHODIMP AppWrapper::put_clientInstallData(BSTR data) {
 }
 
 STDMETHODIMP AppWrapper::get_serverInstallDataIndex(BSTR* index) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_serverInstallDataIndex(index);
 }
 
@@ -1405,7 +1427,7 @@ STDMETHODIMP AppWrapper::put_serverInstallDataIndex(BSTR index) {
 }
 
 STDMETHODIMP AppWrapper::get_untrustedData(BSTR* data) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_untrustedData(data);
 }
 
@@ -1415,7 +1437,7 @@ STDMETHODIMP AppWrapper::put_untrustedData(BSTR data) {
 }
 
 STDMETHODIMP AppWrapper::get_usageStatsEnable(UINT* usage_stats_enable) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_usageStatsEnable(usage_stats_enable);
 }
 
@@ -1425,7 +1447,7 @@ STDMETHODIMP AppWrapper::put_usageStatsEnable(UINT usage_stats_enable) {
 }
 
 STDMETHODIMP AppWrapper::get_currentState(IDispatch** current_state_disp) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_currentState(current_state_disp);
 }
 
@@ -93,6 +93,11 @@ class App : public ModelObject {
 
   CString app_guid_string() const;
 
+  // Returns the id of the trace spans of the app, which is the session id of
+  // the bundle followed by the app guid. The spans of the bundle use the
+  // session id alone, which is a prefix of the ids of all its apps.
+  CString span_id() const;
+
   // TODO(omaha): refactor so that the app guid setter is only used by tests.
   GUID app_guid() const;
   void set_app_guid(const GUID& app_guid);
@@ -164,6 +169,9 @@ class App : public ModelObject {
 
   CString tt_token() const;
 
+  CString state_token() const;
+  void set_state_token(const CString& state_token);
+
   Cohort cohort() const;
   void set_cohort(const Cohort& cohort);
 
@@ -437,6 +445,7 @@ class App : public ModelObject {
   std::vector<StringPair> app_defined_attributes_;
   CString ap_;
   CString tt_token_;
+  CString state_token_;
   Cohort cohort_;
   GUID iid_;
   CString brand_code_;
@@ -21,10 +21,12 @@
 #include "omaha/base/logging.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/scoped_impersonation.h"
+#include "omaha/base/scoped_ptr_address.h"
 #include "omaha/base/thread_pool_callback.h"
 #include "omaha/base/user_rights.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
+#include "omaha/common/goopdate_utils.h"
 #include "omaha/common/lang.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
@@ -167,7 +169,7 @@ HRESULT AppBundle::CaptureCallerPrimaryToken() {
 }
 
 size_t AppBundle::GetNumberOfApps() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return apps_.size();
 }
 
@@ -259,6 +261,8 @@ HRESULT AppBundle::SendPingEventsAsync() {
                               ping.get(),
                               token.GetHandle(),
                               &send_ping_events_gate)));
+  // The caller blocks until the work item starts.
+  callback->set_priority(UserWorkItem::kPriorityUrgent);
   HRESULT hr = Goopdate::Instance().QueueUserWorkItem(callback.get(),
                                                       COINIT_MULTITHREADED,
                                                       WT_EXECUTELONGFUNCTION);
@@ -296,7 +300,7 @@ void AppBundle::SendPingEvents(internal::SendPingEventsParameters params) {
 // IAppBundle.
 STDMETHODIMP AppBundle::get_displayName(BSTR* display_name) {
   ASSERT1(display_name);
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   *display_name = display_name_.AllocSysString();
   return S_OK;
 }
@@ -309,7 +313,7 @@ STDMETHODIMP AppBundle::put_displayName(BSTR display_name) {
 
 STDMETHODIMP AppBundle::get_installSource(BSTR* install_source) {
   ASSERT1(install_source);
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   *install_source = install_source_.AllocSysString();
   return S_OK;
 }
@@ -322,7 +326,7 @@ STDMETHODIMP AppBundle::put_installSource(BSTR install_source) {
 
 STDMETHODIMP AppBundle::get_originURL(BSTR* origin_url) {
   ASSERT1(origin_url);
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   *origin_url = origin_url_.AllocSysString();
   return S_OK;
 }
@@ -335,7 +339,7 @@ STDMETHODIMP AppBundle::put_originURL(BSTR origin_url) {
 
 STDMETHODIMP AppBundle::get_offlineDirectory(BSTR* offline_dir) {
   ASSERT1(offline_dir);
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   *offline_dir = offline_dir_.AllocSysString();
   return S_OK;
 }
@@ -349,7 +353,7 @@ STDMETHODIMP AppBundle::put_offlineDirectory(BSTR offline_dir) {
 
 STDMETHODIMP AppBundle::get_sessionId(BSTR* session_id) {
   ASSERT1(session_id);
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   *session_id = session_id_.AllocSysString();
   return S_OK;
 }
@@ -362,7 +366,7 @@ STDMETHODIMP AppBundle::put_sessionId(BSTR session_id) {
 
 STDMETHODIMP AppBundle::get_sendPings(VARIANT_BOOL* send_pings) {
   ASSERT1(send_pings);
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   *send_pings = send_pings_ ? VARIANT_TRUE : VARIANT_FALSE;
   return S_OK;
 }
@@ -377,7 +381,7 @@ STDMETHODIMP AppBundle::put_sendPings(VARIANT_BOOL send_pings) {
 
 STDMETHODIMP AppBundle::get_priority(long* priority) {  // NOLINT
   ASSERT1(priority);
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   *priority = priority_;
   return S_OK;
 }
@@ -421,7 +425,7 @@ CString AppBundle::display_language() const {
 
 STDMETHODIMP AppBundle::get_displayLanguage(BSTR* language) {
   ASSERT1(language);
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   *language = display_language_.AllocSysString();
   return S_OK;
 }
@@ -441,7 +445,7 @@ STDMETHODIMP AppBundle::put_displayLanguage(BSTR language) {
 }
 
 bool AppBundle::is_machine() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return is_machine_;
 }
 
@@ -466,7 +470,7 @@ const CString& AppBundle::offline_dir() const {
 }
 
 const CString& AppBundle::session_id() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return session_id_;
 }
 
@@ -494,7 +498,16 @@ STDMETHODIMP AppBundle::initialize() {
           alt_tokens_set ||
           !UserRights::VerifyCallerIsSystem());
 
-  return app_bundle_state_->Initialize(this);
+  HRESULT hr = app_bundle_state_->Initialize(this);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  hr = CreateProgressEvent();
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[CreateProgressEvent failed][0x%08x]"), hr));
+  }
+  return S_OK;
 }
 
 // App is created with is_update=false because the caller is not using
@@ -551,7 +564,7 @@ STDMETHODIMP AppBundle::createAllInstalledApps() {
 STDMETHODIMP AppBundle::get_Count(long* count) {  // NOLINT
   ASSERT1(count);
 
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
 
   const size_t num_apps = apps_.size();
   if (num_apps > LONG_MAX) {
@@ -582,6 +595,33 @@ WebServicesClientInterface* AppBundle::update_check_client() {
   return update_check_client_.get();
 }
 
+void AppBundle::CancelUpdateCheck() {
+  __mutexScope(model()->lock());
+
+  if (update_check_client_.get()) {
+    update_check_client_->Cancel();
+  }
+  if (update_check_cancel_event_) {
+    VERIFY1(::SetEvent(get(update_check_cancel_event_)));
+  }
+}
+
+HANDLE AppBundle::update_check_cancel_event() {
+  __mutexScope(model()->lock());
+  return get(update_check_cancel_event_);
+}
+
+WebServicesClientResult AppBundle::update_check_result() {
+  __mutexScope(model()->lock());
+  return update_check_result_;
+}
+
+void AppBundle::set_update_check_result(
+    const WebServicesClientResult& result) {
+  __mutexScope(model()->lock());
+  update_check_result_ = result;
+}
+
 STDMETHODIMP AppBundle::checkForUpdate() {
   CORE_LOG(L1, (_T("[AppBundle::checkForUpdate][0x%p]"), this));
 
@@ -678,7 +718,7 @@ STDMETHODIMP AppBundle::isBusy(VARIANT_BOOL* is_busy) {
   CORE_LOG(L3, (_T("[AppBundle::isBusy][0x%p]"), this));
   ASSERT1(is_busy);
 
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
 
   *is_busy = IsBusy() ? VARIANT_TRUE : VARIANT_FALSE;
   return S_OK;
@@ -752,8 +792,16 @@ void AppBundle::CompleteAsyncCall() {
   user_work_item_ = NULL;
 }
 
-bool AppBundle::IsBusy() const {
+void AppBundle::CancelAsyncCall() {
   __mutexScope(model()->lock());
+
+  if (user_work_item_) {
+    user_work_item_->Cancel();
+  }
+}
+
+bool AppBundle::IsBusy() const {
+  __mutexScope(model()->shared_lock());
   const bool is_busy = app_bundle_state_->IsBusy();
   CORE_LOG(L3, (_T("[AppBundle::isBusy returned][0x%p][%u]"), this, is_busy));
   return is_busy;
@@ -764,6 +812,26 @@ void AppBundle::ChangeState(fsm::AppBundleState* app_bundle_state) {
   ASSERT1(model()->IsLockedByCaller());
 
   app_bundle_state_.reset(app_bundle_state);
+  NotifyProgress();
+}
+
+HRESULT AppBundle::CreateProgressEvent() {
+  ASSERT1(model()->IsLockedByCaller());
+  ASSERT1(!session_id_.IsEmpty());
+
+  NamedObjectAttributes event_attr;
+  goopdate_utils::GetBundleProgressEventAttributes(session_id_,
+                                                   is_machine_,
+                                                   &event_attr);
+  return goopdate_utils::CreateEvent(&event_attr, address(progress_event_));
+}
+
+void AppBundle::NotifyProgress() {
+  ASSERT1(model()->IsLockedByCaller());
+
+  if (progress_event_) {
+    VERIFY1(::SetEvent(get(progress_event_)));
+  }
 }
 
 
@@ -784,7 +852,7 @@ AppBundleWrapper::~AppBundleWrapper() {
 //
 
 STDMETHODIMP AppBundleWrapper::get_displayName(BSTR* display_name) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_displayName(display_name);
 }
 
@@ -794,7 +862,7 @@ STDMETHODIMP AppBundleWrapper::put_displayName(BSTR display_name) {
 }
 
 STDMETHODIMP AppBundleWrapper::get_installSource(BSTR* install_source) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_installSource(install_source);
 }
 
@@ -804,7 +872,7 @@ STDMETHODIMP AppBundleWrapper::put_installSource(BSTR install_source) {
 }
 
 STDMETHODIMP AppBundleWrapper::get_originURL(BSTR* origin_url) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_originURL(origin_url);
 }
 
@@ -814,7 +882,7 @@ STDMETHODIMP AppBundleWrapper::put_originURL(BSTR origin_url) {
 }
 
 STDMETHODIMP AppBundleWrapper::get_offlineDirectory(BSTR* offline_dir) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_offlineDirectory(offline_dir);
 }
 
@@ -824,7 +892,7 @@ STDMETHODIMP AppBundleWrapper::put_offlineDirectory(BSTR offline_dir) {
 }
 
 STDMETHODIMP AppBundleWrapper::get_sessionId(BSTR* session_id) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_sessionId(session_id);
 }
 
@@ -834,7 +902,7 @@ STDMETHODIMP AppBundleWrapper::put_sessionId(BSTR session_id) {
 }
 
 STDMETHODIMP AppBundleWrapper::get_sendPings(VARIANT_BOOL* send_pings) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_sendPings(send_pings);
 }
 
@@ -844,7 +912,7 @@ STDMETHODIMP AppBundleWrapper::put_sendPings(VARIANT_BOOL send_pings) {
 }
 
 STDMETHODIMP AppBundleWrapper::get_priority(long* priority) {  // NOLINT
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_priority(priority);
 }
 
@@ -868,7 +936,7 @@ STDMETHODIMP AppBundleWrapper::put_parentHWND(ULONG_PTR hwnd) {
 }
 
 STDMETHODIMP AppBundleWrapper::get_displayLanguage(BSTR* language) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_displayLanguage(language);
 }
 STDMETHODIMP AppBundleWrapper::put_displayLanguage(BSTR language) {
@@ -912,7 +980,7 @@ STDMETHODIMP AppBundleWrapper::createAllInstalledApps() {
 }
 
 STDMETHODIMP AppBundleWrapper::get_Count(long* count) {  // NOLINT
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_Count(count);
 }
 
@@ -969,7 +1037,7 @@ STDMETHODIMP AppBundleWrapper::resume() {
 }
 
 STDMETHODIMP AppBundleWrapper::isBusy(VARIANT_BOOL* is_busy) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->isBusy(is_busy);
 }
 
@@ -979,7 +1047,7 @@ STDMETHODIMP AppBundleWrapper::downloadPackage(BSTR app_id, BSTR package_name) {
 }
 
 STDMETHODIMP AppBundleWrapper::get_currentState(VARIANT* current_state) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_currentState(current_state);
 }
 
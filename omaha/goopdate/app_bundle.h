@@ -31,6 +31,7 @@
 #include "omaha/base/scoped_any.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/common/ping.h"
+#include "omaha/common/web_services_client.h"
 #include "omaha/goopdate/com_wrapper_creator.h"
 #include "omaha/goopdate/model_object.h"
 #include "omaha/net/proxy_auth.h"
@@ -44,7 +45,6 @@ namespace omaha {
 
 class App;
 class Model;
-class WebServicesClientInterface;
 class UserWorkItem;
 
 namespace fsm {
@@ -130,6 +130,10 @@ class AppBundle
   // Marks an asynchronous operation complete.
   void CompleteAsyncCall();
 
+  // Cancels the work item of the pending asynchronous operation. The work
+  // item completes the operation without running it if it has not started.
+  void CancelAsyncCall();
+
   bool IsBusy() const;
 
   // Returns a shared pointer to this instance of the class under the
@@ -156,6 +160,19 @@ class AppBundle
 
   WebServicesClientInterface* update_check_client();
 
+  // Cancels the update check of the bundle, including the wait for the
+  // response of an identical update check sent by another bundle.
+  void CancelUpdateCheck();
+
+  // Signaled when the update check of the bundle is canceled.
+  HANDLE update_check_cancel_event();
+
+  // The outcome of the http transaction which produced the update response of
+  // the bundle. The transaction belongs to another bundle when the bundle
+  // shared the response of an identical update check.
+  WebServicesClientResult update_check_result();
+  void set_update_check_result(const WebServicesClientResult& result);
+
   bool is_machine() const;
 
   bool is_auto_update() const;
@@ -181,6 +198,10 @@ class AppBundle
   // in the registry.
   HRESULT BuildAndPersistPing();
 
+  // Signals the clients that the state of the bundle, or the state or the
+  // progress of one of its apps, has changed.
+  void NotifyProgress();
+
  private:
   // Sets the state for unit testing.
   friend void SetAppBundleStateForUnitTest(AppBundle* app_bundle,
@@ -201,6 +222,10 @@ class AppBundle
 
   void ChangeState(fsm::AppBundleState* app_bundle_state);
 
+  // Creates the event signaled by NotifyProgress(). Clients which can't open
+  // the event poll the bundle instead.
+  HRESULT CreateProgressEvent();
+
   bool is_pending_non_blocking_call() const;
 
   CString display_name_;
@@ -239,6 +264,8 @@ class AppBundle
   UserWorkItem* user_work_item_;
 
   scoped_ptr<WebServicesClientInterface> update_check_client_;
+  scoped_event update_check_cancel_event_;
+  WebServicesClientResult update_check_result_;
 
   // The apps in the bundle. Do not add to it directly; use AddApp() instead.
   std::vector<App*> apps_;
@@ -269,6 +296,10 @@ class AppBundle
   // COM caller's display language.
   CString display_language_;
 
+  // Signaled when the state or the progress of the bundle changes. The clients
+  // reset the event before they read the state of the bundle.
+  scoped_event progress_event_;
+
   friend class fsm::AppBundleState;
   friend class fsm::AppBundleStateInit;
 
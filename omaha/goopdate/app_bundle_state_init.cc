@@ -124,6 +124,14 @@ HRESULT AppBundleStateInit::Initialize(AppBundle* app_bundle) {
   }
   app_bundle->update_check_client_.reset(web_service_client.release());
 
+  reset(app_bundle->update_check_cancel_event_,
+        ::CreateEvent(NULL, true, false, NULL));
+  if (!app_bundle->update_check_cancel_event_) {
+    hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[Update check cancel event failed][0x%08x]"), hr));
+    return hr;
+  }
+
   ChangeState(app_bundle, new AppBundleStateInitialized);
   return S_OK;
 }
@@ -655,6 +655,38 @@ TEST_F(AppBundleInitializedUserTest, checkForUpdate_NoApps) {
   EXPECT_EQ(GOOPDATE_E_CALL_UNEXPECTED, app_bundle_->checkForUpdate());
 }
 
+TEST_F(AppBundleInitializedUserTest, ProgressEvent) {
+  CComBSTR session_id;
+  EXPECT_SUCCEEDED(app_bundle_->get_sessionId(&session_id));
+
+  NamedObjectAttributes event_attr;
+  goopdate_utils::GetBundleProgressEventAttributes(CString(session_id),
+                                                   false,
+                                                   &event_attr);
+  scoped_event progress_event(::OpenEvent(SYNCHRONIZE | EVENT_MODIFY_STATE,
+                                          false,
+                                          event_attr.name));
+  ASSERT_TRUE(progress_event);
+
+  DummyUserWorkItem dummy_work_item;
+  EXPECT_CALL(*worker_, CheckForUpdateAsync(_))
+      .WillOnce(SetWorkItem(&dummy_work_item));
+
+  App* app = NULL;
+  EXPECT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kGuid1), &app));
+
+  EXPECT_TRUE(::ResetEvent(get(progress_event)));
+  EXPECT_FALSE(IsHandleSignaled(get(progress_event)));
+
+  // The bundle becomes busy.
+  EXPECT_SUCCEEDED(app_bundle_->checkForUpdate());
+  EXPECT_TRUE(IsHandleSignaled(get(progress_event)));
+
+  EXPECT_TRUE(::ResetEvent(get(progress_event)));
+  app_bundle_->CompleteAsyncCall();  // Simulate thread completion.
+  EXPECT_TRUE(IsHandleSignaled(get(progress_event)));
+}
+
 // Does not verify the update check occurs.
 TEST_F(AppBundleInitializedUserTest, checkForUpdate_OneApp) {
   DummyUserWorkItem dummy_work_item;
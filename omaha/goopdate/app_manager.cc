@@ -58,27 +58,6 @@ int GetNumberOfDaysSince(int time) {
   return (now - time) / kSecondsPerDay;
 }
 
-// Determines if an application is registered with Omaha.
-class IsAppRegisteredFunc
-    : public std::unary_function<const CString&, HRESULT> {
- public:
-  explicit IsAppRegisteredFunc(const CString& guid)
-      : is_registered_(false),
-        guid_(guid) {}
-
-  bool is_registered() const { return is_registered_; }
-
-  HRESULT operator() (const CString& guid) {
-    if (guid.CompareNoCase(guid_) == 0) {
-      is_registered_ = true;
-    }
-    return S_OK;
-  }
- private:
-  CString guid_;
-  bool is_registered_;
-};
-
 // Enumerates all sub keys of the key and calls the functor for each of them,
 // ignoring errors to ensure all keys are processed.
 template <typename T>
@@ -282,15 +261,13 @@ bool AppManager::IsAppRegistered(const GUID& app_guid) const {
 // Vulnerable to a race condition with installers. To prevent this, acquire
 // GetRegistryStableStateLock().
 bool AppManager::IsAppRegistered(const CString& app_id) const {
-  IsAppRegisteredFunc func(app_id);
-  HRESULT hr = EnumerateSubKeys(
-      ConfigManager::Instance()->registry_clients(is_machine_),
-      &func);
-  if (FAILED(hr)) {
+  if (app_id.IsEmpty()) {
     return false;
   }
 
-  return func.is_registered();
+  return RegKey::HasKey(AppendRegKeyPath(
+      ConfigManager::Instance()->registry_clients(is_machine_),
+      app_id));
 }
 
 bool AppManager::IsAppUninstalled(const CString& app_id) const {
@@ -459,47 +436,75 @@ HRESULT AppManager::CreateClientStateKey(const GUID& app_guid,
   return S_OK;
 }
 
-HRESULT AppManager::ReadAppDefinedAttributes(
-    const CString& app_id, std::vector<StringPair>* attributes) const {
-  ASSERT1(!app_id.IsEmpty());
-  ASSERT1(attributes);
-  ASSERT1(attributes->empty());
+void AppManager::ReadAppKeySnapshots(const GUID& app_guid,
+                                     AppKeySnapshots* snapshots) const {
+  ASSERT1(snapshots);
 
-  CString base_key_name(
-    is_machine_ ?
-    ConfigManager::Instance()->machine_registry_client_state_medium() :
-    ConfigManager::Instance()->registry_client_state(is_machine_));
+  snapshots->client_hr = snapshots->client.Read(GetClientKeyName(app_guid), 0);
 
-  RegKey app_id_key;
-  CString app_id_key_name = AppendRegKeyPath(base_key_name, app_id);
-  HRESULT hr = app_id_key.Open(app_id_key_name, KEY_READ);
-  if (FAILED(hr)) {
-    if (hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND)) {
-      hr = S_FALSE;
-    }
-    return hr;
+  // The cohort and the app-defined aggregates are subkeys of the state keys.
+  snapshots->client_state_hr =
+      snapshots->client_state.Read(GetClientStateKeyName(app_guid), 1);
+  if (is_machine_) {
+    snapshots->client_state_medium_hr = snapshots->client_state_medium.Read(
+        GetClientStateMediumKeyName(app_guid), 1);
   }
+}
 
-  hr = ReadAppDefinedAttributeValues(&app_id_key, attributes);
+bool AppManager::IsAppEulaAccepted(const GUID& app_guid,
+                                   const AppKeySnapshots& snapshots) const {
+  DWORD eula_accepted = 0;
+  if (FAILED(snapshots.client_state.GetValue(kRegValueEulaAccepted,
+                                             &eula_accepted))) {
+    return true;
+  }
+  if (eula_accepted) {
+    return true;
+  }
+
+  if (!is_machine_) {
+    return false;
+  }
+
+  eula_accepted = 0;
+  if (FAILED(snapshots.client_state_medium.GetValue(kRegValueEulaAccepted,
+                                                    &eula_accepted)) ||
+      !eula_accepted) {
+    return false;
+  }
+
+  VERIFY1(SUCCEEDED(RegKey::SetValue(GetClientStateKeyName(app_guid),
+                                     kRegValueEulaAccepted,
+                                     eula_accepted)));
+  return true;
+}
+
+HRESULT AppManager::ReadAppDefinedAttributes(
+    const RegistrySnapshot& app_id_key,
+    std::vector<StringPair>* attributes) const {
+  ASSERT1(attributes);
+  ASSERT1(attributes->empty());
+
+  HRESULT hr = ReadAppDefinedAttributeValues(app_id_key, attributes);
   if (FAILED(hr)) {
     return hr;
   }
 
-  return ReadAppDefinedAttributeSubkeys(&app_id_key, attributes);
+  return ReadAppDefinedAttributeSubkeys(app_id_key, attributes);
 }
 
 HRESULT AppManager::ReadAppDefinedAttributeValues(
-    RegKey* app_id_key, std::vector<StringPair>* attributes) const {
-  ASSERT1(app_id_key);
+    const RegistrySnapshot& app_id_key,
+    std::vector<StringPair>* attributes) const {
   ASSERT1(attributes);
 
-  const int num_attributes = app_id_key->GetValueCount();
+  const size_t num_attributes = app_id_key.GetValueCount();
 
-  for (int i = 0; i < num_attributes; ++i) {
+  for (size_t i = 0; i < num_attributes; ++i) {
     CString attribute_name;
     DWORD type(REG_SZ);
 
-    HRESULT hr = app_id_key->GetValueNameAt(i, &attribute_name, &type);
+    HRESULT hr = app_id_key.GetValueNameAt(i, &attribute_name, &type);
     attribute_name.MakeLower();
     if (FAILED(hr)) {
       OPT_LOG(LE, (_T("[ReadAppDefinedAttributeValues][Failed read Attribute]")
@@ -518,7 +523,7 @@ HRESULT AppManager::ReadAppDefinedAttributeValues(
     }
 
     CString attribute_value;
-    hr = app_id_key->GetValue(attribute_name, &attribute_value);
+    hr = app_id_key.GetValue(attribute_name, &attribute_value);
     if (FAILED(hr)) {
       continue;
     }
@@ -530,19 +535,15 @@ HRESULT AppManager::ReadAppDefinedAttributeValues(
 }
 
 HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
-    RegKey* app_id_key, std::vector<StringPair>* attributes) const {
-  ASSERT1(app_id_key);
+    const RegistrySnapshot& app_id_key,
+    std::vector<StringPair>* attributes) const {
   ASSERT1(attributes);
 
-  const int num_subkeys = app_id_key->GetSubkeyCount();
+  const size_t num_subkeys = app_id_key.GetSubkeyCount();
 
-  for (int i = 0; i < num_subkeys; ++i) {
-    CString attribute_subkey_name;
-    HRESULT hr = app_id_key->GetSubkeyNameAt(i, &attribute_subkey_name);
+  for (size_t i = 0; i < num_subkeys; ++i) {
+    CString attribute_subkey_name(app_id_key.GetSubkeyNameAt(i));
     attribute_subkey_name.MakeLower();
-    if (FAILED(hr)) {
-      continue;
-    }
 
     if (!String_StartsWith(attribute_subkey_name,
                            kRegValueAppDefinedPrefix,
@@ -550,17 +551,15 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
       continue;
     }
 
-
-    RegKey attribute_subkey;
-    hr = attribute_subkey.Open(app_id_key->Key(),
-                               attribute_subkey_name,
-                               KEY_READ);
-    if (FAILED(hr)) {
+    const RegistrySnapshot* attribute_subkey =
+        app_id_key.GetSubkey(attribute_subkey_name);
+    if (!attribute_subkey) {
       continue;
     }
 
     CString value;
-    hr = attribute_subkey.GetValue(kRegValueAppDefinedAggregate, &value);
+    HRESULT hr = attribute_subkey->GetValue(kRegValueAppDefinedAggregate,
+                                            &value);
     if (FAILED(hr)) {
       continue;
     }
@@ -571,13 +570,13 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
       continue;
     }
 
-    const int num_values = attribute_subkey.GetValueCount();
+    const size_t num_values = attribute_subkey->GetValueCount();
     DWORD attribute_sum = 0;
 
-    for (int j = 0; j < num_values; ++j) {
+    for (size_t j = 0; j < num_values; ++j) {
       CString value_name;
       DWORD type(REG_DWORD);
-      hr = attribute_subkey.GetValueNameAt(j, &value_name, &type);
+      hr = attribute_subkey->GetValueNameAt(j, &value_name, &type);
       if (FAILED(hr)) {
         continue;
       }
@@ -589,7 +588,7 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
       }
 
       DWORD val = 0;
-      hr = attribute_subkey.GetValue(value_name, &val);
+      hr = attribute_subkey->GetValue(value_name, &val);
       if (FAILED(hr)) {
         continue;
       }
@@ -616,6 +615,7 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
 //    lang (if not present in Clients)
 //    ap
 //    tttoken
+//    statetoken
 //    cohort
 //    cohorthint
 //    cohortname
@@ -640,30 +640,35 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
 HRESULT AppManager::ReadAppPersistentData(App* app) {
   ASSERT1(app);
 
-  const GUID& app_guid = app->app_guid();
-  const CString& app_guid_string = app->app_guid_string();
-
   CORE_LOG(L2, (_T("[AppManager::ReadAppPersistentData][%s]"),
-                app_guid_string));
+                app->app_guid_string()));
 
   ASSERT1(app->model()->IsLockedByCaller());
 
   __mutexScope(registry_access_lock_);
 
-  const bool is_eula_accepted =
-      app_registry_utils::IsAppEulaAccepted(is_machine_,
-                                            app_guid_string,
-                                            false);
+  AppKeySnapshots snapshots;
+  ReadAppKeySnapshots(app->app_guid(), &snapshots);
+  return ReadAppPersistentDataFromSnapshots(snapshots, app);
+}
+
+HRESULT AppManager::ReadAppPersistentDataFromSnapshots(
+    const AppKeySnapshots& snapshots,
+    App* app) {
+  ASSERT1(app);
+
+  const GUID& app_guid = app->app_guid();
+  const CString& app_guid_string = app->app_guid_string();
+
+  const bool is_eula_accepted = IsAppEulaAccepted(app_guid, snapshots);
   app->is_eula_accepted_ = is_eula_accepted ? TRISTATE_TRUE : TRISTATE_FALSE;
 
-  bool client_key_exists = false;
-  RegKey client_key;
-  HRESULT hr = OpenClientKey(app_guid, &client_key);
-  if (SUCCEEDED(hr)) {
-    client_key_exists = true;
+  const bool client_key_exists = SUCCEEDED(snapshots.client_hr);
+  if (client_key_exists) {
+    const RegistrySnapshot& client_key = snapshots.client;
 
     CString version;
-    hr = client_key.GetValue(kRegValueProductVersion, &version);
+    HRESULT hr = client_key.GetValue(kRegValueProductVersion, &version);
     CORE_LOG(L3, (_T("[AppManager::ReadAppPersistentData]")
                   _T("[%s][version=%s]"), app_guid_string, version));
     if (FAILED(hr)) {
@@ -700,7 +705,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
   app->set_day_of_last_roll_call(-1);
 
   // The following do not rely on client_state_key, so check them before
-  // possibly returning if OpenClientStateKey fails.
+  // possibly returning if the ClientState key does not exist.
 
   // Reads the did run value.
   ApplicationUsageData app_usage(is_machine_, vista_util::IsVistaOrLater());
@@ -714,9 +719,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
   // that the results when ClientState does not exist are desirable. See the
   // comments near that function and above set_days_since_last_active_ping call.
 
-  RegKey client_state_key;
-  hr = OpenClientStateKey(app_guid, KEY_READ, &client_state_key);
-  if (FAILED(hr)) {
+  if (FAILED(snapshots.client_state_hr)) {
     // It is possible that the client state key has not yet been populated.
     // In this case just return the information that we have gathered thus far.
     // However if both keys do not exist, then we are doing something wrong.
@@ -724,22 +727,25 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     if (client_key_exists) {
       return S_OK;
     } else {
-      return hr;
+      return snapshots.client_state_hr;
     }
   }
+  const RegistrySnapshot& client_state_key = snapshots.client_state;
 
   // Read language from ClientState key if it was not found in the Clients key.
   if (app->language().IsEmpty()) {
     client_state_key.GetValue(kRegValueLanguage, &app->language_);
   }
 
-  VERIFY1(SUCCEEDED(ReadAppDefinedAttributes(GuidToString(app_guid),
-                                             &app->app_defined_attributes_)));
+  VERIFY1(SUCCEEDED(ReadAppDefinedAttributes(
+      is_machine_ ? snapshots.client_state_medium : snapshots.client_state,
+      &app->app_defined_attributes_)));
 
   client_state_key.GetValue(kRegValueAdditionalParams, &app->ap_);
   client_state_key.GetValue(kRegValueTTToken, &app->tt_token_);
+  client_state_key.GetValue(kRegValueStateToken, &app->state_token_);
 
-  ReadCohort(app_guid, &app->cohort_);
+  ReadCohort(client_state_key, &app->cohort_);
 
   CString iid;
   client_state_key.GetValue(kRegValueInstallationId, &iid);
@@ -770,13 +776,12 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     app->set_days_since_last_roll_call(days_since_last_roll_call);
   }
 
-  app->install_time_diff_sec_ = GetInstallTimeDiffSec(app_guid);
+  app->install_time_diff_sec_ = GetInstallTimeDiffSec(snapshots);
   // Generally GetInstallTimeDiffSec() shouldn't return kInitialInstallTimeDiff
   // here. The only exception is in the unexpected case when ClientState exists
   // without a pv.
   ASSERT1((app->install_time_diff_sec_ != kInitialInstallTimeDiff) ||
-          !RegKey::HasValue(GetClientStateKeyName(app_guid),
-                            kRegValueProductVersion));
+          !client_state_key.HasValue(kRegValueProductVersion));
 
   // For apps installed before day_of_install is implemented, skip sending
   // day_of_last* one more time (hence resets the values to 0). Once client
@@ -801,7 +806,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     app->set_day_of_last_roll_call(day_of_last_roll_call);
   }
 
-  app->day_of_install_ = GetDayOfInstall(app_guid);
+  app->day_of_install_ = GetDayOfInstall(snapshots);
 
   CString ping_freshness;
   if (SUCCEEDED(client_state_key.GetValue(kRegValuePingFreshness,
@@ -1119,7 +1124,7 @@ HRESULT AppManager::ReadInstallerRegistrationValues(App* app) {
   return S_OK;
 }
 
-// Writes tttoken and updates relevant stats.
+// Writes tttoken and statetoken and updates relevant stats.
 void AppManager::PersistSuccessfulUpdateCheckResponse(
     const App& app,
     bool is_update_available) {
@@ -1129,6 +1134,8 @@ void AppManager::PersistSuccessfulUpdateCheckResponse(
 
   VERIFY1(SUCCEEDED(SetTTToken(app)));
 
+  VERIFY1(SUCCEEDED(WriteStateToken(app, is_update_available)));
+
   VERIFY1(SUCCEEDED(WriteCohort(app)));
 
   const CString client_state_key = GetClientStateKeyName(app.app_guid());
@@ -1340,19 +1347,56 @@ HRESULT AppManager::SetTTToken(const App& app) const {
   }
 }
 
+// The server can only confirm that an update check still has no update, so
+// the token is deleted when an update is available.
+HRESULT AppManager::WriteStateToken(const App& app,
+                                    bool is_update_available) const {
+  CORE_LOG(L3, (_T("[AppManager::WriteStateToken][token=%s][%d]"),
+                app.state_token(), is_update_available));
+
+  __mutexScope(registry_access_lock_);
+
+  RegKey client_state_key;
+  HRESULT hr = CreateClientStateKey(app.app_guid(), &client_state_key);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (is_update_available || app.state_token().IsEmpty()) {
+    return client_state_key.DeleteValue(kRegValueStateToken);
+  } else {
+    return client_state_key.SetValue(kRegValueStateToken, app.state_token());
+  }
+}
+
 HRESULT AppManager::DeleteCohortKey(const GUID& app_guid) const {
   return app_registry_utils::DeleteCohortKey(is_machine_,
                                              GuidToString(app_guid));
 }
 
-HRESULT AppManager::ReadCohort(const GUID& app_guid, Cohort * cohort) const {
-  CORE_LOG(L3, (_T("[AppManager::ReadCohort][%s]"), GuidToString(app_guid)));
-
+HRESULT AppManager::ReadCohort(const RegistrySnapshot& client_state_key,
+                               Cohort* cohort) const {
   ASSERT1(cohort);
 
-  return app_registry_utils::ReadCohort(is_machine_,
-                                        GuidToString(app_guid),
-                                        cohort);
+  const RegistrySnapshot* cohort_key =
+      client_state_key.GetSubkey(kRegSubkeyCohort);
+  if (!cohort_key) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  HRESULT hr = cohort_key->GetValue(NULL, &cohort->cohort);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // Optional values.
+  cohort_key->GetValue(kRegValueCohortHint, &cohort->hint);
+  cohort_key->GetValue(kRegValueCohortName, &cohort->name);
+
+  CORE_LOG(L3, (_T("[AppManager::ReadCohort][%s][%s][%s]"), cohort->cohort,
+                                                            cohort->hint,
+                                                            cohort->name));
+  return S_OK;
 }
 
 HRESULT AppManager::WriteCohort(const App& app) const {
@@ -1471,24 +1515,46 @@ void AppManager::ReadUpdateAvailableStats(
 }
 
 uint32 AppManager::GetInstallTimeDiffSec(const GUID& app_guid) const {
-  if (!IsAppRegistered(app_guid) && !IsAppUninstalled(app_guid)) {
+  AppKeySnapshots snapshots;
+  ReadAppKeySnapshots(app_guid, &snapshots);
+  return GetInstallTimeDiffSec(snapshots);
+}
+
+// The app is registered if its Clients key exists, and it is uninstalled if
+// it is not registered and its ClientState key contains a pv.
+uint32 AppManager::GetInstallTimeDiffSec(
+    const AppKeySnapshots& snapshots) const {
+  if (FAILED(snapshots.client_hr) &&
+      !snapshots.client_state.HasValue(kRegValueProductVersion)) {
     return kInitialInstallTimeDiff;
   }
 
-  return app_registry_utils::GetInstallTimeDiffSec(is_machine_,
-                                                   GuidToString(app_guid));
+  DWORD install_time(0);
+  if (FAILED(snapshots.client_state.GetValue(kRegValueInstallTimeSec,
+                                             &install_time))) {
+    return 0;
+  }
+
+  return app_registry_utils::InstallTimeToInstallTimeDiffSec(install_time);
 }
 
 uint32 AppManager::GetDayOfInstall(const GUID& app_guid) const {
-  if (!IsAppRegistered(app_guid) && !IsAppUninstalled(app_guid)) {
+  AppKeySnapshots snapshots;
+  ReadAppKeySnapshots(app_guid, &snapshots);
+  return GetDayOfInstall(snapshots);
+}
+
+uint32 AppManager::GetDayOfInstall(const AppKeySnapshots& snapshots) const {
+  if (FAILED(snapshots.client_hr) &&
+      !snapshots.client_state.HasValue(kRegValueProductVersion)) {
     return kInitialDayOfInstall;
   }
 
   DWORD day_of_install(0);
-  if (SUCCEEDED(app_registry_utils::GetDayOfInstall(
-      is_machine_, GuidToString(app_guid), &day_of_install)) &&
+  if (SUCCEEDED(snapshots.client_state.GetValue(kRegValueDayOfInstall,
+                                                &day_of_install)) &&
       day_of_install != static_cast<DWORD>(-1)) {
-    return day_of_install;
+    return app_registry_utils::TruncateDayOfInstall(day_of_install);
   }
 
   // No DayOfInstall is present. This app is probably installed before
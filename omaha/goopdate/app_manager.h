@@ -20,6 +20,7 @@
 #include <atlstr.h>
 #include <vector>
 #include "base/basictypes.h"
+#include "omaha/base/registry_snapshot.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/common/protocol_definition.h"
 #include "goopdate/omaha3_idl.h"
@@ -219,6 +220,22 @@ class AppManager {
   bool IsAppOemInstalledAndEulaAccepted(const CString& app_id) const;
 
  private:
+  // The registry keys of an app, read in one pass. The result of reading each
+  // key is kept so that missing keys can be told apart from empty keys.
+  struct AppKeySnapshots {
+    AppKeySnapshots()
+        : client_hr(E_UNEXPECTED),
+          client_state_hr(E_UNEXPECTED),
+          client_state_medium_hr(E_UNEXPECTED) {}
+
+    RegistrySnapshot client;
+    RegistrySnapshot client_state;
+    RegistrySnapshot client_state_medium;
+    HRESULT client_hr;
+    HRESULT client_state_hr;
+    HRESULT client_state_medium_hr;
+  };
+
   explicit AppManager(bool is_machine);
   ~AppManager() {}
 
@@ -238,23 +255,46 @@ class AppManager {
   HRESULT CreateClientStateKey(const GUID& app_guid,
                                RegKey* client_state_key) const;
 
+  // Reads the Clients key of the app, and the ClientState and the
+  // ClientStateMedium keys of the app along with their subkeys.
+  void ReadAppKeySnapshots(const GUID& app_guid,
+                           AppKeySnapshots* snapshots) const;
+
+  // Populates the app from the snapshots of its registry keys. See
+  // ReadAppPersistentData.
+  HRESULT ReadAppPersistentDataFromSnapshots(const AppKeySnapshots& snapshots,
+                                             App* app);
+
+  // Returns true if the EULA is accepted or not explicitly rejected. Copies
+  // the acceptance from ClientStateMedium to ClientState for machine apps.
+  bool IsAppEulaAccepted(const GUID& app_guid,
+                         const AppKeySnapshots& snapshots) const;
+
+  uint32 GetInstallTimeDiffSec(const AppKeySnapshots& snapshots) const;
+  uint32 GetDayOfInstall(const AppKeySnapshots& snapshots) const;
+
   // Reads name/value pairs that have a '_' prefix under the
   // ClientState/ClientStateMedium key.
   HRESULT ReadAppDefinedAttributes(
-      const CString& app_id, std::vector<StringPair>* attributes) const;
+      const RegistrySnapshot& app_id_key,
+      std::vector<StringPair>* attributes) const;
   HRESULT ReadAppDefinedAttributeValues(
-      RegKey* app_id_key, std::vector<StringPair>* attributes) const;
+      const RegistrySnapshot& app_id_key,
+      std::vector<StringPair>* attributes) const;
   // Aggregates are '_' prefixed subkeys that store values that need to be
   // aggregated. The only aggregate supported at the moment is "sum".
   HRESULT ReadAppDefinedAttributeSubkeys(
-      RegKey* app_id_key, std::vector<StringPair>* attributes) const;
+      const RegistrySnapshot& app_id_key,
+      std::vector<StringPair>* attributes) const;
 
   // Write the TT Token with what the server returned.
   HRESULT SetTTToken(const App& app) const;
+  HRESULT WriteStateToken(const App& app, bool is_update_available) const;
 
   CString GetCohortKeyName(const GUID& app_guid) const;
   HRESULT DeleteCohortKey(const GUID& app_guid) const;
-  HRESULT ReadCohort(const GUID& app_guid, Cohort* cohort) const;
+  HRESULT ReadCohort(const RegistrySnapshot& client_state_key,
+                     Cohort* cohort) const;
   HRESULT WriteCohort(const App& app) const;
 
   // Stores information about the update available event for the app.
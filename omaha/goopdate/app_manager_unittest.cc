@@ -1237,6 +1237,37 @@ class AppManagerTestBase : public AppTestBaseWithRegistryOverride {
     RegKey::DeleteKey(cohort_key_name);
   }
 
+  // Reads the app from snapshots which are built in memory instead of read
+  // from the registry. The ClientState key contains 'eula_accepted'.
+  HRESULT ReadAppPersistentDataFromMemorySnapshots(DWORD eula_accepted) {
+    AppManager::AppKeySnapshots snapshots;
+
+    snapshots.client_hr = S_OK;
+    snapshots.client.SetValue(kRegValueProductVersion,
+                              CString(_T("1.2.3.4")));
+    snapshots.client.SetValue(kRegValueAppName, CString(_T("Memory App")));
+
+    snapshots.client_state_hr = S_OK;
+    RegistrySnapshot& client_state = is_machine_ ?
+        snapshots.client_state_medium : snapshots.client_state;
+    if (is_machine_) {
+      snapshots.client_state_medium_hr = S_OK;
+    }
+    snapshots.client_state.SetValue(kRegValueEulaAccepted, eula_accepted);
+    snapshots.client_state.SetValue(kRegValueAdditionalParams,
+                                    CString(_T("mem_ap")));
+    snapshots.client_state.SetValue(kRegValueBrandCode, CString(_T("MEMB")));
+    client_state.SetValue(_T("_Attribute"), CString(_T("attribute_value")));
+
+    RegistrySnapshot* cohort = snapshots.client_state.AddSubkey(
+        kRegSubkeyCohort);
+    cohort->SetValue(NULL, CString(_T("1:2:")));
+    cohort->SetValue(kRegValueCohortName, CString(_T("memory_cohort")));
+
+    __mutexScope(app_->model()->lock());
+    return app_manager_->ReadAppPersistentDataFromSnapshots(snapshots, app_);
+  }
+
   AppManager* app_manager_;
   App* app_;
   // A second bundle is necessary because the same bundle cannot have the same
@@ -1931,6 +1962,45 @@ TEST_F(AppManagerReadAppPersistentDataUserTest, AppExists_EmptyDisplayName) {
   ValidateExpectedValues(*expected_app, *app_);
 }
 
+TEST_F(AppManagerReadAppPersistentDataUserTest, FromMemorySnapshots) {
+  EXPECT_SUCCEEDED(ReadAppPersistentDataFromMemorySnapshots(1));
+
+  EXPECT_STREQ(_T("1.2.3.4"), app_->current_version()->version());
+  EXPECT_STREQ(_T("Memory App"), app_->display_name());
+  EXPECT_STREQ(_T("mem_ap"), app_->ap());
+  EXPECT_STREQ(_T("MEMB"), app_->brand_code());
+  EXPECT_STREQ(_T("1:2:"), app_->cohort().cohort);
+  EXPECT_STREQ(_T("memory_cohort"), app_->cohort().name);
+  EXPECT_TRUE(app_->is_eula_accepted());
+
+  const std::vector<StringPair> attributes(app_->app_defined_attributes());
+  ASSERT_EQ(1, attributes.size());
+  EXPECT_STREQ(_T("_attribute"), attributes[0].first);
+  EXPECT_STREQ(_T("attribute_value"), attributes[0].second);
+
+  // Nothing is read from or written to the registry.
+  EXPECT_FALSE(RegKey::HasKey(GetClientKeyName(guid1_)));
+  EXPECT_FALSE(IsClientStateKeyPresent(*app_));
+}
+
+TEST_F(AppManagerReadAppPersistentDataMachineTest, FromMemorySnapshots) {
+  EXPECT_SUCCEEDED(ReadAppPersistentDataFromMemorySnapshots(1));
+
+  EXPECT_STREQ(_T("1.2.3.4"), app_->current_version()->version());
+  EXPECT_STREQ(_T("mem_ap"), app_->ap());
+
+  // Machine apps read app-defined attributes from ClientStateMedium.
+  const std::vector<StringPair> attributes(app_->app_defined_attributes());
+  ASSERT_EQ(1, attributes.size());
+  EXPECT_STREQ(_T("_attribute"), attributes[0].first);
+}
+
+TEST_F(AppManagerReadAppPersistentDataUserTest,
+       FromMemorySnapshots_EulaNotAccepted) {
+  EXPECT_SUCCEEDED(ReadAppPersistentDataFromMemorySnapshots(0));
+  EXPECT_FALSE(app_->is_eula_accepted());
+}
+
 TEST_F(AppManagerReadAppPersistentDataUserTest, EulaNotAccepted) {
   App* expected_app = CreateAppForRegistryPopulation(kGuid1);
   PopulateExpectedApp1(expected_app);
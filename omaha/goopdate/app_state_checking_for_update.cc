@@ -252,10 +252,10 @@ void AppStateCheckingForUpdate::HandleErrorResponse(App* app,
 void AppStateCheckingForUpdate::PersistUpdateCheckValuesOnFailure(App* app) {
   ASSERT1(app);
 
-  const int daynum =
-      app->app_bundle()->update_check_client()->http_xdaynum_header_value();
-  const int daystart =
-      app->app_bundle()->update_check_client()->http_xdaystart_header_value();
+  const WebServicesClientResult update_check_result(
+      app->app_bundle()->update_check_result());
+  const int daynum = update_check_result.http_xdaynum_header_value;
+  const int daystart = update_check_result.http_xdaystart_header_value;
 
   if (daystart == -1 || daynum == -1) {
     return;
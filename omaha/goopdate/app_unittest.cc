@@ -16,6 +16,8 @@
 #include <atlbase.h>
 #include <atlcom.h>
 #include "omaha/base/error.h"
+#include "omaha/base/scoped_any.h"
+#include "omaha/base/synchronized.h"
 #include "omaha/base/time.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/const_group_policy.h"
@@ -53,6 +55,23 @@ const TCHAR* const kChromeClientStateKeyPathUser =
 const TCHAR* const kInstallPolicyApp2 = _T("Install") APP_ID2;
 const TCHAR* const kUpdatePolicyApp2 = _T("Update") APP_ID2;
 
+// Polls the app through its COM wrapper, as the UI does.
+DWORD WINAPI PollAppThreadProc(void* param) {
+  IApp* app = static_cast<IApp*>(param);
+
+  CComPtr<IDispatch> current_state;
+  EXPECT_SUCCEEDED(app->get_currentState(&current_state));
+  EXPECT_TRUE(current_state);
+
+  CComBSTR app_id;
+  EXPECT_SUCCEEDED(app->get_appId(&app_id));
+  EXPECT_STREQ(kAppId1, app_id);
+
+  CComBSTR display_name;
+  EXPECT_SUCCEEDED(app->get_displayName(&display_name));
+  return 0;
+}
+
 }  // namespace
 
 class AppTest : public AppTestBaseWithRegistryOverride {
@@ -898,4 +917,42 @@ TEST_F(AppInstallTest, ExperimentLabels) {
                app->GetExperimentLabelsNoTimestamps());
 }
 
+// The wrapper getters take the model lock shared. A poll runs while another
+// thread reads the model and waits only while a writer holds the lock.
+TEST_F(AppInstallTest, WrapperPollsRunConcurrentlyWithReaders) {
+  CComPtr<IDispatch> app_disp;
+  {
+    __mutexScope(model_->lock());
+    EXPECT_SUCCEEDED(AppWrapper::Create(app_bundle_, app_, &app_disp));
+  }
+  CComQIPtr<IApp> app_wrapper(app_disp);
+  ASSERT_TRUE(app_wrapper);
+
+  {
+    __mutexScope(model_->shared_lock());
+    scoped_handle reader(::CreateThread(NULL,
+                                        0,
+                                        PollAppThreadProc,
+                                        app_wrapper.p,
+                                        0,
+                                        NULL));
+    ASSERT_TRUE(get(reader));
+    EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(reader), 10000));
+  }
+
+  scoped_handle reader;
+  {
+    __mutexScope(model_->lock());
+    reset(reader, ::CreateThread(NULL,
+                                 0,
+                                 PollAppThreadProc,
+                                 app_wrapper.p,
+                                 0,
+                                 NULL));
+    ASSERT_TRUE(get(reader));
+    EXPECT_EQ(WAIT_TIMEOUT, ::WaitForSingleObject(get(reader), 100));
+  }
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(reader), 10000));
+}
+
 }  // namespace omaha
@@ -41,7 +41,7 @@ AppVersion::~AppVersion() {
 }
 
 CString AppVersion::version() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return version_;
 }
 
@@ -56,7 +56,7 @@ App* AppVersion::app() {
 }
 
 const App* AppVersion::app() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return app_;
 }
 
@@ -79,7 +79,7 @@ void AppVersion::set_install_manifest(xml::InstallManifest* install_manifest) {
 }
 
 size_t AppVersion::GetNumberOfPackages() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return packages_.size();
 }
 
@@ -94,7 +94,7 @@ HRESULT AppVersion::AddPackage(const CString& filename,
 }
 
 Package* AppVersion::GetPackage(size_t index) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
 
   if (index >= GetNumberOfPackages()) {
     ASSERT1(false);
@@ -105,7 +105,7 @@ Package* AppVersion::GetPackage(size_t index) {
 }
 
 const Package* AppVersion::GetPackage(size_t index) const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
 
   if (index >= GetNumberOfPackages()) {
     ASSERT1(false);
@@ -130,14 +130,14 @@ HRESULT AppVersion::AddDownloadBaseUrl(const CString& base_url) {
 
 // IAppVersion.
 STDMETHODIMP AppVersion::get_version(BSTR* version) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(version);
   *version = version_.AllocSysString();
   return S_OK;
 }
 
 STDMETHODIMP AppVersion::get_packageCount(long* count) {  // NOLINT
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
 
   const size_t num_packages = GetNumberOfPackages();
   if (num_packages > LONG_MAX) {
@@ -161,12 +161,12 @@ STDMETHODIMP AppVersion::get_package(long index, Package** package) {  // NOLINT
 }
 
 STDMETHODIMP AppVersionWrapper::get_version(BSTR* version) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_version(version);
 }
 
 STDMETHODIMP AppVersionWrapper::get_packageCount(long* count) {  // NOLINT
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_packageCount(count);
 }
 
@@ -80,6 +80,8 @@ HRESULT CoCreateAsyncStatus::CreateOmahaMachineServerAsync(
                             &CoCreateAsyncStatus::CreateOmahaMachineServer,
                             origin_url,
                             create_elevated));
+  // The caller blocks until the work item starts.
+  callback->set_priority(UserWorkItem::kPriorityUrgent);
   HRESULT hr = Goopdate::Instance().QueueUserWorkItem(callback.get(),
                                                       COINIT_MULTITHREADED,
                                                       WT_EXECUTELONGFUNCTION);
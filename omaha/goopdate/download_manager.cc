@@ -35,6 +35,7 @@
 #include "omaha/base/path.h"
 #include "omaha/base/scoped_impersonation.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/span_trace.h"
 #include "omaha/base/string.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/user_rights.h"
@@ -57,6 +58,13 @@ namespace omaha {
 
 namespace {
 
+// A download from a url which is not the last url of the package is abandoned
+// when its throughput drops below this rate and well below the peak
+// throughput of the url, so that the next url is tried. A download which has
+// been slow from the start is kept, since the link of the client is the most
+// likely bottleneck and abandoning it would discard the bytes downloaded.
+const int kMinDownloadRateBytesPerSec = 4 * 1024;
+
 // Creates and initializes an instance of the NetworkRequest for the
 // DownloadManager to use. Defines the fallback chain: BITS, WinHttp.
 HRESULT CreateNetworkRequest(NetworkRequest** network_request_ptr) {
@@ -334,6 +342,7 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
   ASSERT1(state);
 
   App* app = package->app_version()->app();
+  TRACE_SPAN("DownloadManager::DoDownloadPackage", app->span_id());
   const CString app_id(app->app_guid_string());
   const CString version(package->app_version()->version());
   const CString package_name(package->filename());
@@ -402,6 +411,10 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
 
       ASSERT1(static_cast<DWORD>(url.GetLength()) == url_length);
 
+      const bool has_next_url = i + 1 != download_base_urls.size();
+      network_request->set_min_download_rate(
+          has_next_url ? kMinDownloadRateBytesPerSec : 0);
+
       hr = DoDownloadPackageFromUrl(url, unique_filename_path, package, state);
       AddDownloadMetricsPingEvents(network_request->download_metrics(), app);
       if (SUCCEEDED(hr)) {
@@ -440,6 +453,7 @@ HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
                                                   const CString& filename,
                                                   Package* package,
                                                   State* state) {
+  TRACE_NESTED_SPAN("DownloadManager::DoDownloadPackageFromUrl");
   OPT_LOG(L3, (_T("[starting download][from '%s'][to '%s']"), url, filename));
 
   // Downloading a file is a blocking call. It assumes the model is not
@@ -59,8 +59,12 @@
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scoped_any.h"
 #include "omaha/base/scoped_ptr_address.h"
+#include "omaha/base/span_trace.h"
+#include "omaha/base/startup_trace.h"
 #include "omaha/base/system_info.h"
+#include "omaha/base/thread_pool.h"
 #include "omaha/base/utils.h"
+#include "omaha/base/version.h"
 #include "omaha/base/vistautil.h"
 #include "omaha/client/client_utils.h"
 #include "omaha/client/install.h"
@@ -162,13 +166,18 @@ bool CheckRegisteredVersion(const CString& version,
     case COMMANDLINE_MODE_UNINSTALL:
 
     default:
-      // This binary's version should be the installed version.
+      // This binary's version should be the installed version. The versions
+      // are compared as versions, so that "1.3.26.0" matches "1.3.026.0".
       CString installed_version;
       VERIFY1(SUCCEEDED(RegKey::GetValue(
           ConfigManager::Instance()->registry_update(is_machine),
           kRegValueInstalledVersion,
           &installed_version)));
-      return version == installed_version;
+      Version this_version;
+      Version registered_version;
+      return Version::Parse(version, &this_version) &&
+             Version::Parse(installed_version, &registered_version) &&
+             this_version == registered_version;
   }
 }
 #endif
@@ -349,9 +358,13 @@ GoopdateImpl::GoopdateImpl(Goopdate* goopdate, bool is_local_system)
     omaha::g_crash_specific_error = static_cast<HRESULT>(crash_specific_error);
   }
 
+  // Bounds the number of app bundle operations which run at the same time.
+  // The queued operations start by order of the bundle priority.
   static const int kThreadPoolShutdownDelayMs = 60000;
+  static const int kThreadPoolMaxConcurrentWorkItems = 4;
   thread_pool_.reset(new ThreadPool);
-  HRESULT hr = thread_pool_->Initialize(kThreadPoolShutdownDelayMs);
+  HRESULT hr = thread_pool_->Initialize(kThreadPoolShutdownDelayMs,
+                                        kThreadPoolMaxConcurrentWorkItems);
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[thread_pool_->Initialize failed][0x%08x]"), hr));
   }
@@ -397,6 +410,16 @@ HRESULT GoopdateImpl::QueueUserWorkItem(UserWorkItem* work_item,
 }
 
 void GoopdateImpl::Stop() {
+  if (thread_pool_.get()) {
+    ThreadPoolStats stats;
+    thread_pool_->GetStats(&stats);
+    CORE_LOG(L2, (_T("[GoopdateImpl::Stop][thread pool]")
+                  _T("[processed %d][canceled %d][max queue depth %d]")
+                  _T("[max queue latency %u ms]"),
+                  stats.num_processed, stats.num_canceled,
+                  stats.max_queue_depth, stats.max_queue_latency_ms));
+  }
+
   // The thread pool destructor waits for any remaining jobs to complete.
   thread_pool_.reset();
 }
@@ -527,12 +550,28 @@ HRESULT GoopdateImpl::Main(HINSTANCE instance,
   ResourceManager::Delete();
   scheduled_task_utils::DeleteScheduledTasksInstance();
 
+  CString trace_name;
+  SafeCStringFormat(&trace_name, _T("goopdate_mode%d"), args_.mode);
+  HRESULT trace_hr = StartupTrace::WriteChromeTraceIfEnabled(trace_name);
+  if (FAILED(trace_hr)) {
+    CORE_LOG(LW, (_T("[StartupTrace::WriteChromeTraceIfEnabled failed]")
+                  _T("[0x%08x]"), trace_hr));
+  }
+  trace_hr = SpanTrace::WriteChromeTraceIfEnabled(trace_name);
+  if (FAILED(trace_hr)) {
+    CORE_LOG(LW, (_T("[SpanTrace::WriteChromeTraceIfEnabled failed][0x%08x]"),
+                  trace_hr));
+  }
+
   return hr;
 }
 
 HRESULT GoopdateImpl::DoMain(HINSTANCE instance,
                              const TCHAR* cmd_line,
                              int cmd_show) {
+  STARTUP_TRACE_PHASE("GoopdateImpl::DoMain");
+  SpanTrace::EnableIfConfigured();
+
   module_instance_ = instance;
   cmd_line_ = cmd_line;
   cmd_show_ = cmd_show;
@@ -563,7 +602,11 @@ HRESULT GoopdateImpl::DoMain(HINSTANCE instance,
                 vista_util::IsUserNonElevatedAdmin(),
                 ConfigManager::Instance()->GetTestSource()));
 
-  HRESULT parse_hr = omaha::ParseCommandLine(cmd_line_, &args_);
+  HRESULT parse_hr = S_OK;
+  {
+    STARTUP_TRACE_PHASE("ParseCommandLine");
+    parse_hr = omaha::ParseCommandLine(cmd_line_, &args_);
+  }
   if (FAILED(parse_hr)) {
     CORE_LOG(LE, (_T("[Parse cmd line failed][0x%08x]"), parse_hr));
     args_.mode = COMMANDLINE_MODE_UNKNOWN;
@@ -644,6 +687,8 @@ HRESULT GoopdateImpl::DoMain(HINSTANCE instance,
 
 // Assumes the command line has been parsed.
 HRESULT GoopdateImpl::InitializeGoopdateAndLoadResources() {
+  STARTUP_TRACE_PHASE("GoopdateImpl::InitializeGoopdateAndLoadResources");
+
   // IsMachineProcess requires the command line be parsed first.
   is_machine_ = IsMachineProcess();
   OPT_LOG(L1, (_T("[is machine: %d]"), is_machine_));
@@ -708,6 +753,7 @@ COINIT GoopdateImpl::GetComThreadingModelForMode(CommandLineMode mode) {
 // structures, we need one of multiple modules selected at runtime and cannot
 // statically allocate.
 HRESULT GoopdateImpl::ExecuteMode(bool* has_ui_been_displayed) {
+  STARTUP_TRACE_PHASE("GoopdateImpl::ExecuteMode");
   ASSERT1(has_ui_been_displayed);
 
   // Save the mode on the stack for post-mortem debugging purposes.
@@ -993,6 +1039,8 @@ bool GoopdateImpl::IsShutdownEventSet() {
 // 5. Modes where an error message needs to be displayed.
 HRESULT GoopdateImpl::LoadResourceDllIfNecessary(CommandLineMode mode,
                                                  const CString& resource_dir) {
+  STARTUP_TRACE_PHASE("GoopdateImpl::LoadResourceDllIfNecessary");
+
   switch (mode) {
     case COMMANDLINE_MODE_UNKNOWN:             // Displays an error using UI.
     case COMMANDLINE_MODE_NOARGS:              // Displays an error using UI.
@@ -1284,12 +1332,20 @@ HRESULT GoopdateImpl::DoUpdateAllApps(bool* has_ui_been_displayed ) {
     return is_interactive_update ? hr : S_OK;
   }
 
-  hr = UpdateApps(is_machine_,
-                  is_interactive_update,
-                  is_on_demand,
-                  install_source,
-                  args_.extra.language,
-                  has_ui_been_displayed);
+  if (!is_interactive_update &&
+      install_source == kCmdLineInstallSource_Core &&
+      ConfigManager::Instance()->IsPersistentUpdateWorkerEnabled()) {
+    hr = UpdateAppsPersistent(is_machine_,
+                              install_source,
+                              args_.extra.language);
+  } else {
+    hr = UpdateApps(is_machine_,
+                    is_interactive_update,
+                    is_on_demand,
+                    install_source,
+                    args_.extra.language,
+                    has_ui_been_displayed);
+  }
   OPT_LOG(L2, (_T("[Update all apps process finished][0x%x]"), hr));
 
   // The UA worker always returns S_OK. UA can be launched by the scheduled task
@@ -1513,6 +1569,8 @@ HRESULT GoopdateImpl::SetBackgroundPriorityIfNeeded(CommandLineMode mode) {
 }
 
 HRESULT GoopdateImpl::InstallExceptionHandler() {
+  STARTUP_TRACE_PHASE("GoopdateImpl::InstallExceptionHandler");
+
   if (!OmahaExceptionHandler::OkayToInstall()) {
     // This process has opted out of Breakpad exception handling, by being
     // launched via crash_utils::StartProcessWithNoExceptionHandler().  (This
@@ -1556,6 +1614,8 @@ HRESULT GoopdateImpl::CaptureUserMetrics() {
 }
 
 HRESULT GoopdateImpl::CaptureOSMetrics() {
+  STARTUP_TRACE_PHASE("GoopdateImpl::CaptureOSMetrics");
+
   int major_version(0);
   int minor_version(0);
   int service_pack_major(0);
@@ -21,6 +21,7 @@
 #include "omaha/base/path.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scope_guard.h"
+#include "omaha/base/span_trace.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
@@ -95,6 +96,7 @@ CString InstallManager::install_working_dir() const {
 void InstallManager::InstallApp(App* app,  const CString& dir) {
   CORE_LOG(L3, (_T("[InstallManager::InstallApp][0x%p]"), app));
   ASSERT1(app);
+  TRACE_SPAN("InstallManager::InstallApp", app->span_id());
 
   const ConfigManager& cm = *ConfigManager::Instance();
   // TODO(omaha): Since we don't currently have is_manual, check the least
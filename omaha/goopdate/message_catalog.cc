@@ -0,0 +1,143 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/message_catalog.h"
+#include <algorithm>
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+
+namespace omaha {
+
+namespace {
+
+struct EnumStringBlockContext {
+  MessageCatalog* catalog;
+  HRESULT hr;
+};
+
+}  // namespace
+
+MessageCatalog::MessageCatalog() {
+}
+
+MessageCatalog::~MessageCatalog() {
+}
+
+HRESULT MessageCatalog::Load(HMODULE module) {
+  ASSERT1(module);
+
+  EnumStringBlockContext context = { this, S_OK };
+  if (!::EnumResourceNames(module,
+                           RT_STRING,
+                           &MessageCatalog::EnumStringBlock,
+                           reinterpret_cast<LONG_PTR>(&context))) {
+    const HRESULT hr = HRESULTFromLastError();
+    if (FAILED(context.hr)) {
+      return context.hr;
+    }
+    CORE_LOG(LE, (_T("[EnumResourceNames failed][0x%08x]"), hr));
+    return hr;
+  }
+
+  CORE_LOG(L3, (_T("[MessageCatalog::Load][%u messages]"), entries_.size()));
+  return S_OK;
+}
+
+BOOL CALLBACK MessageCatalog::EnumStringBlock(HMODULE module,
+                                              const TCHAR* type,
+                                              TCHAR* name,
+                                              LONG_PTR param) {
+  EnumStringBlockContext* context =
+      reinterpret_cast<EnumStringBlockContext*>(param);
+  ASSERT1(context);
+
+  if (!IS_INTRESOURCE(name)) {
+    // String blocks always have integer ids.
+    return TRUE;
+  }
+
+  HRSRC resource = ::FindResource(module, name, type);
+  HGLOBAL resource_data = resource ? ::LoadResource(module, resource) : NULL;
+  const void* data = resource_data ? ::LockResource(resource_data) : NULL;
+  if (!data) {
+    context->hr = HRESULTFromLastError();
+    return FALSE;
+  }
+
+  context->hr = context->catalog->AddStringBlock(
+      static_cast<int>(reinterpret_cast<ULONG_PTR>(name)),
+      data,
+      ::SizeofResource(module, resource));
+  return SUCCEEDED(context->hr);
+}
+
+HRESULT MessageCatalog::AddStringBlock(int block_id,
+                                       const void* data,
+                                       size_t size) {
+  ASSERT1(data || !size);
+  if (block_id <= 0) {
+    return E_INVALIDARG;
+  }
+
+  const WCHAR* current = static_cast<const WCHAR*>(data);
+  const WCHAR* const end = current + size / sizeof(WCHAR);
+  const int32 first_message_id = (block_id - 1) * kStringsPerBlock;
+
+  for (int i = 0; i < kStringsPerBlock && current < end; ++i) {
+    const size_t length = *current++;
+    if (length > static_cast<size_t>(end - current)) {
+      CORE_LOG(LE, (_T("[Truncated string block][%d]"), block_id));
+      return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    // Empty slots are placeholders for the unused ids of the block.
+    if (length) {
+      Entry entry = { first_message_id + i, text_.size(), length };
+      text_.insert(text_.end(), current, current + length);
+
+      std::vector<Entry>::iterator it = std::lower_bound(
+          entries_.begin(), entries_.end(), entry, LessByMessageId);
+      if (it != entries_.end() && it->message_id == entry.message_id) {
+        *it = entry;
+      } else {
+        entries_.insert(it, entry);
+      }
+    }
+    current += length;
+  }
+
+  return S_OK;
+}
+
+bool MessageCatalog::FindMessage(int32 message_id, CString* message) const {
+  ASSERT1(message);
+
+  const Entry key = { message_id, 0, 0 };
+  std::vector<Entry>::const_iterator it = std::lower_bound(
+      entries_.begin(), entries_.end(), key, LessByMessageId);
+  if (it == entries_.end() || it->message_id != message_id) {
+    return false;
+  }
+
+  message->SetString(&text_[it->offset], static_cast<int>(it->length));
+  return true;
+}
+
+bool MessageCatalog::LessByMessageId(const Entry& lhs, const Entry& rhs) {
+  return lhs.message_id < rhs.message_id;
+}
+
+}  // namespace omaha
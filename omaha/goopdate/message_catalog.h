@@ -0,0 +1,75 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Message catalog of a resource DLL. The string table of the DLL is read once
+// into a single buffer, indexed by message id, so that looking up a message
+// does not search the resources of the DLL every time.
+
+#ifndef OMAHA_GOOPDATE_MESSAGE_CATALOG_H_
+#define OMAHA_GOOPDATE_MESSAGE_CATALOG_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class MessageCatalog {
+ public:
+  // Each RT_STRING resource block holds this many consecutive messages.
+  static const int kStringsPerBlock = 16;
+
+  MessageCatalog();
+  ~MessageCatalog();
+
+  // Reads all the RT_STRING blocks of 'module'.
+  HRESULT Load(HMODULE module);
+
+  // Adds the messages of a raw RT_STRING block. 'block_id' is the resource id
+  // of the block, which holds the messages starting at
+  // (block_id - 1) * kStringsPerBlock. Each message is stored as its length in
+  // characters followed by its characters, without a terminating null.
+  HRESULT AddStringBlock(int block_id, const void* data, size_t size);
+
+  // Returns false if the catalog does not have a message for 'message_id'.
+  bool FindMessage(int32 message_id, CString* message) const;
+
+  size_t GetMessageCount() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    int32 message_id;
+    size_t offset;
+    size_t length;
+  };
+
+  static bool LessByMessageId(const Entry& lhs, const Entry& rhs);
+
+  static BOOL CALLBACK EnumStringBlock(HMODULE module,
+                                       const TCHAR* type,
+                                       TCHAR* name,
+                                       LONG_PTR param);
+
+  // Sorted by message id.
+  std::vector<Entry> entries_;
+  std::vector<WCHAR> text_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessageCatalog);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_MESSAGE_CATALOG_H_
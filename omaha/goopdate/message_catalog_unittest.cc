@@ -0,0 +1,141 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <vector>
+#include "omaha/base/app_util.h"
+#include "omaha/base/path.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/goopdate/message_catalog.h"
+#include "omaha/goopdate/resources/goopdateres/goopdate.grh"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+// Appends a message in the RT_STRING block format to 'block'.
+void AppendMessage(const TCHAR* message, std::vector<WCHAR>* block) {
+  const size_t length = _tcslen(message);
+  block->push_back(static_cast<WCHAR>(length));
+  block->insert(block->end(), message, message + length);
+}
+
+// Returns a string block which has messages only in the first and the last
+// slots, like the blocks the resource compiler generates for sparse ids.
+std::vector<WCHAR> MakeSparseBlock(const TCHAR* first, const TCHAR* last) {
+  std::vector<WCHAR> block;
+  AppendMessage(first, &block);
+  for (int i = 1; i < MessageCatalog::kStringsPerBlock - 1; ++i) {
+    AppendMessage(_T(""), &block);
+  }
+  AppendMessage(last, &block);
+  return block;
+}
+
+}  // namespace
+
+TEST(MessageCatalogTest, AddStringBlock) {
+  MessageCatalog catalog;
+  EXPECT_EQ(0, catalog.GetMessageCount());
+
+  // Block 2 holds the messages 16 to 31.
+  std::vector<WCHAR> block = MakeSparseBlock(_T("sixteen"), _T("thirty-one"));
+  EXPECT_SUCCEEDED(catalog.AddStringBlock(2,
+                                          &block.front(),
+                                          block.size() * sizeof(WCHAR)));
+  EXPECT_EQ(2, catalog.GetMessageCount());
+
+  CString message;
+  EXPECT_TRUE(catalog.FindMessage(16, &message));
+  EXPECT_STREQ(_T("sixteen"), message);
+  EXPECT_TRUE(catalog.FindMessage(31, &message));
+  EXPECT_STREQ(_T("thirty-one"), message);
+
+  // Empty slots do not have messages.
+  EXPECT_FALSE(catalog.FindMessage(17, &message));
+  EXPECT_FALSE(catalog.FindMessage(15, &message));
+  EXPECT_FALSE(catalog.FindMessage(32, &message));
+
+  // Blocks added out of order are found as well.
+  block = MakeSparseBlock(_T("zero"), _T("fifteen"));
+  EXPECT_SUCCEEDED(catalog.AddStringBlock(1,
+                                          &block.front(),
+                                          block.size() * sizeof(WCHAR)));
+  EXPECT_EQ(4, catalog.GetMessageCount());
+  EXPECT_TRUE(catalog.FindMessage(0, &message));
+  EXPECT_STREQ(_T("zero"), message);
+  EXPECT_TRUE(catalog.FindMessage(16, &message));
+  EXPECT_STREQ(_T("sixteen"), message);
+
+  // Adding a block again replaces its messages.
+  block = MakeSparseBlock(_T("new zero"), _T("new fifteen"));
+  EXPECT_SUCCEEDED(catalog.AddStringBlock(1,
+                                          &block.front(),
+                                          block.size() * sizeof(WCHAR)));
+  EXPECT_EQ(4, catalog.GetMessageCount());
+  EXPECT_TRUE(catalog.FindMessage(15, &message));
+  EXPECT_STREQ(_T("new fifteen"), message);
+}
+
+TEST(MessageCatalogTest, AddStringBlock_Invalid) {
+  MessageCatalog catalog;
+  std::vector<WCHAR> block;
+  AppendMessage(_T("message"), &block);
+
+  EXPECT_EQ(E_INVALIDARG,
+            catalog.AddStringBlock(0,
+                                   &block.front(),
+                                   block.size() * sizeof(WCHAR)));
+
+  // The length of the message is larger than the block.
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            catalog.AddStringBlock(1,
+                                   &block.front(),
+                                   (block.size() - 1) * sizeof(WCHAR)));
+}
+
+TEST(MessageCatalogTest, Load) {
+  CString dll_name;
+  SafeCStringFormat(&dll_name, kOmahaResourceDllNameFormat, _T("en"));
+  const CString path = ConcatenatePath(app_util::GetModuleDirectory(NULL),
+                                       dll_name);
+  HMODULE module = ::LoadLibraryEx(path, NULL, LOAD_LIBRARY_AS_DATAFILE);
+  ASSERT_TRUE(module);
+
+  MessageCatalog catalog;
+  EXPECT_SUCCEEDED(catalog.Load(module));
+  EXPECT_LT(0, catalog.GetMessageCount());
+
+  // The catalog has the same strings as the string table of the module.
+  const int kMessageIds[] = { IDS_CLOSE, IDS_DEFAULT_APP_DISPLAY_NAME };
+  for (int i = 0; i < arraysize(kMessageIds); ++i) {
+    CString message;
+    EXPECT_TRUE(catalog.FindMessage(kMessageIds[i], &message));
+
+    CString expected;
+    const TCHAR* resource_string = NULL;
+    const int length = ::LoadString(module,
+                                    kMessageIds[i],
+                                    reinterpret_cast<TCHAR*>(&resource_string),
+                                    0);
+    ASSERT_LT(0, length);
+    expected.SetString(resource_string, length);
+    EXPECT_STREQ(expected, message);
+  }
+
+  EXPECT_TRUE(::FreeLibrary(module));
+}
+
+}  // namespace omaha
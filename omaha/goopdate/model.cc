@@ -149,13 +149,13 @@ HRESULT Model::DownloadPackage(Package* package) {
 }
 
 HRESULT Model::GetPackage(const Package* package, const CString& dir) const {
-  __mutexScope(lock_);
+  __mutexScope(lock_.shared());
 
   return worker_->GetPackage(package, dir);
 }
 
 bool Model::IsPackageAvailable(const Package* package) const {
-  __mutexScope(lock_);
+  __mutexScope(lock_.shared());
 
   return worker_->IsPackageAvailable(package);
 }
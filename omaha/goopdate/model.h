@@ -44,13 +44,27 @@ class Model {
   explicit Model(WorkerModelInterface* worker);
   virtual ~Model();
 
+  // Returns the lock for exclusive access to the model. Code that mutates
+  // model objects must hold this lock.
   const Lockable& lock() const { return lock_; }
 
-  // Returns true if the model lock is held by the calling thread.
+  // Returns the lock for shared access to the model. Read-only accessors, such
+  // as the state and progress queries polled by the COM clients, use this lock
+  // so that they run concurrently with each other. The shared lock is granted
+  // to the thread that holds the exclusive lock.
+  const Lockable& shared_lock() const { return lock_.shared(); }
+
+  // Returns true if the model lock is exclusively held by the calling thread.
   bool IsLockedByCaller() const {
     return ::GetCurrentThreadId() == lock_.GetOwner();
   }
 
+  // Returns true if the model lock is held by the calling thread, either
+  // exclusively or shared.
+  bool IsLockedSharedByCaller() const {
+    return lock_.IsHeldByCaller();
+  }
+
   // Creates an AppBundle object in the model.
   shared_ptr<AppBundle> CreateAppBundle(bool is_machine);
 
@@ -90,8 +104,9 @@ class Model {
  private:
   typedef weak_ptr<AppBundle> AppBundleWeakPtr;
 
-  // Serializes access to the model objects. Consider replacing with SWMR lock.
-  LLock lock_;
+  // Serializes access to the model objects. Writers hold the lock exclusively,
+  // read-only accessors hold it shared.
+  ReaderWriterLock lock_;
 
   std::vector<AppBundleWeakPtr> app_bundles_;
   WorkerModelInterface* worker_;
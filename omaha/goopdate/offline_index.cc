@@ -0,0 +1,230 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/offline_index.h"
+#include <string.h>
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+namespace {
+
+// The tables are aligned so that the entries can be read in place.
+const uint32 kTableAlignment = 8;
+
+COMPILE_ASSERT(sizeof(OfflineIndex::Header) == 40, header_size_mismatch);
+COMPILE_ASSERT(sizeof(OfflineIndex::AppEntry) == 24, app_entry_size_mismatch);
+
+// Returns true if the range [offset, offset + size) is within 'limit'.
+bool IsInRange(uint64 offset, uint64 size, uint64 limit) {
+  return offset <= limit && size <= limit - offset;
+}
+
+bool IsValidTable(uint32 offset,
+                  uint32 count,
+                  size_t entry_size,
+                  size_t file_size) {
+  return offset % kTableAlignment == 0 &&
+         IsInRange(offset, static_cast<uint64>(count) * entry_size, file_size);
+}
+
+bool IsLessThan(const GUID& a, const GUID& b) {
+  return memcmp(&a, &b, sizeof(GUID)) < 0;
+}
+
+}  // namespace
+
+OfflineIndex::OfflineIndex()
+    : header_(NULL),
+      apps_(NULL),
+      data_(NULL) {
+}
+
+OfflineIndex::~OfflineIndex() {
+}
+
+HRESULT OfflineIndex::Open(const CString& path) {
+  CORE_LOG(L3, (_T("[OfflineIndex::Open][%s]"), path));
+
+  reset(file_, ::CreateFile(path,
+                            GENERIC_READ,
+                            FILE_SHARE_READ,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL));
+  if (!file_) {
+    return HRESULTFromLastError();
+  }
+
+  LARGE_INTEGER size = {0};
+  if (!::GetFileSizeEx(get(file_), &size)) {
+    return HRESULTFromLastError();
+  }
+  if (size.HighPart || size.LowPart < sizeof(Header)) {
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  reset(file_mapping_, ::CreateFileMapping(get(file_),
+                                           NULL,
+                                           PAGE_READONLY,
+                                           0,
+                                           0,
+                                           NULL));
+  if (!file_mapping_) {
+    return HRESULTFromLastError();
+  }
+
+  reset(file_view_, ::MapViewOfFile(get(file_mapping_),
+                                    FILE_MAP_READ,
+                                    0,
+                                    0,
+                                    size.LowPart));
+  if (!file_view_) {
+    return HRESULTFromLastError();
+  }
+
+  return Load(static_cast<const uint8*>(get(file_view_)), size.LowPart);
+}
+
+HRESULT OfflineIndex::Load(const uint8* data, size_t size) {
+  ASSERT1(data);
+
+  header_ = NULL;
+  apps_ = NULL;
+  data_ = NULL;
+
+  if (size < sizeof(Header)) {
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  const Header* header = reinterpret_cast<const Header*>(data);
+  if (header->magic != kMagic || header->version != kVersion) {
+    CORE_LOG(LE, (_T("[unsupported offline index][0x%08x][%u]"),
+                  header->magic, header->version));
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  if (!IsValidTable(header->apps_offset,
+                    header->num_apps,
+                    sizeof(AppEntry),
+                    size) ||
+      !IsInRange(header->data_offset, header->data_size, size)) {
+    CORE_LOG(LE, (_T("[offline index sections out of range]")));
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  header_ = header;
+  apps_ = reinterpret_cast<const AppEntry*>(data + header->apps_offset);
+  data_ = data + header->data_offset;
+
+  bool is_valid = IsValidText(header->prefix_offset, header->prefix_size) &&
+                  IsValidText(header->suffix_offset, header->suffix_size);
+  for (uint32 i = 0; is_valid && i != header->num_apps; ++i) {
+    const AppEntry& app = apps_[i];
+    is_valid = (!i || IsLessThan(apps_[i - 1].app_id, app.app_id)) &&
+               app.manifest_size &&
+               IsValidText(app.manifest_offset, app.manifest_size);
+  }
+
+  if (!is_valid) {
+    CORE_LOG(LE, (_T("[offline index entries are not valid]")));
+    header_ = NULL;
+    apps_ = NULL;
+    data_ = NULL;
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  CORE_LOG(L3, (_T("[OfflineIndex::Load][%u apps]"), header->num_apps));
+  return S_OK;
+}
+
+size_t OfflineIndex::num_apps() const {
+  return header_ ? header_->num_apps : 0;
+}
+
+bool OfflineIndex::HasApp(const GUID& app_id) const {
+  return FindApp(app_id) != NULL;
+}
+
+HRESULT OfflineIndex::GetBundleManifest(const std::vector<GUID>& app_ids,
+                                        std::vector<uint8>* manifest) const {
+  ASSERT1(manifest);
+
+  if (!header_) {
+    return E_UNEXPECTED;
+  }
+
+  std::vector<const AppEntry*> apps;
+  size_t manifest_size = header_->prefix_size + header_->suffix_size;
+  for (size_t i = 0; i != app_ids.size(); ++i) {
+    const AppEntry* app = FindApp(app_ids[i]);
+    if (!app) {
+      CORE_LOG(LW, (_T("[app not in offline index][%s]"),
+                    GuidToString(app_ids[i])));
+      return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+    }
+    apps.push_back(app);
+    manifest_size += app->manifest_size;
+  }
+
+  manifest->clear();
+  manifest->reserve(manifest_size);
+  AppendText(header_->prefix_offset, header_->prefix_size, manifest);
+  for (size_t i = 0; i != apps.size(); ++i) {
+    AppendText(apps[i]->manifest_offset, apps[i]->manifest_size, manifest);
+  }
+  AppendText(header_->suffix_offset, header_->suffix_size, manifest);
+  return S_OK;
+}
+
+const OfflineIndex::AppEntry* OfflineIndex::FindApp(const GUID& app_id) const {
+  if (!header_) {
+    return NULL;
+  }
+
+  const AppEntry* begin = apps_;
+  const AppEntry* end = apps_ + header_->num_apps;
+  while (begin != end) {
+    const AppEntry* middle = begin + (end - begin) / 2;
+    const int result = memcmp(&middle->app_id, &app_id, sizeof(GUID));
+    if (!result) {
+      return middle;
+    }
+    if (result < 0) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return NULL;
+}
+
+bool OfflineIndex::IsValidText(uint32 offset, uint32 size) const {
+  ASSERT1(header_);
+  return IsInRange(offset, size, header_->data_size);
+}
+
+void OfflineIndex::AppendText(uint32 offset,
+                              uint32 size,
+                              std::vector<uint8>* text) const {
+  ASSERT1(text);
+  text->insert(text->end(), data_ + offset, data_ + offset + size);
+}
+
+}  // namespace omaha
@@ -0,0 +1,111 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// OfflineIndex reads the index of an offline installer. The index lists the
+// apps of the installer with their manifests, so that an install from an
+// offline installer with hundreds of apps does not parse the manifest of every
+// app.
+// The index is written by standalone/offline_index.py when the installer is
+// built. The file is mapped in memory and validated once when it is opened,
+// and the lookups read it in place.
+//
+// The integers are little-endian. The offsets of the sections are relative to
+// the start of the file, and the offsets of the text are relative to the start
+// of the data section.
+//
+//   Header      the magic "OMIX", the version, the count and the sections.
+//   AppEntry[]  sorted by app id, which is a GUID in its memory layout.
+//   Data        the UTF-8 text of the manifests.
+//
+// The manifest of an app is its 'app' element. The manifest of a bundle is the
+// response prefix, followed by the 'app' elements of the apps in the bundle,
+// followed by the response suffix.
+
+#ifndef OMAHA_GOOPDATE_OFFLINE_INDEX_H_
+#define OMAHA_GOOPDATE_OFFLINE_INDEX_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+#include "base/basictypes.h"
+#include "omaha/base/scoped_any.h"
+
+namespace omaha {
+
+class OfflineIndex {
+ public:
+  static const uint32 kMagic = 0x58494d4f;  // "OMIX".
+  static const uint32 kVersion = 1;
+
+  struct Header {
+    uint32 magic;
+    uint32 version;
+    uint32 num_apps;
+    uint32 apps_offset;
+    uint32 data_offset;
+    uint32 data_size;
+    uint32 prefix_offset;
+    uint32 prefix_size;
+    uint32 suffix_offset;
+    uint32 suffix_size;
+  };
+
+  struct AppEntry {
+    GUID app_id;
+    uint32 manifest_offset;
+    uint32 manifest_size;
+  };
+
+  OfflineIndex();
+  ~OfflineIndex();
+
+  // Maps the index file in memory and validates it.
+  HRESULT Open(const CString& path);
+
+  // Validates an index which is already in memory. The memory must outlive
+  // this object. Returns HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if the index
+  // is not valid.
+  HRESULT Load(const uint8* data, size_t size);
+
+  size_t num_apps() const;
+
+  bool HasApp(const GUID& app_id) const;
+
+  // Builds the manifest of a bundle of apps, which is an update response in
+  // UTF-8. Returns HRESULT_FROM_WIN32(ERROR_NOT_FOUND) if an app is not in the
+  // index.
+  HRESULT GetBundleManifest(const std::vector<GUID>& app_ids,
+                            std::vector<uint8>* manifest) const;
+
+ private:
+  const AppEntry* FindApp(const GUID& app_id) const;
+  bool IsValidText(uint32 offset, uint32 size) const;
+  void AppendText(uint32 offset, uint32 size, std::vector<uint8>* text) const;
+
+  scoped_hfile file_;
+  scoped_file_mapping file_mapping_;
+  scoped_file_view file_view_;
+
+  // Point into the index after it has been validated.
+  const Header* header_;
+  const AppEntry* apps_;
+  const uint8* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(OfflineIndex);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_OFFLINE_INDEX_H_
@@ -0,0 +1,182 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "omaha/base/error.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/offline_index.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const char kPrefix[] = "<response protocol=\"3.0\">";
+const char kSuffix[] = "</response>";
+
+const TCHAR* const kTestApps[] = {
+  _T("{CDABE316-39CD-43BA-8440-6D1E0547AEE6}"),
+  _T("{8E472315-1B2A-4E3A-9D2C-4E0B9E1B0A11}"),
+  _T("{2D8B1A7C-0E4F-4A5B-8C6D-7E8F9A0B1C2D}"),
+};
+
+// Returns the manifest of an app, which is its 'app' element.
+CStringA GetAppManifest(const TCHAR* app_id) {
+  CStringA manifest;
+  manifest.Format("<app appid=\"%s\" status=\"ok\"/>", CStringA(app_id));
+  return manifest;
+}
+
+uint32 AppendText(const char* text, size_t size, std::vector<uint8>* data) {
+  const uint32 offset = static_cast<uint32>(data->size());
+  data->insert(data->end(), text, text + size);
+  return offset;
+}
+
+// Builds an index the way offline_index.py does.
+std::vector<uint8> MakeIndex(const TCHAR* const* apps, size_t num_apps) {
+  std::vector<OfflineIndex::AppEntry> app_entries(num_apps);
+  std::vector<uint8> data;
+  for (size_t i = 0; i != num_apps; ++i) {
+    OfflineIndex::AppEntry& app = app_entries[i];
+    EXPECT_SUCCEEDED(StringToGuidSafe(apps[i], &app.app_id));
+    const CStringA manifest(GetAppManifest(apps[i]));
+    app.manifest_offset = AppendText(manifest, manifest.GetLength(), &data);
+    app.manifest_size = manifest.GetLength();
+  }
+
+  for (size_t i = 1; i < num_apps; ++i) {
+    for (size_t j = i; j > 0 &&
+         memcmp(&app_entries[j].app_id,
+                &app_entries[j - 1].app_id,
+                sizeof(GUID)) < 0; --j) {
+      std::swap(app_entries[j], app_entries[j - 1]);
+    }
+  }
+
+  OfflineIndex::Header header = {0};
+  header.magic = OfflineIndex::kMagic;
+  header.version = OfflineIndex::kVersion;
+  header.num_apps = static_cast<uint32>(num_apps);
+  header.prefix_offset = AppendText(kPrefix, strlen(kPrefix), &data);
+  header.prefix_size = static_cast<uint32>(strlen(kPrefix));
+  header.suffix_offset = AppendText(kSuffix, strlen(kSuffix), &data);
+  header.suffix_size = static_cast<uint32>(strlen(kSuffix));
+  header.apps_offset = sizeof(header);
+  header.data_offset = static_cast<uint32>(
+      header.apps_offset + num_apps * sizeof(OfflineIndex::AppEntry));
+  header.data_size = static_cast<uint32>(data.size());
+
+  std::vector<uint8> index(header.data_offset + data.size());
+  memcpy(&index[0], &header, sizeof(header));
+  if (num_apps) {
+    memcpy(&index[header.apps_offset],
+           &app_entries[0],
+           num_apps * sizeof(OfflineIndex::AppEntry));
+  }
+  if (!data.empty()) {
+    memcpy(&index[header.data_offset], &data[0], data.size());
+  }
+  return index;
+}
+
+GUID ToGuid(const TCHAR* app_id) {
+  GUID guid = GUID_NULL;
+  EXPECT_SUCCEEDED(StringToGuidSafe(app_id, &guid));
+  return guid;
+}
+
+OfflineIndex::Header* GetHeader(std::vector<uint8>* index) {
+  return reinterpret_cast<OfflineIndex::Header*>(&index->front());
+}
+
+}  // namespace
+
+TEST(OfflineIndexTest, Load) {
+  const std::vector<uint8> data(MakeIndex(kTestApps, arraysize(kTestApps)));
+  OfflineIndex index;
+  EXPECT_SUCCEEDED(index.Load(&data.front(), data.size()));
+  EXPECT_EQ(arraysize(kTestApps), index.num_apps());
+
+  for (size_t i = 0; i != arraysize(kTestApps); ++i) {
+    EXPECT_TRUE(index.HasApp(ToGuid(kTestApps[i])));
+  }
+  EXPECT_FALSE(index.HasApp(GUID_NULL));
+}
+
+TEST(OfflineIndexTest, GetBundleManifest) {
+  const std::vector<uint8> data(MakeIndex(kTestApps, arraysize(kTestApps)));
+  OfflineIndex index;
+  ASSERT_SUCCEEDED(index.Load(&data.front(), data.size()));
+
+  // The apps are in the order of the bundle, not of the index.
+  std::vector<GUID> app_ids;
+  app_ids.push_back(ToGuid(kTestApps[2]));
+  app_ids.push_back(ToGuid(kTestApps[0]));
+
+  std::vector<uint8> manifest;
+  EXPECT_SUCCEEDED(index.GetBundleManifest(app_ids, &manifest));
+
+  const CStringA expected_manifest = CStringA(kPrefix) +
+                                     GetAppManifest(kTestApps[2]) +
+                                     GetAppManifest(kTestApps[0]) +
+                                     kSuffix;
+  EXPECT_STREQ(expected_manifest,
+               CStringA(reinterpret_cast<const char*>(&manifest.front()),
+                        static_cast<int>(manifest.size())));
+
+  app_ids.push_back(GUID_NULL);
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_NOT_FOUND),
+            index.GetBundleManifest(app_ids, &manifest));
+}
+
+TEST(OfflineIndexTest, Load_Invalid) {
+  const std::vector<uint8> data(MakeIndex(kTestApps, arraysize(kTestApps)));
+  OfflineIndex index;
+
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            index.Load(&data.front(), sizeof(OfflineIndex::Header) - 1));
+
+  std::vector<uint8> invalid(data);
+  GetHeader(&invalid)->version = OfflineIndex::kVersion + 1;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            index.Load(&invalid.front(), invalid.size()));
+
+  // The data section runs past the end of the file.
+  invalid = data;
+  GetHeader(&invalid)->data_size = 0xffffffff;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            index.Load(&invalid.front(), invalid.size()));
+
+  // The count of apps overflows the size of the table.
+  invalid = data;
+  GetHeader(&invalid)->num_apps = 0x10000000;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            index.Load(&invalid.front(), invalid.size()));
+
+  // The apps are not sorted.
+  invalid = data;
+  uint8* first_app = &invalid[GetHeader(&invalid)->apps_offset];
+  std::swap_ranges(first_app,
+                   first_app + sizeof(GUID),
+                   first_app + sizeof(OfflineIndex::AppEntry));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            index.Load(&invalid.front(), invalid.size()));
+  EXPECT_EQ(0, index.num_apps());
+}
+
+}  // namespace omaha
@@ -19,6 +19,8 @@
 #include "omaha/base/file.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/offline_index.h"
 
 namespace omaha {
 
@@ -69,15 +71,41 @@ HRESULT FindV2OfflinePackagePath(const CString& offline_app_dir,
   return S_OK;
 }
 
-HRESULT ParseOfflineManifest(const CString& app_id,
+HRESULT ParseOfflineManifest(const std::vector<CString>& app_ids,
                              const CString& offline_dir,
                              xml::UpdateResponse* update_response) {
-  CORE_LOG(L3, (_T("[ParseOfflineManifest][%s][%s]"), app_id, offline_dir));
+  ASSERT1(!app_ids.empty());
   ASSERT1(update_response);
+  CORE_LOG(L3, (_T("[ParseOfflineManifest][%s][%Iu apps]"),
+                offline_dir, app_ids.size()));
+
+  // An installer with many apps has a large manifest, of which a bundle needs
+  // only a few apps.
+  OfflineIndex index;
+  if (SUCCEEDED(OpenOfflineIndex(offline_dir, &index))) {
+    std::vector<GUID> guids(app_ids.size());
+    HRESULT hr = S_OK;
+    for (size_t i = 0; SUCCEEDED(hr) && i != app_ids.size(); ++i) {
+      hr = StringToGuidSafe(app_ids[i], &guids[i]);
+    }
+
+    std::vector<uint8> manifest;
+    if (SUCCEEDED(hr)) {
+      hr = index.GetBundleManifest(guids, &manifest);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = update_response->Deserialize(manifest);
+      if (SUCCEEDED(hr)) {
+        return S_OK;
+      }
+    }
+
+    CORE_LOG(LW, (_T("[offline index manifest failed][0x%x]"), hr));
+  }
 
   CString manifest_path(ConcatenatePath(offline_dir, kOfflineManifestFileName));
   if (!File::Exists(manifest_path)) {
-    manifest_path = GetV2OfflineManifest(app_id, offline_dir);
+    manifest_path = GetV2OfflineManifest(app_ids[0], offline_dir);
   }
 
   HRESULT hr = update_response->DeserializeFromFile(manifest_path);
@@ -90,6 +118,24 @@ HRESULT ParseOfflineManifest(const CString& app_id,
   return S_OK;
 }
 
+HRESULT OpenOfflineIndex(const CString& offline_dir, OfflineIndex* index) {
+  ASSERT1(index);
+
+  const CString index_path(ConcatenatePath(offline_dir, kOfflineIndexFileName));
+  if (!File::Exists(index_path)) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  HRESULT hr = index->Open(index_path);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[OfflineIndex::Open failed][%s][0x%x]"),
+                  index_path, hr));
+    return hr;
+  }
+
+  return S_OK;
+}
+
 }  // namespace offline_utils
 
 }  // namespace omaha
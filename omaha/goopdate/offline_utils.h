@@ -18,10 +18,14 @@
 
 #include <windows.h>
 #include <atlstr.h>
+#include <vector>
+#include "base/basictypes.h"
 #include "omaha/common/update_response.h"
 
 namespace omaha {
 
+class OfflineIndex;
+
 namespace offline_utils {
 
 CString GetV2OfflineManifest(const CString& app_id,
@@ -30,9 +34,17 @@ CString GetV2OfflineManifest(const CString& app_id,
 HRESULT FindV2OfflinePackagePath(const CString& offline_app_dir,
                                  CString* package_path);
 
-HRESULT ParseOfflineManifest(const CString& app_id,
+// Parses the manifest of the apps of an offline install. If the installer has
+// an offline index, only the manifests of the apps in 'app_ids' are parsed.
+// Otherwise, the offline manifest of the installer is parsed, or the v2
+// manifest of the first app.
+HRESULT ParseOfflineManifest(const std::vector<CString>& app_ids,
                              const CString& offline_dir,
                              xml::UpdateResponse* update_response);
+
+// Opens the offline index of the installer, if it has one.
+HRESULT OpenOfflineIndex(const CString& offline_dir, OfflineIndex* index);
+
 }  // namespace offline_utils
 
 }  // namespace omaha
@@ -15,6 +15,8 @@
 
 #include "omaha/goopdate/offline_utils.h"
 #include <atlpath.h>
+#include <string.h>
+#include <vector>
 #include "omaha/base/app_util.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
@@ -22,6 +24,7 @@
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/utils.h"
+#include "omaha/goopdate/offline_index.h"
 #include "omaha/goopdate/update_response_utils.h"
 #include "omaha/testing/resource.h"
 #include "omaha/testing/unit_test.h"
@@ -31,6 +34,7 @@ namespace omaha {
 namespace {
 
 const TCHAR* kAppId1 = _T("{CDABE316-39CD-43BA-8440-6D1E0547AEE6}");
+const TCHAR* kAppId2 = _T("{8E472315-1B2A-4E3A-9D2C-4E0B9E1B0A11}");
 
 void CheckResponse(const xml::response::Response& xml_response,
                    const TCHAR* expected_protocol_version) {
@@ -99,13 +103,18 @@ void CheckResponse(const xml::response::Response& xml_response,
             update_response_utils::GetInstallData(app.data, _T("foo"), &value));
 }
 
-void ParseAndCheck(const TCHAR* source_manifest_extension,
-                   const TCHAR* target_manifest_filename,
-                   const TCHAR* expected_protocol_version) {
+CString GetSourceManifestPath(const TCHAR* source_manifest_extension) {
   CString source_manifest_path = ConcatenatePath(
       app_util::GetCurrentModuleDirectory(), _T("unittest_support"));
   source_manifest_path = ConcatenatePath(source_manifest_path, kAppId1);
-  source_manifest_path += source_manifest_extension;
+  return source_manifest_path + source_manifest_extension;
+}
+
+void ParseAndCheck(const TCHAR* source_manifest_extension,
+                   const TCHAR* target_manifest_filename,
+                   const TCHAR* expected_protocol_version) {
+  CString source_manifest_path(
+      GetSourceManifestPath(source_manifest_extension));
 
   CString target_manifest_path = ConcatenatePath(
       app_util::GetCurrentModuleDirectory(), target_manifest_filename);
@@ -116,7 +125,7 @@ void ParseAndCheck(const TCHAR* source_manifest_extension,
   scoped_ptr<xml::UpdateResponse> update_response(
       xml::UpdateResponse::Create());
   EXPECT_SUCCEEDED(offline_utils::ParseOfflineManifest(
-                       kAppId1,
+                       std::vector<CString>(1, kAppId1),
                        app_util::GetCurrentModuleDirectory(),
                        update_response.get()));
 
@@ -125,10 +134,79 @@ void ParseAndCheck(const TCHAR* source_manifest_extension,
   EXPECT_SUCCEEDED(File::Remove(target_manifest_path));
 }
 
+// Builds the offline index of the v3 manifest, the way offline_index.py does.
+std::vector<byte> MakeOfflineIndex() {
+  std::vector<byte> manifest;
+  EXPECT_SUCCEEDED(ReadEntireFile(GetSourceManifestPath(_T(".v3.gup")),
+                                  0,
+                                  &manifest));
+  const CStringA text(reinterpret_cast<const char*>(&manifest.front()),
+                      static_cast<int>(manifest.size()));
+  const int app_start = text.Find("<app ");
+  const int app_end = text.Find("</app>") + static_cast<int>(strlen("</app>"));
+  EXPECT_LT(0, app_start);
+  EXPECT_LT(app_start, app_end);
+
+  OfflineIndex::Header header = {0};
+  header.magic = OfflineIndex::kMagic;
+  header.version = OfflineIndex::kVersion;
+  header.num_apps = 1;
+  header.apps_offset = sizeof(header);
+  header.data_offset = sizeof(header) + sizeof(OfflineIndex::AppEntry);
+  header.data_size = static_cast<uint32>(manifest.size());
+  header.prefix_offset = 0;
+  header.prefix_size = app_start;
+  header.suffix_offset = app_end;
+  header.suffix_size = static_cast<uint32>(manifest.size()) - app_end;
+
+  OfflineIndex::AppEntry app = {0};
+  EXPECT_SUCCEEDED(StringToGuidSafe(kAppId1, &app.app_id));
+  app.manifest_offset = app_start;
+  app.manifest_size = app_end - app_start;
+
+  std::vector<byte> index(header.data_offset);
+  memcpy(&index[0], &header, sizeof(header));
+  memcpy(&index[header.apps_offset], &app, sizeof(app));
+  index.insert(index.end(), manifest.begin(), manifest.end());
+  return index;
+}
+
 }  // namespace
 
 namespace offline_utils {
 
+class OfflineUtilsIndexTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    offline_dir_ = ConcatenatePath(app_util::GetCurrentModuleDirectory(),
+                                   _T("offline_index_test"));
+    EXPECT_SUCCEEDED(CreateDir(offline_dir_, NULL));
+  }
+
+  virtual void TearDown() {
+    EXPECT_SUCCEEDED(DeleteDirectory(offline_dir_));
+  }
+
+  void WriteIndex(const std::vector<byte>& index) {
+    EXPECT_SUCCEEDED(WriteEntireFile(
+        ConcatenatePath(offline_dir_, kOfflineIndexFileName), index));
+  }
+
+  void WriteManifest() {
+    EXPECT_SUCCEEDED(File::Copy(
+        GetSourceManifestPath(_T(".v3.gup")),
+        ConcatenatePath(offline_dir_, kOfflineManifestFileName),
+        true));
+  }
+
+  HRESULT Parse(const std::vector<CString>& app_ids,
+                xml::UpdateResponse* update_response) {
+    return ParseOfflineManifest(app_ids, offline_dir_, update_response);
+  }
+
+  CString offline_dir_;
+};
+
 TEST(OfflineUtilsTest, GetV2OfflineManifest) {
   CString manifest_path = offline_utils::GetV2OfflineManifest(
       kAppId1, app_util::GetCurrentModuleDirectory());
@@ -182,11 +260,75 @@ TEST(OfflineUtilsTest, ParseOfflineManifest_FileDoesNotExist) {
       xml::UpdateResponse::Create());
   EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
             offline_utils::ParseOfflineManifest(
-                               kAppId1,
+                               std::vector<CString>(1, kAppId1),
                                app_util::GetCurrentModuleDirectory(),
                                update_response.get()));
 }
 
+// Only the index is present, so the manifest can only come from the index.
+TEST_F(OfflineUtilsIndexTest, ParseOfflineManifest_Index) {
+  WriteIndex(MakeOfflineIndex());
+
+  scoped_ptr<xml::UpdateResponse> update_response(
+      xml::UpdateResponse::Create());
+  EXPECT_SUCCEEDED(Parse(std::vector<CString>(1, kAppId1),
+                         update_response.get()));
+  CheckResponse(update_response->response(), _T("3.0"));
+}
+
+// An app which is not in the index is looked up in the full manifest.
+TEST_F(OfflineUtilsIndexTest, ParseOfflineManifest_AppNotInIndex) {
+  WriteIndex(MakeOfflineIndex());
+
+  std::vector<CString> app_ids;
+  app_ids.push_back(kAppId1);
+  app_ids.push_back(kAppId2);
+
+  scoped_ptr<xml::UpdateResponse> update_response(
+      xml::UpdateResponse::Create());
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            Parse(app_ids, update_response.get()));
+
+  WriteManifest();
+  update_response.reset(xml::UpdateResponse::Create());
+  EXPECT_SUCCEEDED(Parse(app_ids, update_response.get()));
+  CheckResponse(update_response->response(), _T("3.0"));
+}
+
+// An app id which is not a GUID is looked up in the full manifest.
+TEST_F(OfflineUtilsIndexTest, ParseOfflineManifest_InvalidAppId) {
+  WriteIndex(MakeOfflineIndex());
+  WriteManifest();
+
+  std::vector<CString> app_ids;
+  app_ids.push_back(kAppId1);
+  app_ids.push_back(_T("not a guid"));
+
+  scoped_ptr<xml::UpdateResponse> update_response(
+      xml::UpdateResponse::Create());
+  EXPECT_SUCCEEDED(Parse(app_ids, update_response.get()));
+  CheckResponse(update_response->response(), _T("3.0"));
+}
+
+// An index which is not valid is ignored.
+TEST_F(OfflineUtilsIndexTest, ParseOfflineManifest_InvalidIndex) {
+  std::vector<byte> index(MakeOfflineIndex());
+  reinterpret_cast<OfflineIndex::Header*>(&index.front())->version =
+      OfflineIndex::kVersion + 1;
+  WriteIndex(index);
+
+  scoped_ptr<xml::UpdateResponse> update_response(
+      xml::UpdateResponse::Create());
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            Parse(std::vector<CString>(1, kAppId1), update_response.get()));
+
+  WriteManifest();
+  update_response.reset(xml::UpdateResponse::Create());
+  EXPECT_SUCCEEDED(Parse(std::vector<CString>(1, kAppId1),
+                         update_response.get()));
+  CheckResponse(update_response->response(), _T("3.0"));
+}
+
 }  // namespace offline_utils
 
 }  // namespace omaha
@@ -189,6 +189,8 @@ class ATL_NO_VTABLE OnDemand
                          dup_impersonation_token.GetHandle(),
                          dup_primary_token.GetHandle(),
                          &on_demand_gate)));
+    // The caller blocks until the work item starts.
+    callback->set_priority(UserWorkItem::kPriorityUrgent);
 
     hr = Goopdate::Instance().QueueUserWorkItem(callback.get(),
                                                 COINIT_APARTMENTTHREADED,
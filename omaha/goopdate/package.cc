@@ -45,7 +45,7 @@ AppVersion* Package::app_version() {
 }
 
 const AppVersion* Package::app_version() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return app_version_;
 }
 
@@ -60,7 +60,7 @@ STDMETHODIMP Package::get_isAvailable(VARIANT_BOOL* is_available) const {
 }
 
 STDMETHODIMP Package::get_filename(BSTR* filename_as_bstr) const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(filename_as_bstr);
   *filename_as_bstr = CComBSTR(filename()).Detach();
   return S_OK;
@@ -100,10 +100,23 @@ void Package::OnProgress(int bytes,
   //         bytes_total == static_cast<int>(expected_size_));
   ASSERT1(bytes <= bytes_total);
 
+  // The clients are notified once for each percent of the package which is
+  // downloaded instead of once for each read.
+  const int previous_percentage = GetPercentage(bytes_downloaded_,
+                                                bytes_total_);
+
   bytes_downloaded_ = bytes;
   bytes_total_ = bytes_total;
 
   progress_sampler_.AddSampleWithCurrentTimeStamp(bytes_downloaded_);
+
+  if (GetPercentage(bytes_downloaded_, bytes_total_) != previous_percentage) {
+    app_version_->app()->app_bundle()->NotifyProgress();
+  }
+}
+
+int Package::GetPercentage(int bytes, int bytes_total) {
+  return bytes_total > 0 ? static_cast<int>(100LL * bytes / bytes_total) : -1;
 }
 
 void Package::OnRequestBegin() {
@@ -118,6 +131,7 @@ void Package::OnRequestRetryScheduled(time64 next_download_retry_time) {
   __mutexScope(model()->lock());
   ASSERT1(next_download_retry_time >= GetCurrent100NSTime());
   next_download_retry_time_ = next_download_retry_time;
+  app_version_->app()->app_bundle()->NotifyProgress();
 }
 
 void Package::SetFileInfo(const CString& filename,
@@ -135,34 +149,34 @@ void Package::SetFileInfo(const CString& filename,
 }
 
 CString Package::filename() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(!filename_.IsEmpty());
   return filename_;
 }
 
 uint64 Package::expected_size() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return expected_size_;
 }
 
 FileHash Package::expected_hash() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   ASSERT1(!expected_hash_.sha256.IsEmpty() ||!expected_hash_.sha1.IsEmpty());
   return expected_hash_;
 }
 
 uint64 Package::bytes_downloaded() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return bytes_downloaded_;
 }
 
 time64 Package::next_download_retry_time() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return next_download_retry_time_;
 }
 
 LONG Package::GetEstimatedRemainingDownloadTimeMs() const {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
 
   const LONG kUnknownRemainingTime = -1;
 
@@ -189,17 +203,17 @@ LONG Package::GetEstimatedRemainingDownloadTimeMs() const {
 }
 
 STDMETHODIMP PackageWrapper::get(BSTR dir) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get(dir);
 }
 
 STDMETHODIMP PackageWrapper::get_isAvailable(VARIANT_BOOL* is_available) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_isAvailable(is_available);
 }
 
 STDMETHODIMP PackageWrapper::get_filename(BSTR* filename) {
-  __mutexScope(model()->lock());
+  __mutexScope(model()->shared_lock());
   return wrapped_obj()->get_filename(filename);
 }
 
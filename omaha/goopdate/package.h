@@ -79,6 +79,10 @@ class Package
   LONG GetEstimatedRemainingDownloadTimeMs() const;
 
  private:
+  // Returns the percentage of the package which is downloaded, or -1 if the
+  // size of the package is not known.
+  static int GetPercentage(int bytes, int bytes_total);
+
   // Weak reference to the parent of the package.
   AppVersion* app_version_;
 
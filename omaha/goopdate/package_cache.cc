@@ -24,7 +24,9 @@
 #include "omaha/base/string.h"
 #include "omaha/base/signatures.h"
 #include "omaha/base/signaturevalidator.h"
+#include "omaha/base/span_trace.h"
 #include "omaha/base/utils.h"
+#include "omaha/base/version.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/goopdate/file_hash.h"
 #include "omaha/goopdate/package_cache_internal.h"
@@ -194,6 +196,7 @@ bool PackageCache::IsCached(const Key& key, const FileHash& hash) const {
 HRESULT PackageCache::Put(const Key& key,
                           const CString& source_file,
                           const FileHash& hash) {
+  TRACE_NESTED_SPAN("PackageCache::Put");
   ++metric_worker_package_cache_put_total;
   CORE_LOG(L3, (_T("[PackageCache::Put][key '%s'][source_file '%s'][hash %s]"),
                 key.ToString(), source_file, internal::GetHashString(hash)));
@@ -311,8 +314,8 @@ HRESULT PackageCache::PurgeAppLowerVersions(const CString& app_id,
 
   __mutexScope(cache_lock_);
 
-  ULONGLONG my_version = VersionFromString(version);
-  if (!my_version) {
+  Version my_version;
+  if (!Version::Parse(version, &my_version) || my_version.IsZero()) {
     return E_INVALIDARG;
   }
 
@@ -337,8 +340,11 @@ HRESULT PackageCache::PurgeAppLowerVersions(const CString& app_id,
     }
     ASSERT1(internal::IsSubDirectoryFindData(find_data));
 
-    ULONGLONG found_version = VersionFromString(find_data.cFileName);
-    if (!found_version || found_version >= my_version) {
+    // The directory names are parsed in place, without copying them.
+    Version found_version;
+    if (!Version::Parse(find_data.cFileName, &found_version) ||
+        found_version.IsZero() ||
+        found_version >= my_version) {
       CORE_LOG(L2, (_T("[Not purging version][%s]"), find_data.cFileName));
       continue;
     }
@@ -485,6 +491,7 @@ HRESULT PackageCache::VerifyHash(const CString& filename,
                                  const FileHash& expected_hash) {
   CORE_LOG(L3, (_T("[PackageCache::VerifyHash][%s][%s]"),
            filename, internal::GetHashString(expected_hash)));
+  TRACE_NESTED_SPAN("PackageCache::VerifyHash");
   HighresTimer verification_timer;
 
   std::vector<CString> files;
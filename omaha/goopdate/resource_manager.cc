@@ -17,6 +17,7 @@
 #include <windows.h>
 #include <map>
 #include <vector>
+#include "base/scoped_ptr.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/commontypes.h"
 #include "omaha/base/debug.h"
@@ -29,6 +30,7 @@
 #include "omaha/base/utils.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/lang.h"
+#include "omaha/goopdate/message_catalog.h"
 
 namespace omaha {
 
@@ -74,6 +76,12 @@ ResourceManager::ResourceManager(bool is_machine, const CString& resource_dir)
 }
 
 ResourceManager::~ResourceManager() {
+  for (LanguageToCatalogMap::iterator it = catalog_map_.begin();
+       it != catalog_map_.end();
+       ++it) {
+    delete it->second;
+  }
+
   if (saved_atl_resource_) {
     _AtlBaseModule.SetResourceInstance(saved_atl_resource_);
   }
@@ -106,6 +114,56 @@ HRESULT ResourceManager::GetResourceDll(const CString& language,
   return S_OK;
 }
 
+HRESULT ResourceManager::LoadString(const CString& language,
+                                    int32 message_id,
+                                    CString* message) {
+  ASSERT1(message);
+
+  __mutexScope(lock_);
+
+  const MessageCatalog* catalog = NULL;
+  HRESULT hr = GetMessageCatalog(language, &catalog);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (!catalog->FindMessage(message_id, message)) {
+    return HRESULT_FROM_WIN32(ERROR_RESOURCE_NAME_NOT_FOUND);
+  }
+  return S_OK;
+}
+
+HRESULT ResourceManager::GetMessageCatalog(const CString& language,
+                                           const MessageCatalog** catalog) {
+  ASSERT1(catalog);
+
+  __mutexScope(lock_);
+
+  LanguageToCatalogMap::const_iterator it = catalog_map_.find(language);
+  if (it != catalog_map_.end()) {
+    *catalog = it->second;
+    return S_OK;
+  }
+
+  ResourceDllInfo dll_info;
+  HRESULT hr = GetResourceDllInfo(language, &dll_info);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  scoped_ptr<MessageCatalog> new_catalog(new MessageCatalog);
+  hr = new_catalog->Load(dll_info.dll_handle);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[MessageCatalog::Load failed][%s][0x%08x]"),
+                  dll_info.file_path, hr));
+    return hr;
+  }
+
+  *catalog = new_catalog.get();
+  catalog_map_.insert(std::make_pair(language, new_catalog.release()));
+  return S_OK;
+}
+
 HRESULT ResourceManager::GetResourceDllInfo(const CString& language,
                                             ResourceDllInfo* dll_info) {
   ASSERT1(dll_info);
@@ -26,6 +26,8 @@
 
 namespace omaha {
 
+class MessageCatalog;
+
 class ResourceManager {
  public:
   // Create must be called before going multithreaded.
@@ -44,6 +46,13 @@ class ResourceManager {
   // necessary.
   HRESULT GetResourceDll(const CString& language, HINSTANCE* dll_handle);
 
+  // Loads the string 'message_id' for the given language. The string table of
+  // the resource DLL is read into a message catalog the first time a string
+  // is loaded for the language, and later lookups are served from it.
+  HRESULT LoadString(const CString& language,
+                     int32 message_id,
+                     CString* message);
+
  private:
   struct ResourceDllInfo {
     ResourceDllInfo() : dll_handle(NULL) {}
@@ -71,14 +80,21 @@ class ResourceManager {
   HRESULT GetResourceDllInfo(const CString& language,
                              ResourceDllInfo* dll_info);
 
+  // Gets the message catalog for the given language. The catalog will be
+  // created if necessary.
+  HRESULT GetMessageCatalog(const CString& language,
+                            const MessageCatalog** catalog);
+
   static CString GetResourceDllName(const CString& language);
 
   LLock lock_;
   typedef std::map<CString, ResourceDllInfo> LanguageToResourceMap;
+  typedef std::map<CString, MessageCatalog*> LanguageToCatalogMap;
 
   bool is_machine_;
   CString resource_dir_;
   LanguageToResourceMap resource_map_;
+  LanguageToCatalogMap catalog_map_;
   HINSTANCE saved_atl_resource_;
 
   static ResourceManager* instance_;
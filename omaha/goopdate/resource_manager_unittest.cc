@@ -136,6 +136,28 @@ TEST_F(ResourceManagerTest, GetResourceDllName_SpecialCases) {
   EXPECT_STREQ(_T("goopdateres_iw.dll"), GetResourceDllName(_T("he")));
 }
 
+TEST_F(ResourceManagerTest, LoadString) {
+  CString message;
+  EXPECT_SUCCEEDED(ResourceManager::Instance().LoadString(_T("en"),
+                                                          IDS_CLOSE,
+                                                          &message));
+  EXPECT_STREQ(_T("Close"), message);
+
+  EXPECT_SUCCEEDED(ResourceManager::Instance().LoadString(_T("fr"),
+                                                          IDS_CLOSE,
+                                                          &message));
+  EXPECT_STREQ(_T("Fermer"), message);
+
+  // The catalog of the language is reused.
+  EXPECT_SUCCEEDED(ResourceManager::Instance().LoadString(_T("en"),
+                                                          IDS_CLOSE,
+                                                          &message));
+  EXPECT_STREQ(_T("Close"), message);
+
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_RESOURCE_NAME_NOT_FOUND),
+            ResourceManager::Instance().LoadString(_T("en"), 0, &message));
+}
+
 TEST_F(ResourceManagerTest, LoadResourceFail) {
   SetMachine(false);
 
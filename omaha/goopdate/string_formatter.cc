@@ -30,29 +30,9 @@ StringFormatter::StringFormatter(const CString& language)
 HRESULT StringFormatter::LoadString(int32 resource_id, CString* result) {
   ASSERT1(result);
 
-  HINSTANCE resource_handle = NULL;
-  HRESULT hr = ResourceManager::Instance().GetResourceDll(language_,
-                                                          &resource_handle);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  const TCHAR* resource_string = NULL;
-  int string_length = ::LoadString(
-      resource_handle,
-      resource_id,
-      reinterpret_cast<TCHAR*>(&resource_string),
-      0);
-  if (string_length <= 0) {
-    return HRESULTFromLastError();
-  }
-  ASSERT1(resource_string && *resource_string);
-
-  // resource_string is the string starting point but not null-terminated, so
-  // explicitly copy from it for string_length characters.
-  result->SetString(resource_string, string_length);
-
-  return S_OK;
+  return ResourceManager::Instance().LoadString(language_,
+                                                resource_id,
+                                                result);
 }
 
 HRESULT StringFormatter::FormatMessage(CString* result, int32 format_id, ...) {
@@ -0,0 +1,272 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/update_check_broker.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/signatures.h"
+#include "omaha/base/time.h"
+#include "omaha/common/update_request.h"
+#include "omaha/common/update_response.h"
+#include "omaha/common/web_services_client.h"
+
+namespace omaha {
+
+UpdateCheckBroker::Check::Check()
+    : hr(E_PENDING),
+      completed_ms(0),
+      num_waiters(0),
+      is_cached(true) {
+}
+
+UpdateCheckBroker::Check::~Check() {
+}
+
+UpdateCheckBroker::UpdateCheckBroker(int response_cache_time_ms)
+    : response_cache_time_ms_(response_cache_time_ms),
+      num_requests_sent_(0) {
+  ASSERT1(response_cache_time_ms >= 0);
+}
+
+UpdateCheckBroker::~UpdateCheckBroker() {
+  __mutexScope(lock_);
+  for (Checks::iterator it = checks_.begin(); it != checks_.end(); ++it) {
+    ASSERT1(!it->second->num_waiters);
+    delete it->second;
+  }
+}
+
+HRESULT UpdateCheckBroker::Send(WebServicesClientInterface* update_check_client,
+                                HANDLE cancel_event,
+                                const xml::UpdateRequest* update_request,
+                                xml::UpdateResponse* update_response,
+                                WebServicesClientResult* result) {
+  ASSERT1(update_check_client);
+  ASSERT1(update_request);
+  ASSERT1(update_response);
+  ASSERT1(result);
+
+  RequestKey key;
+  HRESULT hr = GetRequestKey(*update_request, &key);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[GetRequestKey failed][0x%08x]"), hr));
+    return SendUnshared(update_check_client,
+                        update_request,
+                        update_response,
+                        result);
+  }
+
+  Check* check = NULL;
+  bool is_sender = false;
+  {
+    __mutexScope(lock_);
+    RemoveExpiredChecks(GetCurrentMsTime());
+
+    Checks::const_iterator it = checks_.find(key);
+    if (it != checks_.end()) {
+      check = it->second;
+      if (check->completed_ms) {
+        // Only the checks which succeeded remain after they complete.
+        ASSERT1(SUCCEEDED(check->hr));
+        CORE_LOG(L3, (_T("[UpdateCheckBroker][reusing response]")));
+        update_response->CopyFrom(*check->update_response);
+        *result = check->result;
+        return check->hr;
+      }
+      ++check->num_waiters;
+    } else {
+      scoped_ptr<Check> new_check(new Check);
+      reset(new_check->done_event, ::CreateEvent(NULL, true, false, NULL));
+      if (new_check->done_event) {
+        new_check->update_response.reset(xml::UpdateResponse::Create());
+        check = new_check.release();
+        checks_[key] = check;
+        is_sender = true;
+      }
+    }
+  }
+
+  if (!check) {
+    return SendUnshared(update_check_client,
+                        update_request,
+                        update_response,
+                        result);
+  }
+
+  return is_sender ? SendCheck(key,
+                               check,
+                               update_check_client,
+                               update_request,
+                               update_response,
+                               result) :
+                     WaitForCheck(check,
+                                  update_check_client,
+                                  cancel_event,
+                                  update_request,
+                                  update_response,
+                                  result);
+}
+
+HRESULT UpdateCheckBroker::SendCheck(
+    const RequestKey& key,
+    Check* check,
+    WebServicesClientInterface* update_check_client,
+    const xml::UpdateRequest* update_request,
+    xml::UpdateResponse* update_response,
+    WebServicesClientResult* result) {
+  ASSERT1(check);
+
+  const HRESULT hr = SendUnshared(update_check_client,
+                                  update_request,
+                                  update_response,
+                                  result);
+
+  __mutexScope(lock_);
+  check->hr = hr;
+  check->result = *result;
+  check->completed_ms = GetCurrentMsTime();
+  if (SUCCEEDED(hr)) {
+    check->update_response->CopyFrom(*update_response);
+  } else {
+    // The waiters get the error but later checks send a new request.
+    checks_.erase(key);
+    check->is_cached = false;
+  }
+
+  VERIFY1(::SetEvent(get(check->done_event)));
+  if (!check->is_cached && !check->num_waiters) {
+    delete check;
+  }
+  return hr;
+}
+
+HRESULT UpdateCheckBroker::WaitForCheck(
+    Check* check,
+    WebServicesClientInterface* update_check_client,
+    HANDLE cancel_event,
+    const xml::UpdateRequest* update_request,
+    xml::UpdateResponse* update_response,
+    WebServicesClientResult* result) {
+  ASSERT1(check);
+
+  CORE_LOG(L3, (_T("[UpdateCheckBroker][waiting for identical check]")));
+  const HANDLE events[] = {get(check->done_event), cancel_event};
+  const DWORD num_events = cancel_event ? arraysize(events) : 1;
+  const DWORD wait_result =
+      ::WaitForMultipleObjects(num_events, events, false, INFINITE);
+  ASSERT1(wait_result == WAIT_OBJECT_0 || wait_result == WAIT_OBJECT_0 + 1);
+
+  HRESULT hr = S_OK;
+  {
+    __mutexScope(lock_);
+    if (wait_result != WAIT_OBJECT_0) {
+      CORE_LOG(L3, (_T("[UpdateCheckBroker][wait canceled]")));
+      ReleaseWaiter(check);
+      return GOOPDATE_E_CANCELLED;
+    }
+
+    hr = check->hr;
+    if (SUCCEEDED(hr)) {
+      update_response->CopyFrom(*check->update_response);
+    }
+    *result = check->result;
+    ReleaseWaiter(check);
+  }
+
+  if (hr == GOOPDATE_E_CANCELLED) {
+    // The bundle which sent the check was canceled, this one was not.
+    return SendUnshared(update_check_client,
+                        update_request,
+                        update_response,
+                        result);
+  }
+
+  return hr;
+}
+
+HRESULT UpdateCheckBroker::SendUnshared(
+    WebServicesClientInterface* update_check_client,
+    const xml::UpdateRequest* update_request,
+    xml::UpdateResponse* update_response,
+    WebServicesClientResult* result) {
+  ASSERT1(update_check_client);
+  ASSERT1(result);
+
+  ::InterlockedIncrement(&num_requests_sent_);
+  const HRESULT hr = update_check_client->Send(update_request,
+                                               update_response);
+  *result = WebServicesClientResult(*update_check_client);
+  return hr;
+}
+
+void UpdateCheckBroker::ReleaseWaiter(Check* check) {
+  ASSERT1(check);
+  ASSERT1(check->num_waiters > 0);
+
+  if (!--check->num_waiters && !check->is_cached) {
+    delete check;
+  }
+}
+
+void UpdateCheckBroker::RemoveExpiredChecks(uint64 now_ms) {
+  Checks::iterator it = checks_.begin();
+  while (it != checks_.end()) {
+    Check* check = it->second;
+    if (!check->completed_ms ||
+        now_ms - check->completed_ms < static_cast<uint64>(
+                                           response_cache_time_ms_)) {
+      ++it;
+      continue;
+    }
+
+    // Checks which still have waiters are deleted by their last waiter.
+    check->is_cached = false;
+    if (!check->num_waiters) {
+      delete check;
+    }
+    checks_.erase(it++);
+  }
+}
+
+HRESULT UpdateCheckBroker::GetRequestKey(
+    const xml::UpdateRequest& update_request,
+    RequestKey* key) {
+  ASSERT1(key);
+
+  CString request_string;
+  HRESULT hr = update_request.Serialize(&request_string);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  const xml::request::Request& request = update_request.request();
+  if (!request.request_id.IsEmpty()) {
+    request_string.Replace(request.request_id, _T(""));
+  }
+  if (!request.session_id.IsEmpty()) {
+    request_string.Replace(request.session_id, _T(""));
+  }
+
+  const uint8* data =
+      reinterpret_cast<const uint8*>(request_string.GetString());
+  const std::vector<uint8> buffer(
+      data, data + request_string.GetLength() * sizeof(TCHAR));
+
+  CryptoHash crypto_hash(CryptoHash::kSha256);
+  return crypto_hash.Compute(buffer, key);
+}
+
+}  // namespace omaha
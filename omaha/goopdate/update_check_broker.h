@@ -0,0 +1,134 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// UpdateCheckBroker coalesces the update checks which the bundles of a server
+// process send for the same apps. Update3Web, OnDemand and the /ua bundles of
+// the same process can check the same apps a few seconds apart. When a check
+// is in flight, identical checks wait for its response instead of sending their
+// own request, and a successful response is reused for a short time.
+//
+// Checks are identical when their requests are the same except for the request
+// and the session ids, which are unique to each bundle. The requests are keyed
+// by a hash of their serialized form.
+
+#ifndef OMAHA_GOOPDATE_UPDATE_CHECK_BROKER_H_
+#define OMAHA_GOOPDATE_UPDATE_CHECK_BROKER_H_
+
+#include <windows.h>
+#include <map>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/scoped_ptr.h"
+#include "omaha/base/scoped_any.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/common/web_services_client.h"
+
+namespace omaha {
+
+namespace xml {
+
+class UpdateRequest;
+class UpdateResponse;
+
+}  // namespace xml
+
+class UpdateCheckBroker {
+ public:
+  // How long a successful response is reused.
+  static const int kDefaultResponseCacheTimeMs = 30 * 1000;
+
+  explicit UpdateCheckBroker(int response_cache_time_ms);
+  ~UpdateCheckBroker();
+
+  // Sends the update check with 'update_check_client', or waits for the
+  // response of an identical check. 'result' receives the outcome of the http
+  // transaction which produced the response, which is not the transaction of
+  // 'update_check_client' when the response is shared. A waiting caller
+  // returns GOOPDATE_E_CANCELLED when 'cancel_event' is signaled. If the check
+  // it waits for was canceled, the caller sends its own request.
+  // 'cancel_event' can be NULL.
+  HRESULT Send(WebServicesClientInterface* update_check_client,
+               HANDLE cancel_event,
+               const xml::UpdateRequest* update_request,
+               xml::UpdateResponse* update_response,
+               WebServicesClientResult* result);
+
+  // Returns the number of checks which were sent to the server.
+  int num_requests_sent() const { return num_requests_sent_; }
+
+ private:
+  typedef std::vector<uint8> RequestKey;
+
+  struct Check {
+    Check();
+    ~Check();
+
+    HRESULT hr;
+    scoped_ptr<xml::UpdateResponse> update_response;
+    WebServicesClientResult result;
+    scoped_event done_event;
+    uint64 completed_ms;      // 0 while the check is in flight.
+    int num_waiters;
+    bool is_cached;           // True while the check is in checks_.
+  };
+
+  typedef std::map<RequestKey, Check*> Checks;
+
+  // Computes the key of the request, which ignores the request and the
+  // session ids.
+  static HRESULT GetRequestKey(const xml::UpdateRequest& update_request,
+                               RequestKey* key);
+
+  // Sends the check and publishes its result to the waiters.
+  HRESULT SendCheck(const RequestKey& key,
+                    Check* check,
+                    WebServicesClientInterface* update_check_client,
+                    const xml::UpdateRequest* update_request,
+                    xml::UpdateResponse* update_response,
+                    WebServicesClientResult* result);
+
+  // Waits for the check sent by another caller and copies its response.
+  HRESULT WaitForCheck(Check* check,
+                       WebServicesClientInterface* update_check_client,
+                       HANDLE cancel_event,
+                       const xml::UpdateRequest* update_request,
+                       xml::UpdateResponse* update_response,
+                       WebServicesClientResult* result);
+
+  // Sends the check without sharing it with other callers.
+  HRESULT SendUnshared(WebServicesClientInterface* update_check_client,
+                       const xml::UpdateRequest* update_request,
+                       xml::UpdateResponse* update_response,
+                       WebServicesClientResult* result);
+
+  // Stops waiting for 'check' and deletes it if it was the last reference.
+  // Called under the lock.
+  void ReleaseWaiter(Check* check);
+
+  // Removes the checks whose responses are too old to be reused. Called under
+  // the lock.
+  void RemoveExpiredChecks(uint64 now_ms);
+
+  LLock lock_;
+  const int response_cache_time_ms_;
+  Checks checks_;
+  volatile LONG num_requests_sent_;
+
+  DISALLOW_COPY_AND_ASSIGN(UpdateCheckBroker);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_UPDATE_CHECK_BROKER_H_
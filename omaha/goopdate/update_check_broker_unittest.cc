@@ -0,0 +1,336 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "base/scoped_ptr.h"
+#include "omaha/base/error.h"
+#include "omaha/base/scoped_any.h"
+#include "omaha/base/thread.h"
+#include "omaha/common/update_request.h"
+#include "omaha/common/update_response.h"
+#include "omaha/common/web_services_client.h"
+#include "omaha/goopdate/update_check_broker.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kAppId1 = _T("{F0E1D2C3-B4A5-4968-8776-5A4B3C2D1E0F}");
+const TCHAR* const kAppId2 = _T("{0F1E2D3C-4B5A-4968-8776-A5B4C3D2E1F0}");
+
+const int kNumConcurrentChecks = 8;
+
+// Stands in for the update server. Counts the requests it receives and holds
+// them until it is released, so that concurrent checks overlap.
+class FakeUpdateServer {
+ public:
+  FakeUpdateServer() : num_requests_(0) {
+    reset(release_event_, ::CreateEvent(NULL, true, true, NULL));
+  }
+
+  void Hold() { EXPECT_TRUE(::ResetEvent(get(release_event_))); }
+  void Release() { EXPECT_TRUE(::SetEvent(get(release_event_))); }
+
+  // Answers with the apps of the request.
+  void HandleRequest(const xml::UpdateRequest& update_request,
+                     xml::UpdateResponse* update_response) {
+    ::InterlockedIncrement(&num_requests_);
+    EXPECT_EQ(WAIT_OBJECT_0,
+              ::WaitForSingleObject(get(release_event_), INFINITE));
+
+    xml::response::Response response;
+    for (size_t i = 0; i != update_request.request().apps.size(); ++i) {
+      xml::response::App app;
+      app.appid = update_request.request().apps[i].app_id;
+      app.status = _T("ok");
+      response.apps.push_back(app);
+    }
+    SetResponseForUnitTest(update_response, response);
+  }
+
+  int num_requests() const { return num_requests_; }
+
+ private:
+  volatile LONG num_requests_;
+  scoped_event release_event_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeUpdateServer);
+};
+
+class FakeUpdateCheckClient : public WebServicesClientInterface {
+ public:
+  FakeUpdateCheckClient(FakeUpdateServer* server, HRESULT hr)
+      : server_(server),
+        hr_(hr),
+        retry_after_sec_(-1) {
+  }
+
+  void set_retry_after_sec(int retry_after_sec) {
+    retry_after_sec_ = retry_after_sec;
+  }
+
+  virtual HRESULT Send(const xml::UpdateRequest* update_request,
+                       xml::UpdateResponse* update_response) {
+    server_->HandleRequest(*update_request, update_response);
+    return hr_;
+  }
+
+  virtual HRESULT SendString(const CString*, xml::UpdateResponse*) {
+    return E_NOTIMPL;
+  }
+
+  virtual void Cancel() {}
+  virtual void set_proxy_auth_config(const ProxyAuthConfig&) {}
+  virtual void set_use_circuit_breaker(bool) {}
+  virtual bool is_http_success() const { return SUCCEEDED(hr_); }
+  virtual int http_status_code() const { return 0; }
+  virtual CString http_trace() const { return CString(); }
+  virtual bool http_used_ssl() const { return true; }
+  virtual HRESULT http_ssl_result() const { return hr_; }
+  virtual int http_xdaystart_header_value() const { return -1; }
+  virtual int http_xdaynum_header_value() const { return -1; }
+  virtual int retry_after_sec() const { return retry_after_sec_; }
+
+ private:
+  FakeUpdateServer* server_;
+  const HRESULT hr_;
+  int retry_after_sec_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeUpdateCheckClient);
+};
+
+// Sends an update check from its own bundle session on a separate thread.
+class UpdateCheckRunner : public Runnable {
+ public:
+  UpdateCheckRunner(UpdateCheckBroker* broker,
+                    FakeUpdateServer* server,
+                    HRESULT server_hr,
+                    const CString& session_id,
+                    const CString& app_id)
+      : broker_(broker),
+        client_(server, server_hr),
+        update_request_(xml::UpdateRequest::Create(false,
+                                                   session_id,
+                                                   _T("unittest"),
+                                                   CString())),
+        update_response_(xml::UpdateResponse::Create()),
+        hr_(E_PENDING) {
+    xml::request::App app;
+    app.app_id = app_id;
+    app.version = _T("1.2.3.4");
+    update_request_->AddApp(app);
+    reset(cancel_event_, ::CreateEvent(NULL, true, false, NULL));
+  }
+
+  virtual void Run() {
+    hr_ = broker_->Send(&client_,
+                        get(cancel_event_),
+                        update_request_.get(),
+                        update_response_.get(),
+                        &result_);
+  }
+
+  void Cancel() { EXPECT_TRUE(::SetEvent(get(cancel_event_))); }
+
+  FakeUpdateCheckClient* client() { return &client_; }
+  HRESULT hr() const { return hr_; }
+  const xml::UpdateResponse& update_response() const {
+    return *update_response_;
+  }
+  const WebServicesClientResult& result() const { return result_; }
+
+ private:
+  UpdateCheckBroker* broker_;
+  FakeUpdateCheckClient client_;
+  scoped_event cancel_event_;
+  scoped_ptr<xml::UpdateRequest> update_request_;
+  scoped_ptr<xml::UpdateResponse> update_response_;
+  WebServicesClientResult result_;
+  HRESULT hr_;
+
+  DISALLOW_COPY_AND_ASSIGN(UpdateCheckRunner);
+};
+
+CString GetSessionId(int i) {
+  CString session_id;
+  session_id.Format(_T("{5C0B2A8E-0000-4C8A-9F1D-%012d}"), i);
+  return session_id;
+}
+
+}  // namespace
+
+class UpdateCheckBrokerTest : public testing::Test {
+ protected:
+  UpdateCheckBrokerTest()
+      : broker_(UpdateCheckBroker::kDefaultResponseCacheTimeMs) {
+  }
+
+  // Waits until the server has received 'num_requests' requests.
+  void WaitForRequests(int num_requests) {
+    for (int i = 0; i != 100 && server_.num_requests() < num_requests; ++i) {
+      ::Sleep(50);
+    }
+    ASSERT_EQ(num_requests, server_.num_requests());
+  }
+
+  UpdateCheckBroker broker_;
+  FakeUpdateServer server_;
+};
+
+TEST_F(UpdateCheckBrokerTest, ConcurrentIdenticalChecks) {
+  server_.Hold();
+
+  scoped_ptr<UpdateCheckRunner> runners[kNumConcurrentChecks];
+  Thread threads[kNumConcurrentChecks];
+  for (int i = 0; i != kNumConcurrentChecks; ++i) {
+    runners[i].reset(new UpdateCheckRunner(&broker_,
+                                           &server_,
+                                           S_OK,
+                                           GetSessionId(i),
+                                           kAppId1));
+    ASSERT_TRUE(threads[i].Start(runners[i].get()));
+    if (!i) {
+      WaitForRequests(1);
+    }
+  }
+
+  // The checks which started after the server answered reuse the response.
+  server_.Release();
+  for (int i = 0; i != kNumConcurrentChecks; ++i) {
+    EXPECT_TRUE(threads[i].WaitTillExit(INFINITE));
+    EXPECT_SUCCEEDED(runners[i]->hr());
+    EXPECT_TRUE(runners[i]->update_response().GetApp(kAppId1));
+  }
+
+  EXPECT_EQ(1, server_.num_requests());
+  EXPECT_EQ(1, broker_.num_requests_sent());
+}
+
+// The checks which share a response get the http result of the check which
+// was sent, rather than the result of their own client.
+TEST_F(UpdateCheckBrokerTest, SharedResult) {
+  UpdateCheckRunner runner1(&broker_, &server_, S_OK, GetSessionId(1), kAppId1);
+  UpdateCheckRunner runner2(&broker_, &server_, S_OK, GetSessionId(2), kAppId1);
+  runner1.client()->set_retry_after_sec(3600);
+  runner1.Run();
+  runner2.Run();
+
+  EXPECT_SUCCEEDED(runner2.hr());
+  EXPECT_EQ(3600, runner1.result().retry_after_sec);
+  EXPECT_EQ(3600, runner2.result().retry_after_sec);
+  EXPECT_EQ(1, server_.num_requests());
+}
+
+TEST_F(UpdateCheckBrokerTest, DifferentApps) {
+  UpdateCheckRunner runner1(&broker_, &server_, S_OK, GetSessionId(1), kAppId1);
+  UpdateCheckRunner runner2(&broker_, &server_, S_OK, GetSessionId(2), kAppId2);
+  runner1.Run();
+  runner2.Run();
+
+  EXPECT_SUCCEEDED(runner1.hr());
+  EXPECT_SUCCEEDED(runner2.hr());
+  EXPECT_TRUE(runner1.update_response().GetApp(kAppId1));
+  EXPECT_FALSE(runner1.update_response().GetApp(kAppId2));
+  EXPECT_TRUE(runner2.update_response().GetApp(kAppId2));
+  EXPECT_EQ(2, server_.num_requests());
+}
+
+TEST_F(UpdateCheckBrokerTest, CachedResponse) {
+  UpdateCheckRunner runner1(&broker_, &server_, S_OK, GetSessionId(1), kAppId1);
+  UpdateCheckRunner runner2(&broker_, &server_, S_OK, GetSessionId(2), kAppId1);
+  runner1.Run();
+  runner2.Run();
+
+  EXPECT_SUCCEEDED(runner2.hr());
+  EXPECT_TRUE(runner2.update_response().GetApp(kAppId1));
+  EXPECT_EQ(1, server_.num_requests());
+}
+
+TEST_F(UpdateCheckBrokerTest, CachedResponseExpires) {
+  UpdateCheckBroker broker(0);
+  UpdateCheckRunner runner1(&broker, &server_, S_OK, GetSessionId(1), kAppId1);
+  UpdateCheckRunner runner2(&broker, &server_, S_OK, GetSessionId(2), kAppId1);
+  runner1.Run();
+  runner2.Run();
+
+  EXPECT_SUCCEEDED(runner2.hr());
+  EXPECT_EQ(2, server_.num_requests());
+  EXPECT_EQ(2, broker.num_requests_sent());
+}
+
+TEST_F(UpdateCheckBrokerTest, FailedCheckIsNotReused) {
+  UpdateCheckRunner runner1(&broker_, &server_, E_FAIL, GetSessionId(1),
+                            kAppId1);
+  UpdateCheckRunner runner2(&broker_, &server_, S_OK, GetSessionId(2), kAppId1);
+  runner1.Run();
+  runner2.Run();
+
+  EXPECT_EQ(E_FAIL, runner1.hr());
+  EXPECT_SUCCEEDED(runner2.hr());
+  EXPECT_EQ(2, server_.num_requests());
+}
+
+// A check which waits for a canceled check sends its own request.
+TEST_F(UpdateCheckBrokerTest, CanceledCheck) {
+  server_.Hold();
+
+  UpdateCheckRunner canceled_runner(&broker_,
+                                    &server_,
+                                    GOOPDATE_E_CANCELLED,
+                                    GetSessionId(1),
+                                    kAppId1);
+  UpdateCheckRunner runner(&broker_, &server_, S_OK, GetSessionId(2), kAppId1);
+
+  Thread canceled_thread;
+  Thread thread;
+  ASSERT_TRUE(canceled_thread.Start(&canceled_runner));
+  WaitForRequests(1);
+  ASSERT_TRUE(thread.Start(&runner));
+
+  server_.Release();
+  EXPECT_TRUE(canceled_thread.WaitTillExit(INFINITE));
+  EXPECT_TRUE(thread.WaitTillExit(INFINITE));
+
+  EXPECT_EQ(GOOPDATE_E_CANCELLED, canceled_runner.hr());
+  EXPECT_SUCCEEDED(runner.hr());
+  EXPECT_TRUE(runner.update_response().GetApp(kAppId1));
+  EXPECT_EQ(2, server_.num_requests());
+}
+
+// A waiting check returns as soon as its bundle is canceled, while the check
+// it waits for is still in flight.
+TEST_F(UpdateCheckBrokerTest, CanceledWaiter) {
+  server_.Hold();
+
+  UpdateCheckRunner runner(&broker_, &server_, S_OK, GetSessionId(1), kAppId1);
+  UpdateCheckRunner waiter(&broker_, &server_, S_OK, GetSessionId(2), kAppId1);
+
+  Thread thread;
+  Thread waiter_thread;
+  ASSERT_TRUE(thread.Start(&runner));
+  WaitForRequests(1);
+  ASSERT_TRUE(waiter_thread.Start(&waiter));
+
+  waiter.Cancel();
+  EXPECT_TRUE(waiter_thread.WaitTillExit(INFINITE));
+  EXPECT_EQ(GOOPDATE_E_CANCELLED, waiter.hr());
+
+  server_.Release();
+  EXPECT_TRUE(thread.WaitTillExit(INFINITE));
+  EXPECT_SUCCEEDED(runner.hr());
+  EXPECT_EQ(1, server_.num_requests());
+}
+
+}  // namespace omaha
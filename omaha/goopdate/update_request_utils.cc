@@ -90,6 +90,9 @@ void BuildRequest(const App* app,
     request_app.update_check.is_update_disabled =
         FAILED(app->CheckGroupPolicy());
     request_app.update_check.tt_token = app->tt_token();
+    if (app->is_update()) {
+      request_app.update_check.state_token = app->state_token();
+    }
     request_app.update_check.target_version_prefix =
         app->GetTargetVersionPrefix();
   }
@@ -18,8 +18,8 @@
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
-#include "omaha/base/atl_regexp.h"
 #include "omaha/base/system_info.h"
+#include "omaha/base/version.h"
 #include "omaha/common/lang.h"
 #include "omaha/common/experiment_labels.h"
 #include "omaha/common/xml_const.h"
@@ -36,19 +36,12 @@ namespace {
 
 // This function is called with a dotted pair, which is the minimum OS
 // version and it comes from the update response, or with the a dotted quad,
-// which is the OS version of the host.
-ULONGLONG OSVersionFromString(const CString& s) {
-  if (AtlRE::PartialMatch(s, AtlRE(_T("^\\d+\\.\\d+$")))) {
-    // Convert from "x.y" to "x.y.0.0" format so we can use the existing
-    // VersionFromString utility function.
-    return VersionFromString(s + _T(".0.0"));
-  }
-
-  // The string is a dotted quad version. VersionFromString handles the error if
-  // the parameter is something else.
-  ASSERT1(AtlRE::PartialMatch(s, AtlRE(_T("^\\d+\\.\\d+\\.\\d+\\.\\d+$"))));
-
-  return VersionFromString(s);
+// which is the OS version of the host. Missing components are zero, and so
+// are invalid versions.
+Version OSVersionFromString(const CString& s) {
+  Version version;
+  Version::ParsePartial(s, 2, &version);
+  return version;
 }
 
 bool IsPlatformCompatible(const CString& platform) {
@@ -173,6 +166,11 @@ CString GetAppResponseStatus(const xml::response::App& app) {
   return app.status;
 }
 
+bool IsUnchangedResponse(const xml::response::App& app) {
+  return _tcsicmp(xml::response::kStatusUnchanged,
+                  GetAppResponseStatus(app)) == 0;
+}
+
 HRESULT BuildApp(const xml::UpdateResponse* update_response,
                  HRESULT code,
                  App* app) {
@@ -184,12 +182,19 @@ HRESULT BuildApp(const xml::UpdateResponse* update_response,
 
   const CString& app_id = app->app_guid_string();
 
-  const xml::response::App* response_app(GetApp(update_response->response(),
-                                                app_id));
+  const xml::response::App* response_app(update_response->GetApp(app_id));
   ASSERT1(response_app);
   const xml::response::UpdateCheck& update_check = response_app->update_check;
 
+  // An "unchanged" response only confirms the previous "noupdate" response,
+  // so the values persisted from that response are kept.
+  if (IsUnchangedResponse(*response_app)) {
+    ASSERT1(code == GOOPDATE_E_NO_UPDATE_RESPONSE);
+    return S_OK;
+  }
+
   VERIFY1(SUCCEEDED(app->put_ttToken(CComBSTR(update_check.tt_token))));
+  app->set_state_token(update_check.state_token);
 
   Cohort cohort;
   cohort.cohort = response_app->cohort;
@@ -258,8 +263,7 @@ xml::UpdateResponseResult GetResult(const xml::UpdateResponse* update_response,
                                     const CString& app_name,
                                     const CString& language) {
   ASSERT1(update_response);
-  const xml::response::App* response_app(GetApp(update_response->response(),
-                                                appid));
+  const xml::response::App* response_app(update_response->GetApp(appid));
 
   StringFormatter formatter(language);
   CString text;
@@ -283,8 +287,9 @@ xml::UpdateResponseResult GetResult(const xml::UpdateResponse* update_response,
     return std::make_pair(S_OK, CString());
   }
 
-  // noupdate
-  if (_tcsicmp(xml::response::kStatusNoUpdate, status) == 0) {
+  // noupdate, or unchanged since the last noupdate
+  if (_tcsicmp(xml::response::kStatusNoUpdate, status) == 0 ||
+      _tcsicmp(xml::response::kStatusUnchanged, status) == 0) {
     VERIFY1(SUCCEEDED(formatter.LoadString(IDS_NO_UPDATE_RESPONSE, &text)));
     return std::make_pair(GOOPDATE_E_NO_UPDATE_RESPONSE, text);
   }
@@ -40,8 +40,12 @@ HRESULT GetInstallData(const std::vector<xml::response::Data>& data,
                        const CString& index,
                        CString* value);
 
+// Returns true if the server answered that the update check of the app has the
+// same result as the check which returned the state token of the app.
+bool IsUnchangedResponse(const xml::response::App& app);
+
 // Builds an App object from its corresponding representation in the
-// update response.
+// update response. An "unchanged" response leaves the app as it is.
 HRESULT BuildApp(const xml::UpdateResponse* update_response,
                  HRESULT code,
                  App* app);
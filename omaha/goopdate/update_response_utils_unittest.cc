@@ -13,10 +13,13 @@
 // limitations under the License.
 // ========================================================================
 
+#include <iostream>
 #include "base/scoped_ptr.h"
 #include "omaha/base/app_util.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/error.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/safe_format.h"
 #include "omaha/base/system_info.h"
 #include "omaha/goopdate/app_unittest_base.h"
 #include "omaha/goopdate/resource_manager.h"
@@ -151,6 +154,72 @@ TEST(UpdateResponseUtilsGetAppTest, ResponseAppIdAllUpperCase) {
   EXPECT_EQ(&response.apps[0], GetApp(response, kAppIdWithLowerCase));
 }
 
+TEST(UpdateResponseUtilsGetAppTest, UpdateResponseGetApp) {
+  xml::response::Response response;
+  xml::response::App app;
+  app.status = xml::response::kStatusOkValue;
+  app.appid = kAppIdWithLowerCase;
+  response.apps.push_back(app);
+  app.appid = kAppId1;
+  response.apps.push_back(app);
+  app.appid = _T("not-a-guid");
+  response.apps.push_back(app);
+
+  scoped_ptr<xml::UpdateResponse> update_response(
+      xml::UpdateResponse::Create());
+  SetResponseForUnitTest(update_response.get(), response);
+  const std::vector<xml::response::App>& apps =
+      update_response->response().apps;
+
+  EXPECT_EQ(&apps[0], update_response->GetApp(kAppIdWithLowerCase));
+  EXPECT_EQ(&apps[0],
+            update_response->GetApp(kAppIdWithLowerCaseAllUpperCase));
+  EXPECT_EQ(&apps[1], update_response->GetApp(kAppId1));
+  EXPECT_EQ(&apps[2], update_response->GetApp(_T("NOT-A-GUID")));
+  EXPECT_EQ(NULL, update_response->GetApp(kAppId2));
+  EXPECT_EQ(NULL, update_response->GetApp(_T("")));
+
+  // Setting the response again rebuilds the index.
+  response.apps.erase(response.apps.begin());
+  SetResponseForUnitTest(update_response.get(), response);
+  EXPECT_EQ(NULL, update_response->GetApp(kAppIdWithLowerCase));
+  EXPECT_EQ(&update_response->response().apps[0],
+            update_response->GetApp(kAppId1));
+}
+
+// Looks up every app of bundles of up to 2000 apps, the way the apps of a
+// bundle are matched with the update response.
+TEST(UpdateResponseUtilsGetAppTest, LargeBundles) {
+  const int kBundleSizes[] = { 1, 10, 100, 1000, 2000 };
+
+  for (int i = 0; i < arraysize(kBundleSizes); ++i) {
+    const int bundle_size = kBundleSizes[i];
+
+    xml::response::Response response;
+    std::vector<CString> app_ids;
+    for (int j = 0; j < bundle_size; ++j) {
+      xml::response::App app;
+      SafeCStringFormat(&app.appid,
+                        _T("{%08X-0000-0000-0000-000000000000}"),
+                        j);
+      app_ids.push_back(app.appid);
+      response.apps.push_back(app);
+    }
+
+    scoped_ptr<xml::UpdateResponse> update_response(
+        xml::UpdateResponse::Create());
+    SetResponseForUnitTest(update_response.get(), response);
+
+    HighresTimer timer;
+    for (int j = bundle_size - 1; j >= 0; --j) {
+      EXPECT_EQ(&update_response->response().apps[j],
+                update_response->GetApp(app_ids[j]));
+    }
+    std::wcout << _T("\tGetApp: ") << bundle_size << _T(" apps in ")
+               << timer.GetElapsedMs() << _T(" ms") << std::endl;
+  }
+}
+
 TEST_F(UpdateResponseUtilsGetResultTest, EmptyResponse) {
   EXPECT_TRUE(kAppNotFoundResult ==
               GetResult(update_response_.get(), kAppId1, _T(""), _T("en")));
@@ -277,6 +346,29 @@ TEST(UpdateResponseUtils, ValidateUntrustedData) {
   data.clear();
 }
 
+TEST_F(UpdateResponseUtilsGetResultTest, Unchanged) {
+  xml::response::Response response;
+  xml::response::App app;
+  app.status = xml::response::kStatusOkValue;
+  app.update_check.status = xml::response::kStatusUnchanged;
+  app.appid = kAppId1;
+  response.apps.push_back(app);
+  app.update_check.status = xml::response::kStatusNoUpdate;
+  app.appid = kAppId2;
+  response.apps.push_back(app);
+  SetResponseForUnitTest(update_response_.get(), response);
+
+  // An unchanged app has the same result as an app with no update.
+  const UpdateResponseResult unchanged_result =
+      GetResult(update_response_.get(), kAppId1, _T(""), _T("en"));
+  EXPECT_EQ(GOOPDATE_E_NO_UPDATE_RESPONSE, unchanged_result.first);
+  EXPECT_TRUE(unchanged_result ==
+              GetResult(update_response_.get(), kAppId2, _T(""), _T("en")));
+
+  EXPECT_TRUE(IsUnchangedResponse(response.apps[0]));
+  EXPECT_FALSE(IsUnchangedResponse(response.apps[1]));
+}
+
 TEST_F(UpdateResponseUtilsGetResultTest, HwNotSupported) {
   xml::response::Response response;
   xml::response::App app;
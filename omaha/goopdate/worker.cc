@@ -27,18 +27,23 @@
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/reactor.h"
+#include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scoped_impersonation.h"
+#include "omaha/base/span_trace.h"
 #include "omaha/base/system.h"
 #include "omaha/base/utils.h"
-#include "omaha/base/thread_pool_callback.h"
+#include "omaha/base/thread_pool.h"
 #include "omaha/base/vistautil.h"
 #include "omaha/common/app_registry_utils.h"
 #include "omaha/common/config_manager.h"
+#include "omaha/common/const_cmd_line.h"
+#include "omaha/common/const_goopdate.h"
 #include "omaha/common/event_logger.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/ping.h"
 #include "omaha/common/ping_event.h"
+#include "omaha/common/update_check_policy.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
 #include "omaha/common/web_services_client.h"
@@ -50,6 +55,7 @@
 #include "omaha/goopdate/offline_utils.h"
 #include "omaha/goopdate/server_resource.h"
 #include "omaha/goopdate/string_formatter.h"
+#include "omaha/goopdate/update_check_broker.h"
 #include "omaha/goopdate/update_request_utils.h"
 #include "omaha/goopdate/update_response_utils.h"
 #include "omaha/goopdate/worker_metrics.h"
@@ -228,6 +234,80 @@ void SendCupFailurePing(bool is_machine,
   }
 }
 
+// Runs a deferred function of the worker on the thread pool. When the app
+// bundle is stopped before the work item starts, the deferred function does
+// not run and the pending call of the app bundle is completed instead, so the
+// app bundle does not remain busy.
+class DeferredBundleCall : public UserWorkItem {
+ public:
+  explicit DeferredBundleCall(shared_ptr<AppBundle> app_bundle)
+      : app_bundle_(app_bundle) {
+    set_priority(app_bundle_->priority());
+  }
+
+ protected:
+  shared_ptr<AppBundle> app_bundle() const { return app_bundle_; }
+
+ private:
+  virtual void DoCancel() {
+    CORE_LOG(L3, (_T("[DeferredBundleCall::DoCancel][0x%p]"),
+                  app_bundle_.get()));
+    app_bundle_->CompleteAsyncCall();
+  }
+
+  shared_ptr<AppBundle> app_bundle_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeferredBundleCall);
+};
+
+class DeferredBundleCall0 : public DeferredBundleCall {
+ public:
+  typedef void (Worker::*DeferredFunction)(shared_ptr<AppBundle>);
+
+  DeferredBundleCall0(Worker* worker,
+                      DeferredFunction deferred_function,
+                      shared_ptr<AppBundle> app_bundle)
+      : DeferredBundleCall(app_bundle),
+        worker_(worker),
+        deferred_function_(deferred_function) {}
+
+ private:
+  virtual void DoProcess() {
+    (worker_->*deferred_function_)(app_bundle());
+  }
+
+  Worker* worker_;
+  DeferredFunction deferred_function_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeferredBundleCall0);
+};
+
+template <typename P1>
+class DeferredBundleCall1 : public DeferredBundleCall {
+ public:
+  typedef void (Worker::*DeferredFunction)(shared_ptr<AppBundle>, P1);
+
+  DeferredBundleCall1(Worker* worker,
+                      DeferredFunction deferred_function,
+                      shared_ptr<AppBundle> app_bundle,
+                      P1 p1)
+      : DeferredBundleCall(app_bundle),
+        worker_(worker),
+        deferred_function_(deferred_function),
+        p1_(p1) {}
+
+ private:
+  virtual void DoProcess() {
+    (worker_->*deferred_function_)(app_bundle(), p1_);
+  }
+
+  Worker* worker_;
+  DeferredFunction deferred_function_;
+  P1 p1_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeferredBundleCall1);
+};
+
 }  // namespace internal
 
 Worker::Worker()
@@ -239,6 +319,8 @@ Worker::Worker()
   reactor_.reset(new Reactor);
   shutdown_handler_.reset(new ShutdownHandler);
   model_.reset(new Model(this));
+  update_check_broker_.reset(
+      new UpdateCheckBroker(UpdateCheckBroker::kDefaultResponseCacheTimeMs));
 }
 
 Worker::~Worker() {
@@ -495,7 +577,7 @@ void Worker::CheckForUpdateHelper(AppBundle* app_bundle,
     CORE_LOG(L3, (_T("[CUP failed][%#08x]"), hr));
     // Only send the CUP debug ping when there is no "retry after" in effect.
     const int retry_after_sec(
-        app_bundle->update_check_client()->retry_after_sec());
+        app_bundle->update_check_result().retry_after_sec);
     if (retry_after_sec <= 0) {
       internal::SendCupFailurePing(is_machine_,
                                    app_bundle->session_id(),
@@ -785,11 +867,10 @@ HRESULT Worker::Stop(AppBundle* app_bundle) {
 
   // Cancels update check client but not the ping client since we need to send
   // cancellation ping.
-  WebServicesClientInterface* update_check_client(
-      app_bundle->update_check_client());
-  if (update_check_client) {
-    update_check_client->Cancel();
-  }
+  app_bundle->CancelUpdateCheck();
+
+  // A deferred call which is still queued in the thread pool does not run.
+  app_bundle->CancelAsyncCall();
 
   // TODO(omaha3): What do we do with active installs? We can at least cancel
   // the InstallManager/InstallerWrapper if it has not started.
@@ -824,13 +905,13 @@ HRESULT Worker::Resume(AppBundle* app_bundle) {
 
 HRESULT Worker::GetPackage(const Package* package, const CString& dir) {
   CORE_LOG(L3, (_T("[Worker::GetPackage]")));
-  ASSERT1(model_->IsLockedByCaller());
+  ASSERT1(model_->IsLockedSharedByCaller());
   return download_manager_->GetPackage(package, dir);
 }
 
 bool Worker::IsPackageAvailable(const Package* package) const {
   CORE_LOG(L3, (_T("[Worker::IsPackageAvailable]")));
-  ASSERT1(model_->IsLockedByCaller());
+  ASSERT1(model_->IsLockedSharedByCaller());
   return download_manager_->IsPackageAvailable(package);
 }
 
@@ -927,6 +1008,7 @@ HRESULT Worker::DoUpdateCheck(AppBundle* app_bundle,
   ASSERT1(app_bundle);
   ASSERT1(update_request);
   ASSERT1(update_response);
+  TRACE_SPAN("Worker::DoUpdateCheck", app_bundle->session_id());
 
   ASSERT1(app_bundle->GetNumberOfApps() > 0);
 
@@ -938,9 +1020,13 @@ HRESULT Worker::DoUpdateCheck(AppBundle* app_bundle,
   }
 
   if (app_bundle->is_offline_install()) {
-    return offline_utils::ParseOfflineManifest(
-        app_bundle->GetApp(0)->app_guid_string(), app_bundle->offline_dir(),
-        update_response);
+    std::vector<CString> app_ids;
+    for (size_t i = 0; i != app_bundle->GetNumberOfApps(); ++i) {
+      app_ids.push_back(app_bundle->GetApp(i)->app_guid_string());
+    }
+    return offline_utils::ParseOfflineManifest(app_ids,
+                                               app_bundle->offline_dir(),
+                                               update_response);
   }
 
   if (!ConfigManager::Instance()->CanUseNetwork(is_machine_)) {
@@ -956,12 +1042,22 @@ HRESULT Worker::DoUpdateCheck(AppBundle* app_bundle,
 
   HighresTimer update_check_timer;
 
-  // This is a blocking call on the network.
-  HRESULT hr = app_bundle->update_check_client()->Send(update_request,
-                                                       update_response);
+  // Only the automatic update checks back off from a failing server, the
+  // other checks have a user waiting for them.
+  app_bundle->update_check_client()->set_use_circuit_breaker(is_update);
 
-  CORE_LOG(L3, (_T("[Update check HTTP trace][%s]"),
-      app_bundle->update_check_client()->http_trace()));
+  // This is a blocking call on the network. Identical checks from other
+  // bundles of this process share the same request.
+  WebServicesClientResult result;
+  HRESULT hr = update_check_broker_->Send(
+      app_bundle->update_check_client(),
+      app_bundle->update_check_cancel_event(),
+      update_request,
+      update_response,
+      &result);
+  app_bundle->set_update_check_result(result);
+
+  CORE_LOG(L3, (_T("[Update check HTTP trace][%s]"), result.http_trace));
 
   if (FAILED(hr)) {
     metric_updatecheck_failed_ms.AddSample(update_check_timer.GetElapsedMs());
@@ -969,9 +1065,9 @@ HRESULT Worker::DoUpdateCheck(AppBundle* app_bundle,
     CORE_LOG(LE, (_T("[Send failed][0x%08x]"), hr));
     worker_utils::AddHttpRequestDataToEventLog(
         hr,
-        app_bundle->update_check_client()->http_ssl_result(),
-        app_bundle->update_check_client()->http_status_code(),
-        app_bundle->update_check_client()->http_trace(),
+        result.http_ssl_result,
+        result.http_status_code,
+        result.http_trace,
         is_machine_);
 
     // TODO(omaha3): Omaha 2 would launch a web browser here for installs by
@@ -1000,7 +1096,16 @@ void Worker::DoPostUpdateCheck(AppBundle* app_bundle,
       is_machine_,
       update_response)));
 
-  PersistRetryAfter(app_bundle->update_check_client()->retry_after_sec());
+  // Only the automatic checks started by the core or by the scheduled task
+  // change the error backoff, so that an interactive or an on-demand check
+  // does not delay the next automatic check.
+  const bool is_scheduled_check =
+      app_bundle->is_auto_update() &&
+      (app_bundle->install_source() == kCmdLineInstallSource_Core ||
+       app_bundle->install_source() == kCmdLineInstallSource_Scheduler);
+  PersistRetryAfter(update_check_result,
+                    is_scheduled_check,
+                    app_bundle->update_check_result());
 
   for (size_t i = 0; i != app_bundle->GetNumberOfApps(); ++i) {
     App* app = app_bundle->GetApp(i);
@@ -1018,12 +1123,43 @@ void Worker::DoPostUpdateCheck(AppBundle* app_bundle,
   }
 }
 
-void Worker::PersistRetryAfter(int retry_after_sec) const {
-  CORE_LOG(L6, (_T("[Worker::PersistRetryAfter][%d]"), retry_after_sec));
+// Persists the earliest time of the next automatic update check. This is the
+// later of the time the server asked for in the X-Retry-After header and the
+// end of the error backoff, which grows while the server fails scheduled
+// update checks. Other update checks only honor the X-Retry-After header.
+void Worker::PersistRetryAfter(
+    HRESULT update_check_result,
+    bool is_scheduled_check,
+    const WebServicesClientResult& http_result) const {
+  const int server_retry_after_sec = http_result.retry_after_sec;
+  const int http_status_code = http_result.http_status_code;
+  CORE_LOG(L6, (_T("[Worker::PersistRetryAfter][0x%08x][%d][%d][%d]"),
+                update_check_result, is_scheduled_check, http_status_code,
+                server_retry_after_sec));
 
   // Registry writes to HKLM need admin.
   ASSERT1(!is_machine_ || vista_util::IsUserAdmin());
 
+  ConfigManager* cm = ConfigManager::Instance();
+  DWORD failures = 0;
+  if (is_scheduled_check) {
+    failures = cm->GetUpdateCheckFailures(is_machine_);
+    if (SUCCEEDED(update_check_result)) {
+      failures = 0;
+    } else if (update_check_policy::IsServerFailure(http_status_code)) {
+      ++failures;
+    }
+    VERIFY1(SUCCEEDED(cm->SetUpdateCheckFailures(is_machine_, failures)));
+  }
+
+  // The backoff of each client is spread by its user id, if it has one.
+  CString user_id;
+  RegKey::GetValue(cm->registry_update(is_machine_), kRegValueUserId, &user_id);
+
+  const int retry_after_sec = update_check_policy::GetRetryAfterSec(
+      server_retry_after_sec,
+      static_cast<int>(failures),
+      user_id);
   if (retry_after_sec <= 0) {
     return;
   }
@@ -1031,8 +1167,7 @@ void Worker::PersistRetryAfter(int retry_after_sec) const {
   ASSERT1(retry_after_sec <= kSecondsPerDay);
   const uint32 now_sec = Time64ToInt32(GetCurrent100NSTime());
   DWORD retry_after_time_sec = now_sec + retry_after_sec;
-  ConfigManager::Instance()->SetRetryAfterTime(is_machine_,
-                                               retry_after_time_sec);
+  cm->SetRetryAfterTime(is_machine_, retry_after_time_sec);
 }
 
 // Creates a thread pool work item for deferred execution of deferred_function.
@@ -1043,10 +1178,8 @@ HRESULT Worker::QueueDeferredFunctionCall0(
   ASSERT1(app_bundle.get());
   ASSERT1(deferred_function);
 
-  typedef ThreadPoolCallBack1<Worker, shared_ptr<AppBundle> > Callback;
-  scoped_ptr<Callback> callback(new Callback(this,
-                                             deferred_function,
-                                             app_bundle));
+  scoped_ptr<internal::DeferredBundleCall0> callback(
+      new internal::DeferredBundleCall0(this, deferred_function, app_bundle));
   HRESULT hr = Goopdate::Instance().QueueUserWorkItem(callback.get(),
                                                       COINIT_MULTITHREADED,
                                                       WT_EXECUTELONGFUNCTION);
@@ -1069,11 +1202,11 @@ HRESULT Worker::QueueDeferredFunctionCall1(
   ASSERT1(app_bundle.get());
   ASSERT1(deferred_function);
 
-  typedef ThreadPoolCallBack2<Worker, shared_ptr<AppBundle>, P1> Callback;
-  scoped_ptr<Callback> callback(new Callback(this,
-                                             deferred_function,
-                                             app_bundle,
-                                             p1));
+  scoped_ptr<internal::DeferredBundleCall1<P1> > callback(
+      new internal::DeferredBundleCall1<P1>(this,
+                                            deferred_function,
+                                            app_bundle,
+                                            p1));
   HRESULT hr = Goopdate::Instance().QueueUserWorkItem(callback.get(),
                                                       COINIT_MULTITHREADED,
                                                       WT_EXECUTELONGFUNCTION);
@@ -41,6 +41,8 @@ class InstallManagerInterface;
 class Model;
 class Package;
 class Reactor;
+class UpdateCheckBroker;
+struct WebServicesClientResult;
 
 // Limited subset of Worker interface that the Model needs.
 class WorkerModelInterface {
@@ -161,7 +163,10 @@ class Worker : public WorkerModelInterface, public ShutdownCallback {
                          HRESULT update_check_result,
                          xml::UpdateResponse* update_response);
 
-  void PersistRetryAfter(int retry_after_sec) const;
+  void PersistRetryAfter(
+      HRESULT update_check_result,
+      bool is_scheduled_check,
+      const WebServicesClientResult& http_result) const;
 
   HRESULT QueueDeferredFunctionCall0(
       shared_ptr<AppBundle> app_bundle,
@@ -187,6 +192,7 @@ class Worker : public WorkerModelInterface, public ShutdownCallback {
   scoped_ptr<Model>           model_;
   scoped_ptr<DownloadManagerInterface> download_manager_;
   scoped_ptr<InstallManagerInterface> install_manager_;
+  scoped_ptr<UpdateCheckBroker> update_check_broker_;
 
   CMessageLoop message_loop_;
 
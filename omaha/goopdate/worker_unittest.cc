@@ -129,6 +129,8 @@ class MockWebServicesClient : public WebServicesClientInterface {
       void());
   MOCK_METHOD1(set_proxy_auth_config,
       void(const ProxyAuthConfig& config));
+  MOCK_METHOD1(set_use_circuit_breaker,
+      void(bool use_circuit_breaker));
   MOCK_CONST_METHOD0(is_http_success,
       bool());
   MOCK_CONST_METHOD0(http_status_code,
@@ -0,0 +1,211 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/circuit_breaker.h"
+#include <algorithm>
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/scoped_any.h"
+#include "omaha/base/user_info.h"
+
+namespace omaha {
+
+namespace {
+
+HRESULT CreateHostHealthRegKey(RegKey* key) {
+  ASSERT1(key);
+
+  if (user_info::IsRunningAsSystem()) {
+    return key->Create(HKEY_LOCAL_MACHINE,
+                       RegistryHostHealthStore::kRegKeyHostHealth);
+  }
+
+  scoped_hkey user_root_key;
+  HRESULT hr = ::RegOpenCurrentUser(KEY_READ | KEY_WRITE,
+                                    address(user_root_key));
+  if (FAILED(hr)) {
+    return hr;
+  }
+  return key->Create(get(user_root_key),
+                     RegistryHostHealthStore::kRegKeyHostHealth);
+}
+
+}  // namespace
+
+HRESULT MemoryHostHealthStore::Load(const CString& host, HostHealth* health) {
+  ASSERT1(health);
+
+  std::map<CString, HostHealth>::const_iterator it = hosts_.find(host);
+  *health = it != hosts_.end() ? it->second : HostHealth();
+  return S_OK;
+}
+
+HRESULT MemoryHostHealthStore::Save(const CString& host,
+                                    const HostHealth& health) {
+  if (health.is_healthy()) {
+    hosts_.erase(host);
+  } else {
+    hosts_[host] = health;
+  }
+  return S_OK;
+}
+
+const TCHAR* const RegistryHostHealthStore::kRegKeyHostHealth =
+    GOOPDATE_MAIN_KEY _T("hosthealth");
+
+HRESULT RegistryHostHealthStore::Load(const CString& host,
+                                      HostHealth* health) {
+  ASSERT1(health);
+
+  *health = HostHealth();
+
+  RegKey key;
+  HRESULT hr = CreateHostHealthRegKey(&key);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (!key.HasValue(host)) {
+    return S_OK;
+  }
+
+  DWORD64 value = 0;
+  hr = key.GetValue(host, &value);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  health->consecutive_failures = static_cast<int>(value >> 32);
+  health->open_until_sec = static_cast<uint32>(value);
+  return S_OK;
+}
+
+HRESULT RegistryHostHealthStore::Save(const CString& host,
+                                      const HostHealth& health) {
+  RegKey key;
+  HRESULT hr = CreateHostHealthRegKey(&key);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (health.is_healthy()) {
+    return key.HasValue(host) ? key.DeleteValue(host) : S_OK;
+  }
+
+  const DWORD64 value =
+      static_cast<DWORD64>(health.consecutive_failures) << 32 |
+      health.open_until_sec;
+  return key.SetValue(host, value);
+}
+
+CircuitBreaker::CircuitBreaker(HostHealthStore* store) : store_(store) {
+  ASSERT1(store);
+}
+
+// static
+int CircuitBreaker::GetCooldownSec(int consecutive_failures) {
+  ASSERT1(consecutive_failures >= kFailureThreshold);
+
+  int cooldown_sec = kMinCooldownSec;
+  for (int i = kFailureThreshold;
+       i < consecutive_failures && cooldown_sec < kMaxCooldownSec;
+       ++i) {
+    cooldown_sec *= 2;
+  }
+  return std::min(cooldown_sec, static_cast<int>(kMaxCooldownSec));
+}
+
+bool CircuitBreaker::IsRequestAllowed(const CString& host, uint32 now_sec) {
+  if (host.IsEmpty()) {
+    return true;
+  }
+
+  HostHealth health;
+  if (FAILED(store_->Load(host, &health)) || now_sec >= health.open_until_sec) {
+    return true;
+  }
+
+  // A cooldown which ends further away than the longest cooldown was stored
+  // before the clock was set back, and is ignored.
+  if (health.open_until_sec - now_sec > static_cast<uint32>(kMaxCooldownSec)) {
+    NET_LOG(LW, (_T("[CircuitBreaker][ignoring cooldown of %s]"), host));
+    return true;
+  }
+
+  NET_LOG(L3, (_T("[CircuitBreaker][circuit open][%s][%u s left]"),
+               host, health.open_until_sec - now_sec));
+  return false;
+}
+
+void CircuitBreaker::OnAttemptFinished(const CString& host,
+                                       uint32 now_sec,
+                                       RetryPolicy::ErrorClass error_class,
+                                       int retry_after_sec) {
+  if (host.IsEmpty()) {
+    return;
+  }
+
+  HostHealth health;
+  if (FAILED(store_->Load(host, &health))) {
+    return;
+  }
+
+  switch (error_class) {
+    case RetryPolicy::ERROR_CLASS_SERVER:
+    case RetryPolicy::ERROR_CLASS_THROTTLED:
+      break;
+
+    case RetryPolicy::ERROR_CLASS_NONE:
+      if (!health.is_healthy()) {
+        NET_LOG(L3, (_T("[CircuitBreaker][%s recovered]"), host));
+        Save(host, HostHealth());
+      }
+      return;
+
+    default:
+      // The other errors do not say anything about the health of the host.
+      return;
+  }
+
+  ++health.consecutive_failures;
+
+  int cooldown_sec = 0;
+  if (health.consecutive_failures >= kFailureThreshold) {
+    cooldown_sec = GetCooldownSec(health.consecutive_failures);
+  }
+  if (retry_after_sec > 0) {
+    cooldown_sec = std::max(cooldown_sec,
+                            std::min(retry_after_sec,
+                                     static_cast<int>(kMaxCooldownSec)));
+  }
+  if (cooldown_sec) {
+    health.open_until_sec = now_sec + cooldown_sec;
+    NET_LOG(LW, (_T("[CircuitBreaker][circuit open][%s][%d failures][%d s]"),
+                 host, health.consecutive_failures, cooldown_sec));
+  }
+
+  Save(host, health);
+}
+
+void CircuitBreaker::Save(const CString& host, const HostHealth& health) {
+  HRESULT hr = store_->Save(host, health);
+  if (FAILED(hr)) {
+    NET_LOG(LW, (_T("[CircuitBreaker][failed to save %s][0x%08x]"), host, hr));
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,131 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// CircuitBreaker stops sending requests to a host which keeps failing, so
+// that the clients of an overloaded server back off together instead of each
+// client retrying on its own schedule. After a few consecutive failures, the
+// circuit for the host opens for a cooldown which grows with every further
+// failure. Once the cooldown is over, the next request probes the host:
+// success closes the circuit, failure opens it again. The health of the hosts
+// is kept in a HostHealthStore, which the registry implements so that all the
+// processes of the user share it. The breaker is only meant for background
+// requests, which NetworkRequest::set_host_health_store opts in.
+
+#ifndef OMAHA_NET_CIRCUIT_BREAKER_H_
+#define OMAHA_NET_CIRCUIT_BREAKER_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <map>
+#include "base/basictypes.h"
+#include "omaha/base/constants.h"
+#include "omaha/net/retry_policy.h"
+
+namespace omaha {
+
+struct HostHealth {
+  HostHealth() : consecutive_failures(0), open_until_sec(0) {}
+
+  bool is_healthy() const {
+    return !consecutive_failures && !open_until_sec;
+  }
+
+  int consecutive_failures;
+
+  // The time, in seconds since 1970, until which the circuit is open.
+  uint32 open_until_sec;
+};
+
+class HostHealthStore {
+ public:
+  virtual ~HostHealthStore() {}
+
+  // Returns the health of 'host', or a healthy state if nothing is stored for
+  // the host.
+  virtual HRESULT Load(const CString& host, HostHealth* health) = 0;
+
+  // Stores the health of 'host'. Storing a healthy state removes the host.
+  virtual HRESULT Save(const CString& host, const HostHealth& health) = 0;
+};
+
+class MemoryHostHealthStore : public HostHealthStore {
+ public:
+  MemoryHostHealthStore() {}
+
+  virtual HRESULT Load(const CString& host, HostHealth* health);
+  virtual HRESULT Save(const CString& host, const HostHealth& health);
+
+ private:
+  std::map<CString, HostHealth> hosts_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryHostHealthStore);
+};
+
+// Stores one QWORD value per host under the Update key of the user, or of the
+// machine when running as system, like the proxy configuration.
+class RegistryHostHealthStore : public HostHealthStore {
+ public:
+  static const TCHAR* const kRegKeyHostHealth;
+
+  RegistryHostHealthStore() {}
+
+  virtual HRESULT Load(const CString& host, HostHealth* health);
+  virtual HRESULT Save(const CString& host, const HostHealth& health);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RegistryHostHealthStore);
+};
+
+class CircuitBreaker {
+ public:
+  // The number of consecutive failures which opens the circuit.
+  static const int kFailureThreshold = 3;
+
+  // The cooldown doubles from the minimum for every failure after the
+  // threshold, up to the maximum.
+  static const int kMinCooldownSec = 60;
+  static const int kMaxCooldownSec = kSecondsPerHour;
+
+  // Does not take ownership of 'store'.
+  explicit CircuitBreaker(HostHealthStore* store);
+
+  // Returns true if a request to 'host' can be sent at 'now_sec'.
+  bool IsRequestAllowed(const CString& host, uint32 now_sec);
+
+  // Records the outcome of a request to 'host'. Only the responses which mean
+  // the host is overloaded count as failures: HTTP 5xx and 429. Connection
+  // errors do not count, since the network of the client is as likely to
+  // cause them as the host. 'retry_after_sec' is the Retry-After value of the
+  // response, or -1. When the attempt failed, the circuit stays open at least
+  // that long.
+  void OnAttemptFinished(const CString& host,
+                         uint32 now_sec,
+                         RetryPolicy::ErrorClass error_class,
+                         int retry_after_sec);
+
+  // Returns the cooldown after 'consecutive_failures' failures.
+  static int GetCooldownSec(int consecutive_failures);
+
+ private:
+  void Save(const CString& host, const HostHealth& health);
+
+  HostHealthStore* store_;
+
+  DISALLOW_COPY_AND_ASSIGN(CircuitBreaker);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_CIRCUIT_BREAKER_H_
@@ -0,0 +1,171 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/circuit_breaker.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kHost = _T("tools.google.com");
+const uint32 kNowSec = 1400000000;
+
+}  // namespace
+
+class CircuitBreakerTest : public testing::Test {
+ protected:
+  CircuitBreakerTest() : circuit_breaker_(&store_) {}
+
+  void Fail(uint32 now_sec, int count) {
+    for (int i = 0; i < count; ++i) {
+      circuit_breaker_.OnAttemptFinished(kHost,
+                                         now_sec,
+                                         RetryPolicy::ERROR_CLASS_SERVER,
+                                         -1);
+    }
+  }
+
+  MemoryHostHealthStore store_;
+  CircuitBreaker circuit_breaker_;
+};
+
+TEST_F(CircuitBreakerTest, OpensAfterConsecutiveFailures) {
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec));
+
+  Fail(kNowSec, CircuitBreaker::kFailureThreshold - 1);
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec));
+
+  Fail(kNowSec, 1);
+  EXPECT_FALSE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec));
+  EXPECT_FALSE(circuit_breaker_.IsRequestAllowed(
+      kHost, kNowSec + CircuitBreaker::kMinCooldownSec - 1));
+
+  // The other hosts are not affected.
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(_T("dl.google.com"),
+                                                kNowSec));
+
+  // The host is probed once the cooldown is over.
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(
+      kHost, kNowSec + CircuitBreaker::kMinCooldownSec));
+}
+
+TEST_F(CircuitBreakerTest, ProbeFailureDoublesCooldown) {
+  Fail(kNowSec, CircuitBreaker::kFailureThreshold);
+
+  const uint32 probe_sec = kNowSec + CircuitBreaker::kMinCooldownSec;
+  Fail(probe_sec, 1);
+  EXPECT_FALSE(circuit_breaker_.IsRequestAllowed(
+      kHost, probe_sec + 2 * CircuitBreaker::kMinCooldownSec - 1));
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(
+      kHost, probe_sec + 2 * CircuitBreaker::kMinCooldownSec));
+}
+
+TEST_F(CircuitBreakerTest, SuccessClosesCircuit) {
+  Fail(kNowSec, CircuitBreaker::kFailureThreshold + 2);
+
+  circuit_breaker_.OnAttemptFinished(kHost,
+                                     kNowSec + CircuitBreaker::kMaxCooldownSec,
+                                     RetryPolicy::ERROR_CLASS_NONE,
+                                     -1);
+  HostHealth health;
+  EXPECT_SUCCEEDED(store_.Load(kHost, &health));
+  EXPECT_TRUE(health.is_healthy());
+
+  // It takes as many failures as before to open the circuit again.
+  Fail(kNowSec, CircuitBreaker::kFailureThreshold - 1);
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec));
+}
+
+TEST_F(CircuitBreakerTest, OnlyServerErrorsAreFailures) {
+  const RetryPolicy::ErrorClass kErrorClasses[] = {
+    RetryPolicy::ERROR_CLASS_CONNECTION,
+    RetryPolicy::ERROR_CLASS_NAME_RESOLUTION,
+    RetryPolicy::ERROR_CLASS_SECURE_CHANNEL,
+    RetryPolicy::ERROR_CLASS_CLIENT,
+    RetryPolicy::ERROR_CLASS_OTHER,
+  };
+  for (int i = 0; i < arraysize(kErrorClasses); ++i) {
+    for (int j = 0; j < CircuitBreaker::kFailureThreshold; ++j) {
+      circuit_breaker_.OnAttemptFinished(kHost, kNowSec, kErrorClasses[i], -1);
+    }
+  }
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec));
+
+  for (int i = 0; i < CircuitBreaker::kFailureThreshold; ++i) {
+    circuit_breaker_.OnAttemptFinished(kHost,
+                                       kNowSec,
+                                       RetryPolicy::ERROR_CLASS_SERVER,
+                                       -1);
+  }
+  EXPECT_FALSE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec));
+}
+
+TEST_F(CircuitBreakerTest, RetryAfterOpensCircuit) {
+  circuit_breaker_.OnAttemptFinished(kHost,
+                                     kNowSec,
+                                     RetryPolicy::ERROR_CLASS_THROTTLED,
+                                     600);
+  EXPECT_FALSE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec + 599));
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec + 600));
+
+  // The Retry-After value is capped by the longest cooldown.
+  circuit_breaker_.OnAttemptFinished(kHost,
+                                     kNowSec,
+                                     RetryPolicy::ERROR_CLASS_THROTTLED,
+                                     kSecondsPerDay);
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(
+      kHost, kNowSec + CircuitBreaker::kMaxCooldownSec));
+}
+
+TEST_F(CircuitBreakerTest, IgnoresCooldownAfterClockChange) {
+  Fail(kNowSec, CircuitBreaker::kFailureThreshold);
+  EXPECT_FALSE(circuit_breaker_.IsRequestAllowed(kHost, kNowSec));
+  EXPECT_TRUE(circuit_breaker_.IsRequestAllowed(kHost,
+                                                kNowSec - kSecondsPerDay));
+}
+
+TEST(CircuitBreakerStaticTest, GetCooldownSec) {
+  const int kThreshold = CircuitBreaker::kFailureThreshold;
+  EXPECT_EQ(60, CircuitBreaker::GetCooldownSec(kThreshold));
+  EXPECT_EQ(120, CircuitBreaker::GetCooldownSec(kThreshold + 1));
+  EXPECT_EQ(1920, CircuitBreaker::GetCooldownSec(kThreshold + 5));
+  EXPECT_EQ(CircuitBreaker::kMaxCooldownSec,
+            CircuitBreaker::GetCooldownSec(kThreshold + 6));
+  EXPECT_EQ(CircuitBreaker::kMaxCooldownSec,
+            CircuitBreaker::GetCooldownSec(INT_MAX));
+}
+
+TEST(RegistryHostHealthStoreTest, SaveAndLoad) {
+  const TCHAR* const kTestHost = _T("circuitbreakertest.invalid");
+  RegistryHostHealthStore store;
+
+  HostHealth health;
+  health.consecutive_failures = 5;
+  health.open_until_sec = 0xfffffff0;
+  EXPECT_SUCCEEDED(store.Save(kTestHost, health));
+
+  HostHealth loaded_health;
+  EXPECT_SUCCEEDED(store.Load(kTestHost, &loaded_health));
+  EXPECT_EQ(5, loaded_health.consecutive_failures);
+  EXPECT_EQ(0xfffffff0, loaded_health.open_until_sec);
+
+  // Saving a healthy state removes the value.
+  EXPECT_SUCCEEDED(store.Save(kTestHost, HostHealth()));
+  EXPECT_SUCCEEDED(store.Load(kTestHost, &loaded_health));
+  EXPECT_TRUE(loaded_health.is_healthy());
+}
+
+}  // namespace omaha
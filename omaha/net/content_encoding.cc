@@ -0,0 +1,213 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/content_encoding.h"
+#include <stdlib.h>
+#include <algorithm>
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "third_party/lzma/files/C/LzmaDec.h"
+#include "third_party/lzma/files/C/LzmaEnc.h"
+
+namespace omaha {
+
+namespace {
+
+// Protocol messages are a few KB to a few hundred KB, so the dictionary is
+// sized to the body instead of the multi-megabyte default of the encoder.
+const UInt32 kMinDictionarySize = 1 << 12;
+const UInt32 kMaxDictionarySize = 1 << 20;
+
+const int kCompressionLevel = 5;
+
+const size_t kDecodedSizeOffset = LZMA_PROPS_SIZE;
+
+void* LzmaAlloc(void* p, size_t size) {
+  UNREFERENCED_PARAMETER(p);
+  return size ? ::malloc(size) : NULL;
+}
+
+void LzmaFree(void* p, void* address) {
+  UNREFERENCED_PARAMETER(p);
+  ::free(address);
+}
+
+ISzAlloc lzma_allocator = { &LzmaAlloc, &LzmaFree };
+
+}  // namespace
+
+HRESULT LzmaEncodeBody(const void* body,
+                       size_t body_size,
+                       std::vector<uint8>* encoded_body) {
+  ASSERT1(body || !body_size);
+  ASSERT1(encoded_body);
+
+  CLzmaEncProps props;
+  LzmaEncProps_Init(&props);
+  props.level = kCompressionLevel;
+  props.dictSize = kMinDictionarySize;
+  while (props.dictSize < body_size && props.dictSize < kMaxDictionarySize) {
+    props.dictSize <<= 1;
+  }
+  props.numThreads = 1;
+
+  // This is the bound the LZMA SDK documents for incompressible data.
+  SizeT encoded_size = body_size + body_size / 3 + 128;
+  encoded_body->resize(LzmaBodyDecoder::kHeaderSize + encoded_size);
+
+  SizeT props_size = LZMA_PROPS_SIZE;
+  const SRes res = LzmaEncode(
+      &(*encoded_body)[LzmaBodyDecoder::kHeaderSize],
+      &encoded_size,
+      static_cast<const Byte*>(body),
+      body_size,
+      &props,
+      &encoded_body->front(),
+      &props_size,
+      0,
+      NULL,
+      &lzma_allocator,
+      &lzma_allocator);
+  if (res != SZ_OK) {
+    NET_LOG(LE, (_T("[LzmaEncode failed][%d]"), res));
+    encoded_body->clear();
+    return res == SZ_ERROR_MEM ? E_OUTOFMEMORY : E_FAIL;
+  }
+  ASSERT1(props_size == LZMA_PROPS_SIZE);
+
+  const uint64 decoded_size = body_size;
+  for (int i = 0; i != 8; ++i) {
+    (*encoded_body)[kDecodedSizeOffset + i] =
+        static_cast<uint8>(decoded_size >> (8 * i));
+  }
+  encoded_body->resize(LzmaBodyDecoder::kHeaderSize + encoded_size);
+
+  NET_LOG(L4, (_T("[LzmaEncodeBody][%u bytes][%u encoded]"),
+               body_size, encoded_body->size()));
+  return S_OK;
+}
+
+struct LzmaBodyDecoder::DecoderState {
+  CLzmaDec decoder;
+};
+
+LzmaBodyDecoder::LzmaBodyDecoder() : is_finished_(false) {
+}
+
+LzmaBodyDecoder::~LzmaBodyDecoder() {
+  if (state_.get()) {
+    LzmaDec_FreeProbs(&state_->decoder, &lzma_allocator);
+  }
+}
+
+HRESULT LzmaBodyDecoder::Decode(const void* data, size_t size) {
+  ASSERT1(data || !size);
+
+  const uint8* next = static_cast<const uint8*>(data);
+  if (!state_.get()) {
+    HRESULT hr = ReadHeader(&next, &size);
+    if (FAILED(hr) || !state_.get()) {
+      return hr;
+    }
+  }
+
+  if (is_finished_ || !size) {
+    return S_OK;
+  }
+
+  CLzmaDec* decoder = &state_->decoder;
+  SizeT input_size = size;
+  ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+  const SRes res = LzmaDec_DecodeToDic(decoder,
+                                       decoded_body_.size(),
+                                       next,
+                                       &input_size,
+                                       LZMA_FINISH_ANY,
+                                       &status);
+  if (res != SZ_OK) {
+    NET_LOG(LE, (_T("[LzmaDec_DecodeToDic failed][%d]"), res));
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  is_finished_ = decoder->dicPos == decoded_body_.size();
+  if (!is_finished_ && status == LZMA_STATUS_FINISHED_WITH_MARK) {
+    NET_LOG(LE, (_T("[encoded body ended early][%u of %u bytes]"),
+                 decoder->dicPos, decoded_body_.size()));
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  return S_OK;
+}
+
+bool LzmaBodyDecoder::is_finished() const {
+  return is_finished_;
+}
+
+void LzmaBodyDecoder::TakeDecodedBody(std::vector<uint8>* body) {
+  ASSERT1(body);
+  ASSERT1(is_finished_);
+
+  body->swap(decoded_body_);
+  decoded_body_.clear();
+}
+
+HRESULT LzmaBodyDecoder::ReadHeader(const uint8** data, size_t* size) {
+  ASSERT1(data);
+  ASSERT1(size);
+
+  const size_t header_bytes = std::min(kHeaderSize - header_.size(), *size);
+  header_.insert(header_.end(), *data, *data + header_bytes);
+  *data += header_bytes;
+  *size -= header_bytes;
+  if (header_.size() < kHeaderSize) {
+    return S_OK;
+  }
+
+  // The encoder always writes the length of the body, so the marker for an
+  // unknown length is rejected as any other length which is too large.
+  uint64 decoded_size = 0;
+  for (int i = 7; i >= 0; --i) {
+    decoded_size = (decoded_size << 8) | header_[kDecodedSizeOffset + i];
+  }
+  if (decoded_size > kMaxDecodedSize) {
+    NET_LOG(LE, (_T("[decoded body too large][%I64u]"), decoded_size));
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  scoped_ptr<DecoderState> state(new DecoderState);
+  LzmaDec_Construct(&state->decoder);
+  const SRes res = LzmaDec_AllocateProbs(&state->decoder,
+                                         &header_.front(),
+                                         LZMA_PROPS_SIZE,
+                                         &lzma_allocator);
+  if (res != SZ_OK) {
+    NET_LOG(LE, (_T("[LzmaDec_AllocateProbs failed][%d]"), res));
+    return res == SZ_ERROR_MEM ? E_OUTOFMEMORY :
+                                 HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  // The decoded body is the dictionary of the decoder.
+  decoded_body_.resize(static_cast<size_t>(decoded_size));
+  state->decoder.dic = decoded_body_.empty() ? NULL : &decoded_body_.front();
+  state->decoder.dicBufSize = decoded_body_.size();
+  LzmaDec_Init(&state->decoder);
+
+  state_.reset(state.release());
+  is_finished_ = decoded_body_.empty();
+  return S_OK;
+}
+
+}  // namespace omaha
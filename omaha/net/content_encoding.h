@@ -0,0 +1,88 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Encodes and decodes the bodies of the protocol requests and responses with
+// LZMA. The server answers with an encoded body when the request advertises
+// the encoding in the Accept-Encoding header, and it decodes request bodies
+// sent with the Content-Encoding header.
+//
+// An encoded body is in the .lzma format: the 5 bytes of the coder properties,
+// the length of the decoded body as a 64-bit little-endian integer, and the
+// compressed data. Since the length of the decoded body is known up front, the
+// decoder decodes into a buffer which is allocated only once and which also
+// serves as the dictionary of the decoder.
+
+#ifndef OMAHA_NET_CONTENT_ENCODING_H_
+#define OMAHA_NET_CONTENT_ENCODING_H_
+
+#include <windows.h>
+#include <tchar.h>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/scoped_ptr.h"
+
+namespace omaha {
+
+// The content coding in the Accept-Encoding and Content-Encoding headers.
+const TCHAR* const kLzmaContentEncoding = _T("lzma");
+
+// Encodes 'body_size' bytes at 'body'.
+HRESULT LzmaEncodeBody(const void* body,
+                       size_t body_size,
+                       std::vector<uint8>* encoded_body);
+
+// Decodes an encoded body as its bytes are received, so that the body is
+// decoded by the time the last bytes arrive.
+class LzmaBodyDecoder {
+ public:
+  // The size of the properties and of the decoded length at the start of
+  // an encoded body.
+  static const size_t kHeaderSize = 13;
+
+  // Bodies which claim to decode to more bytes than this are rejected before
+  // anything is allocated for them.
+  static const uint64 kMaxDecodedSize = 32 * 1024 * 1024;
+
+  LzmaBodyDecoder();
+  ~LzmaBodyDecoder();
+
+  // Decodes the next 'size' bytes of the encoded body. Returns
+  // HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if the body is corrupt. The bytes
+  // which follow the end of the body are ignored.
+  HRESULT Decode(const void* data, size_t size);
+
+  // Returns true once the whole body has been decoded.
+  bool is_finished() const;
+
+  // Moves the decoded body into 'body'.
+  void TakeDecodedBody(std::vector<uint8>* body);
+
+ private:
+  struct DecoderState;
+
+  // Reads the header from the start of 'data' and allocates the decoded body.
+  HRESULT ReadHeader(const uint8** data, size_t* size);
+
+  std::vector<uint8> header_;
+  std::vector<uint8> decoded_body_;
+  scoped_ptr<DecoderState> state_;
+  bool is_finished_;
+
+  DISALLOW_COPY_AND_ASSIGN(LzmaBodyDecoder);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_CONTENT_ENCODING_H_
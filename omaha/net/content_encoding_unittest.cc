@@ -0,0 +1,215 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "omaha/base/error.h"
+#include "omaha/net/content_encoding.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+// Returns an update check request for 'num_apps' apps, which is as redundant
+// as the requests which the client sends.
+std::vector<uint8> MakeUpdateRequest(int num_apps) {
+  CStringA request(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+      "<request protocol=\"3.0\" version=\"1.3.26.0\" ismachine=\"1\" "
+      "sessionid=\"{5FAD27D4-6BFA-4daa-A1B3-5A1F821FEE0F}\" "
+      "installsource=\"scheduler\" requestid=\"{C8F6EDF3-B623-4ee6-B2DA-"
+      "1D08A0B4C665}\"><os platform=\"win\" version=\"6.1\" sp=\"Service "
+      "Pack 1\" arch=\"x64\"/>");
+  for (int i = 0; i < num_apps; ++i) {
+    request.AppendFormat(
+        "<app appid=\"{%08X-E6DB-4b29-8FCD-8FEC3CD4E5D1}\" "
+        "version=\"%d.0.%d.0\" nextversion=\"\" lang=\"en\" brand=\"GGLS\" "
+        "client=\"\" installage=\"%d\"><updatecheck/>"
+        "<ping active=\"1\" a=\"1\" r=\"1\"/><event eventtype=\"3\" "
+        "eventresult=\"1\" errorcode=\"0\" extracode1=\"0\"/></app>",
+        i, i % 7, i * 13, i % 100);
+  }
+  request.Append("</request>");
+
+  const uint8* begin = reinterpret_cast<const uint8*>(request.GetString());
+  return std::vector<uint8>(begin, begin + request.GetLength());
+}
+
+// Decodes 'encoded_body' by feeding it to the decoder in chunks of
+// 'chunk_size' bytes.
+HRESULT DecodeInChunks(const std::vector<uint8>& encoded_body,
+                       size_t chunk_size,
+                       std::vector<uint8>* body) {
+  LzmaBodyDecoder decoder;
+  for (size_t i = 0; i < encoded_body.size(); i += chunk_size) {
+    const size_t size = std::min(chunk_size, encoded_body.size() - i);
+    HRESULT hr = decoder.Decode(&encoded_body[i], size);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+  if (!decoder.is_finished()) {
+    return E_FAIL;
+  }
+  decoder.TakeDecodedBody(body);
+  return S_OK;
+}
+
+}  // namespace
+
+TEST(ContentEncodingTest, RoundTrip) {
+  const std::vector<uint8> body(MakeUpdateRequest(50));
+
+  std::vector<uint8> encoded_body;
+  EXPECT_SUCCEEDED(LzmaEncodeBody(&body.front(), body.size(), &encoded_body));
+  EXPECT_LT(encoded_body.size() * 10, body.size());
+
+  std::vector<uint8> decoded_body;
+  EXPECT_SUCCEEDED(DecodeInChunks(encoded_body,
+                                  encoded_body.size(),
+                                  &decoded_body));
+  EXPECT_TRUE(body == decoded_body);
+}
+
+TEST(ContentEncodingTest, DecodeInChunks) {
+  const std::vector<uint8> body(MakeUpdateRequest(10));
+
+  std::vector<uint8> encoded_body;
+  EXPECT_SUCCEEDED(LzmaEncodeBody(&body.front(), body.size(), &encoded_body));
+
+  // The chunks split the header as well as the compressed data.
+  const size_t kChunkSizes[] = { 1, 2, 7, 100, 4096 };
+  for (size_t i = 0; i < arraysize(kChunkSizes); ++i) {
+    std::vector<uint8> decoded_body;
+    EXPECT_SUCCEEDED(DecodeInChunks(encoded_body,
+                                    kChunkSizes[i],
+                                    &decoded_body));
+    EXPECT_TRUE(body == decoded_body);
+  }
+}
+
+TEST(ContentEncodingTest, EmptyBody) {
+  std::vector<uint8> encoded_body;
+  EXPECT_SUCCEEDED(LzmaEncodeBody(NULL, 0, &encoded_body));
+  EXPECT_LE(LzmaBodyDecoder::kHeaderSize, encoded_body.size());
+
+  std::vector<uint8> decoded_body(1, 'a');
+  EXPECT_SUCCEEDED(DecodeInChunks(encoded_body, 1, &decoded_body));
+  EXPECT_TRUE(decoded_body.empty());
+}
+
+TEST(ContentEncodingTest, IncompressibleBody) {
+  std::vector<uint8> body(64 * 1024);
+  srand(1);
+  for (size_t i = 0; i != body.size(); ++i) {
+    body[i] = static_cast<uint8>(rand());
+  }
+
+  std::vector<uint8> encoded_body;
+  EXPECT_SUCCEEDED(LzmaEncodeBody(&body.front(), body.size(), &encoded_body));
+  EXPECT_LT(body.size(), encoded_body.size());
+
+  std::vector<uint8> decoded_body;
+  EXPECT_SUCCEEDED(DecodeInChunks(encoded_body, 1000, &decoded_body));
+  EXPECT_TRUE(body == decoded_body);
+}
+
+TEST(ContentEncodingTest, TruncatedBody) {
+  const std::vector<uint8> body(MakeUpdateRequest(10));
+  std::vector<uint8> encoded_body;
+  EXPECT_SUCCEEDED(LzmaEncodeBody(&body.front(), body.size(), &encoded_body));
+
+  LzmaBodyDecoder decoder;
+  EXPECT_SUCCEEDED(decoder.Decode(&encoded_body.front(),
+                                  encoded_body.size() / 2));
+  EXPECT_FALSE(decoder.is_finished());
+
+  // A body cut in the header is not finished either.
+  LzmaBodyDecoder header_decoder;
+  EXPECT_SUCCEEDED(header_decoder.Decode(&encoded_body.front(), 5));
+  EXPECT_FALSE(header_decoder.is_finished());
+}
+
+TEST(ContentEncodingTest, InvalidHeader) {
+  const std::vector<uint8> body(MakeUpdateRequest(1));
+  std::vector<uint8> encoded_body;
+  EXPECT_SUCCEEDED(LzmaEncodeBody(&body.front(), body.size(), &encoded_body));
+
+  // The properties are out of range.
+  std::vector<uint8> invalid_properties(encoded_body);
+  invalid_properties[0] = 0xff;
+  LzmaBodyDecoder properties_decoder;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            properties_decoder.Decode(&invalid_properties.front(),
+                                      invalid_properties.size()));
+
+  // The length is unknown, which is encoded as all bits set.
+  std::vector<uint8> unknown_length(encoded_body);
+  memset(&unknown_length[5], 0xff, 8);
+  LzmaBodyDecoder unknown_length_decoder;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            unknown_length_decoder.Decode(&unknown_length.front(),
+                                          unknown_length.size()));
+
+  // The length is larger than a body can be.
+  std::vector<uint8> large_length(encoded_body);
+  memset(&large_length[5], 0, 8);
+  large_length[8] = 0x10;
+  LzmaBodyDecoder large_length_decoder;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            large_length_decoder.Decode(&large_length.front(),
+                                        large_length.size()));
+}
+
+TEST(ContentEncodingTest, CorruptBody) {
+  const std::vector<uint8> body(MakeUpdateRequest(50));
+  std::vector<uint8> encoded_body;
+  EXPECT_SUCCEEDED(LzmaEncodeBody(&body.front(), body.size(), &encoded_body));
+
+  // LZMA has no checksum, so a corrupt body is either rejected or decodes to
+  // a different body. CUP detects the latter for the update checks.
+  for (size_t i = LzmaBodyDecoder::kHeaderSize;
+       i < encoded_body.size();
+       i += 97) {
+    std::vector<uint8> corrupt_body(encoded_body);
+    corrupt_body[i] ^= 0x55;
+    std::vector<uint8> decoded_body;
+    const HRESULT hr = DecodeInChunks(corrupt_body, 512, &decoded_body);
+    if (SUCCEEDED(hr)) {
+      EXPECT_EQ(body.size(), decoded_body.size());
+    }
+  }
+}
+
+TEST(ContentEncodingTest, EncodedSize) {
+  const int kNumApps[] = { 1, 50, 1000 };
+  for (size_t i = 0; i < arraysize(kNumApps); ++i) {
+    const std::vector<uint8> body(MakeUpdateRequest(kNumApps[i]));
+    std::vector<uint8> encoded_body;
+    EXPECT_SUCCEEDED(LzmaEncodeBody(&body.front(),
+                                    body.size(),
+                                    &encoded_body));
+    EXPECT_LT(encoded_body.size(), body.size());
+
+    std::wcout << _T("\t") << kNumApps[i] << _T(" apps: ") << body.size()
+               << _T(" bytes, ") << encoded_body.size() << _T(" encoded")
+               << std::endl;
+  }
+}
+
+}  // namespace omaha
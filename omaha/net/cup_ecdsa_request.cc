@@ -109,10 +109,25 @@ HRESULT CupEcdsaRequestImpl::Resume() {
   return http_request_->Resume();
 }
 
+// The response body is moved out of the inner request when it is received,
+// unless the inner request failed.
 std::vector<uint8> CupEcdsaRequestImpl::GetResponse() const {
+  if (cup_.get() && !cup_->response.empty()) {
+    return cup_->response;
+  }
   return http_request_->GetResponse();
 }
 
+void CupEcdsaRequestImpl::TakeResponse(std::vector<uint8>* response) {
+  ASSERT1(response);
+  if (cup_.get() && !cup_->response.empty()) {
+    response->clear();
+    cup_->response.swap(*response);
+    return;
+  }
+  http_request_->TakeResponse(response);
+}
+
 HRESULT CupEcdsaRequestImpl::QueryHeadersString(uint32 info_level,
                                                 const TCHAR* name,
                                                 CString* value) const {
@@ -159,6 +174,10 @@ void CupEcdsaRequestImpl::set_low_priority(bool low_priority) {
   http_request_->set_low_priority(low_priority);
 }
 
+void CupEcdsaRequestImpl::set_compress_request(bool compress_request) {
+  http_request_->set_compress_request(compress_request);
+}
+
 void CupEcdsaRequestImpl::set_callback(NetworkRequestCallback* callback) {
   http_request_->set_callback(callback);
 }
@@ -188,7 +207,10 @@ HRESULT CupEcdsaRequestImpl::BuildRequest() {
   }
 
   // Compute the SHA-256 hash of the request body; we need it to verify the
-  // response, and we can optionally send it to the server as well.
+  // response, and we can optionally send it to the server as well. The hashes
+  // of the request and of the response are computed over the bodies before
+  // they are encoded for the wire, since the inner request encodes the request
+  // body and decodes the response body.
   VERIFY1(SafeSHA256Hash(request_buffer_, request_buffer_length_,
                          &cup_->request_hash));
 
@@ -227,7 +249,7 @@ HRESULT CupEcdsaRequestImpl::DoSend() {
   }
 
   // Save the response body, and make sure we got an HTTP 200 or 206.
-  http_request_->GetResponse().swap(cup_->response);
+  http_request_->TakeResponse(&cup_->response);
   int status_code(http_request_->GetHttpStatusCode());
   if (status_code != HTTP_STATUS_OK &&
       status_code != HTTP_STATUS_PARTIAL_CONTENT) {
@@ -438,6 +460,10 @@ std::vector<uint8> CupEcdsaRequest::GetResponse() const {
   return impl_->GetResponse();
 }
 
+void CupEcdsaRequest::TakeResponse(std::vector<uint8>* response) {
+  impl_->TakeResponse(response);
+}
+
 int CupEcdsaRequest::GetHttpStatusCode() const {
   return impl_->GetHttpStatusCode();
 }
@@ -481,6 +507,10 @@ void CupEcdsaRequest::set_low_priority(bool low_priority) {
   impl_->set_low_priority(low_priority);
 }
 
+void CupEcdsaRequest::set_compress_request(bool compress_request) {
+  impl_->set_compress_request(compress_request);
+}
+
 void CupEcdsaRequest::set_callback(NetworkRequestCallback* callback) {
   impl_->set_callback(callback);
 }
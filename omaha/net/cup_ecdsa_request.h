@@ -56,6 +56,8 @@ class CupEcdsaRequest : public HttpRequestInterface {
 
   virtual std::vector<uint8> GetResponse() const;
 
+  virtual void TakeResponse(std::vector<uint8>* response);
+
   virtual HRESULT QueryHeadersString(uint32 info_level,
                                      const TCHAR* name,
                                      CString* value) const;
@@ -78,6 +80,8 @@ class CupEcdsaRequest : public HttpRequestInterface {
 
   virtual void set_low_priority(bool low_priority);
 
+  virtual void set_compress_request(bool compress_request);
+
   virtual void set_callback(NetworkRequestCallback* callback);
 
   virtual void set_additional_headers(const CString& additional_headers);
@@ -0,0 +1,115 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/download_controller.h"
+#include <algorithm>
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/logging.h"
+
+namespace omaha {
+
+namespace {
+
+// The throughput is averaged over the last few seconds, and is not known
+// before half a second of download.
+const int kSampleTimeRangeMs = 3000;
+const int kMinimumSampleRangeMs = 500;
+
+}  // namespace
+
+DownloadController::DownloadController(bool is_low_priority,
+                                       int min_bytes_per_sec)
+    : is_low_priority_(is_low_priority),
+      min_bytes_per_sec_(min_bytes_per_sec),
+      sampler_(kSampleTimeRangeMs, kMinimumSampleRangeMs),
+      start_time_ms_(0),
+      bytes_(0),
+      peak_bytes_per_sec_(-1) {
+  ASSERT1(min_bytes_per_sec >= 0);
+}
+
+void DownloadController::Start(uint64 time_ms) {
+  sampler_.Reset();
+  start_time_ms_ = time_ms;
+  bytes_ = 0;
+  peak_bytes_per_sec_ = -1;
+  sampler_.AddSample(0, 0);
+}
+
+void DownloadController::OnBytesReceived(uint64 time_ms, uint64 bytes) {
+  ASSERT1(time_ms >= start_time_ms_);
+  bytes_ += bytes;
+
+  // The samples are scaled so that the progress per ms of the sampler is the
+  // number of bytes per second, which keeps the precision for slow links.
+  sampler_.AddSample(time_ms - start_time_ms_,
+                     static_cast<int64>(bytes_) * kMsPerSec);
+  peak_bytes_per_sec_ = std::max(peak_bytes_per_sec_, GetBytesPerSec());
+}
+
+DWORD DownloadController::GetReadSize() const {
+  const int64 bytes_per_sec = GetBytesPerSec();
+  if (bytes_per_sec <= 0) {
+    return kMinReadSize;
+  }
+
+  const int64 read_size = bytes_per_sec * kReadIntervalMs / kMsPerSec;
+  return static_cast<DWORD>(std::min(std::max(read_size,
+                                              static_cast<int64>(kMinReadSize)),
+                                     static_cast<int64>(kMaxReadSize)));
+}
+
+// The delay keeps the average throughput since the start of the transfer at
+// the target share of the peak throughput. Bounding each delay spreads out
+// the delay owed for the reads which happened before the peak was known.
+int DownloadController::GetThrottleDelayMs(uint64 time_ms) const {
+  if (!is_low_priority_ || peak_bytes_per_sec_ <= 0) {
+    return 0;
+  }
+
+  const int64 target_bytes_per_sec =
+      std::max(peak_bytes_per_sec_ * kBackgroundSharePercent / 100,
+               static_cast<int64>(1));
+  const int64 target_elapsed_ms =
+      static_cast<int64>(bytes_) * kMsPerSec / target_bytes_per_sec;
+  const int64 elapsed_ms = static_cast<int64>(time_ms - start_time_ms_);
+  if (target_elapsed_ms <= elapsed_ms) {
+    return 0;
+  }
+
+  return static_cast<int>(std::min(target_elapsed_ms - elapsed_ms,
+                                   static_cast<int64>(kMaxThrottleDelayMs)));
+}
+
+bool DownloadController::IsTooSlow(uint64 time_ms) const {
+  if (!min_bytes_per_sec_ ||
+      time_ms - start_time_ms_ < kMinTimeBeforeTooSlowMs) {
+    return false;
+  }
+
+  const int64 bytes_per_sec = GetBytesPerSec();
+  return bytes_per_sec >= 0 &&
+         bytes_per_sec < min_bytes_per_sec_ &&
+         bytes_per_sec < peak_bytes_per_sec_ * kTooSlowPercentOfPeak / 100;
+}
+
+int64 DownloadController::GetBytesPerSec() const {
+  const int64 bytes_per_sec = sampler_.GetAverageProgressPerMs();
+  return bytes_per_sec == ProgressSampler<int64>::kUnknownProgressPerMs ?
+         -1 : bytes_per_sec;
+}
+
+}  // namespace omaha
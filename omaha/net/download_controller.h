@@ -0,0 +1,104 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// DownloadController adapts a file download to the throughput measured while
+// the file is downloaded. It chooses how much data to read at a time, delays
+// the reads of background downloads so that they only use a share of the
+// throughput of the link, and detects downloads which are too slow to finish
+// from the current url when the file can be downloaded from another url.
+//
+// The throughput is measured over the wall-clock time of the download. The
+// network stack keeps receiving data while a background download waits, so
+// the time spent waiting cannot be taken out of the measurement. The delays
+// only start once the throughput is known, therefore the peak throughput is
+// measured without delays and is the throughput of the link.
+
+#ifndef OMAHA_NET_DOWNLOAD_CONTROLLER_H_
+#define OMAHA_NET_DOWNLOAD_CONTROLLER_H_
+
+#include <windows.h>
+#include "base/basictypes.h"
+#include "omaha/common/progress_sampler.h"
+
+namespace omaha {
+
+class DownloadController {
+ public:
+  // Reads are sized to take about this long at the measured throughput.
+  static const int kReadIntervalMs = 100;
+  static const DWORD kMinReadSize = 8 * 1024;
+  static const DWORD kMaxReadSize = 1024 * 1024;
+
+  // Background downloads use this share of the highest throughput measured.
+  static const int kBackgroundSharePercent = 50;
+
+  // Bounds each delay, so that canceling a background download is not delayed
+  // by more than this.
+  static const int kMaxThrottleDelayMs = 500;
+
+  // The download must have run this long before it is considered too slow.
+  static const int kMinTimeBeforeTooSlowMs = 30 * 1000;
+
+  // A download is only too slow if its throughput has dropped below this
+  // share of its peak throughput.
+  static const int kTooSlowPercentOfPeak = 25;
+
+  // 'min_bytes_per_sec' is the throughput below which the download may be too
+  // slow, or 0 if the download is never too slow.
+  DownloadController(bool is_low_priority, int min_bytes_per_sec);
+
+  // Starts measuring a transfer which begins at 'time_ms'.
+  void Start(uint64 time_ms);
+
+  // Records that 'bytes' more bytes have been read at 'time_ms'.
+  void OnBytesReceived(uint64 time_ms, uint64 bytes);
+
+  // Returns the number of bytes to read next.
+  DWORD GetReadSize() const;
+
+  // Returns how long to wait before the next read. Always 0 for foreground
+  // downloads. The caller is expected to wait for the returned time.
+  int GetThrottleDelayMs(uint64 time_ms) const;
+
+  // Returns true if, after the download has run for kMinTimeBeforeTooSlowMs,
+  // the throughput is below the minimum throughput and has dropped below
+  // kTooSlowPercentOfPeak of the peak throughput. A download which has been
+  // slow from the start is most likely limited by the link of the client,
+  // which another url would not make faster.
+  bool IsTooSlow(uint64 time_ms) const;
+
+  // Returns the throughput of the link in bytes per second, or -1 if there
+  // are not enough samples yet.
+  int64 GetBytesPerSec() const;
+
+  int64 peak_bytes_per_sec() const { return peak_bytes_per_sec_; }
+
+ private:
+  const bool is_low_priority_;
+  const int min_bytes_per_sec_;
+
+  // Samples of the bytes read over the time since Start() was called.
+  ProgressSampler<int64> sampler_;
+
+  uint64 start_time_ms_;
+  uint64 bytes_;
+  int64 peak_bytes_per_sec_;
+
+  DISALLOW_COPY_AND_ASSIGN(DownloadController);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_DOWNLOAD_CONTROLLER_H_
@@ -0,0 +1,310 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <algorithm>
+#include "base/basictypes.h"
+#include "omaha/base/constants.h"
+#include "omaha/net/download_controller.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+// Simulates the transfer of data over a link with a given bandwidth, a fixed
+// latency for each read, and the loss of a packet every few reads, which
+// costs a retransmission timeout. The link keeps delivering data while the
+// reader waits, up to the size of the receive window, and the buffered data
+// is read instantly. The time is simulated as well, so the tests run
+// instantly and always measure the same throughput.
+class SimulatedLink {
+ public:
+  static const uint64 kReceiveWindowBytes = 64 * 1024;
+
+  SimulatedLink(int bytes_per_sec, int latency_ms)
+      : bytes_per_sec_(bytes_per_sec),
+        latency_ms_(latency_ms),
+        slowdown_bytes_(0),
+        slow_bytes_per_sec_(0),
+        loss_period_(0),
+        retransmit_ms_(0),
+        bytes_sent_(0),
+        bytes_buffered_(0),
+        last_read_end_ms_(0),
+        reads_(0) {
+  }
+
+  // The bandwidth of the link drops to 'bytes_per_sec' once 'after_bytes'
+  // bytes have been sent.
+  void set_slowdown(uint64 after_bytes, int bytes_per_sec) {
+    slowdown_bytes_ = after_bytes;
+    slow_bytes_per_sec_ = bytes_per_sec;
+  }
+
+  // Every 'loss_period' read loses a packet, which delays it by
+  // 'retransmit_ms'.
+  void set_loss(int loss_period, int retransmit_ms) {
+    loss_period_ = loss_period;
+    retransmit_ms_ = retransmit_ms;
+  }
+
+  // Returns how long it takes to read 'bytes' bytes at 'now_ms'.
+  int Transfer(uint64 now_ms, uint64 bytes) {
+    if (last_read_end_ms_ && now_ms > last_read_end_ms_) {
+      const uint64 delivered_bytes =
+          (now_ms - last_read_end_ms_) * GetBytesPerSec() / kMsPerSec;
+      const uint64 window_bytes = kReceiveWindowBytes - bytes_buffered_;
+      const uint64 buffered_bytes = std::min(delivered_bytes, window_bytes);
+      bytes_buffered_ += buffered_bytes;
+      bytes_sent_ += buffered_bytes;
+    }
+
+    const uint64 read_from_buffer = std::min(bytes, bytes_buffered_);
+    bytes_buffered_ -= read_from_buffer;
+
+    int transfer_ms = 0;
+    if (bytes > read_from_buffer) {
+      const uint64 start_ms = GetSendTimeMs(bytes_sent_);
+      bytes_sent_ += bytes - read_from_buffer;
+      transfer_ms = latency_ms_ +
+                    static_cast<int>(GetSendTimeMs(bytes_sent_) - start_ms);
+    }
+    if (loss_period_ && ++reads_ % loss_period_ == 0) {
+      transfer_ms += retransmit_ms_;
+    }
+
+    last_read_end_ms_ = now_ms + transfer_ms;
+    return transfer_ms;
+  }
+
+ private:
+  int GetBytesPerSec() const {
+    return slow_bytes_per_sec_ && bytes_sent_ >= slowdown_bytes_ ?
+           slow_bytes_per_sec_ : bytes_per_sec_;
+  }
+
+  // Returns how long it takes to send the first 'bytes' bytes over the link.
+  // The transfer times are computed from the total bytes sent so that
+  // rounding does not accumulate.
+  uint64 GetSendTimeMs(uint64 bytes) const {
+    if (!slow_bytes_per_sec_ || bytes <= slowdown_bytes_) {
+      return bytes * kMsPerSec / bytes_per_sec_;
+    }
+    return slowdown_bytes_ * kMsPerSec / bytes_per_sec_ +
+           (bytes - slowdown_bytes_) * kMsPerSec / slow_bytes_per_sec_;
+  }
+
+  const int bytes_per_sec_;
+  const int latency_ms_;
+  uint64 slowdown_bytes_;
+  int slow_bytes_per_sec_;
+  int loss_period_;
+  int retransmit_ms_;
+  uint64 bytes_sent_;
+  uint64 bytes_buffered_;
+  uint64 last_read_end_ms_;
+  int reads_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedLink);
+};
+
+}  // namespace
+
+class DownloadControllerTest : public testing::Test {
+ protected:
+  DownloadControllerTest() : now_ms_(1000000) {}
+
+  // Downloads 'total_bytes' over 'link' the way SimpleRequest does, waiting
+  // for the throttle delays. Returns the simulated duration of the download.
+  // Stops early if the controller finds the download too slow.
+  uint64 Download(DownloadController* controller,
+                  SimulatedLink* link,
+                  uint64 total_bytes) {
+    const uint64 start_ms = now_ms_;
+    controller->Start(now_ms_);
+
+    uint64 bytes_received = 0;
+    while (bytes_received < total_bytes) {
+      now_ms_ += controller->GetThrottleDelayMs(now_ms_);
+
+      const uint64 bytes = std::min(static_cast<uint64>(
+                                        controller->GetReadSize()),
+                                    total_bytes - bytes_received);
+      now_ms_ += link->Transfer(now_ms_, bytes);
+      controller->OnBytesReceived(now_ms_, bytes);
+      bytes_received += bytes;
+
+      if (controller->IsTooSlow(now_ms_)) {
+        break;
+      }
+    }
+    return now_ms_ - start_ms;
+  }
+
+  // Returns true if 'actual' is within 10% of 'expected'.
+  static bool IsNear(int64 expected, int64 actual) {
+    return actual >= expected * 9 / 10 && actual <= expected * 11 / 10;
+  }
+
+  uint64 now_ms_;
+};
+
+TEST_F(DownloadControllerTest, NoSamples) {
+  DownloadController controller(true, 1024);
+  controller.Start(now_ms_);
+
+  EXPECT_EQ(-1, controller.GetBytesPerSec());
+  EXPECT_EQ(DownloadController::kMinReadSize, controller.GetReadSize());
+  EXPECT_EQ(0, controller.GetThrottleDelayMs(now_ms_));
+  EXPECT_FALSE(controller.IsTooSlow(now_ms_ + 60000));
+}
+
+TEST_F(DownloadControllerTest, ReadSizeFollowsThroughput) {
+  DownloadController controller(false, 0);
+  SimulatedLink link(1000000, 0);
+  Download(&controller, &link, 10000000);
+
+  EXPECT_TRUE(IsNear(1000000, controller.GetBytesPerSec()));
+  EXPECT_TRUE(IsNear(1000000 * DownloadController::kReadIntervalMs / kMsPerSec,
+                     controller.GetReadSize()));
+}
+
+TEST_F(DownloadControllerTest, ReadSizeIsBounded) {
+  DownloadController fast_controller(false, 0);
+  SimulatedLink fast_link(100000000, 0);
+  Download(&fast_controller, &fast_link, 500000000);
+  EXPECT_EQ(DownloadController::kMaxReadSize, fast_controller.GetReadSize());
+
+  DownloadController slow_controller(false, 0);
+  SimulatedLink slow_link(10000, 0);
+  Download(&slow_controller, &slow_link, 100000);
+  EXPECT_EQ(DownloadController::kMinReadSize, slow_controller.GetReadSize());
+}
+
+TEST_F(DownloadControllerTest, ForegroundIsNotThrottled) {
+  DownloadController controller(false, 0);
+  SimulatedLink link(1000000, 0);
+  const uint64 duration_ms = Download(&controller, &link, 10000000);
+
+  EXPECT_TRUE(IsNear(10000, duration_ms));
+  EXPECT_EQ(0, controller.GetThrottleDelayMs(now_ms_));
+}
+
+TEST_F(DownloadControllerTest, BackgroundUsesShareOfThroughput) {
+  DownloadController controller(true, 0);
+  SimulatedLink link(1000000, 0);
+  const uint64 duration_ms = Download(&controller, &link, 10000000);
+
+  // The download takes as long as it would at the share of the throughput,
+  // even though the link buffers data during the delays.
+  EXPECT_TRUE(IsNear(10000 * 100 / DownloadController::kBackgroundSharePercent,
+                     duration_ms));
+  EXPECT_TRUE(IsNear(
+      1000000 * DownloadController::kBackgroundSharePercent / 100,
+      controller.GetBytesPerSec()));
+
+  // The peak is measured before the delays start.
+  EXPECT_TRUE(IsNear(1000000, controller.peak_bytes_per_sec()));
+}
+
+TEST_F(DownloadControllerTest, ThrottleDelayIsBounded) {
+  DownloadController controller(true, 0);
+  controller.Start(now_ms_);
+
+  // 1 MB is read at 1 MB/s, which is owed 1 second of delay.
+  for (int i = 0; i != 10; ++i) {
+    now_ms_ += 100;
+    controller.OnBytesReceived(now_ms_, 100000);
+  }
+  EXPECT_EQ(DownloadController::kMaxThrottleDelayMs,
+            controller.GetThrottleDelayMs(now_ms_));
+  now_ms_ += DownloadController::kMaxThrottleDelayMs;
+  EXPECT_EQ(DownloadController::kMaxThrottleDelayMs,
+            controller.GetThrottleDelayMs(now_ms_));
+  now_ms_ += DownloadController::kMaxThrottleDelayMs;
+  EXPECT_EQ(0, controller.GetThrottleDelayMs(now_ms_));
+}
+
+TEST_F(DownloadControllerTest, TooSlow) {
+  const int kMinRate = 4096;
+  DownloadController controller(false, kMinRate);
+  SimulatedLink link(kMinRate * 10, 0);
+  link.set_slowdown(200000, kMinRate / 4);
+  const uint64 duration_ms = Download(&controller, &link, 1000000);
+
+  EXPECT_TRUE(controller.IsTooSlow(now_ms_));
+  EXPECT_LE(DownloadController::kMinTimeBeforeTooSlowMs, duration_ms);
+  EXPECT_GT(DownloadController::kMinTimeBeforeTooSlowMs + 10000, duration_ms);
+}
+
+// A download which is slow from the start is limited by the link of the
+// client, so it is not abandoned.
+TEST_F(DownloadControllerTest, TooSlow_SlowFromTheStart) {
+  const int kMinRate = 4096;
+  DownloadController controller(false, kMinRate);
+  SimulatedLink link(kMinRate / 2, 0);
+  const uint64 duration_ms = Download(&controller, &link, 200000);
+
+  EXPECT_FALSE(controller.IsTooSlow(now_ms_));
+  EXPECT_LT(DownloadController::kMinTimeBeforeTooSlowMs, duration_ms);
+}
+
+// The throttling of a background download does not make it too slow.
+TEST_F(DownloadControllerTest, TooSlow_Background) {
+  const int kMinRate = 4096;
+  DownloadController controller(true, kMinRate);
+  SimulatedLink link(kMinRate * 3 / 2, 0);
+  const uint64 duration_ms = Download(&controller, &link, 400000);
+
+  EXPECT_FALSE(controller.IsTooSlow(now_ms_));
+  EXPECT_LT(DownloadController::kMinTimeBeforeTooSlowMs, duration_ms);
+}
+
+TEST_F(DownloadControllerTest, TooSlow_FastEnough) {
+  const int kMinRate = 4096;
+  DownloadController controller(false, kMinRate);
+  SimulatedLink link(kMinRate * 2, 0);
+  Download(&controller, &link, 400000);
+
+  EXPECT_FALSE(controller.IsTooSlow(now_ms_));
+}
+
+TEST_F(DownloadControllerTest, TooSlow_NoMinimumRate) {
+  DownloadController controller(false, 0);
+  SimulatedLink link(1000, 0);
+  Download(&controller, &link, 100000);
+
+  EXPECT_FALSE(controller.IsTooSlow(now_ms_));
+}
+
+TEST_F(DownloadControllerTest, LatencyAndLoss) {
+  DownloadController controller(false, 0);
+  SimulatedLink link(1000000, 20);
+  link.set_loss(5, 300);
+  Download(&controller, &link, 10000000);
+
+  // The latency and the retransmissions lower the throughput which the reads
+  // are sized for.
+  const int64 bytes_per_sec = controller.GetBytesPerSec();
+  EXPECT_LT(0, bytes_per_sec);
+  EXPECT_GT(1000000, bytes_per_sec);
+  EXPECT_EQ(std::max(static_cast<DWORD>(bytes_per_sec *
+                                        DownloadController::kReadIntervalMs /
+                                        kMsPerSec),
+                     DownloadController::kMinReadSize),
+            controller.GetReadSize());
+}
+
+}  // namespace omaha
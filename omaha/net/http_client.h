@@ -73,10 +73,13 @@ namespace omaha {
 
 const TCHAR* const kHttpGetMethod = _T("GET");
 const TCHAR* const kHttpPostMethod = _T("POST");
+const TCHAR* const kHttpAcceptEncodingHeader = _T("Accept-Encoding");
+const TCHAR* const kHttpContentEncodingHeader = _T("Content-Encoding");
 const TCHAR* const kHttpContentLengthHeader = _T("Content-Length");
 const TCHAR* const kHttpContentTypeHeader = _T("Content-Type");
 const TCHAR* const kHttpLastModifiedHeader = _T("Last-Modified");
 const TCHAR* const kHttpIfModifiedSinceHeader = _T("If-Modified-Since");
+const TCHAR* const kHttpRetryAfterHeader = _T("Retry-After");
 const TCHAR* const kHttpPostTextContentType =
                 _T("application/x-www-form-urlencoded");
 const TCHAR* const kHttpPostRawContentType = _T("application/octet-stream");
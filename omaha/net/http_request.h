@@ -78,6 +78,19 @@ class HttpRequestInterface {
 
   virtual void set_low_priority(bool low_priority) = 0;
 
+  // Sets the throughput below which a file download is abandoned with
+  // OMAHA_NET_E_DOWNLOAD_TOO_SLOW. Requests which do not measure their
+  // throughput ignore it.
+  virtual void set_min_download_rate(int bytes_per_sec) {
+    UNREFERENCED_PARAMETER(bytes_per_sec);
+  }
+
+  // Sets whether the request body is sent encoded. Requests which do not
+  // support encoding send the body as is.
+  virtual void set_compress_request(bool compress_request) {
+    UNREFERENCED_PARAMETER(compress_request);
+  }
+
   virtual void set_callback(NetworkRequestCallback* callback) = 0;
 
   virtual void set_additional_headers(const CString& additional_headers) = 0;
@@ -100,6 +113,12 @@ class HttpRequestInterface {
   // they are meaningful for download requests only. Download requests are the
   // requests where the response goes to a file.
   virtual bool download_metrics(DownloadMetrics* download_metrics) const = 0;
+
+  // Moves the response body into |response| instead of copying it. The
+  // request does not have a response after this call.
+  virtual void TakeResponse(std::vector<uint8>* response) {
+    GetResponse().swap(*response);
+  }
 };
 
 }   // namespace omaha
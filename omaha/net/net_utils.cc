@@ -107,5 +107,25 @@ CString MakeHttpsUrl(const CString& url) {
   return https_url;
 }
 
+CString GetUrlHost(const CString& url) {
+  CString host(RemoveInternetProtocolHeader(url));
+
+  const int path_begin = host.FindOneOf(_T("/?#"));
+  if (path_begin != -1) {
+    host.Truncate(path_begin);
+  }
+  const int user_info_end = host.ReverseFind(_T('@'));
+  if (user_info_end != -1) {
+    host.Delete(0, user_info_end + 1);
+  }
+  // The colons of an IPv6 literal are inside the brackets.
+  const int port_begin = host.ReverseFind(_T(':'));
+  if (port_begin != -1 && port_begin > host.ReverseFind(_T(']'))) {
+    host.Truncate(port_begin);
+  }
+
+  return host.MakeLower();
+}
+
 }  // namespace omaha
 
@@ -48,6 +48,10 @@ CString MakeHttpUrl(const CString& url);
 // Changes the protocol scheme of an url to https.
 CString MakeHttpsUrl(const CString& url);
 
+// Returns the host of an url in lowercase, without the scheme, the user info,
+// the port, and the path. Returns an empty string if the url has no host.
+CString GetUrlHost(const CString& url);
+
 }  // namespace omaha
 
 #endif  // OMAHA_NET_NET_UTILS_H__
@@ -29,6 +29,7 @@
 #include "base/scoped_ptr.h"
 #include "base/scope_guard.h"
 #include "omaha/base/browser_utils.h"
+#include "omaha/base/const_utils.h"
 #include "omaha/base/const_object_names.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
@@ -42,11 +43,13 @@
 #include "omaha/base/scoped_ptr_address.h"
 #include "omaha/base/string.h"
 #include "omaha/base/system.h"
+#include "omaha/base/timer.h"
 #include "omaha/base/user_info.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/net/http_client.h"
+#include "omaha/net/network_config_metrics.h"
 #include "omaha/net/winhttp.h"
 
 using omaha::encrypt::EncryptData;
@@ -70,6 +73,21 @@ size_t hash_value(const ProxyConfig& config) {
   return hash;
 }
 
+namespace {
+
+// Changes to the values or to the subkeys of these registry keys invalidate
+// the detected proxy configurations. The last key changes when the network
+// interfaces change, for instance, when an interface acquires an address.
+const TCHAR* const kProxySettingsKeys[] = {
+  kRegKeyIESettings,
+  MACHINE_REG_UPDATE_DEV,
+  MACHINE_KEY GOOPDATE_POLICIES_RELATIVE,
+  MACHINE_KEY _T("SYSTEM\\CurrentControlSet\\Services\\Tcpip\\Parameters\\")
+      _T("Interfaces"),
+};
+
+}  // namespace
+
 const TCHAR* const NetworkConfig::kUserAgent = _T("Google Update/%s");
 
 const TCHAR* const NetworkConfig::kRegKeyProxy = GOOPDATE_MAIN_KEY _T("proxy");
@@ -80,6 +98,9 @@ const TCHAR* const NetworkConfig::kDirectConnectionIdentifier = _T("direct");
 
 NetworkConfig::NetworkConfig(bool is_machine)
     : is_machine_(is_machine),
+      are_configurations_detected_(false),
+      detection_time_ms_(0),
+      detection_ttl_ms_(kDefaultDetectionTtlMs),
       is_initialized_(false) {}
 
 NetworkConfig::~NetworkConfig() {
@@ -88,6 +109,10 @@ NetworkConfig::~NetworkConfig() {
     session_.session_handle = NULL;
   }
   Clear();
+
+  for (size_t i = 0; i != change_watchers_.size(); ++i) {
+    delete change_watchers_[i];
+  }
 }
 
 HRESULT NetworkConfig::Initialize() {
@@ -155,6 +180,7 @@ void NetworkConfig::Add(ProxyDetectorInterface* detector) {
   ASSERT1(detector);
   __mutexBlock(lock_) {
     detectors_.push_back(detector);
+    are_configurations_detected_ = false;
   }
 }
 
@@ -165,11 +191,23 @@ void NetworkConfig::Clear() {
     }
     detectors_.clear();
     configurations_.clear();
+    are_configurations_detected_ = false;
   }
 }
 
 HRESULT NetworkConfig::Detect() {
   __mutexBlock(lock_) {
+    if (AreConfigurationsCurrent()) {
+      ++metric_net_proxy_detection_cache_hits;
+      return S_OK;
+    }
+    ++metric_net_proxy_detection_cache_misses;
+
+    // Watches for changes before running the detectors, so that changes
+    // which occur during the detection invalidate its outcome.
+    WatchForChanges();
+
+    LowResTimer detection_timer(true);
     std::vector<ProxyConfig> configurations;
 
     for (size_t i = 0; i != detectors_.size(); ++i) {
@@ -179,11 +217,81 @@ HRESULT NetworkConfig::Detect() {
       }
     }
     configurations_.swap(configurations);
+
+    are_configurations_detected_ = true;
+    detection_time_ms_ = ::GetTickCount();
+
+    const uint32 detection_ms = detection_timer.GetMilliseconds();
+    metric_net_proxy_detection_ms.AddSample(detection_ms);
+    NET_LOG(L3, (_T("[NetworkConfig::Detect][%u ms]"), detection_ms));
   }
 
   return S_OK;
 }
 
+void NetworkConfig::InvalidateConfigurations() {
+  __mutexBlock(lock_) {
+    are_configurations_detected_ = false;
+  }
+}
+
+void NetworkConfig::set_detection_ttl_ms(int detection_ttl_ms) {
+  ASSERT1(detection_ttl_ms >= 0);
+  __mutexBlock(lock_) {
+    detection_ttl_ms_ = detection_ttl_ms;
+  }
+}
+
+bool NetworkConfig::AreConfigurationsCurrent() const {
+  ASSERT1(lock_.GetOwner() == ::GetCurrentThreadId());
+
+  if (!are_configurations_detected_ || detection_ttl_ms_ <= 0) {
+    return false;
+  }
+
+  const DWORD age_ms = ::GetTickCount() - detection_time_ms_;
+  if (age_ms >= static_cast<DWORD>(detection_ttl_ms_)) {
+    return false;
+  }
+
+  for (size_t i = 0; i != change_watchers_.size(); ++i) {
+    if (change_watchers_[i]->HasChangeOccurred()) {
+      NET_LOG(L3, (_T("[proxy settings or network interfaces changed]")));
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void NetworkConfig::WatchForChanges() {
+  ASSERT1(lock_.GetOwner() == ::GetCurrentThreadId());
+
+  if (change_watchers_.empty()) {
+    for (size_t i = 0; i != arraysize(kProxySettingsKeys); ++i) {
+      if (RegKey::HasKey(kProxySettingsKeys[i])) {
+        change_watchers_.push_back(
+            new RegKeyWatcher(kProxySettingsKeys[i],
+                              true,
+                              REG_NOTIFY_CHANGE_NAME |
+                              REG_NOTIFY_CHANGE_LAST_SET,
+                              false));
+      }
+    }
+  }
+
+  // Registry change notifications end when the thread which requested them
+  // exits, which signals the event. When that happens, the configurations
+  // are detected again and the notification is requested again, from the
+  // current thread.
+  for (size_t i = 0; i != change_watchers_.size(); ++i) {
+    HRESULT hr = change_watchers_[i]->EnsureEventSetup();
+    if (FAILED(hr)) {
+      NET_LOG(LW, (_T("[EnsureEventSetup failed][0x%08x]"), hr));
+    }
+  }
+}
+
 void NetworkConfig::SortProxies(std::vector<ProxyConfig>* configurations) {
   ASSERT1(configurations);
 
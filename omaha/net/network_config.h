@@ -85,6 +85,8 @@ struct ProxyConfig {
   } priority;
 };
 
+class StoreWatcher;
+
 // Manages the network configurations.
 class NetworkConfig {
  public:
@@ -107,8 +109,19 @@ class NetworkConfig {
   void Clear();
 
   // Detects the network configuration for each of the registered detectors.
+  // The detected configurations are shared by all the network requests in
+  // the process and they are reused until they are older than the detection
+  // ttl, or until the proxy settings or the network interfaces change.
   HRESULT Detect();
 
+  // Discards the detected configurations so that the next call to Detect
+  // runs the detectors again.
+  void InvalidateConfigurations();
+
+  // Sets how long the detected configurations are reused. A value of zero
+  // disables reusing the configurations.
+  void set_detection_ttl_ms(int detection_ttl_ms);
+
   // Detects the network configuration for the given source.
   HRESULT Detect(const CString& proxy_source, ProxyConfig* config) const;
 
@@ -215,6 +228,9 @@ class NetworkConfig {
   static const TCHAR* const kWPADIdentifier;
   static const TCHAR* const kDirectConnectionIdentifier;
 
+  // How long the detected configurations are reused by default.
+  static const int kDefaultDetectionTtlMs = 5 * 60 * 1000;   // 5 minutes.
+
  private:
   explicit NetworkConfig(bool is_machine);
   ~NetworkConfig();
@@ -233,6 +249,14 @@ class NetworkConfig {
                             const CString& pac_url,
                             HttpClient::ProxyInfo* proxy_info);
 
+  // Returns true if the detected configurations can be reused. Must be called
+  // with the lock held.
+  bool AreConfigurationsCurrent() const;
+
+  // Starts watching the registry keys which change when the proxy settings
+  // or the network interfaces change. Must be called with the lock held.
+  void WatchForChanges();
+
   // Creates the proxy configuration registry key for the calling user
   // identified by the token.
   static HRESULT CreateProxyConfigRegKey(RegKey* key);
@@ -252,6 +276,15 @@ class NetworkConfig {
   std::vector<ProxyConfig> configurations_;
   std::vector<ProxyDetectorInterface*> detectors_;
 
+  // True if 'configurations_' holds the outcome of the detectors, and the
+  // tick count when the detection ran.
+  bool are_configurations_detected_;
+  DWORD detection_time_ms_;
+  int detection_ttl_ms_;
+
+  // Signal when the proxy settings or the network interfaces change.
+  std::vector<StoreWatcher*> change_watchers_;
+
   // Synchronizes access to per-process instance data, which includes
   // the detectors and configurations.
   LLock lock_;
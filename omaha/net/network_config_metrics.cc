@@ -0,0 +1,24 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/network_config_metrics.h"
+
+namespace omaha {
+
+DEFINE_METRIC_count(net_proxy_detection_cache_hits);
+DEFINE_METRIC_count(net_proxy_detection_cache_misses);
+DEFINE_METRIC_timing(net_proxy_detection_ms);
+
+}  // namespace omaha
@@ -0,0 +1,35 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#ifndef OMAHA_NET_NETWORK_CONFIG_METRICS_H_
+#define OMAHA_NET_NETWORK_CONFIG_METRICS_H_
+
+#include "omaha/statsreport/metrics.h"
+
+namespace omaha {
+
+// Number of proxy detections answered with the configurations detected
+// earlier in the process.
+DECLARE_METRIC_count(net_proxy_detection_cache_hits);
+
+// Number of proxy detections which ran the proxy detectors.
+DECLARE_METRIC_count(net_proxy_detection_cache_misses);
+
+// Time it took to run the proxy detectors.
+DECLARE_METRIC_timing(net_proxy_detection_ms);
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_NETWORK_CONFIG_METRICS_H_
@@ -17,18 +17,39 @@
 #include <atlconv.h>
 #include <algorithm>
 #include <cstring>
+#include <vector>
 #include "base/basictypes.h"
 #include "omaha/base/app_util.h"
 #include "omaha/base/omaha_version.h"
 #include "omaha/base/reg_key.h"
 #include "omaha/base/utils.h"
 #include "omaha/base/vistautil.h"
+#include "omaha/net/detector.h"
 #include "omaha/net/http_client.h"
 #include "omaha/net/network_config.h"
 #include "omaha/testing/unit_test.h"
 
 namespace omaha {
 
+// Counts how many times the proxy detection runs.
+class CountingProxyDetector : public ProxyDetectorInterface {
+ public:
+  explicit CountingProxyDetector(int* num_detections)
+      : num_detections_(num_detections) {}
+
+  virtual HRESULT Detect(ProxyConfig* config) {
+    ++*num_detections_;
+    config->source = source();
+    config->proxy = _T("proxy:8080");
+    return S_OK;
+  }
+  virtual const TCHAR* source() { return _T("Counting"); }
+
+ private:
+  int* num_detections_;
+  DISALLOW_COPY_AND_ASSIGN(CountingProxyDetector);
+};
+
 class NetworkConfigTest : public testing::Test {
  protected:
   NetworkConfigTest() {}
@@ -235,5 +256,36 @@ TEST_F(NetworkConfigTest, ToString) {
   EXPECT_STREQ(expected_tostring, NetworkConfig::ToString(config));
 }
 
+TEST_F(NetworkConfigTest, DetectReusesConfigurations) {
+  NetworkConfig* network_config = NULL;
+  EXPECT_HRESULT_SUCCEEDED(
+      NetworkConfigManager::Instance().GetUserNetworkConfig(&network_config));
+
+  int num_detections = 0;
+  network_config->Clear();
+  network_config->Add(new CountingProxyDetector(&num_detections));
+
+  EXPECT_HRESULT_SUCCEEDED(network_config->Detect());
+  EXPECT_HRESULT_SUCCEEDED(network_config->Detect());
+  EXPECT_EQ(1, num_detections);
+
+  std::vector<ProxyConfig> configurations(
+      network_config->GetConfigurations());
+  ASSERT_EQ(1U, configurations.size());
+  EXPECT_STREQ(_T("proxy:8080"), configurations[0].proxy);
+
+  network_config->InvalidateConfigurations();
+  EXPECT_HRESULT_SUCCEEDED(network_config->Detect());
+  EXPECT_EQ(2, num_detections);
+
+  network_config->set_detection_ttl_ms(0);
+  EXPECT_HRESULT_SUCCEEDED(network_config->Detect());
+  EXPECT_HRESULT_SUCCEEDED(network_config->Detect());
+  EXPECT_EQ(4, num_detections);
+
+  network_config->set_detection_ttl_ms(NetworkConfig::kDefaultDetectionTtlMs);
+  network_config->Clear();
+}
+
 }  // namespace omaha
 
@@ -85,6 +85,15 @@ void NetworkRequest::set_retry_delay_jitter(int jitter_ms) {
   return impl_->set_retry_delay_jitter(jitter_ms);
 }
 
+void NetworkRequest::set_retry_policy(RetryPolicy* retry_policy) {
+  return impl_->set_retry_policy(retry_policy);
+}
+
+void NetworkRequest::set_host_health_store(
+    HostHealthStore* host_health_store) {
+  return impl_->set_host_health_store(host_health_store);
+}
+
 void NetworkRequest::set_callback(NetworkRequestCallback* callback) {
   return impl_->set_callback(callback);
 }
@@ -111,6 +120,14 @@ void NetworkRequest::set_low_priority(bool low_priority) {
   return impl_->set_low_priority(low_priority);
 }
 
+void NetworkRequest::set_min_download_rate(int bytes_per_sec) {
+  return impl_->set_min_download_rate(bytes_per_sec);
+}
+
+void NetworkRequest::set_compress_request(bool compress_request) {
+  return impl_->set_compress_request(compress_request);
+}
+
 void NetworkRequest::set_proxy_configuration(
     const ProxyConfig* proxy_configuration) {
   return impl_->set_proxy_configuration(proxy_configuration);
@@ -29,6 +29,9 @@
 
 namespace omaha {
 
+class HostHealthStore;
+class RetryPolicy;
+
 namespace internal {
 
 class NetworkRequestImpl;
@@ -165,11 +168,27 @@ class NetworkRequest {
   // in network_request_impl.h -- currently, it is 5 seconds.)
   void set_time_between_retries(int time_between_retries_ms);
 
-  // Sets a +/- jitter, in milliseconds, to be applied to each retry delay.
-  // Set to 0 (or any negative value) to disable delay jittering.  (Default
-  // value is set in network_request_impl.h -- currently, it is 3 seconds.)
+  // Sets the jitter, in milliseconds, of the retry delays. The delays of
+  // server errors vary by +/- the jitter, and the other delays are randomized
+  // between the initial delay and three times the previous delay. Set to 0
+  // (or any negative value) to disable delay jittering, so that the delays
+  // double deterministically.  (Default value is set in
+  // network_request_impl.h -- currently, it is 3 seconds.)
   void set_retry_delay_jitter(int jitter_ms);
 
+  // Replaces the retry policy, which decides which errors are retried and the
+  // delays between the retries. Takes ownership of 'retry_policy'. When no
+  // policy is set, the time between retries and the jitter above are used.
+  void set_retry_policy(RetryPolicy* retry_policy);
+
+  // Sets the store of the health of the hosts, which the circuit breaker uses
+  // to stop sending requests to a host which keeps failing. Takes ownership of
+  // 'host_health_store'. The circuit breaker is disabled by default, and is
+  // only meant for the background requests, which can wait for the host to
+  // recover. A RegistryHostHealthStore shares the health of the hosts with
+  // all the processes of the user.
+  void set_host_health_store(HostHealthStore* host_health_store);
+
   // Sets an external observer for the request. The ownership of the callback
   // remains with the caller. The current implementation provides callback
   // notification for DownloadFile only.
@@ -179,6 +198,18 @@ class NetworkRequest {
   // prioritization of requests.
   void set_low_priority(bool low_priority);
 
+  // Sets the throughput, in bytes per second, below which a file download is
+  // abandoned with OMAHA_NET_E_DOWNLOAD_TOO_SLOW instead of being retried,
+  // provided that the throughput has also dropped well below its own peak.
+  // The default is 0, which never abandons downloads. Currently, only WinHTTP
+  // requests measure their throughput.
+  void set_min_download_rate(int bytes_per_sec);
+
+  // Sets whether the body of a POST request is sent LZMA-encoded, which only
+  // servers known to decode it should be sent. The default is false.
+  // Currently, only WinHTTP requests encode their body.
+  void set_compress_request(bool compress_request);
+
   // Overrides detecting the network configuration and uses the configuration
   // specified. If parameter is NULL, it defaults to detecting the configuration
   // automatically.
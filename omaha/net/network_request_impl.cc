@@ -23,7 +23,6 @@
 #include <functional>
 #include <vector>
 #include "base/basictypes.h"
-#include "base/rand_util.h"
 #include "omaha/base/const_addresses.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
@@ -32,6 +31,8 @@
 #include "omaha/base/omaha_version.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scoped_any.h"
+#include "omaha/base/span_trace.h"
+#include "omaha/base/startup_trace.h"
 #include "omaha/base/string.h"
 #include "omaha/base/time.h"
 #include "omaha/base/user_info.h"
@@ -43,6 +44,12 @@ namespace omaha {
 
 namespace internal {
 
+// Returns the current time in seconds since 1970, as the circuit breaker
+// keeps it.
+uint32 GetCurrentTimeSec() {
+  return static_cast<uint32>(Time64ToInt32(GetCurrent100NSTime()));
+}
+
 // Returns the user sid corresponding to the token. This function is only used
 // for logging purposes.
 CString GetTokenUser(HANDLE token) {
@@ -87,6 +94,7 @@ NetworkRequestImpl::NetworkRequestImpl(
       : cur_http_request_(NULL),
         cur_proxy_config_(NULL),
         retry_after_seconds_(-1),
+        server_retry_after_seconds_(-1),
         cur_retry_count_(0),
         cur_retry_delay_ms_(kDefaultTimeBetweenRetriesMs),
         http_attempts_(0),
@@ -96,8 +104,11 @@ NetworkRequestImpl::NetworkRequestImpl(
         proxy_auth_config_(NULL, CString()),
         num_retries_(0),
         low_priority_(false),
+        min_download_rate_(0),
+        compress_request_(false),
         initial_retry_delay_ms_(kDefaultTimeBetweenRetriesMs),
         retry_delay_jitter_ms_(kDefaultRetryTimeJitterMs),
+        host_health_store_(NULL),
         callback_(NULL),
         request_buffer_(NULL),
         request_buffer_length_(0),
@@ -142,6 +153,7 @@ void NetworkRequestImpl::Reset() {
   cur_http_request_      = NULL;
   cur_proxy_config_      = NULL;
   retry_after_seconds_   = -1;
+  server_retry_after_seconds_ = -1;
   cur_retry_count_       = 0;
   http_attempts_         = 0;
   last_hr_               = S_OK;
@@ -238,6 +250,8 @@ HRESULT NetworkRequestImpl::Resume() {
 }
 
 HRESULT NetworkRequestImpl::DoSendWithRetries() {
+  STARTUP_TRACE_PHASE("NetworkRequest::Send");
+  TRACE_NESTED_SPAN("NetworkRequestImpl::DoSendWithRetries");
   ASSERT1(num_retries_ >= 0);
   ASSERT1(response_ || !filename_.IsEmpty());
 
@@ -261,11 +275,30 @@ HRESULT NetworkRequestImpl::DoSendWithRetries() {
 
   HRESULT hr = S_OK;
 
-  cur_retry_delay_ms_ = initial_retry_delay_ms_;
+  // Requests to a host which keeps failing are not sent until the cooldown
+  // of its circuit breaker is over.
+  const CString host(GetUrlHost(url_));
+  scoped_ptr<CircuitBreaker> circuit_breaker;
+  if (host_health_store_.get()) {
+    circuit_breaker.reset(new CircuitBreaker(host_health_store_.get()));
+    if (!circuit_breaker->IsRequestAllowed(host, GetCurrentTimeSec())) {
+      NET_LOG(LW, (_T("[host unavailable][%s]"), host));
+      return OMAHA_NET_E_HOST_UNAVAILABLE;
+    }
+  }
+
+  RetryPolicy default_retry_policy(initial_retry_delay_ms_,
+                                   kMaxTimeBetweenRetriesMs,
+                                   retry_delay_jitter_ms_);
+  RetryPolicy* retry_policy = retry_policy_.get() ? retry_policy_.get() :
+                                                    &default_retry_policy;
+  retry_policy->Reset();
+
+  cur_retry_delay_ms_ = retry_policy->base_delay_ms();
   cur_retry_count_ = 0;
   http_attempts_ = 0;
 
-  while (CanRetryRequest()) {
+  while (CanRetryRequest(retry_policy->max_delay_ms())) {
     // Check early to see if we've been canceled.
     if (IsHandleSignaled(get(event_cancel_))) {
       ASSERT1(is_canceled_);
@@ -289,22 +322,44 @@ HRESULT NetworkRequestImpl::DoSendWithRetries() {
 
     hr = DoSend(&http_status_code, &response_headers, &response);
 
-    // Exit from the loop if we got a successful request, or a HTTP 4xx error
-    // (4xx implies that something has changed on the server and that this URL
-    // will never succeed), or if the server sends the optional X-Retry-After
-    // header with a positive value.
-    HttpClient::StatusCodeClass status_code_class =
-        HttpClient::GetStatusCodeClass(http_status_code);
+    const RetryPolicy::ErrorClass error_class =
+        RetryPolicy::ClassifyError(hr, http_status_code);
+    if (circuit_breaker.get() && hr != GOOPDATE_E_CANCELLED) {
+      circuit_breaker->OnAttemptFinished(host,
+                                         GetCurrentTimeSec(),
+                                         error_class,
+                                         server_retry_after_seconds_);
+    }
+
+    // Exit from the loop if we got a successful request, or if the server
+    // sends the optional X-Retry-After header with a positive value. A
+    // download which was too slow is not retried either, since the caller has
+    // another url to download from.
     if (SUCCEEDED(hr) ||
         hr == GOOPDATE_E_CANCELLED ||
-        status_code_class == HttpClient::STATUS_CODE_CLIENT_ERROR ||
+        hr == OMAHA_NET_E_DOWNLOAD_TOO_SLOW ||
         retry_after_seconds_ > 0) {
       break;
     }
 
-    // Compute how long we need to delay, based on the result of the attempt.
-    ComputeNextRetryDelay(status_code_class);
+    // The policy decides whether the error is worth retrying, for instance,
+    // a HTTP 4xx error other than 429 implies that something has changed on
+    // the server and that this URL will never succeed. Otherwise, it computes
+    // how long we need to delay, based on the result of the attempt.
+    int retry_delay_ms = 0;
+    if (!retry_policy->GetNextDelayMs(error_class,
+                                      server_retry_after_seconds_,
+                                      &retry_delay_ms)) {
+      break;
+    }
+    cur_retry_delay_ms_ = retry_delay_ms;
     ++cur_retry_count_;
+
+    // Stops retrying if the failures of this request opened the circuit.
+    if (circuit_breaker.get() &&
+        !circuit_breaker->IsRequestAllowed(host, GetCurrentTimeSec())) {
+      break;
+    }
   }
 
   if (cur_retry_count_ == num_retries_ + 1) {
@@ -319,7 +374,7 @@ HRESULT NetworkRequestImpl::DoSendWithRetries() {
   if (is_canceled_) {
     return GOOPDATE_E_CANCELLED;
   }
-  if (cur_retry_delay_ms_ > kMaxTimeBetweenRetriesMs) {
+  if (cur_retry_delay_ms_ > retry_policy->max_delay_ms()) {
     return OMAHA_NET_E_EXCEEDED_MAX_RETRY_DELAY;
   }
 
@@ -373,6 +428,7 @@ HRESULT NetworkRequestImpl::DoSend(int* http_status_code,
     if (SUCCEEDED(hr) ||
         hr == GOOPDATE_E_CANCELLED ||
         hr == CI_E_BITS_DISABLED ||
+        hr == OMAHA_NET_E_DOWNLOAD_TOO_SLOW ||
         *http_status_code == HTTP_STATUS_NOT_FOUND ||
         retry_after_seconds_ > 0) {
       break;
@@ -440,6 +496,7 @@ HRESULT NetworkRequestImpl::DoSendWithConfig(
     SafeCStringAppendFormat(&trace_, _T("%s.\r\n"), msg);
 
     ++http_attempts_;
+    response->clear();
     hr = DoSendHttpRequest(http_status_code, response_headers, response);
 
     SafeCStringFormat(&msg,
@@ -453,7 +510,7 @@ HRESULT NetworkRequestImpl::DoSendWithConfig(
       error_hr = hr;
       error_http_status_code = cur_http_request_->GetHttpStatusCode();
       error_response_headers = cur_http_request_->GetResponseHeaders();
-      cur_http_request_->GetResponse().swap(error_response);
+      error_response.swap(*response);
       first_error_from_http_request_saved = true;
     }
 
@@ -514,6 +571,8 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
   cur_http_request_->set_url(url_);
   cur_http_request_->set_filename(filename_);
   cur_http_request_->set_low_priority(low_priority_);
+  cur_http_request_->set_min_download_rate(min_download_rate_);
+  cur_http_request_->set_compress_request(compress_request_);
   cur_http_request_->set_callback(callback_);
   cur_http_request_->set_additional_headers(BuildPerRequestHeaders());
   cur_http_request_->set_proxy_configuration(*cur_proxy_config_);
@@ -550,7 +609,7 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
 
   *http_status_code = cur_http_request_->GetHttpStatusCode();
   *response_headers = cur_http_request_->GetResponseHeaders();
-  cur_http_request_->GetResponse().swap(*response);
+  cur_http_request_->TakeResponse(response);
 
   CString retry_after_header;
   if (IsHttpsUrl(url_) &&
@@ -561,6 +620,17 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
     retry_after_seconds_ = String_StringToInt(retry_after_header);
   }
 
+  retry_after_header.Empty();
+  if (IsHttpsUrl(url_) &&
+      SUCCEEDED(QueryHeadersString(WINHTTP_QUERY_CUSTOM,
+                                   kHttpRetryAfterHeader,
+                                   &retry_after_header)) &&
+      !retry_after_header.IsEmpty() &&
+      retry_after_header.SpanIncluding(_T("0123456789")) ==
+          retry_after_header) {
+    server_retry_after_seconds_ = String_StringToInt(retry_after_header);
+  }
+
   // Check if the computer is connected to the network.
   if (FAILED(last_hr_)) {
     last_hr_ = IsMachineConnectedToNetwork() ? last_hr_ : GOOPDATE_E_NO_NETWORK;
@@ -690,9 +760,9 @@ void NetworkRequestImpl::DetectProxyConfiguration(
   ASSERT1(!proxy_configurations->empty());
 }
 
-bool NetworkRequestImpl::CanRetryRequest() {
+bool NetworkRequestImpl::CanRetryRequest(int max_retry_delay_ms) {
   return (cur_retry_count_ <= num_retries_ &&
-          cur_retry_delay_ms_ <= kMaxTimeBetweenRetriesMs);
+          cur_retry_delay_ms_ <= max_retry_delay_ms);
 }
 
 HRESULT NetworkRequestImpl::DoWaitBetweenRetries() {
@@ -734,40 +804,6 @@ HRESULT NetworkRequestImpl::DoWaitBetweenRetries() {
   }
 }
 
-void NetworkRequestImpl::ComputeNextRetryDelay(
-    HttpClient::StatusCodeClass previous_result) {
-  // If the result of the previous attempt was an HTTP 5xx error, we need to
-  // aggressively back off.
-  if (previous_result == HttpClient::STATUS_CODE_SERVER_ERROR) {
-    if (cur_retry_delay_ms_ < kServerErrMinTimeBetweenRetriesMs) {
-      cur_retry_delay_ms_ = kServerErrMinTimeBetweenRetriesMs;
-    }
-  }
-
-  // Compute the next wait interval, checking for multiplication overflow.
-  // If we'd overflow, clamp to the maximum amount.
-  if (cur_retry_delay_ms_ > INT_MAX / kTimeBetweenRetriesMultiplier) {
-    ASSERT1(false);
-    cur_retry_delay_ms_ = kMaxTimeBetweenRetriesMs;
-    return;
-  }
-
-  cur_retry_delay_ms_ *= kTimeBetweenRetriesMultiplier;
-
-  if (retry_delay_jitter_ms_ > 0 &&
-      cur_retry_delay_ms_ >= retry_delay_jitter_ms_) {
-    // Generate a random int containing 2x the jitter amount, add it, then
-    // subtract the jitter amount to produce +/- jitter.
-    unsigned int jitter_amount = 0;
-    if (!RandUint32(&jitter_amount)) {
-      jitter_amount = retry_delay_jitter_ms_;
-    }
-    cur_retry_delay_ms_ += jitter_amount % (2 * retry_delay_jitter_ms_);
-    cur_retry_delay_ms_ -= retry_delay_jitter_ms_;
-    ASSERT1(cur_retry_delay_ms_ > 0);
-  }
-}
-
 }   // namespace internal
 
 }   // namespace omaha
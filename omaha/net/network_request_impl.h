@@ -23,9 +23,11 @@
 #include "base/scoped_ptr.h"
 #include "omaha/base/scoped_any.h"
 #include "omaha/base/synchronized.h"
+#include "omaha/net/circuit_breaker.h"
 #include "omaha/net/network_config.h"
 #include "omaha/net/network_request.h"
 #include "omaha/net/http_request.h"
+#include "omaha/net/retry_policy.h"
 
 namespace omaha {
 
@@ -84,12 +86,28 @@ class NetworkRequestImpl {
     retry_delay_jitter_ms_ = jitter_ms;
   }
 
+  void set_retry_policy(RetryPolicy* retry_policy) {
+    retry_policy_.reset(retry_policy);
+  }
+
+  void set_host_health_store(HostHealthStore* host_health_store) {
+    host_health_store_.reset(host_health_store);
+  }
+
   void set_callback(NetworkRequestCallback* callback) {
     callback_ = callback;
   }
 
   void set_low_priority(bool low_priority) { low_priority_ = low_priority; }
 
+  void set_min_download_rate(int bytes_per_sec) {
+    min_download_rate_ = bytes_per_sec;
+  }
+
+  void set_compress_request(bool compress_request) {
+    compress_request_ = compress_request;
+  }
+
   void set_proxy_configuration(const ProxyConfig* proxy_configuration) {
     if (proxy_configuration) {
       proxy_configuration_.reset(new ProxyConfig);
@@ -141,16 +159,12 @@ class NetworkRequestImpl {
 
   // Returns true if we should continue to retry a network request, false if
   // we should bail out early.
-  bool CanRetryRequest();
+  bool CanRetryRequest(int max_retry_delay_ms);
 
   // Delays for a specified interval, notifying any specified callbacks at the
   // beginning and end of the wait.
   HRESULT DoWaitBetweenRetries();
 
-  // Adjusts the delay until the next retry, given the current retry status
-  // and the result of the previous network attempt.
-  void ComputeNextRetryDelay(HttpClient::StatusCodeClass previous_result);
-
   // Builds headers for the current HttpRequest and network configuration.
   CString BuildPerRequestHeaders() const;
 
@@ -175,9 +189,19 @@ class NetworkRequestImpl {
   ProxyAuthConfig proxy_auth_config_;
   int      num_retries_;
   bool     low_priority_;
+  int      min_download_rate_;     // Bytes per second, or 0.
+  bool     compress_request_;
   int      initial_retry_delay_ms_;
   int      retry_delay_jitter_ms_;
 
+  // The retry policy set by the caller. When it is not set, each request
+  // uses a policy built from the initial delay and the jitter above.
+  scoped_ptr<RetryPolicy> retry_policy_;
+
+  // Keeps the health of the hosts for the circuit breaker. The breaker is
+  // disabled when there is no store.
+  scoped_ptr<HostHealthStore> host_health_store_;
+
   // Output data members.
   int      http_status_code_;
   CString  response_headers_;      // Each header is separated by \r\n.
@@ -203,6 +227,12 @@ class NetworkRequestImpl {
   // NetworkRequestImpl::DoSendWithRetries() call immediately.
   int retry_after_seconds_;
 
+  // Stores the last valid value, in seconds, of the Retry-After header of an
+  // HTTPS response, or -1. Unlike X-Retry-After, it only sets the delay until
+  // the next retry and how long the circuit breaker of the host stays open.
+  // The HTTP-date form of the header is not supported.
+  int server_retry_after_seconds_;
+
   // The current retry count and delay between retries, defined by the outermost
   // DoSendWithRetries() call.
   int cur_retry_count_;
@@ -222,9 +252,7 @@ class NetworkRequestImpl {
   std::vector<DownloadMetrics> download_metrics_;
 
   static const int kDefaultTimeBetweenRetriesMs      = 5000;    // 5 seconds.
-  static const int kServerErrMinTimeBetweenRetriesMs = 20000;   // 20 seconds.
   static const int kMaxTimeBetweenRetriesMs          = 100000;  // 100 seconds.
-  static const int kTimeBetweenRetriesMultiplier     = 2;
   static const int kDefaultRetryTimeJitterMs         = 3000;    // +- 3 seconds.
 
   DISALLOW_EVIL_CONSTRUCTORS(NetworkRequestImpl);
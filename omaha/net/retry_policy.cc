@@ -0,0 +1,166 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/retry_policy.h"
+#include <limits.h>
+#include <winhttp.h>
+#include <algorithm>
+#include "base/rand_util.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+
+namespace omaha {
+
+namespace {
+
+// Returns 'value' multiplied by 'factor', or INT_MAX if the product does not
+// fit in an int.
+int SaturatedMultiply(int value, int factor) {
+  ASSERT1(value >= 0);
+  ASSERT1(factor > 0);
+  return value > INT_MAX / factor ? INT_MAX : value * factor;
+}
+
+}  // namespace
+
+RetryPolicy::RetryPolicy(int base_delay_ms, int max_delay_ms, int jitter_ms)
+    : base_delay_ms_(base_delay_ms),
+      max_delay_ms_(max_delay_ms),
+      jitter_ms_(jitter_ms),
+      previous_delay_ms_(base_delay_ms) {
+  ASSERT1(base_delay_ms >= 0);
+  ASSERT1(max_delay_ms >= base_delay_ms);
+}
+
+RetryPolicy::~RetryPolicy() {
+}
+
+// static
+RetryPolicy::ErrorClass RetryPolicy::ClassifyError(HRESULT hr,
+                                                   int http_status_code) {
+  if (SUCCEEDED(hr)) {
+    return ERROR_CLASS_NONE;
+  }
+
+  if (http_status_code == 429) {
+    return ERROR_CLASS_THROTTLED;
+  }
+  if (http_status_code >= 500 && http_status_code < 600) {
+    return ERROR_CLASS_SERVER;
+  }
+  if (http_status_code >= 400 && http_status_code < 500) {
+    return ERROR_CLASS_CLIENT;
+  }
+
+  switch (hr) {
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_NAME_NOT_RESOLVED):
+      return ERROR_CLASS_NAME_RESOLUTION;
+
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_CANNOT_CONNECT):
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_CONNECTION_ERROR):
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_TIMEOUT):
+      return ERROR_CLASS_CONNECTION;
+
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_FAILURE):
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_CHANNEL_ERROR):
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_INVALID_CERT):
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_INVALID_CA):
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_CERT_CN_INVALID):
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_CERT_DATE_INVALID):
+    case HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_CERT_REVOKED):
+      return ERROR_CLASS_SECURE_CHANNEL;
+
+    default:
+      return ERROR_CLASS_OTHER;
+  }
+}
+
+void RetryPolicy::Reset() {
+  previous_delay_ms_ = base_delay_ms_;
+}
+
+bool RetryPolicy::GetNextDelayMs(ErrorClass error_class,
+                                 int retry_after_sec,
+                                 int* delay_ms) {
+  ASSERT1(delay_ms);
+
+  switch (error_class) {
+    case ERROR_CLASS_NONE:
+    case ERROR_CLASS_SECURE_CHANNEL:
+    case ERROR_CLASS_CLIENT:
+      return false;
+
+    case ERROR_CLASS_SERVER:
+    case ERROR_CLASS_THROTTLED:
+      if (retry_after_sec > 0) {
+        *delay_ms = SaturatedMultiply(retry_after_sec, 1000);
+        previous_delay_ms_ = std::max(previous_delay_ms_,
+                                      std::min(*delay_ms, max_delay_ms_));
+      } else {
+        *delay_ms = GetServerErrorDelayMs();
+      }
+      break;
+
+    default:
+      if (jitter_ms_ > 0) {
+        *delay_ms = GetDecorrelatedDelayMs();
+      } else {
+        previous_delay_ms_ = SaturatedMultiply(previous_delay_ms_, 2);
+        *delay_ms = previous_delay_ms_;
+      }
+      break;
+  }
+
+  NET_LOG(L3, (_T("[RetryPolicy][error class %d][retry in %d ms]"),
+               error_class, *delay_ms));
+  return true;
+}
+
+uint32 RetryPolicy::Random() {
+  uint32 value = 0;
+  if (!RandUint32(&value)) {
+    value = ::GetTickCount();
+  }
+  return value;
+}
+
+int RetryPolicy::GetServerErrorDelayMs() {
+  // The delay doubles from at least kServerErrorMinDelayMs, so that repeated
+  // server errors quickly reach the maximum delay and the request gives up.
+  const int min_delay_ms = previous_delay_ms_ < kServerErrorMinDelayMs ?
+                           kServerErrorMinDelayMs : previous_delay_ms_;
+  int delay_ms = SaturatedMultiply(min_delay_ms, 2);
+  if (jitter_ms_ > 0 &&
+      delay_ms >= jitter_ms_ &&
+      delay_ms <= INT_MAX - jitter_ms_) {
+    delay_ms += static_cast<int>(Random() % (2 * jitter_ms_)) - jitter_ms_;
+  }
+  previous_delay_ms_ = delay_ms;
+  return delay_ms;
+}
+
+int RetryPolicy::GetDecorrelatedDelayMs() {
+  const int upper_ms = std::min(SaturatedMultiply(previous_delay_ms_, 3),
+                                max_delay_ms_);
+  int delay_ms = base_delay_ms_;
+  if (upper_ms > base_delay_ms_) {
+    delay_ms += static_cast<int>(Random() % (upper_ms - base_delay_ms_ + 1));
+  }
+  previous_delay_ms_ = delay_ms;
+  return delay_ms;
+}
+
+}  // namespace omaha
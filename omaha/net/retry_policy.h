@@ -0,0 +1,96 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// RetryPolicy decides whether NetworkRequestImpl retries a request which
+// failed, and how long it waits before the retry, depending on the class of
+// the error. By default, the delays grow with decorrelated jitter: each delay
+// is random between the base delay and three times the previous delay, which
+// spreads the retries of clients which failed at the same time better than a
+// fixed jitter around an exponential delay. Server errors back off faster, and
+// a Retry-After value sent by the server overrides the computed delay.
+
+#ifndef OMAHA_NET_RETRY_POLICY_H_
+#define OMAHA_NET_RETRY_POLICY_H_
+
+#include <windows.h>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class RetryPolicy {
+ public:
+  enum ErrorClass {
+    ERROR_CLASS_NONE,             // The attempt succeeded.
+    ERROR_CLASS_NAME_RESOLUTION,  // The host name could not be resolved,
+                                  // which usually means the client is
+                                  // offline rather than the host is down.
+    ERROR_CLASS_CONNECTION,       // The host could not be reached or timed
+                                  // out.
+    ERROR_CLASS_SECURE_CHANNEL,   // The TLS handshake or the certificate
+                                  // failed. Retrying does not help.
+    ERROR_CLASS_SERVER,           // HTTP 5xx.
+    ERROR_CLASS_THROTTLED,        // HTTP 429.
+    ERROR_CLASS_CLIENT,           // Other HTTP 4xx. The url will not succeed.
+    ERROR_CLASS_OTHER,
+  };
+
+  // Server errors wait at least this long before they are retried.
+  static const int kServerErrorMinDelayMs = 20000;
+
+  // 'base_delay_ms' is the shortest delay, 'max_delay_ms' is the delay above
+  // which the request gives up. Setting 'jitter_ms' to 0 or less turns off
+  // the jitter, so that the delays double deterministically. Otherwise, the
+  // delays of the server errors vary by +/- 'jitter_ms'.
+  RetryPolicy(int base_delay_ms, int max_delay_ms, int jitter_ms);
+  virtual ~RetryPolicy();
+
+  // Returns the class of an attempt which returned 'hr' and
+  // 'http_status_code'.
+  static ErrorClass ClassifyError(HRESULT hr, int http_status_code);
+
+  // Starts over the delays for a new request.
+  virtual void Reset();
+
+  // Returns true if an attempt which failed with 'error_class' can be
+  // retried, and the delay before the retry in 'delay_ms'. 'retry_after_sec'
+  // is the value of the Retry-After header of the response, or -1. The delay
+  // can be longer than the maximum delay, in which case the caller gives up
+  // with OMAHA_NET_E_EXCEEDED_MAX_RETRY_DELAY.
+  virtual bool GetNextDelayMs(ErrorClass error_class,
+                              int retry_after_sec,
+                              int* delay_ms);
+
+  int base_delay_ms() const { return base_delay_ms_; }
+  int max_delay_ms() const { return max_delay_ms_; }
+
+ protected:
+  // Returns a random number. Simulations override it to be deterministic.
+  virtual uint32 Random();
+
+ private:
+  int GetServerErrorDelayMs();
+  int GetDecorrelatedDelayMs();
+
+  const int base_delay_ms_;
+  const int max_delay_ms_;
+  const int jitter_ms_;
+  int previous_delay_ms_;
+
+  DISALLOW_COPY_AND_ASSIGN(RetryPolicy);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_RETRY_POLICY_H_
@@ -0,0 +1,407 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <winhttp.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "base/scoped_ptr.h"
+#include "omaha/base/error.h"
+#include "omaha/net/circuit_breaker.h"
+#include "omaha/net/retry_policy.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+// Replaces the random numbers with a linear congruential generator, so that
+// the delays are the same on every run.
+class DeterministicRetryPolicy : public RetryPolicy {
+ public:
+  DeterministicRetryPolicy(int base_delay_ms,
+                           int max_delay_ms,
+                           int jitter_ms,
+                           uint32 seed)
+      : RetryPolicy(base_delay_ms, max_delay_ms, jitter_ms),
+        state_(seed) {}
+
+ protected:
+  virtual uint32 Random() {
+    state_ = state_ * 1103515245 + 12345;
+    return state_ >> 8;
+  }
+
+ private:
+  uint32 state_;
+};
+
+// The delays NetworkRequestImpl computed before it had a retry policy: all
+// errors double the delay with the same +/- jitter, and all errors other than
+// HTTP 4xx are retried.
+class LegacyRetryPolicy : public DeterministicRetryPolicy {
+ public:
+  LegacyRetryPolicy(int base_delay_ms,
+                    int max_delay_ms,
+                    int jitter_ms,
+                    uint32 seed)
+      : DeterministicRetryPolicy(base_delay_ms, max_delay_ms, jitter_ms, seed),
+        jitter_ms_(jitter_ms),
+        delay_ms_(base_delay_ms) {}
+
+  virtual void Reset() {
+    delay_ms_ = base_delay_ms();
+  }
+
+  virtual bool GetNextDelayMs(ErrorClass error_class,
+                              int retry_after_sec,
+                              int* delay_ms) {
+    UNREFERENCED_PARAMETER(retry_after_sec);
+    if (error_class == ERROR_CLASS_NONE || error_class == ERROR_CLASS_CLIENT) {
+      return false;
+    }
+    if (error_class == ERROR_CLASS_SERVER) {
+      delay_ms_ = std::max(delay_ms_,
+                           static_cast<int>(kServerErrorMinDelayMs));
+    }
+    delay_ms_ *= 2;
+    if (jitter_ms_ > 0 && delay_ms_ >= jitter_ms_) {
+      delay_ms_ += static_cast<int>(Random() % (2 * jitter_ms_)) - jitter_ms_;
+    }
+    *delay_ms = delay_ms_;
+    return true;
+  }
+
+ private:
+  const int jitter_ms_;
+  int delay_ms_;
+};
+
+struct OutageScenario {
+  int num_clients;
+  int start_window_ms;       // The clients start within this window.
+  int outage_ms;             // The host fails from the start until then.
+  int session_interval_ms;   // The delay before a failed session is retried.
+  int num_retries;           // The retries of a session.
+};
+
+struct OutageResult {
+  OutageResult()
+      : requests_during_outage(0),
+        sessions_blocked(0),
+        peak_requests_per_second(0),
+        mean_recovery_ms(0),
+        max_recovery_ms(0) {}
+
+  int requests_during_outage;
+  int sessions_blocked;          // Sessions the circuit breaker stopped.
+  int peak_requests_per_second;
+
+  // From the end of the outage to the first successful request of the
+  // clients which failed during the outage.
+  int64 mean_recovery_ms;
+  int64 max_recovery_ms;
+};
+
+class SimulatedClient {
+ public:
+  static const int kMaxDelayMs = 100000;
+
+  SimulatedClient(int id, bool legacy)
+      : retry_count(0),
+        has_failed(false) {
+    const int kBaseDelayMs = 5000;
+    const int kJitterMs = 3000;
+    if (legacy) {
+      retry_policy.reset(new LegacyRetryPolicy(kBaseDelayMs,
+                                               kMaxDelayMs,
+                                               kJitterMs,
+                                               id + 1));
+    } else {
+      retry_policy.reset(new DeterministicRetryPolicy(kBaseDelayMs,
+                                                      kMaxDelayMs,
+                                                      kJitterMs,
+                                                      id + 1));
+      circuit_breaker.reset(new CircuitBreaker(&store));
+    }
+  }
+
+  scoped_ptr<RetryPolicy> retry_policy;
+  MemoryHostHealthStore store;
+  scoped_ptr<CircuitBreaker> circuit_breaker;
+  int retry_count;
+  bool has_failed;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SimulatedClient);
+};
+
+// Simulates the clients of a host which is overloaded for a while and answers
+// with HTTP 503. Each client keeps sending update check sessions, each made of
+// one request and its retries, until one succeeds. Each client has its own
+// circuit breaker, which is off in legacy mode.
+OutageResult SimulateOutage(const OutageScenario& scenario, bool legacy) {
+  const TCHAR* const kHost = _T("tools.google.com");
+
+  // The events are the times the clients send a request, earliest first.
+  typedef std::pair<int64, int> Event;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events;
+
+  std::vector<SimulatedClient*> clients;
+  uint32 seed = 1;
+  for (int i = 0; i < scenario.num_clients; ++i) {
+    clients.push_back(new SimulatedClient(i, legacy));
+    seed = seed * 1103515245 + 12345;
+    events.push(Event((seed >> 8) % scenario.start_window_ms, i));
+  }
+
+  OutageResult result;
+  std::vector<int> requests_per_second;
+  int64 total_recovery_ms = 0;
+  int num_recovered_clients = 0;
+
+  while (!events.empty()) {
+    const int64 now_ms = events.top().first;
+    const int id = events.top().second;
+    events.pop();
+    SimulatedClient* client = clients[id];
+    CircuitBreaker* circuit_breaker = client->circuit_breaker.get();
+    const uint32 now_sec = static_cast<uint32>(now_ms / 1000);
+
+    if (!client->retry_count) {
+      client->retry_policy->Reset();
+      if (circuit_breaker &&
+          !circuit_breaker->IsRequestAllowed(kHost, now_sec)) {
+        ++result.sessions_blocked;
+        events.push(Event(now_ms + scenario.session_interval_ms, id));
+        continue;
+      }
+    }
+
+    const size_t second = static_cast<size_t>(now_sec);
+    if (second >= requests_per_second.size()) {
+      requests_per_second.resize(second + 1);
+    }
+    result.peak_requests_per_second = std::max(result.peak_requests_per_second,
+                                               ++requests_per_second[second]);
+
+    const bool is_host_down = now_ms < scenario.outage_ms;
+    const int http_status_code = is_host_down ? 503 : 200;
+    const RetryPolicy::ErrorClass error_class = RetryPolicy::ClassifyError(
+        is_host_down ? HRESULTFromHttpStatusCode(http_status_code) : S_OK,
+        http_status_code);
+    if (circuit_breaker) {
+      circuit_breaker->OnAttemptFinished(kHost, now_sec, error_class, -1);
+    }
+
+    if (!is_host_down) {
+      if (client->has_failed) {
+        const int64 recovery_ms = now_ms - scenario.outage_ms;
+        total_recovery_ms += recovery_ms;
+        ++num_recovered_clients;
+        result.max_recovery_ms = std::max(result.max_recovery_ms, recovery_ms);
+      }
+      continue;
+    }
+    ++result.requests_during_outage;
+    client->has_failed = true;
+
+    int delay_ms = 0;
+    const bool can_retry =
+        client->retry_count < scenario.num_retries &&
+        client->retry_policy->GetNextDelayMs(error_class, -1, &delay_ms) &&
+        delay_ms <= SimulatedClient::kMaxDelayMs &&
+        (!circuit_breaker || circuit_breaker->IsRequestAllowed(kHost,
+                                                               now_sec));
+    if (can_retry) {
+      ++client->retry_count;
+    } else {
+      client->retry_count = 0;
+      delay_ms = scenario.session_interval_ms;
+    }
+    events.push(Event(now_ms + delay_ms, id));
+  }
+
+  for (size_t i = 0; i != clients.size(); ++i) {
+    delete clients[i];
+  }
+
+  if (num_recovered_clients) {
+    result.mean_recovery_ms = total_recovery_ms / num_recovered_clients;
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(RetryPolicyTest, ClassifyError) {
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_NONE,
+            RetryPolicy::ClassifyError(S_OK, 200));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_THROTTLED,
+            RetryPolicy::ClassifyError(HRESULTFromHttpStatusCode(429), 429));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_SERVER,
+            RetryPolicy::ClassifyError(HRESULTFromHttpStatusCode(503), 503));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_CLIENT,
+            RetryPolicy::ClassifyError(HRESULTFromHttpStatusCode(404), 404));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_NAME_RESOLUTION,
+            RetryPolicy::ClassifyError(
+                HRESULT_FROM_WIN32(ERROR_WINHTTP_NAME_NOT_RESOLVED), 0));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_CONNECTION,
+            RetryPolicy::ClassifyError(
+                HRESULT_FROM_WIN32(ERROR_WINHTTP_CANNOT_CONNECT), 0));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_CONNECTION,
+            RetryPolicy::ClassifyError(
+                HRESULT_FROM_WIN32(ERROR_WINHTTP_TIMEOUT), 0));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_SECURE_CHANNEL,
+            RetryPolicy::ClassifyError(
+                HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_FAILURE), 0));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_SECURE_CHANNEL,
+            RetryPolicy::ClassifyError(
+                HRESULT_FROM_WIN32(ERROR_WINHTTP_SECURE_INVALID_CA), 0));
+  EXPECT_EQ(RetryPolicy::ERROR_CLASS_OTHER,
+            RetryPolicy::ClassifyError(GOOPDATE_E_NO_NETWORK, 0));
+}
+
+TEST(RetryPolicyTest, DoesNotRetryPermanentErrors) {
+  RetryPolicy retry_policy(5000, 100000, 3000);
+  int delay_ms = 0;
+  EXPECT_FALSE(retry_policy.GetNextDelayMs(RetryPolicy::ERROR_CLASS_NONE,
+                                           -1,
+                                           &delay_ms));
+  EXPECT_FALSE(retry_policy.GetNextDelayMs(
+      RetryPolicy::ERROR_CLASS_SECURE_CHANNEL, -1, &delay_ms));
+  EXPECT_FALSE(retry_policy.GetNextDelayMs(RetryPolicy::ERROR_CLASS_CLIENT,
+                                           -1,
+                                           &delay_ms));
+}
+
+TEST(RetryPolicyTest, NoJitter) {
+  RetryPolicy retry_policy(5000, 100000, 0);
+  const int kExpectedDelaysMs[] = { 10000, 20000, 40000, 80000, 160000 };
+  for (int i = 0; i < arraysize(kExpectedDelaysMs); ++i) {
+    int delay_ms = 0;
+    EXPECT_TRUE(retry_policy.GetNextDelayMs(
+        RetryPolicy::ERROR_CLASS_CONNECTION, -1, &delay_ms));
+    EXPECT_EQ(kExpectedDelaysMs[i], delay_ms);
+  }
+
+  // Server errors wait at least 20 seconds before doubling.
+  retry_policy.Reset();
+  const int kExpectedServerDelaysMs[] = { 40000, 80000, 160000 };
+  for (int i = 0; i < arraysize(kExpectedServerDelaysMs); ++i) {
+    int delay_ms = 0;
+    EXPECT_TRUE(retry_policy.GetNextDelayMs(RetryPolicy::ERROR_CLASS_SERVER,
+                                            -1,
+                                            &delay_ms));
+    EXPECT_EQ(kExpectedServerDelaysMs[i], delay_ms);
+  }
+}
+
+TEST(RetryPolicyTest, DecorrelatedJitter) {
+  DeterministicRetryPolicy retry_policy(5000, 100000, 3000, 1);
+  int previous_delay_ms = 5000;
+  bool is_max_reached = false;
+  for (int i = 0; i < 1000; ++i) {
+    int delay_ms = 0;
+    EXPECT_TRUE(retry_policy.GetNextDelayMs(RetryPolicy::ERROR_CLASS_OTHER,
+                                            -1,
+                                            &delay_ms));
+    EXPECT_LE(5000, delay_ms);
+    EXPECT_GE(std::min(3 * previous_delay_ms, 100000), delay_ms);
+    is_max_reached |= delay_ms > 90000;
+    previous_delay_ms = delay_ms;
+  }
+  EXPECT_TRUE(is_max_reached);
+
+  // The server errors back off with +/- the jitter.
+  retry_policy.Reset();
+  int delay_ms = 0;
+  EXPECT_TRUE(retry_policy.GetNextDelayMs(RetryPolicy::ERROR_CLASS_SERVER,
+                                          -1,
+                                          &delay_ms));
+  EXPECT_LE(37000, delay_ms);
+  EXPECT_GT(43000, delay_ms);
+}
+
+TEST(RetryPolicyTest, RetryAfter) {
+  RetryPolicy retry_policy(5000, 100000, 3000);
+  int delay_ms = 0;
+  EXPECT_TRUE(retry_policy.GetNextDelayMs(RetryPolicy::ERROR_CLASS_THROTTLED,
+                                          30,
+                                          &delay_ms));
+  EXPECT_EQ(30000, delay_ms);
+
+  // The delay is longer than the maximum, so the request gives up.
+  EXPECT_TRUE(retry_policy.GetNextDelayMs(RetryPolicy::ERROR_CLASS_SERVER,
+                                          INT_MAX,
+                                          &delay_ms));
+  EXPECT_EQ(INT_MAX, delay_ms);
+
+  // Retry-After only applies to the server errors.
+  retry_policy.Reset();
+  EXPECT_TRUE(retry_policy.GetNextDelayMs(RetryPolicy::ERROR_CLASS_CONNECTION,
+                                          30,
+                                          &delay_ms));
+  EXPECT_GT(30000, delay_ms);
+}
+
+// Compares the load which the clients put on a host during an outage, and
+// how long they take to recover once it is over, with the delays used before
+// the retry policy and with the retry policy and the circuit breaker.
+TEST(RetryPolicyTest, SimulateOutage) {
+  OutageScenario scenario = {0};
+  scenario.num_clients = 1000;
+  scenario.start_window_ms = 10 * 60 * 1000;
+  scenario.session_interval_ms = 5 * 60 * 1000;
+  scenario.num_retries = 2;
+
+  const int kOutageMinutes[] = { 1, 30, 120 };
+  for (int i = 0; i < arraysize(kOutageMinutes); ++i) {
+    scenario.outage_ms = kOutageMinutes[i] * 60 * 1000;
+    const OutageResult legacy_result = SimulateOutage(scenario, true);
+    const OutageResult result = SimulateOutage(scenario, false);
+
+    // Short outages see as many requests, since both wait at least the
+    // minimum delay of server errors. Once the outage lasts, the circuit
+    // breakers cut the load by at least a third.
+    if (kOutageMinutes[i] >= 30) {
+      EXPECT_GT(2 * legacy_result.requests_during_outage,
+                3 * result.requests_during_outage);
+    }
+    EXPECT_GE(CircuitBreaker::kMaxCooldownSec * 1000 +
+                  scenario.session_interval_ms,
+              result.max_recovery_ms);
+
+    std::wcout << _T("\t") << kOutageMinutes[i] << _T(" minute outage:")
+               << std::endl
+               << _T("\t  legacy: ") << legacy_result.requests_during_outage
+               << _T(" requests, peak ")
+               << legacy_result.peak_requests_per_second
+               << _T("/s, recovery mean ")
+               << legacy_result.mean_recovery_ms / 1000
+               << _T(" s max ") << legacy_result.max_recovery_ms / 1000
+               << _T(" s") << std::endl
+               << _T("\t  policy: ") << result.requests_during_outage
+               << _T(" requests, ") << result.sessions_blocked
+               << _T(" blocked, peak ") << result.peak_requests_per_second
+               << _T("/s, recovery mean ") << result.mean_recovery_ms / 1000
+               << _T(" s max ") << result.max_recovery_ms / 1000 << _T(" s")
+               << std::endl;
+  }
+}
+
+}  // namespace omaha
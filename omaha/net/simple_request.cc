@@ -29,6 +29,7 @@
 #include "omaha/net/simple_request.h"
 #include <atlconv.h>
 #include <intsafe.h>
+#include <algorithm>
 #include <climits>
 #include <memory>
 #include <vector>
@@ -42,6 +43,8 @@
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/string.h"
 #include "omaha/common/ping_event_download_metrics.h"
+#include "omaha/net/content_encoding.h"
+#include "omaha/net/download_controller.h"
 #include "omaha/net/network_config.h"
 #include "omaha/net/network_request.h"
 #include "omaha/net/proxy_auth.h"
@@ -49,6 +52,16 @@
 
 namespace omaha {
 
+namespace {
+
+// The most memory an in-memory response reserves up front, based on the
+// Content-Length header sent by the server. Larger responses grow the buffer
+// as they arrive, so a bogus header cannot make the client allocate an
+// arbitrary amount of memory before any data is received.
+const int kMaxResponseReserveBytes = 4 * 1024 * 1024;
+
+}  // namespace
+
 SimpleRequest::TransientRequestState::TransientRequestState()
     : port(0),
       http_status_code(0),
@@ -71,6 +84,8 @@ SimpleRequest::SimpleRequest()
       is_closed_(false),
       session_handle_(NULL),
       low_priority_(false),
+      min_download_rate_(0),
+      compress_request_(false),
       callback_(NULL),
       download_completed_(false),
       pause_happened_(false) {
@@ -85,6 +100,11 @@ SimpleRequest::SimpleRequest()
   // to the caller.
   reset(event_resume_, ::CreateEvent(NULL, true, true, NULL));
   ASSERT1(valid(event_resume_));
+
+  // Create a manual reset event which Close() and Cancel() set, so that a
+  // throttled download stops waiting as soon as the request is canceled.
+  reset(event_cancel_, ::CreateEvent(NULL, true, false, NULL));
+  ASSERT1(valid(event_cancel_));
 }
 
 // TODO(omaha): we should attempt to cleanup the file only if we
@@ -125,6 +145,7 @@ HRESULT SimpleRequest::Close() {
 
   __mutexScope(lock_);
   is_closed_ = true;
+  VERIFY1(::SetEvent(get(event_cancel_)));
   CloseHandles();
   request_state_.reset();
   winhttp_adapter_.reset();
@@ -139,6 +160,7 @@ HRESULT SimpleRequest::Cancel() {
 
   __mutexScope(lock_);
   is_canceled_ = true;
+  VERIFY1(::SetEvent(get(event_cancel_)));
   CloseHandles();
 
   // Resume the downloading thread if it is blocked. It is still fine if the
@@ -353,6 +375,26 @@ HRESULT SimpleRequest::Connect() {
     SafeCStringAppendFormat(&additional_headers, _T("Range: bytes=%d-\r\n"),
                             request_state_->current_bytes);
   }
+
+  // Responses received in memory are protocol messages, which the server may
+  // encode. Files are downloaded as they are.
+  if (filename_.IsEmpty()) {
+    SafeCStringAppendFormat(&additional_headers, _T("%s: %s\r\n"),
+                            kHttpAcceptEncodingHeader, kLzmaContentEncoding);
+  }
+
+  if (compress_request_ && IsPostRequest()) {
+    hr = EncodeRequest();
+    if (FAILED(hr)) {
+      return hr;
+    }
+    if (!request_state_->encoded_request.empty()) {
+      SafeCStringAppendFormat(&additional_headers, _T("%s: %s\r\n"),
+                              kHttpContentEncodingHeader,
+                              kLzmaContentEncoding);
+    }
+  }
+
   if (!additional_headers.IsEmpty()) {
     uint32 header_flags = WINHTTP_ADDREQ_FLAG_ADD | WINHTTP_ADDREQ_FLAG_REPLACE;
     hr = winhttp_adapter_->AddRequestHeaders(additional_headers,
@@ -459,10 +501,15 @@ HRESULT SimpleRequest::SendRequest() {
                                                             flags)));
     }
 
-    const DWORD bytes_to_send = static_cast<DWORD>(request_buffer_length_);
+    const std::vector<uint8>& encoded_request = request_state_->encoded_request;
+    const void* body = encoded_request.empty() ? request_buffer_ :
+                                                 &encoded_request.front();
+    const DWORD bytes_to_send = static_cast<DWORD>(
+        encoded_request.empty() ? request_buffer_length_ :
+                                  encoded_request.size());
     hr = winhttp_adapter_->SendRequest(NULL,
                                        0,
-                                       request_buffer_,
+                                       body,
                                        bytes_to_send,
                                        bytes_to_send);
     if (FAILED(hr)) {
@@ -585,6 +632,36 @@ HRESULT SimpleRequest::SendRequest() {
   return hr;
 }
 
+HRESULT SimpleRequest::EncodeRequest() {
+  ASSERT1(IsPostRequest());
+
+  std::vector<uint8> encoded_request;
+  HRESULT hr = LzmaEncodeBody(request_buffer_,
+                              request_buffer_length_,
+                              &encoded_request);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // Small bodies can grow when they are encoded, and are sent as they are.
+  NET_LOG(L3, (_T("[SimpleRequest::EncodeRequest][%u bytes][%u encoded]"),
+               request_buffer_length_, encoded_request.size()));
+  request_state_->encoded_request.clear();
+  if (encoded_request.size() < request_buffer_length_) {
+    request_state_->encoded_request.swap(encoded_request);
+  }
+  return S_OK;
+}
+
+bool SimpleRequest::IsEncodedResponse() const {
+  CString content_encoding;
+  winhttp_adapter_->QueryRequestHeadersString(WINHTTP_QUERY_CONTENT_ENCODING,
+                                              WINHTTP_HEADER_NAME_BY_INDEX,
+                                              &content_encoding,
+                                              WINHTTP_NO_HEADER_INDEX);
+  return !content_encoding.Trim().CompareNoCase(kLzmaContentEncoding);
+}
+
 HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
   ASSERT1(file_handle != INVALID_HANDLE_VALUE || filename_.IsEmpty());
 
@@ -615,34 +692,92 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
       request_state_->http_status_code == HTTP_STATUS_OK ||
       request_state_->http_status_code == HTTP_STATUS_PARTIAL_CONTENT;
 
+  // In-memory responses are read directly at the end of the response buffer,
+  // which is reserved up front when the length of the body is known, up to
+  // kMaxResponseReserveBytes, and grows past that as needed. The
+  // intermediate buffer is only used to write the response to a file, or to
+  // feed an encoded response to the decoder as it arrives.
+  std::vector<uint8>& response = request_state_->response;
+  const bool is_file_download = !filename_.IsEmpty();
+  scoped_ptr<LzmaBodyDecoder> decoder;
+  if (!is_file_download && IsEncodedResponse()) {
+    decoder.reset(new LzmaBodyDecoder);
+  }
+  const bool is_buffered = is_file_download || decoder.get() != NULL;
+  if (!is_buffered && content_length > 0) {
+    response.reserve(response.size() +
+                     std::min(content_length, kMaxResponseReserveBytes) + 1);
+  }
+
+  // File downloads are paced by the throughput measured during the download:
+  // the reads are sized to the throughput, low priority downloads are delayed
+  // to leave part of the throughput to other traffic, and downloads which are
+  // too slow are abandoned.
+  DownloadController download_controller(low_priority_, min_download_rate_);
+  download_controller.Start(GetCurrentMsTime());
+
   std::vector<uint8> buffer;
+  DWORD bytes_available(0);
   do  {
-    DWORD bytes_available(0);
+    if (is_file_download) {
+      const int delay_ms =
+          download_controller.GetThrottleDelayMs(GetCurrentMsTime());
+      if (delay_ms) {
+        VERIFY1(::WaitForSingleObject(get(event_cancel_), delay_ms) !=
+                WAIT_FAILED);
+      }
+    }
+
+    bytes_available = 0;
     winhttp_adapter_->QueryDataAvailable(&bytes_available);
-    buffer.resize(1 + bytes_available);
-    hr = winhttp_adapter_->ReadData(&buffer.front(),
-                                    static_cast<DWORD>(buffer.size()),
+    const DWORD bytes_to_read = is_file_download ?
+        std::max(1 + bytes_available, download_controller.GetReadSize()) :
+        1 + bytes_available;
+
+    const size_t response_size = response.size();
+    uint8* read_buffer = NULL;
+    if (is_buffered) {
+      buffer.resize(bytes_to_read);
+      read_buffer = &buffer.front();
+    } else {
+      response.resize(response_size + bytes_to_read);
+      read_buffer = &response[response_size];
+    }
+
+    hr = winhttp_adapter_->ReadData(read_buffer,
+                                    bytes_to_read,
                                     &bytes_available);
+    if (!is_buffered) {
+      response.resize(response_size + (SUCCEEDED(hr) ? bytes_available : 0));
+    }
     if (FAILED(hr)) {
       return hr;
     }
 
-    buffer.resize(bytes_available);
-    if (!buffer.empty()) {
-      if (!filename_.IsEmpty()) {
-        DWORD num_bytes(0);
-        if (!::WriteFile(file_handle,
-                         reinterpret_cast<const char*>(&buffer.front()),
-                         static_cast<DWORD>(buffer.size()),
-                         &num_bytes,
-                         NULL)) {
-          return HRESULTFromLastError();
-        }
-        ASSERT1(num_bytes == buffer.size());
-      } else {
-        request_state_->response.insert(request_state_->response.end(),
-                                        buffer.begin(),
-                                        buffer.end());
+    if (decoder.get() && bytes_available) {
+      hr = decoder->Decode(read_buffer, bytes_available);
+      if (FAILED(hr)) {
+        return hr;
+      }
+    }
+
+    if (is_file_download && bytes_available) {
+      DWORD num_bytes(0);
+      if (!::WriteFile(file_handle,
+                       reinterpret_cast<const char*>(read_buffer),
+                       bytes_available,
+                       &num_bytes,
+                       NULL)) {
+        return HRESULTFromLastError();
+      }
+      ASSERT1(num_bytes == bytes_available);
+
+      const uint64 now_ms = GetCurrentMsTime();
+      download_controller.OnBytesReceived(now_ms, bytes_available);
+      if (download_controller.IsTooSlow(now_ms)) {
+        NET_LOG(LW, (_T("[download too slow][%I64d bytes/sec]"),
+                     download_controller.GetBytesPerSec()));
+        return OMAHA_NET_E_DOWNLOAD_TOO_SLOW;
       }
     }
 
@@ -661,7 +796,7 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
                             WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
                             NULL);
     }
-  } while (!buffer.empty());
+  } while (bytes_available);
 
   NET_LOG(L3, (_T("[bytes downloaded %d]"), request_state_->current_bytes));
   if (file_handle != INVALID_HANDLE_VALUE) {
@@ -675,6 +810,14 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
     return HRESULT_FROM_WIN32(ERROR_WINHTTP_CONNECTION_ERROR);
   }
 
+  if (decoder.get()) {
+    if (!decoder->is_finished()) {
+      NET_LOG(LE, (_T("[encoded response is truncated]")));
+      return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+    decoder->TakeDecodedBody(&response);
+  }
+
   download_completed_ = true;
   return hr;
 }
@@ -711,6 +854,14 @@ std::vector<uint8> SimpleRequest::GetResponse() const {
                                 std::vector<uint8>();
 }
 
+void SimpleRequest::TakeResponse(std::vector<uint8>* response) {
+  ASSERT1(response);
+  response->clear();
+  if (request_state_.get()) {
+    request_state_->response.swap(*response);
+  }
+}
+
 HRESULT SimpleRequest::QueryHeadersString(uint32 info_level,
                                           const TCHAR* name,
                                           CString* value) const {
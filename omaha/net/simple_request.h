@@ -55,6 +55,8 @@ class SimpleRequest : public HttpRequestInterface {
 
   virtual std::vector<uint8> GetResponse() const;
 
+  virtual void TakeResponse(std::vector<uint8>* response);
+
   virtual int GetHttpStatusCode() const {
     return request_state_.get() ? request_state_->http_status_code : 0;
   }
@@ -89,6 +91,14 @@ class SimpleRequest : public HttpRequestInterface {
     low_priority_ = low_priority;
   }
 
+  virtual void set_min_download_rate(int bytes_per_sec) {
+    min_download_rate_ = bytes_per_sec;
+  }
+
+  virtual void set_compress_request(bool compress_request) {
+    compress_request_ = compress_request;
+  }
+
   virtual void set_callback(NetworkRequestCallback* callback) {
     callback_ = callback;
   }
@@ -115,6 +125,8 @@ class SimpleRequest : public HttpRequestInterface {
   HRESULT PrepareRequest(HANDLE* file_handle);
   HRESULT Connect();
   HRESULT SendRequest();
+  HRESULT EncodeRequest();
+  bool IsEncodedResponse() const;
   HRESULT ReceiveData(HANDLE file_handle);
   HRESULT RequestData(HANDLE file_handle);
   bool IsResumeNeeded() const;
@@ -152,6 +164,7 @@ class SimpleRequest : public HttpRequestInterface {
     CString url_path;
     bool    is_https;
 
+    std::vector<uint8> encoded_request;
     std::vector<uint8> response;
     int http_status_code;
     uint32 proxy_authentication_scheme;
@@ -179,10 +192,13 @@ class SimpleRequest : public HttpRequestInterface {
   ProxyAuthConfig proxy_auth_config_;
   ProxyConfig proxy_config_;
   bool low_priority_;
+  int min_download_rate_;               // Bytes per second, or 0.
+  bool compress_request_;
   NetworkRequestCallback* callback_;
   scoped_ptr<WinHttpAdapter> winhttp_adapter_;
   scoped_ptr<TransientRequestState> request_state_;
   scoped_event event_resume_;
+  scoped_event event_cancel_;
   bool download_completed_;
 
   DISALLOW_COPY_AND_ASSIGN(SimpleRequest);
@@ -165,6 +165,12 @@ void SimpleRequestTest::SimpleGet(const CString& url,
 
   EXPECT_FALSE(simple_request.GetResponseHeaders().IsEmpty());
 
+  // Taking the response moves the body out of the request.
+  std::vector<uint8> response_body;
+  simple_request.TakeResponse(&response_body);
+  EXPECT_STREQ(response, Utf8BufferToWideChar(response_body));
+  EXPECT_TRUE(simple_request.GetResponse().empty());
+
   // Check the user agent went out with the request.
   CString user_agent;
   simple_request.QueryHeadersString(
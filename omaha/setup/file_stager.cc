@@ -0,0 +1,260 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/setup/file_stager.h"
+#include "base/scoped_ptr.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/signatures.h"
+#include "omaha/base/thread_pool.h"
+
+namespace omaha {
+
+namespace {
+
+// Large reads and writes keep the number of I/O requests per file low. Most
+// of the files are smaller than the buffer and are copied with one read and
+// one write.
+const DWORD kCopyBufferSize = 1024 * 1024;
+
+// The work items only do file I/O, so they finish well within this delay.
+const int kThreadPoolShutdownDelayMs = 60000;
+
+const TCHAR* const kStagingFileSuffix = _T(".new");
+
+}  // namespace
+
+class FileStager::StageFileWorkItem : public UserWorkItem {
+ public:
+  StageFileWorkItem(FileStager* stager, size_t index)
+      : stager_(stager),
+        index_(index) {
+    ASSERT1(stager);
+  }
+
+ private:
+  virtual void DoProcess() {
+    StagedFile& file = stager_->files_[index_];
+    file.hr = StageFile(file.source_file, file.destination_file, file.overwrite);
+    stager_->OnFileStaged();
+  }
+
+  FileStager* stager_;
+  const size_t index_;
+
+  DISALLOW_COPY_AND_ASSIGN(StageFileWorkItem);
+};
+
+FileStager::FileStager(int max_concurrent_copies)
+    : max_concurrent_copies_(max_concurrent_copies),
+      pending_files_(0),
+      failed_file_index_(0) {
+  ASSERT1(max_concurrent_copies > 0);
+}
+
+FileStager::~FileStager() {
+  ASSERT1(!pending_files_);
+}
+
+void FileStager::AddFile(const CString& source_file,
+                         const CString& destination_file,
+                         bool overwrite) {
+  ASSERT1(!source_file.IsEmpty());
+  ASSERT1(!destination_file.IsEmpty());
+
+  StagedFile file;
+  file.source_file = source_file;
+  file.destination_file = destination_file;
+  file.overwrite = overwrite;
+  file.hr = E_PENDING;
+  files_.push_back(file);
+}
+
+HRESULT FileStager::Stage() {
+  failed_file_index_ = 0;
+  if (files_.empty()) {
+    return S_OK;
+  }
+
+  reset(done_event_, ::CreateEvent(NULL, true, false, NULL));
+  if (!done_event_) {
+    return HRESULTFromLastError();
+  }
+  pending_files_ = static_cast<LONG>(files_.size());
+
+  {
+    ThreadPool thread_pool;
+    HRESULT hr = thread_pool.Initialize(kThreadPoolShutdownDelayMs,
+                                        max_concurrent_copies_);
+    for (size_t i = 0; i != files_.size(); ++i) {
+      if (SUCCEEDED(hr)) {
+        scoped_ptr<StageFileWorkItem> work_item(
+            new StageFileWorkItem(this, i));
+        hr = thread_pool.QueueUserWorkItem(work_item.get(),
+                                           COINIT_MULTITHREADED,
+                                           WT_EXECUTELONGFUNCTION);
+        if (SUCCEEDED(hr)) {
+          work_item.release();
+          continue;
+        }
+        SETUP_LOG(LW, (_T("[QueueUserWorkItem failed][0x%08x]"), hr));
+      }
+
+      // Copies the rest of the files on this thread if the thread pool fails.
+      files_[i].hr = StageFile(files_[i].source_file,
+                               files_[i].destination_file,
+                               files_[i].overwrite);
+      OnFileStaged();
+    }
+
+    VERIFY1(::WaitForSingleObject(get(done_event_), INFINITE) ==
+            WAIT_OBJECT_0);
+  }
+
+  for (size_t i = 0; i != files_.size(); ++i) {
+    if (FAILED(files_[i].hr)) {
+      failed_file_index_ = static_cast<int>(i + 1);
+      return files_[i].hr;
+    }
+  }
+
+  return S_OK;
+}
+
+void FileStager::OnFileStaged() {
+  if (::InterlockedDecrement(&pending_files_) == 0) {
+    VERIFY1(::SetEvent(get(done_event_)));
+  }
+}
+
+HRESULT FileStager::StageFile(const CString& source_file,
+                              const CString& destination_file,
+                              bool overwrite) {
+  SETUP_LOG(L2, (_T("[FileStager::StageFile][from=%s][to=%s][overwrite=%d]"),
+                 source_file, destination_file, overwrite));
+
+  // TODO(omaha): Reevaluate the value -- or at least, the naming -- of the
+  // overwrite flag.  As it stands, it's largely a debugging tool to force
+  // copying the file when it's not technically needed.
+  if (!overwrite &&
+      File::Exists(destination_file) &&
+      File::AreFilesIdentical(source_file, destination_file)) {
+    return S_OK;
+  }
+
+  const CString staging_file = destination_file + kStagingFileSuffix;
+  std::vector<byte> source_hash;
+  HRESULT hr = CopyAndHashFile(source_file, staging_file, &source_hash);
+  if (FAILED(hr)) {
+    OPT_LOG(LE, (_T("[copy failed][from=%s][to=%s][0x%08x]"),
+                 source_file, staging_file, hr));
+    VERIFY1(SUCCEEDED(File::Remove(staging_file)));
+    return hr;
+  }
+
+  std::vector<byte> staged_hash;
+  CryptoHash crypto_hash(CryptoHash::kSha256);
+  hr = crypto_hash.Compute(staging_file, 0, &staged_hash);
+  if (FAILED(hr) || staged_hash != source_hash) {
+    OPT_LOG(LE, (_T("[postcopy verification failed][from=%s][to=%s][0x%x]"),
+                 source_file, staging_file, hr));
+    VERIFY1(SUCCEEDED(File::Remove(staging_file)));
+    return GOOPDATE_E_POST_COPY_VERIFICATION_FAILED;
+  }
+
+  hr = File::Move(staging_file, destination_file, true);
+  if (FAILED(hr)) {
+    OPT_LOG(LE, (_T("[move failed][from=%s][to=%s][0x%08x]"),
+                 staging_file, destination_file, hr));
+    VERIFY1(SUCCEEDED(File::Remove(staging_file)));
+    return hr;
+  }
+
+  return S_OK;
+}
+
+HRESULT FileStager::CopyAndHashFile(const CString& source_file,
+                                    const CString& destination_file,
+                                    std::vector<byte>* hash) {
+  ASSERT1(hash);
+
+  scoped_hfile source(::CreateFile(source_file,
+                                   GENERIC_READ,
+                                   FILE_SHARE_READ,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_FLAG_SEQUENTIAL_SCAN,
+                                   NULL));
+  if (!source) {
+    return HRESULTFromLastError();
+  }
+
+  scoped_hfile destination(::CreateFile(destination_file,
+                                        GENERIC_WRITE,
+                                        0,
+                                        NULL,
+                                        CREATE_ALWAYS,
+                                        FILE_ATTRIBUTE_NORMAL |
+                                        FILE_FLAG_SEQUENTIAL_SCAN,
+                                        NULL));
+  if (!destination) {
+    return HRESULTFromLastError();
+  }
+
+  scoped_ptr<CryptDetails::HashInterface> hasher(
+      CryptDetails::CreateHasher(true));
+  std::vector<byte> buffer(kCopyBufferSize);
+  for (;;) {
+    DWORD bytes_read = 0;
+    if (!::ReadFile(get(source),
+                    &buffer[0],
+                    kCopyBufferSize,
+                    &bytes_read,
+                    NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (!bytes_read) {
+      break;
+    }
+
+    hasher->update(&buffer[0], bytes_read);
+
+    DWORD bytes_written = 0;
+    if (!::WriteFile(get(destination),
+                     &buffer[0],
+                     bytes_read,
+                     &bytes_written,
+                     NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (bytes_written != bytes_read) {
+      return HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+    }
+  }
+
+  // Keeps the time stamp of the source, as ::CopyFile does.
+  FILETIME last_write_time = {0};
+  if (::GetFileTime(get(source), NULL, NULL, &last_write_time)) {
+    VERIFY1(::SetFileTime(get(destination), NULL, NULL, &last_write_time));
+  }
+
+  const uint8* digest = hasher->final();
+  hash->assign(digest, digest + hasher->hash_size());
+  return S_OK;
+}
+
+}  // namespace omaha
@@ -0,0 +1,91 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Copies the files of an install concurrently. Each source file is read only
+// once: the copy hashes the data as it writes it, and the verification hashes
+// the destination file instead of comparing both files byte by byte. The data
+// is written to a temporary file next to the destination, which replaces the
+// destination only after it has been verified, so the destination never holds
+// a partially written file.
+
+#ifndef OMAHA_SETUP_FILE_STAGER_H_
+#define OMAHA_SETUP_FILE_STAGER_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+#include "base/basictypes.h"
+#include "omaha/base/scoped_any.h"
+
+namespace omaha {
+
+class FileStager {
+ public:
+  // The number of files copied at the same time.
+  static const int kDefaultMaxConcurrentCopies = 4;
+
+  explicit FileStager(int max_concurrent_copies);
+  ~FileStager();
+
+  // Adds a file to copy. Unless 'overwrite' is true, the file is not copied if
+  // the destination already has the same contents.
+  void AddFile(const CString& source_file,
+               const CString& destination_file,
+               bool overwrite);
+
+  // Copies and verifies all the files. Returns the error of the first file
+  // which failed, in the order the files were added. The files which were
+  // staged successfully are kept.
+  HRESULT Stage();
+
+  // Returns the 1-based index of the file which failed, or 0 if none failed.
+  int failed_file_index() const { return failed_file_index_; }
+
+  // Copies 'source_file' to 'destination_file' and returns the SHA-256 hash
+  // of the data which was copied.
+  static HRESULT CopyAndHashFile(const CString& source_file,
+                                 const CString& destination_file,
+                                 std::vector<byte>* hash);
+
+  // Stages a single file. Called concurrently for different files.
+  static HRESULT StageFile(const CString& source_file,
+                           const CString& destination_file,
+                           bool overwrite);
+
+ private:
+  struct StagedFile {
+    CString source_file;
+    CString destination_file;
+    bool overwrite;
+    HRESULT hr;
+  };
+
+  class StageFileWorkItem;
+
+  // Called by the work items when they finish.
+  void OnFileStaged();
+
+  const int max_concurrent_copies_;
+  std::vector<StagedFile> files_;
+  volatile LONG pending_files_;
+  scoped_event done_event_;
+  int failed_file_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileStager);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_SETUP_FILE_STAGER_H_
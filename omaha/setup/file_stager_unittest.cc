@@ -0,0 +1,142 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <vector>
+#include "omaha/base/app_util.h"
+#include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/signatures.h"
+#include "omaha/base/utils.h"
+#include "omaha/setup/file_stager.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+class FileStagerTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    source_dir_ = app_util::GetModuleDirectory(NULL);
+    destination_dir_ = ConcatenatePath(app_util::GetTempDir(),
+                                       _T("FileStagerTest"));
+    ASSERT_SUCCEEDED(CreateDir(destination_dir_, NULL));
+  }
+
+  virtual void TearDown() {
+    EXPECT_SUCCEEDED(DeleteDirectory(destination_dir_));
+  }
+
+  CString SourcePath(const TCHAR* file_name) const {
+    return ConcatenatePath(source_dir_, file_name);
+  }
+
+  CString DestinationPath(const TCHAR* file_name) const {
+    return ConcatenatePath(destination_dir_, file_name);
+  }
+
+  CString source_dir_;
+  CString destination_dir_;
+};
+
+TEST_F(FileStagerTest, CopyAndHashFile) {
+  const CString source = SourcePath(kUnittestName);
+  const CString destination = DestinationPath(kUnittestName);
+
+  std::vector<byte> hash;
+  EXPECT_SUCCEEDED(FileStager::CopyAndHashFile(source, destination, &hash));
+  EXPECT_TRUE(File::AreFilesIdentical(source, destination));
+
+  // The hash is the hash of the data which was copied.
+  std::vector<byte> expected_hash;
+  CryptoHash crypto_hash(CryptoHash::kSha256);
+  EXPECT_SUCCEEDED(crypto_hash.Compute(source, 0, &expected_hash));
+  EXPECT_TRUE(expected_hash == hash);
+}
+
+TEST_F(FileStagerTest, CopyAndHashFile_SourceDoesNotExist) {
+  std::vector<byte> hash;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            FileStager::CopyAndHashFile(SourcePath(_T("no_such_file.exe")),
+                                        DestinationPath(_T("file.exe")),
+                                        &hash));
+  EXPECT_FALSE(File::Exists(DestinationPath(_T("file.exe"))));
+}
+
+TEST_F(FileStagerTest, Stage) {
+  const TCHAR* const kFiles[] = {
+    kUnittestName,
+    kOmahaShellFileName,
+    kOmahaDllName,
+    kOmahaCoreFileName,
+    kCrashHandlerFileName,
+  };
+
+  FileStager stager(2);
+  for (int i = 0; i < arraysize(kFiles); ++i) {
+    stager.AddFile(SourcePath(kFiles[i]), DestinationPath(kFiles[i]), false);
+  }
+  EXPECT_SUCCEEDED(stager.Stage());
+  EXPECT_EQ(0, stager.failed_file_index());
+
+  for (int i = 0; i < arraysize(kFiles); ++i) {
+    EXPECT_TRUE(File::AreFilesIdentical(SourcePath(kFiles[i]),
+                                        DestinationPath(kFiles[i])));
+
+    // The staging files do not remain after the files are moved in place.
+    EXPECT_FALSE(File::Exists(DestinationPath(kFiles[i]) + _T(".new")));
+  }
+}
+
+TEST_F(FileStagerTest, Stage_ReplacesDifferentFile) {
+  const CString destination = DestinationPath(kOmahaShellFileName);
+  std::vector<byte> contents(10, 'a');
+  ASSERT_SUCCEEDED(WriteEntireFile(destination, contents));
+
+  FileStager stager(FileStager::kDefaultMaxConcurrentCopies);
+  stager.AddFile(SourcePath(kOmahaShellFileName), destination, false);
+  EXPECT_SUCCEEDED(stager.Stage());
+  EXPECT_TRUE(File::AreFilesIdentical(SourcePath(kOmahaShellFileName),
+                                      destination));
+}
+
+TEST_F(FileStagerTest, Stage_ReportsFirstFailedFile) {
+  FileStager stager(FileStager::kDefaultMaxConcurrentCopies);
+  stager.AddFile(SourcePath(kOmahaShellFileName),
+                 DestinationPath(kOmahaShellFileName),
+                 true);
+  stager.AddFile(SourcePath(_T("no_such_file.exe")),
+                 DestinationPath(_T("no_such_file.exe")),
+                 true);
+  stager.AddFile(SourcePath(kOmahaDllName),
+                 DestinationPath(kOmahaDllName),
+                 true);
+
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), stager.Stage());
+  EXPECT_EQ(2, stager.failed_file_index());
+
+  // The other files are staged anyway.
+  EXPECT_TRUE(File::Exists(DestinationPath(kOmahaShellFileName)));
+  EXPECT_TRUE(File::Exists(DestinationPath(kOmahaDllName)));
+  EXPECT_FALSE(File::Exists(DestinationPath(_T("no_such_file.exe.new"))));
+}
+
+TEST_F(FileStagerTest, Stage_NoFiles) {
+  FileStager stager(FileStager::kDefaultMaxConcurrentCopies);
+  EXPECT_SUCCEEDED(stager.Stage());
+  EXPECT_EQ(0, stager.failed_file_index());
+}
+
+}  // namespace omaha
@@ -35,6 +35,7 @@
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scoped_any.h"
 #include "omaha/base/scope_guard.h"
+#include "omaha/base/startup_trace.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/system.h"
 #include "omaha/base/timer.h"
@@ -212,6 +213,8 @@ Setup::~Setup() {
 // start during Setup to exit.
 // Setup-related operations do not include installation of the app.
 HRESULT Setup::Install(bool set_keepalive) {
+  STARTUP_TRACE_PHASE("Setup::Install");
+
   SETUP_LOG(L3,
       (_T("[Admin=%d, NEAdmin=%d, Update3Svc=%d, MedSvc=%d, Machine=%d"),
        vista_util::IsUserAdmin(),
@@ -492,6 +495,7 @@ bool Setup::ShouldOverinstall() {
 }
 
 HRESULT Setup::DoProtectedBraveUpdateInstall(SetupFiles* setup_files) {
+  STARTUP_TRACE_PHASE("Setup::DoProtectedBraveUpdateInstall");
   ASSERT1(setup_files);
   SETUP_LOG(L2, (_T("[Setup::DoProtectedBraveUpdateInstall]")));
 
@@ -37,6 +37,7 @@
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/goopdate/resource_manager.h"
+#include "omaha/setup/file_stager.h"
 #include "omaha/setup/setup_metrics.h"
 
 namespace omaha {
@@ -235,15 +236,16 @@ HRESULT SetupFiles::ShouldCopyShell(const CString& shell_install_path,
   }
   *already_exists = true;
 
-  ULONGLONG existing_version = app_util::GetVersionFromFile(shell_install_path);
-  if (!existing_version) {
+  const Version existing_version(
+      app_util::GetVersionFromFile(shell_install_path));
+  if (existing_version.IsZero()) {
     ASSERT(false, (_T("[failed to get existing shell version - replacing]")));
     *should_copy = true;
     return S_OK;
   }
 
-  ULONGLONG source_version = app_util::GetVersionFromFile(source_shell_path);
-  if (!source_version) {
+  const Version source_version(app_util::GetVersionFromFile(source_shell_path));
+  if (source_version.IsZero()) {
     ASSERT(false, (_T("[failed to get this shell version - not replacing]")));
     *should_copy = false;
     return E_FAIL;
@@ -431,48 +433,29 @@ HRESULT SetupFiles::CopyAndValidateFiles(
     }
   }
 
+  FileStager stager(FileStager::kDefaultMaxConcurrentCopies);
   for (size_t i = 0; i != source_file_paths.size(); ++i) {
-    const CString& source_file = source_file_paths[i];
-    const CString& destination_file = destination_file_paths[i];
-    SETUP_LOG(L2, (_T("[CopyAndValidateFiles][from=%s][to=%s][overwrite=%d]")
-        _T("[destination file exists=%d]"), source_file, destination_file,
-        overwrite, File::Exists(destination_file)));
-
-    // 1-based; reserves 0 for success or not set.
-    extra_code1_ = static_cast<int>(i + 1);
-
-    // TODO(omaha): Reevaluate the value -- or at least, the naming -- of the
-    // overwrite flag.  As it stands, it's largely a debugging tool to force
-    // calls to File::Copy when it's not technically needed.
-    if (overwrite ||
-        !File::Exists(destination_file) ||
-        !File::AreFilesIdentical(source_file, destination_file)) {
-      HRESULT hr = File::Copy(source_file, destination_file, true);
-      if (FAILED(hr)) {
-        OPT_LOG(LE, (_T("[copy failed][from=%s][to=%s][0x%08x]"),
-                     source_file, destination_file, hr));
-        return hr;
-      }
-    }
+    stager.AddFile(source_file_paths[i], destination_file_paths[i], overwrite);
+  }
 
-    HRESULT hr = File::AreFilesIdentical(source_file, destination_file) ?
-                     S_OK : GOOPDATE_E_POST_COPY_VERIFICATION_FAILED;
+  HRESULT hr = stager.Stage();
 
-    if (FAILED(hr)) {
-      OPT_LOG(LE, (_T("[postcopy verification failed][from=%s][to=%s][0x%x]"),
-                   source_file, destination_file, hr));
+  // 1-based; reserves 0 for success or not set.
+  extra_code1_ = stager.failed_file_index();
+  if (FAILED(hr)) {
+    OPT_LOG(LE, (_T("[CopyAndValidateFiles failed][file %d][0x%08x]"),
+                 extra_code1_, hr));
+    if (hr == GOOPDATE_E_POST_COPY_VERIFICATION_FAILED) {
       ++metric_setup_files_verification_failed_post;
-      VERIFY1(SUCCEEDED(File::Remove(destination_file)));
-      return hr;
     }
+    return hr;
   }
 
-  extra_code1_ = 0;
   return S_OK;
 }
 
-bool SetupFiles::IsOlderShellVersionCompatible(ULONGLONG version) {
-  return version >= kCompatibleMinimumOlderShellVersion;
+bool SetupFiles::IsOlderShellVersionCompatible(const Version& version) {
+  return version >= Version(kCompatibleMinimumOlderShellVersion);
 }
 
 }  // namespace omaha
@@ -20,6 +20,7 @@
 #include <atlstr.h>
 #include <vector>
 #include "base/basictypes.h"
+#include "omaha/base/version.h"
 
 namespace omaha {
 
@@ -68,6 +69,7 @@ class SetupFiles {
                            bool overwrite);
 
   // Copies each file from the source path to corresponding destination path.
+  // The files are copied concurrently by a FileStager.
   // If overwrite is true, files are moved to .old and scheduled for delete
   // after reboot, which only works for elevated admins.
   HRESULT CopyAndValidateFiles(
@@ -76,7 +78,7 @@ class SetupFiles {
       bool overwrite);
 
   // Returns whether an older shell version is compatible.
-  static bool IsOlderShellVersionCompatible(ULONGLONG version);
+  static bool IsOlderShellVersionCompatible(const Version& version);
 
   const bool is_machine_;
   CString saved_shell_path_;  // Path of the previous shell saved for roll back.
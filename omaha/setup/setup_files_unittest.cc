@@ -152,7 +152,7 @@ class SetupFilesTest : public testing::Test {
   }
 
   static bool IsOlderShellVersionCompatible(ULONGLONG version) {
-    return SetupFiles::IsOlderShellVersionCompatible(version);
+    return SetupFiles::IsOlderShellVersionCompatible(Version(version));
   }
 
   // Assumes the executable version has been changed to the future version.
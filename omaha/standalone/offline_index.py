@@ -0,0 +1,116 @@
+#!/usr/bin/python2.4
+# Copyright 2014 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ========================================================================
+
+"""Writes the offline index of a standalone installer.
+
+The index lets the client find the manifests of the apps it installs without
+parsing the manifest of every app in the installer. The format is described in
+goopdate/offline_index.h, which reads it.
+"""
+
+import os
+import re
+import struct
+import uuid
+
+
+_MAGIC = b'OMIX'
+_VERSION = 1
+_HEADER_FORMAT = '<4s9I'
+_APP_ENTRY_FORMAT = '<16s2I'
+_APP_START_RE = re.compile(br'<app[\s>/]')
+_APP_ID_RE = re.compile(br'\sappid\s*=\s*"([^"]*)"')
+
+
+def _FindApps(manifest):
+  """Returns the app ids and the (start, end) ranges of the app elements."""
+  apps = []
+  start = 0
+  while True:
+    match = _APP_START_RE.search(manifest, start)
+    if not match:
+      return apps
+    start = match.start()
+    tag_end = manifest.find(b'>', start)
+    if tag_end < 0:
+      raise Exception('Manifest has an unterminated app element.')
+    if manifest[tag_end - 1:tag_end] == b'/':
+      end = tag_end + 1
+    else:
+      end = manifest.find(b'</app>', tag_end)
+      if end < 0:
+        raise Exception('Manifest has an unterminated app element.')
+      end += len(b'</app>')
+    app_id = _APP_ID_RE.search(manifest[start:tag_end])
+    if not app_id:
+      raise Exception('Manifest has an app element without an appid.')
+    apps.append((app_id.group(1).decode('ascii'), start, end))
+    start = end
+
+
+def GenerateOfflineIndex(target, manifest_path):
+  """Writes the offline index of an installer.
+
+  Args:
+    target: Target index file name.
+    manifest_path: The offline manifest of the installer, as written by
+      utils.GenerateUpdateResponseFile().
+
+  Raises:
+    Exception: When the manifest is not valid.
+  """
+  f = open(os.path.abspath(manifest_path), 'rb')
+  manifest = f.read()
+  f.close()
+
+  apps = _FindApps(manifest)
+  if not apps:
+    raise Exception('Manifest does not contain app elements.')
+
+  data = []
+  data_size = [0]
+
+  def AddText(text):
+    offset = data_size[0]
+    data.append(text)
+    data_size[0] += len(text)
+    return (offset, len(text))
+
+  prefix = AddText(manifest[:apps[0][1]])
+  suffix = AddText(manifest[apps[-1][2]:])
+
+  entries = {}
+  for (app_id, start, end) in apps:
+    guid = uuid.UUID(app_id).bytes_le
+    if guid in entries:
+      raise Exception('Manifest has app %s more than once.' % app_id)
+    entries[guid] = AddText(manifest[start:end])
+
+  app_table = []
+  for guid in sorted(entries):
+    (manifest_offset, manifest_size) = entries[guid]
+    app_table.append(struct.pack(_APP_ENTRY_FORMAT, guid,
+                                 manifest_offset, manifest_size))
+
+  apps_offset = struct.calcsize(_HEADER_FORMAT)
+  data_offset = apps_offset + len(b''.join(app_table))
+  header = struct.pack(_HEADER_FORMAT, _MAGIC, _VERSION, len(app_table),
+                       apps_offset, data_offset, data_size[0],
+                       prefix[0], prefix[1], suffix[0], suffix[1])
+
+  output_file = open(os.path.abspath(target), 'wb')
+  output_file.write(b''.join([header] + app_table + data))
+  output_file.close()
@@ -0,0 +1,168 @@
+#!/usr/bin/python2.4
+# Copyright 2014 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ========================================================================
+
+"""Tests the offline index writer by reading back the indexes it writes.
+
+The reader follows goopdate/offline_index.cc, so the tests run without a
+Windows build.
+"""
+
+import os
+import shutil
+import struct
+import sys
+import tempfile
+import unittest
+import uuid
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                '..'))
+
+from standalone import offline_index  # pylint: disable-msg=C6204
+
+
+_APP_1 = '{CDABE316-39CD-43BA-8440-6D1E0547AEE6}'
+_APP_2 = '{8E472315-1B2A-4E3A-9D2C-4E0B9E1B0A11}'
+_APP_3 = '{2D8B1A7C-0E4F-4A5B-8C6D-7E8F9A0B1C2D}'
+
+_PREFIX = (b'<?xml version="1.0" encoding="UTF-8"?>\n'
+           b'<response protocol="3.0">\n'
+           b'  <systemrequirements platform="win"/>\n  ')
+_SUFFIX = b'\n</response>\n'
+
+
+def _AppElement(app_id, body=b''):
+  """Returns an app element, which is self-closing when 'body' is empty."""
+  start = b'<app appid="' + app_id.encode('ascii') + b'" status="ok"'
+  if not body:
+    return start + b'/>'
+  return start + b'>' + body + b'</app>'
+
+
+def _ReadIndex(index):
+  """Returns the header fields, the app entries and the data of an index."""
+  header_size = struct.calcsize(offline_index._HEADER_FORMAT)
+  header = struct.unpack(offline_index._HEADER_FORMAT, index[:header_size])
+  (magic, version, num_apps, apps_offset, data_offset, data_size,
+   prefix_offset, prefix_size, suffix_offset, suffix_size) = header
+  entry_size = struct.calcsize(offline_index._APP_ENTRY_FORMAT)
+  apps = []
+  for i in range(num_apps):
+    offset = apps_offset + i * entry_size
+    apps.append(struct.unpack(offline_index._APP_ENTRY_FORMAT,
+                              index[offset:offset + entry_size]))
+  data = index[data_offset:data_offset + data_size]
+  return {
+      'magic': magic,
+      'version': version,
+      'apps_offset': apps_offset,
+      'data_offset': data_offset,
+      'data_size': data_size,
+      'prefix': data[prefix_offset:prefix_offset + prefix_size],
+      'suffix': data[suffix_offset:suffix_offset + suffix_size],
+      'apps': apps,
+      'data': data,
+      }
+
+
+def _GetBundleManifest(parsed_index, app_ids):
+  """Builds the manifest of a bundle as OfflineIndex::GetBundleManifest."""
+  manifests = {}
+  for (guid, offset, size) in parsed_index['apps']:
+    manifests[guid] = parsed_index['data'][offset:offset + size]
+  return b''.join([parsed_index['prefix']] +
+                  [manifests[uuid.UUID(app_id).bytes_le]
+                   for app_id in app_ids] +
+                  [parsed_index['suffix']])
+
+
+class OfflineIndexTest(unittest.TestCase):
+
+  def setUp(self):
+    self._dir = tempfile.mkdtemp()
+    self._manifest_path = os.path.join(self._dir, 'OfflineManifest.gup')
+    self._index_path = os.path.join(self._dir, 'OfflineIndex.dat')
+
+  def tearDown(self):
+    shutil.rmtree(self._dir)
+
+  def _GenerateIndex(self, manifest):
+    f = open(self._manifest_path, 'wb')
+    f.write(manifest)
+    f.close()
+    offline_index.GenerateOfflineIndex(self._index_path, self._manifest_path)
+    f = open(self._index_path, 'rb')
+    index = f.read()
+    f.close()
+    return _ReadIndex(index)
+
+  def testRoundTrip(self):
+    app_1 = _AppElement(_APP_1, b'<updatecheck status="ok"><urls/>'
+                                b'<manifest version="1.0"/></updatecheck>')
+    app_2 = _AppElement(_APP_2)
+    app_3 = _AppElement(_APP_3, b'<updatecheck status="noupdate"/>')
+    manifest = _PREFIX + app_1 + b'\n  ' + app_2 + b'\n  ' + app_3 + _SUFFIX
+    parsed_index = self._GenerateIndex(manifest)
+
+    self.assertEqual(b'OMIX', parsed_index['magic'])
+    self.assertEqual(1, parsed_index['version'])
+    self.assertEqual(0, parsed_index['apps_offset'] % 8)
+    self.assertEqual(_PREFIX, parsed_index['prefix'])
+    self.assertEqual(_SUFFIX, parsed_index['suffix'])
+
+    # The apps are sorted by the memory layout of their GUIDs, which is the
+    # order the client searches them in.
+    guids = [guid for (guid, _, _) in parsed_index['apps']]
+    self.assertEqual(sorted(guids), guids)
+    self.assertEqual(sorted([uuid.UUID(_APP_1).bytes_le,
+                             uuid.UUID(_APP_2).bytes_le,
+                             uuid.UUID(_APP_3).bytes_le]),
+                     guids)
+
+    self.assertEqual(_PREFIX + app_2 + _SUFFIX,
+                     _GetBundleManifest(parsed_index, [_APP_2]))
+    self.assertEqual(_PREFIX + app_3 + app_1 + _SUFFIX,
+                     _GetBundleManifest(parsed_index, [_APP_3, _APP_1]))
+
+  def testRoundTripOneApp(self):
+    app_1 = _AppElement(_APP_1, b'<updatecheck status="ok"/>')
+    parsed_index = self._GenerateIndex(_PREFIX + app_1 + _SUFFIX)
+    self.assertEqual(1, len(parsed_index['apps']))
+    self.assertEqual(_PREFIX + app_1 + _SUFFIX,
+                     _GetBundleManifest(parsed_index, [_APP_1]))
+
+  def testElementsNamedLikeAppAreNotApps(self):
+    # An element whose name starts with 'app' is not an app element.
+    app_1 = _AppElement(_APP_1, b'<appdata name="x"/><data/>')
+    parsed_index = self._GenerateIndex(_PREFIX + app_1 + _SUFFIX)
+    self.assertEqual(1, len(parsed_index['apps']))
+    self.assertEqual(_PREFIX + app_1 + _SUFFIX,
+                     _GetBundleManifest(parsed_index, [_APP_1]))
+
+  def testInvalidManifests(self):
+    invalid_manifests = [
+        _PREFIX + _SUFFIX,
+        _PREFIX + _AppElement(_APP_1) + _AppElement(_APP_1.lower()) + _SUFFIX,
+        _PREFIX + b'<app status="ok"/>' + _SUFFIX,
+        _PREFIX + b'<app appid="' + _APP_1.encode('ascii') + b'">' + _SUFFIX,
+        _PREFIX + b'<app appid="' + _APP_1.encode('ascii') + b'"',
+        ]
+    for manifest in invalid_manifests:
+      self.assertRaises(Exception, self._GenerateIndex, manifest)
+
+
+if __name__ == '__main__':
+  unittest.main()
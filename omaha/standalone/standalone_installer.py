@@ -32,6 +32,7 @@ from enterprise.installer import build_enterprise_installer
 from installers import build_metainstaller
 from installers import tag_meta_installers
 from installers import tagged_installer
+import standalone.offline_index
 import standalone.utils
 
 
@@ -150,6 +151,12 @@ def _GenerateUpdateResponseFile(target, source, env):
       has_x64_binaries=False)
 
 
+def _GenerateOfflineIndex(target, source, env):
+  """Scons wrapper for offline_index.GenerateOfflineIndex()."""
+  standalone.offline_index.GenerateOfflineIndex(str(target[0]),
+                                                str(source[0]))
+
+
 def BuildOfflineInstaller(
     env,
     offline_installer,
@@ -258,6 +265,14 @@ def BuildOfflineInstaller(
 
   additional_payload_contents.append(manifest_file_path)
 
+  # The index lets the client parse only the apps of the bundle it installs.
+  index_file_path = env.Command(
+      target=target_name + '_manifest/OfflineIndex.dat',
+      source=manifest_file_path,
+      action=[_GenerateOfflineIndex]
+      )
+  additional_payload_contents.append(index_file_path)
+
   def WriteLog(target, source, env):
     """Legacy scons wrapper for utils.WriteInstallerLog()."""
     return standalone.utils.WriteInstallerLog(
@@ -0,0 +1,108 @@
+#!/usr/bin/python
+#
+# Copyright 2014 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ========================================================================
+
+"""Aggregates the startup traces written by the Omaha processes.
+
+The processes write a trace when they exit if the UpdateDev value
+StartupTraceDir names a directory. Each trace is in the Chrome trace event
+format and can be viewed in chrome://tracing. This script reports, for each
+phase over all the traces, how long the phase took and when it started
+relative to the creation of its process.
+
+Usage:
+  startup_trace_report.py <trace file or directory> [...]
+"""
+
+import glob
+import json
+import os
+import sys
+
+
+def _ReadTraceFiles(paths):
+  """Returns the list of trace file names in paths."""
+  file_names = []
+  for path in paths:
+    if os.path.isdir(path):
+      file_names.extend(sorted(glob.glob(os.path.join(path, "*.json"))))
+    else:
+      file_names.append(path)
+  return file_names
+
+
+def _GetPhases(trace):
+  """Returns a list of (name, start_us, duration_us) for a trace.
+
+  Begin and end events are matched per thread. Phases which did not end before
+  the trace was written are not returned.
+  """
+  phases = []
+  open_phases = {}
+  for event in trace["traceEvents"]:
+    stack = open_phases.setdefault(event["tid"], [])
+    if event["ph"] == "B":
+      stack.append(event)
+    elif event["ph"] == "E" and stack and stack[-1]["name"] == event["name"]:
+      begin = stack.pop()
+      phases.append((event["name"], begin["ts"], event["ts"] - begin["ts"]))
+  return phases
+
+
+def _Percentile(sorted_values, percent):
+  index = min(len(sorted_values) - 1, len(sorted_values) * percent // 100)
+  return sorted_values[index]
+
+
+def _FormatMs(value_us):
+  return "%.1f" % (value_us / 1000.0)
+
+
+def main(argv):
+  if len(argv) < 2:
+    sys.stderr.write(__doc__)
+    return 1
+
+  file_names = _ReadTraceFiles(argv[1:])
+  durations = {}
+  starts = {}
+  for file_name in file_names:
+    trace_file = open(file_name)
+    try:
+      trace = json.load(trace_file)
+    finally:
+      trace_file.close()
+    for name, start_us, duration_us in _GetPhases(trace):
+      durations.setdefault(name, []).append(duration_us)
+      starts.setdefault(name, []).append(start_us)
+
+  print("%d traces" % len(file_names))
+  print("%-56s %6s %9s %9s %9s %9s" % (
+      "phase (ms)", "count", "start p50", "p50", "p90", "max"))
+  for name in sorted(durations, key=lambda n: sorted(starts[n])[0]):
+    values = sorted(durations[name])
+    print("%-56s %6d %9s %9s %9s %9s" % (
+        name,
+        len(values),
+        _FormatMs(_Percentile(sorted(starts[name]), 50)),
+        _FormatMs(_Percentile(values, 50)),
+        _FormatMs(_Percentile(values, 90)),
+        _FormatMs(values[-1])))
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main(sys.argv))